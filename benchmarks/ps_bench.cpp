@@ -0,0 +1,791 @@
+// Micro-benchmarks for the PostScript interpreter and the PDF parser.
+//
+// Run with --benchmark_out=results.json --benchmark_out_format=json to get
+// machine-readable results (`make bench` does this).
+
+#include "byte_scan.h"
+#include "profiler.h"
+#include "ps_batch.h"
+#include "ps_interpreter.h"
+#include "ps_parser.h"
+#include "ps_raster.h"
+#include "ps_stack.h"
+#include "pdf_filters.h"
+#include "pdf_interpreter.h"
+#include "pdf_parser.h"
+#include "pdf_text.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <ostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+
+// Discards interpreter output so benchmarks measure execution, not the terminal
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+NullBuffer nullBuffer;
+std::ostream nullStream(&nullBuffer);
+
+// A representative mix of literals, operators, procedures and strings
+std::string makeProgram(size_t lines) {
+    std::ostringstream program;
+    program << "% synthetic benchmark program\n";
+    for (size_t i = 0; i < lines; ++i) {
+        program << "/x" << i << " " << i << " def "
+                << "100 " << (i % 50) << " moveto 200 " << (i % 70) << " lineto stroke "
+                << "{ 1 2 add pop } exec (line " << i << ") pop\n";
+    }
+    return program.str();
+}
+
+// --- PSParser ---
+
+void BM_PSParserParse(benchmark::State& state) {
+    std::string program = makeProgram(static_cast<size_t>(state.range(0)));
+    PostScript::PSParser parser;
+    for (auto _ : state) {
+        std::vector<std::string> tokens = parser.parse(program);
+        benchmark::DoNotOptimize(tokens.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * program.size()));
+}
+BENCHMARK(BM_PSParserParse)->Range(16, 4096);
+
+void BM_PSTokenStream(benchmark::State& state) {
+    std::string program = makeProgram(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        PostScript::PSTokenStream tokens{std::string_view(program)};
+        std::string_view token;
+        size_t count = 0;
+        while (tokens.next(token)) {
+            ++count;
+        }
+        benchmark::DoNotOptimize(count);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * program.size()));
+}
+BENCHMARK(BM_PSTokenStream)->Range(16, 4096);
+
+// --- PSInterpreter ---
+
+void BM_ExecuteTokenDispatch(benchmark::State& state) {
+    PostScript::PSInterpreter interpreter;
+    interpreter.setOutput(nullStream);
+    for (auto _ : state) {
+        interpreter.executeToken("1");
+        interpreter.executeToken("2");
+        interpreter.executeToken("add");
+        interpreter.executeToken("dup");
+        interpreter.executeToken("exch");
+        interpreter.executeToken("pop");
+        interpreter.executeToken("pop");
+    }
+    state.SetItemsProcessed(state.iterations() * 7);
+}
+BENCHMARK(BM_ExecuteTokenDispatch);
+
+void BM_ExecuteProgram(benchmark::State& state) {
+    std::string program = makeProgram(static_cast<size_t>(state.range(0)));
+    PostScript::PSInterpreter interpreter;
+    interpreter.setOutput(nullStream);
+    for (auto _ : state) {
+        interpreter.reset();
+        interpreter.execute(program);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * program.size()));
+}
+BENCHMARK(BM_ExecuteProgram)->Range(16, 1024);
+
+// --- Batch jobs ---
+
+// A prolog of procedure definitions, as print drivers prepend to every job
+std::string makeProlog(size_t procedures) {
+    std::ostringstream prolog;
+    for (size_t i = 0; i < procedures; ++i) {
+        prolog << "/p" << i << " { " << i << " 2 mul pop newpath 0 0 moveto 10 " << i << " lineto } def\n";
+    }
+    return prolog.str();
+}
+
+const char* const BATCH_JOB = "p1 p2 p3 stroke 1 2 add pop";
+
+// An interpreter shares the sealed operator table, so creating one only builds its own state
+void BM_CreateInterpreter(benchmark::State& state) {
+    for (auto _ : state) {
+        PostScript::PSInterpreter interpreter;
+        benchmark::DoNotOptimize(&interpreter);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CreateInterpreter)->Unit(benchmark::kMicrosecond);
+
+// One job as a fresh process would run it: build an interpreter and run the prolog first
+void BM_JobFreshInterpreter(benchmark::State& state) {
+    std::string prolog = makeProlog(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        PostScript::PSInterpreter interpreter;
+        interpreter.setOutput(nullStream);
+        interpreter.execute(prolog);
+        interpreter.execute(BATCH_JOB);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_JobFreshInterpreter)->Arg(0)->Arg(100)->Arg(1000)->Unit(benchmark::kMicrosecond);
+
+// The same job on a warm interpreter, restored to its post-prolog state afterwards
+void BM_JobWarmPool(benchmark::State& state) {
+    PostScript::InterpreterPool pool(1, makeProlog(static_cast<size_t>(state.range(0))));
+    PostScript::BatchJob job;
+    job.program = BATCH_JOB;
+    for (auto _ : state) {
+        PostScript::BatchResult result = pool.run(job);
+        benchmark::DoNotOptimize(result.output.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_JobWarmPool)->Arg(0)->Arg(100)->Arg(1000)->Unit(benchmark::kMicrosecond);
+
+// save/restore around a read-only job and around one that defines a name in a
+// userdict of range(0) procedures (first change copies the dictionary)
+void BM_SaveRestore(benchmark::State& state, const char* job) {
+    PostScript::PSInterpreter interpreter;
+    interpreter.setOutput(nullStream);
+    interpreter.execute(makeProlog(static_cast<size_t>(state.range(0))));
+    const std::string program = std::string("save ") + job + " restore";
+    for (auto _ : state) {
+        interpreter.execute(program);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_SaveRestore, read, "1 2 add pop")->Arg(0)->Arg(100)->Arg(1000)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_SaveRestore, define, "/q 1 def")->Arg(0)->Arg(100)->Arg(1000)
+    ->Unit(benchmark::kMicrosecond);
+
+// --- PSStack ---
+
+void BM_StackPushPop(benchmark::State& state) {
+    const int64_t depth = state.range(0);
+    PostScript::PSStack stack;
+    for (auto _ : state) {
+        for (int64_t i = 0; i < depth; ++i) {
+            stack.push(PostScript::PSObject(static_cast<int>(i)));
+        }
+        for (int64_t i = 0; i < depth; ++i) {
+            benchmark::DoNotOptimize(stack.pop());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * depth * 2);
+}
+BENCHMARK(BM_StackPushPop)->Range(8, 4096);
+
+// --- Control flow ---
+
+void runLoop(benchmark::State& state, const std::string& program, int64_t iterationsPerRun) {
+    PostScript::PSInterpreter interpreter;
+    interpreter.setOutput(nullStream);
+    for (auto _ : state) {
+        interpreter.reset();
+        interpreter.execute(program);
+    }
+    state.SetItemsProcessed(state.iterations() * iterationsPerRun);
+}
+
+void BM_Repeat(benchmark::State& state) {
+    const int64_t count = state.range(0);
+    runLoop(state, std::to_string(count) + " { 1 2 add pop } repeat", count);
+}
+BENCHMARK(BM_Repeat)->Range(1 << 10, 1 << 16);
+
+void BM_For(benchmark::State& state) {
+    const int64_t count = state.range(0);
+    // Operands are start, end, increment
+    runLoop(state, "1 " + std::to_string(count) + " 1 { 2 mul pop } for", count);
+}
+BENCHMARK(BM_For)->Range(1 << 10, 1 << 16);
+
+void BM_Forall(benchmark::State& state) {
+    const int64_t count = state.range(0);
+    runLoop(state, std::to_string(count) + " array { pop } forall", count);
+}
+BENCHMARK(BM_Forall)->Range(1 << 10, 1 << 16);
+
+// --- Name lookup ---
+
+void BM_ProcedureLookup(benchmark::State& state) {
+    // A prolog-sized userdict, then range(0) more dictionaries on top of it
+    const int64_t depth = state.range(0);
+    std::string program;
+    for (int i = 0; i < 200; ++i) {
+        program += "/p" + std::to_string(i) + " { 1 pop } def\n";
+    }
+    for (int64_t i = 0; i < depth; ++i) {
+        program += "1 dict begin\n";
+    }
+    program += "4096 { p0 p199 p100 } repeat\n";
+    for (int64_t i = 0; i < depth; ++i) {
+        program += "end\n";
+    }
+    runLoop(state, program, 4096 * 3);
+}
+BENCHMARK(BM_ProcedureLookup)->Arg(0)->Arg(8)->Arg(32);
+
+// --- Profiling ---
+
+void BM_Profiling(benchmark::State& state) {
+    // Operator calls inside named procedures, with collection off (0) or on (1)
+    std::string program = "/inc { 1 add } def /step { inc dup pop } def 0 4096 { step } repeat pop";
+    Profiling::reset();
+    Profiling::setEnabled(state.range(0) != 0);
+    runLoop(state, program, 4096 * 5);
+    Profiling::setEnabled(false);
+}
+BENCHMARK(BM_Profiling)->Arg(0)->Arg(1);
+
+// --- Paths ---
+
+void BM_PathConstruction(benchmark::State& state) {
+    // One long path, saved and restored around every stroke
+    const int64_t count = state.range(0);
+    runLoop(state, "0 0 moveto 1 " + std::to_string(count) +
+                   " 1 { dup lineto } for gsave stroke grestore gsave fill grestore newpath", count);
+}
+BENCHMARK(BM_PathConstruction)->Range(1 << 10, 1 << 14);
+
+void BM_GsaveGrestore(benchmark::State& state) {
+    // gsave/grestore pairs over a path of range(0) segments
+    const int64_t segments = state.range(0);
+    runLoop(state, "0 0 moveto 1 " + std::to_string(segments) + " 1 { dup lineto } for " +
+                   "4096 { gsave grestore } repeat newpath", 4096);
+}
+BENCHMARK(BM_GsaveGrestore)->Arg(16)->Arg(4096);
+
+// --- Rasterization ---
+
+void runRaster(benchmark::State& state, const std::string& program, double resolution, size_t threads = 1) {
+    PostScript::RasterDevice device(612, 792, resolution);
+    device.setThreadCount(threads);
+    PostScript::PSInterpreter interpreter;
+    interpreter.setOutput(nullStream);
+    interpreter.setDevice(&device);
+    for (auto _ : state) {
+        interpreter.reset();
+        interpreter.execute(program);
+        benchmark::DoNotOptimize(device.page().pixels().data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_RasterFill(benchmark::State& state) {
+    // A page-sized disc: mostly solid spans with anti-aliased edges
+    runRaster(state, "0.2 0.4 0.8 setrgbcolor 306 396 280 0 360 arc fill", static_cast<double>(state.range(0)));
+}
+BENCHMARK(BM_RasterFill)->Arg(72)->Arg(300)->Unit(benchmark::kMicrosecond);
+
+void BM_RasterEOFill(benchmark::State& state) {
+    // A self-intersecting star, so even-odd leaves a hole
+    runRaster(state, "306 700 moveto 470 150 lineto 30 500 lineto 580 500 lineto 140 150 lineto closepath eofill",
+              static_cast<double>(state.range(0)));
+}
+BENCHMARK(BM_RasterEOFill)->Arg(72)->Arg(300)->Unit(benchmark::kMicrosecond);
+
+void BM_RasterStroke(benchmark::State& state) {
+    // A 200-segment zigzag: many thin quads and miter joins
+    std::string program = "2 setlinewidth 20 20 moveto";
+    for (int i = 1; i <= 200; ++i) {
+        program += " " + std::to_string(20 + i * 2.8) + " " + std::to_string(i % 2 ? 770 : 20) + " lineto";
+    }
+    runRaster(state, program + " stroke", static_cast<double>(state.range(0)));
+}
+BENCHMARK(BM_RasterStroke)->Arg(72)->Arg(300)->Unit(benchmark::kMicrosecond);
+
+// 400 overlapping discs and rings in varying colours
+std::string shapesProgram() {
+    std::string program;
+    for (int i = 0; i < 400; ++i) {
+        std::string x = std::to_string(40 + (i * 37) % 532), y = std::to_string(40 + (i * 53) % 712);
+        std::string radius = std::to_string(8 + i % 40);
+        program += std::to_string((i % 7) / 7.0) + " 0.5 0.6 setrgbcolor " + x + " " + y + " " + radius +
+                   (i % 2 ? " 0 360 arc fill " : " 0 360 arc closepath 3 setlinewidth stroke ");
+    }
+    return program;
+}
+
+void BM_RasterTiles(benchmark::State& state) {
+    // A 600 dpi page rendered by 1 or 4 threads
+    runRaster(state, shapesProgram(), 600, static_cast<size_t>(state.range(0)));
+}
+BENCHMARK(BM_RasterTiles)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond);
+
+void BM_DisplayListReplay(benchmark::State& state) {
+    // A 72 dpi thumbnail of a page recorded once (compare BM_DisplayListReexecute)
+    PostScript::DisplayList list;
+    PostScript::PSInterpreter interpreter;
+    interpreter.setOutput(nullStream);
+    interpreter.setRecorder(&list);
+    interpreter.execute(shapesProgram());
+
+    PostScript::RasterDevice device(612, 792, 72);
+    device.setThreadCount(1);
+    for (auto _ : state) {
+        device.replay(list);
+        benchmark::DoNotOptimize(device.page().pixels().data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DisplayListReplay)->Unit(benchmark::kMicrosecond);
+
+void BM_DisplayListReexecute(benchmark::State& state) {
+    // The same thumbnail by running the program again
+    runRaster(state, shapesProgram(), 72);
+}
+BENCHMARK(BM_DisplayListReexecute)->Unit(benchmark::kMicrosecond);
+
+void BM_DisplayListSerialize(benchmark::State& state) {
+    // Write and read back the recorded page
+    PostScript::DisplayList list;
+    PostScript::PSInterpreter interpreter;
+    interpreter.setOutput(nullStream);
+    interpreter.setRecorder(&list);
+    interpreter.execute(shapesProgram());
+
+    size_t bytes = 0;
+    for (auto _ : state) {
+        std::stringstream buffer;
+        list.write(buffer);
+        bytes = buffer.str().size();
+        PostScript::DisplayList copy = PostScript::DisplayList::read(buffer);
+        benchmark::DoNotOptimize(copy.size());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+}
+BENCHMARK(BM_DisplayListSerialize)->Unit(benchmark::kMicrosecond);
+
+// --- PDFParser ---
+
+enum class XRefFormat { Table, Stream, ObjectStreams };
+
+// Objects per object stream in XRefFormat::ObjectStreams documents
+constexpr int OBJECTS_PER_STREAM = 100;
+
+std::string deflate(const std::string& data) {
+    uLongf compressedSize = compressBound(data.size());
+    std::string compressed(compressedSize, '\0');
+    compress(reinterpret_cast<Bytef*>(&compressed[0]), &compressedSize,
+             reinterpret_cast<const Bytef*>(data.data()), data.size());
+    compressed.resize(compressedSize);
+    return compressed;
+}
+
+// Synthetic document: a catalog, a flat page tree and objectCount - 2 pages. With
+// contentLines, each page also gets a Flate-compressed content stream of that many
+// text lines (streams cannot go in object streams, so not with XRefFormat::ObjectStreams).
+std::string makePDF(int objectCount, XRefFormat format, int contentLines = 0) {
+    const int pageCount = std::max(objectCount - 2, 1);
+    std::string pdf = "%PDF-1.5\n";
+    std::vector<std::string> bodies;
+    bodies.push_back("<< /Type /Catalog /Pages 2 0 R >>");
+    std::string kids;
+    for (int i = 0; i < pageCount; ++i) {
+        kids += std::to_string(i + 3) + " 0 R ";
+    }
+    bodies.push_back("<< /Type /Pages /Kids [" + kids + "] /Count " + std::to_string(pageCount) + " >>");
+    for (int i = 0; i < pageCount; ++i) {
+        std::string contents = contentLines > 0 ? " /Contents " + std::to_string(pageCount + 3 + i) + " 0 R" : "";
+        bodies.push_back("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] /Rotate 0" + contents + " >>");
+    }
+    for (int i = 0; i < (contentLines > 0 ? pageCount : 0); ++i) {
+        std::string text = "BT\n/F1 12 Tf\n";
+        for (int line = 0; line < contentLines; ++line) {
+            text += "72 " + std::to_string(700 - line % 600) + " Td\n(Page " + std::to_string(i) + " line " +
+                    std::to_string(line) + ") Tj\n";
+        }
+        std::string data = deflate(text + "ET\n");
+        bodies.push_back("<< /Filter /FlateDecode /Length " + std::to_string(data.size()) + " >>\nstream\n" + data +
+                         "\nendstream");
+    }
+
+    std::vector<size_t> offsets;
+    auto addObject = [&](const std::string& body) {
+        offsets.push_back(pdf.size());
+        pdf += std::to_string(offsets.size()) + " 0 obj\n" + body + "\nendobj\n";
+    };
+
+    if (format == XRefFormat::Table) {
+        for (const std::string& body : bodies) {
+            addObject(body);
+        }
+        const int size = static_cast<int>(offsets.size()) + 1;
+        size_t xrefOffset = pdf.size();
+        pdf += "xref\n0 " + std::to_string(size) + "\n0000000000 65535 f \n";
+        char entry[32];
+        for (size_t offset : offsets) {
+            std::snprintf(entry, sizeof(entry), "%010zu 00000 n \n", offset);
+            pdf += entry;
+        }
+        pdf += "trailer\n<< /Size " + std::to_string(size) + " /Root 1 0 R >>\nstartxref\n" +
+               std::to_string(xrefOffset) + "\n%%EOF\n";
+        return pdf;
+    }
+
+    // Xref stream with /W [1 4 2]; the stream itself is the last object
+    std::string rows;
+    auto addRow = [&rows](int type, uint32_t field1, uint16_t field2) {
+        rows.push_back(static_cast<char>(type));
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            rows.push_back(static_cast<char>(field1 >> shift));
+        }
+        rows.push_back(static_cast<char>(field2 >> 8));
+        rows.push_back(static_cast<char>(field2));
+    };
+    addRow(0, 0, 65535);
+
+    if (format == XRefFormat::Stream) {
+        for (const std::string& body : bodies) {
+            addObject(body);
+        }
+        for (size_t offset : offsets) {
+            addRow(1, static_cast<uint32_t>(offset), 0);
+        }
+    } else {
+        // Every object goes into an object stream, numbered after the objects
+        const int objectTotal = static_cast<int>(bodies.size());
+        const int streamCount = (objectTotal + OBJECTS_PER_STREAM - 1) / OBJECTS_PER_STREAM;
+        for (int i = 0; i < objectTotal; ++i) {
+            addRow(2, static_cast<uint32_t>(objectTotal + 1 + i / OBJECTS_PER_STREAM),
+                   static_cast<uint16_t>(i % OBJECTS_PER_STREAM));
+        }
+        offsets.resize(objectTotal);
+        for (int stream = 0; stream < streamCount; ++stream) {
+            std::string header, objects;
+            const int first = stream * OBJECTS_PER_STREAM;
+            for (int i = first; i < std::min(first + OBJECTS_PER_STREAM, objectTotal); ++i) {
+                header += std::to_string(i + 1) + " " + std::to_string(objects.size()) + " ";
+                objects += bodies[i] + "\n";
+            }
+            std::string data = deflate(header + objects);
+            addRow(1, static_cast<uint32_t>(pdf.size()), 0);
+            addObject("<< /Type /ObjStm /N " + std::to_string(std::min(OBJECTS_PER_STREAM, objectTotal - first)) +
+                      " /First " + std::to_string(header.size()) + " /Filter /FlateDecode /Length " +
+                      std::to_string(data.size()) + " >>\nstream\n" + data + "\nendstream");
+        }
+    }
+
+    offsets.push_back(pdf.size());
+    addRow(1, static_cast<uint32_t>(offsets.back()), 0);
+    const int size = static_cast<int>(offsets.size()) + 1;
+    std::string compressed = deflate(rows);
+    const size_t xrefOffset = offsets.back();
+    pdf += std::to_string(offsets.size()) + " 0 obj\n<< /Type /XRef /Size " + std::to_string(size) +
+           " /W [1 4 2] /Root 1 0 R /Filter /FlateDecode /Length " + std::to_string(compressed.size()) +
+           " >>\nstream\n" + compressed + "\nendstream\nendobj\nstartxref\n" + std::to_string(xrefOffset) +
+           "\n%%EOF\n";
+    return pdf;
+}
+
+// Incremental updates that each rewrite the first page, chained through /Prev
+std::string appendUpdates(std::string pdf, int updates) {
+    const std::string size = std::to_string(std::stoi(pdf.substr(pdf.rfind("/Size ") + 6)));
+    size_t previous = std::stoul(pdf.substr(pdf.rfind("startxref") + 10));
+    for (int i = 0; i < updates; ++i) {
+        const size_t offset = pdf.size();
+        pdf += "3 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] /Rotate " +
+               std::to_string(90 * (i % 4)) + " >>\nendobj\n";
+        const size_t xrefOffset = pdf.size();
+        char entry[32];
+        std::snprintf(entry, sizeof(entry), "%010zu 00000 n \n", offset);
+        pdf += "xref\n3 1\n" + std::string(entry) + "trailer\n<< /Size " + size + " /Root 1 0 R /Prev " +
+               std::to_string(previous) + " >>\nstartxref\n" + std::to_string(xrefOffset) + "\n%%EOF\n";
+        previous = xrefOffset;
+    }
+    return pdf;
+}
+
+// Written once per size; parseFile only takes paths
+std::string writePDF(int objectCount, XRefFormat format, const std::string& suffix = "",
+                     const std::function<std::string(std::string)>& edit = nullptr, int contentLines = 0) {
+    static const char* const SUFFIX[] = {"_xref", "_xrefstm", "_objstm"};
+    std::filesystem::path path = std::filesystem::temp_directory_path() /
+        ("ps_bench_" + std::to_string(objectCount) + SUFFIX[static_cast<int>(format)] + suffix + ".pdf");
+    std::ofstream out(path, std::ios::binary);
+    std::string pdf = makePDF(objectCount, format, contentLines);
+    out << (edit ? edit(std::move(pdf)) : pdf);
+    return path.string();
+}
+
+void parsePDF(benchmark::State& state, XRefFormat format, bool lazy) {
+    const int objectCount = static_cast<int>(state.range(0));
+    std::string path = writePDF(objectCount, format);
+    PDF::PDFParser parser;
+    parser.setLazyLoading(lazy);
+    for (auto _ : state) {
+        PDF::PDFDocument document = parser.parseFile(path);
+        benchmark::DoNotOptimize(document.getLoadedObjectCount());
+    }
+    state.SetItemsProcessed(state.iterations() * objectCount);
+    std::filesystem::remove(path);
+}
+
+void BM_PDFParseXRefTable(benchmark::State& state) { parsePDF(state, XRefFormat::Table, false); }
+BENCHMARK(BM_PDFParseXRefTable)->RangeMultiplier(4)->Range(64, 16384)->Unit(benchmark::kMicrosecond);
+
+void BM_PDFParseXRefStream(benchmark::State& state) { parsePDF(state, XRefFormat::Stream, false); }
+BENCHMARK(BM_PDFParseXRefStream)->RangeMultiplier(4)->Range(64, 16384)->Unit(benchmark::kMicrosecond);
+
+void BM_PDFParseLazy(benchmark::State& state) { parsePDF(state, XRefFormat::Table, true); }
+BENCHMARK(BM_PDFParseLazy)->RangeMultiplier(4)->Range(64, 16384)->Unit(benchmark::kMicrosecond);
+
+// Resolving already-parsed objects: the page-tree and resource lookup inner loop
+void BM_PDFResolveCached(benchmark::State& state) {
+    const int objectCount = static_cast<int>(state.range(0));
+    std::string path = writePDF(objectCount, XRefFormat::Table);
+    PDF::PDFParser parser;
+    PDF::PDFDocument document = parser.parseFile(path);
+    for (auto _ : state) {
+        for (int i = 1; i <= objectCount; ++i) {
+            benchmark::DoNotOptimize(document.getObject(i));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * objectCount);
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_PDFResolveCached)->RangeMultiplier(16)->Range(64, 16384)->Unit(benchmark::kMicrosecond);
+
+// Lazy open of a 1024-object document after a chain of incremental updates
+void BM_PDFParseUpdateChain(benchmark::State& state) {
+    const int updates = static_cast<int>(state.range(0));
+    std::string path = writePDF(1024, XRefFormat::Table, "_updates" + std::to_string(updates),
+                                [updates](std::string pdf) { return appendUpdates(std::move(pdf), updates); });
+    PDF::PDFParser parser;
+    parser.setLazyLoading(true);
+    for (auto _ : state) {
+        PDF::PDFDocument document = parser.parseFile(path);
+        benchmark::DoNotOptimize(document.getObject(3));
+    }
+    state.SetItemsProcessed(state.iterations() * updates);
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_PDFParseUpdateChain)->RangeMultiplier(16)->Range(1, 4096)->Unit(benchmark::kMicrosecond);
+
+// Opening a document whose startxref is wrong: the xref is rebuilt from the object headers
+void BM_PDFReconstructXRef(benchmark::State& state) {
+    const int objectCount = static_cast<int>(state.range(0));
+    std::string path = writePDF(objectCount, XRefFormat::Table, "_damaged", [](std::string pdf) {
+        return pdf.substr(0, pdf.rfind("startxref")) + "startxref\n0\n%%EOF\n";
+    });
+    PDF::PDFParser parser;
+    parser.setLazyLoading(true);
+    for (auto _ : state) {
+        PDF::PDFDocument document = parser.parseFile(path);
+        benchmark::DoNotOptimize(document.getLoadedObjectCount());
+    }
+    state.SetItemsProcessed(state.iterations() * objectCount);
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_PDFReconstructXRef)->RangeMultiplier(4)->Range(64, 16384)->Unit(benchmark::kMicrosecond);
+
+// Every object resolved from object streams: one decode per stream
+void BM_PDFParseObjectStreams(benchmark::State& state) { parsePDF(state, XRefFormat::ObjectStreams, false); }
+BENCHMARK(BM_PDFParseObjectStreams)->RangeMultiplier(4)->Range(64, 16384)->Unit(benchmark::kMicrosecond);
+
+// Eager parse of 16384 objects in object streams, the xref split over state.range(0) threads
+void BM_PDFParseParallel(benchmark::State& state) {
+    std::string path = writePDF(16384, XRefFormat::ObjectStreams);
+    PDF::PDFParser parser;
+    parser.setThreadCount(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        PDF::PDFDocument document = parser.parseFile(path);
+        benchmark::DoNotOptimize(document.getLoadedObjectCount());
+    }
+    state.SetItemsProcessed(state.iterations() * 16384);
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_PDFParseParallel)->Arg(1)->Arg(2)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Decoding and tokenizing the content of 256 pages of 64 lines each on state.range(0) threads
+void BM_PDFTokenizePages(benchmark::State& state) {
+    std::string path = writePDF(258, XRefFormat::Table, "_contents", nullptr, 64);
+    PDF::PDFParser parser;
+    parser.setLazyLoading(true);
+    parser.setThreadCount(static_cast<size_t>(state.range(0)));
+    PDF::PDFDocument document = parser.parseFile(path);
+    for (auto _ : state) {
+        std::vector<PDF::PageTokens> pages = parser.tokenizePages(document);
+        benchmark::DoNotOptimize(pages.back().tokens.size());
+    }
+    state.SetItemsProcessed(state.iterations() * 256);
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_PDFTokenizePages)->Arg(1)->Arg(2)->Arg(4)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// Re-processing 64 text pages, as a service does with the same documents; state.range(0)
+// selects the content stream cache (0 = disabled), which hits on every iteration after the first
+void BM_PDFProcessPagesCached(benchmark::State& state) {
+    std::string path = writePDF(66, XRefFormat::Table, "_cache", nullptr, 64);
+    PDF::PDFInterpreter interpreter;
+    interpreter.setThreadCount(1);
+    if (state.range(0) == 0) {
+        interpreter.getCache().setMemoryBudget(0);
+    }
+    PDF::PDFDocument document = interpreter.getParser().parseFile(path);
+    for (auto _ : state) {
+        std::vector<PDF::PageResult> results = interpreter.processPages(document);
+        benchmark::DoNotOptimize(results.back().output.size());
+    }
+    PDF::ContentStreamCache::Stats stats = interpreter.getCache().getStats();
+    state.counters["hits"] = static_cast<double>(stats.hits);
+    state.counters["misses"] = static_cast<double>(stats.misses);
+    state.SetItemsProcessed(state.iterations() * 64);
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_PDFProcessPagesCached)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+// --- ByteScan ---
+
+// The argument is a ByteScan::Level; levels the CPU lacks are skipped
+bool useScanLevel(benchmark::State& state) {
+    auto level = static_cast<ByteScan::Level>(state.range(0));
+    if (!ByteScan::isSupported(level)) {
+        state.SkipWithError("Byte scanning level not supported on this CPU");
+        return false;
+    }
+    ByteScan::setLevel(level);
+    state.SetLabel(ByteScan::levelName(level));
+    return true;
+}
+
+void scanLevels(benchmark::internal::Benchmark* benchmark) {
+    for (ByteScan::Level level : {ByteScan::Level::Scalar, ByteScan::Level::SSE2, ByteScan::Level::AVX2,
+                                  ByteScan::Level::NEON}) {
+        if (ByteScan::isSupported(level)) {
+            benchmark->Arg(static_cast<int>(level));
+        }
+    }
+}
+
+// Indented text-extraction content, as pretty-printing producers write it
+std::string makeContentStream(size_t lines) {
+    std::ostringstream content;
+    content << "BT\n";
+    for (size_t i = 0; i < lines; ++i) {
+        content << "        /F1    12   Tf\n        72    " << (700 - i % 600) << "    Td\n"
+                << "        [(Line " << i << " of the extracted text)   -250   (continues here)]   TJ\n"
+                << "        % glyph run " << i << " ends\n";
+    }
+    content << "ET\n";
+    return content.str();
+}
+
+void BM_PDFContentTokenize(benchmark::State& state) {
+    if (!useScanLevel(state)) {
+        return;
+    }
+    std::string content = makeContentStream(4096);
+    for (auto _ : state) {
+        PDF::PDFMemorySource source{std::string_view(content)};
+        PDF::PDFContentTokenizer tokenizer(source);
+        std::string_view token;
+        size_t count = 0;
+        while (tokenizer.next(token)) {
+            ++count;
+        }
+        benchmark::DoNotOptimize(count);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * content.size()));
+}
+BENCHMARK(BM_PDFContentTokenize)->Apply(scanLevels)->Unit(benchmark::kMicrosecond);
+
+// A program dominated by procedure bodies, strings and comments
+void BM_PSTokenizeComposite(benchmark::State& state) {
+    if (!useScanLevel(state)) {
+        return;
+    }
+    std::ostringstream program;
+    for (size_t i = 0; i < 4096; ++i) {
+        program << "%% Procedure " << i << " draws one labelled box of the chart grid\n"
+                << "/box" << i << " { newpath 10 10 moveto 90 10 lineto 90 90 lineto closepath stroke } def\n"
+                << "    (Label text for box number " << i << " in the chart)    show\n";
+    }
+    std::string source = program.str();
+    for (auto _ : state) {
+        PostScript::PSTokenStream tokens{std::string_view(source)};
+        std::string_view token;
+        size_t count = 0;
+        while (tokens.next(token)) {
+            ++count;
+        }
+        benchmark::DoNotOptimize(count);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+}
+BENCHMARK(BM_PSTokenizeComposite)->Apply(scanLevels)->Unit(benchmark::kMicrosecond);
+
+// Looking for "endstream" through 1 MB of binary stream data, as when /Length is unusable
+void BM_ByteScanFindKeyword(benchmark::State& state) {
+    if (!useScanLevel(state)) {
+        return;
+    }
+    std::string data(1 << 20, '\0');
+    uint32_t seed = 1;
+    for (char& c : data) {
+        seed = seed * 1664525u + 1013904223u;
+        c = static_cast<char>(seed >> 24);
+    }
+    data += "\nendstream";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ByteScan::find(data, "endstream"));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * data.size()));
+}
+BENCHMARK(BM_ByteScanFindKeyword)->Apply(scanLevels)->Unit(benchmark::kMicrosecond);
+
+// --- Text extraction ---
+
+// The 4096-line content stream read by the text extractor
+void BM_PDFTextExtract(benchmark::State& state) {
+    std::string content = makeContentStream(4096);
+    PDF::PDFTextExtractor extractor;
+    size_t bytes = 0;
+    PDF::TextRunHandler onRun = [&bytes](const PDF::TextRun& run) { bytes += run.text.size(); };
+    for (auto _ : state) {
+        PDF::PDFMemorySource source{std::string_view(content)};
+        extractor.reset();
+        benchmark::DoNotOptimize(extractor.extract(source, onRun));
+    }
+    benchmark::DoNotOptimize(bytes);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * content.size()));
+}
+BENCHMARK(BM_PDFTextExtract)->Unit(benchmark::kMicrosecond);
+
+// The same stream executed as a page is, through the PostScript interpreter (uncached)
+void BM_PDFContentExecute(benchmark::State& state) {
+    std::string content = makeContentStream(4096);
+    PDF::PDFInterpreter interpreter;
+    interpreter.getCache().setMemoryBudget(0);
+    std::ostringstream output;
+    interpreter.getPSInterpreter().setOutput(output);
+    for (auto _ : state) {
+        interpreter.getPSInterpreter().reset();
+        output.str("");
+        interpreter.executeContentStream(content);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * content.size()));
+}
+BENCHMARK(BM_PDFContentExecute)->Unit(benchmark::kMicrosecond);
+
+} // namespace
+
+BENCHMARK_MAIN();
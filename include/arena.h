@@ -0,0 +1,220 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Memory {
+
+/**
+ * @brief Monotonic bump allocator released wholesale
+ *
+ * Memory comes from a list of chunks that grow geometrically; individual
+ * deallocation is a no-op and everything is returned when the arena is
+ * destroyed or rewound. Allocation is lock-free except when a new chunk is
+ * needed, so one arena can be shared by several threads.
+ *
+ * Arenas are reference counted: every object carved from one holds a
+ * reference, so an arena outlives all of its objects no matter who drops
+ * the last one. Create arenas with create() and hold them through ArenaRef.
+ */
+class Arena {
+public:
+    static constexpr size_t INITIAL_CHUNK_SIZE = 4 * 1024;
+    static constexpr size_t MAX_CHUNK_SIZE = 1024 * 1024;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+     * @brief Allocate uninitialized memory
+     * @param bytes Size in bytes
+     * @param alignment A power of two, at most alignof(std::max_align_t)
+     * @return Memory valid until the arena is rewound or destroyed
+     */
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    /**
+     * @brief Take a reference (one per live object, plus one per owner)
+     */
+    void retain() { refs_.fetch_add(1, std::memory_order_relaxed); }
+
+    /**
+     * @brief Drop a reference, destroying the arena when it was the last
+     */
+    void release() {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+    }
+
+    /**
+     * @brief Reuse the arena's memory from the start
+     *
+     * Only possible when the caller holds the sole reference, i.e. every
+     * object allocated from the arena has been destroyed. The largest chunk
+     * is kept for the next round; the rest are freed.
+     * @return false (and nothing changes) if objects are still alive
+     */
+    bool rewind();
+
+    /**
+     * @brief Bytes reserved from the system across all chunks
+     */
+    size_t capacity() const;
+
+    /**
+     * @brief The arena installed on this thread by ArenaScope, if any
+     */
+    static Arena* current();
+
+private:
+    friend class ArenaRef;
+    friend class ArenaScope;
+
+    struct alignas(std::max_align_t) Chunk {
+        Chunk* next;
+        size_t size;               // Usable bytes after the header
+        std::atomic<size_t> used;  // Bump offset into the usable bytes
+        char* data() { return reinterpret_cast<char*>(this + 1); }
+    };
+
+    Arena() = default;
+    ~Arena();
+
+    static Chunk* newChunk(size_t size, size_t used);
+    static void* bump(Chunk* chunk, size_t bytes, size_t alignment);
+    void* allocateSlow(size_t bytes, size_t alignment);
+
+    std::atomic<Chunk*> head_{nullptr}; // Chunk currently bumped into
+    mutable std::mutex growMutex_;      // Serializes changes to the chunk list
+    std::atomic<uint32_t> refs_{1};
+};
+
+/**
+ * @brief Owning handle to an Arena (an intrusive shared pointer)
+ */
+class ArenaRef {
+public:
+    ArenaRef() = default;
+    explicit ArenaRef(Arena* arena) : arena_(arena) {
+        if (arena_) arena_->retain();
+    }
+    ArenaRef(const ArenaRef& other) : ArenaRef(other.arena_) {}
+    ArenaRef(ArenaRef&& other) noexcept : arena_(std::exchange(other.arena_, nullptr)) {}
+    ArenaRef& operator=(ArenaRef other) noexcept {
+        std::swap(arena_, other.arena_);
+        return *this;
+    }
+    ~ArenaRef() {
+        if (arena_) arena_->release();
+    }
+
+    /**
+     * @brief Make a new, empty arena
+     */
+    static ArenaRef create();
+
+    Arena* get() const { return arena_; }
+    Arena* operator->() const { return arena_; }
+    explicit operator bool() const { return arena_ != nullptr; }
+
+    /**
+     * @brief Start over with empty memory
+     *
+     * Rewinds the arena when nothing else references it; otherwise leaves it
+     * to the objects still using it and switches to a fresh arena.
+     */
+    void recycle();
+
+private:
+    Arena* arena_ = nullptr;
+};
+
+/**
+ * @brief Installs an arena as the current thread's allocation target
+ *
+ * Code that supports arenas allocates from Arena::current() and falls back
+ * to the heap when no scope is active. The previous arena is restored when
+ * the scope ends.
+ */
+class ArenaScope {
+public:
+    /**
+     * @param arena Arena to install
+     * @param nested If false, an arena that is already installed is kept (and
+     *        left alone when the scope ends), so helper objects created during
+     *        a job allocate from the job's arena
+     */
+    explicit ArenaScope(Arena* arena, bool nested = true);
+    ~ArenaScope();
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+    /**
+     * @brief Switch the thread's allocations from one arena to another mid-scope
+     *
+     * Does nothing unless from is the installed arena. The scope that
+     * installed it still restores its own predecessor when it ends.
+     */
+    static void replace(Arena* from, Arena* to);
+
+private:
+    Arena* previous_;
+    bool installed_;
+};
+
+/**
+ * @brief Standard allocator drawing from an arena (the heap if none)
+ *
+ * A default-constructed allocator binds to Arena::current(), so containers
+ * created during a job use the job's arena without being told. Each
+ * allocator copy holds a reference, so containers and shared_ptr control
+ * blocks built with it keep their arena alive, and the allocator travels
+ * with the contents on assignment and swap.
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator() : arena_(Arena::current()) {}
+    explicit ArenaAllocator(Arena* arena) : arena_(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+    T* allocate(size_t count) {
+        if (!arena_) {
+            return static_cast<T*>(::operator new(count * sizeof(T)));
+        }
+        static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned arena object");
+        return static_cast<T*>(arena_->allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* pointer, size_t) {
+        if (!arena_) {
+            ::operator delete(pointer);
+        }
+    }
+
+    Arena* arena() const { return arena_.get(); }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena() == other.arena(); }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena() != other.arena(); }
+
+private:
+    ArenaRef arena_;
+};
+
+} // namespace Memory
+
+#endif // ARENA_H
@@ -0,0 +1,187 @@
+#ifndef BYTE_SCAN_H
+#define BYTE_SCAN_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+/**
+ * @brief Vectorized scanning for byte classes and keywords
+ *
+ * The tokenizers spend most of their time walking over runs of bytes of a
+ * known class: whitespace between tokens, the characters of a name, the
+ * body of a comment, string or stream. These functions find where such a
+ * run ends 16 or 32 bytes at a time (SSE2, AVX2 or NEON), with a scalar
+ * implementation for other targets. The NEON path is only built with
+ * PS_ENABLE_NEON_SCAN (make NEON_SCAN=1, or the CMake option of that name);
+ * it has not yet been verified on ARM hardware. The best implementation the CPU
+ * supports is picked on first use. Most runs in real files are a few bytes
+ * long, so the first bytes of a run are always tested inline and vector
+ * code is only entered for longer runs.
+ */
+namespace ByteScan {
+
+/**
+ * @brief A set of up to 16 byte values
+ *
+ * Besides a 256-entry table for the scalar path, the set keeps its members
+ * for compare-based matching and a nibble table pair for shuffle-based
+ * matching: a byte b is a member iff low[b & 15] & high[b >> 4] is nonzero,
+ * which is exact as long as the members use at most 8 distinct high nibbles.
+ */
+class ByteSet {
+public:
+    static constexpr size_t MAX_MEMBERS = 16;
+
+    /**
+     * @brief Build a set from its members (the view may contain '\0')
+     * @throws std::invalid_argument if the members do not fit the limits above
+     */
+    constexpr explicit ByteSet(std::string_view members) {
+        int highBits = 0;
+        for (char c : members) {
+            auto b = static_cast<unsigned char>(c);
+            if (table_[b]) {
+                continue;
+            }
+            if (count_ == MAX_MEMBERS) {
+                throw std::invalid_argument("ByteSet has more than 16 members");
+            }
+            table_[b] = true;
+            members_[count_++] = b;
+            if (high_[b >> 4] == 0) {
+                if (highBits == 8) {
+                    throw std::invalid_argument("ByteSet members use more than 8 high nibbles");
+                }
+                high_[b >> 4] = static_cast<uint8_t>(1u << highBits++);
+            }
+            low_[b & 15] |= high_[b >> 4];
+        }
+    }
+
+    constexpr bool contains(char c) const { return table_[static_cast<unsigned char>(c)]; }
+
+    constexpr size_t size() const { return count_; }
+    constexpr const uint8_t* members() const { return members_; }
+    constexpr const uint8_t* lowNibbles() const { return low_; }
+    constexpr const uint8_t* highNibbles() const { return high_; }
+
+private:
+    bool table_[256] = {};
+    uint8_t members_[MAX_MEMBERS] = {};
+    uint8_t low_[16] = {};
+    uint8_t high_[16] = {};
+    size_t count_ = 0;
+};
+
+/**
+ * @brief Scanning implementations, in order of preference on x86-64
+ */
+enum class Level {
+    Scalar,
+    SSE2,
+    AVX2,
+    NEON
+};
+
+namespace detail {
+
+struct Implementation {
+    Level level;
+    // Offset of the first byte of [data, data + size) that is (inSet) or is not (!inSet) in the set
+    size_t (*scan)(const char* data, size_t size, const ByteSet& set, bool inSet);
+    // Offset of the first occurrence of a keyword of at least two bytes, or size
+    size_t (*find)(const char* data, size_t size, const char* keyword, size_t keywordSize);
+};
+
+extern std::atomic<const Implementation*> current;
+
+// Pick the best implementation for this CPU and make it current
+const Implementation& select();
+
+inline const Implementation& active() {
+    const Implementation* implementation = current.load(std::memory_order_relaxed);
+    return implementation ? *implementation : select();
+}
+
+} // namespace detail
+
+/**
+ * @brief Whether a level can run on this CPU
+ */
+bool isSupported(Level level);
+
+/**
+ * @brief The implementation in use
+ */
+Level getLevel();
+
+/**
+ * @brief Force an implementation (for benchmarks and comparisons)
+ * @throws std::invalid_argument if the CPU does not support it
+ */
+void setLevel(Level level);
+
+const char* levelName(Level level);
+
+namespace detail {
+
+// Runs up to this long are scanned inline; vector code only pays off beyond
+constexpr size_t INLINE_SCAN = 16;
+
+inline size_t scan(std::string_view data, size_t pos, const ByteSet& set, bool inSet) {
+    if (pos >= data.size()) {
+        return data.size();
+    }
+    const size_t limit = data.size() - pos > INLINE_SCAN ? pos + INLINE_SCAN : data.size();
+    while (pos < limit) {
+        if (set.contains(data[pos]) == inSet) {
+            return pos;
+        }
+        ++pos;
+    }
+    if (pos == data.size()) {
+        return pos;
+    }
+    return pos + active().scan(data.data() + pos, data.size() - pos, set, inSet);
+}
+
+} // namespace detail
+
+/**
+ * @brief Skip a run of bytes in a set
+ * @return The first position at or after pos whose byte is not in the set, or data.size()
+ */
+inline size_t skipWhile(std::string_view data, size_t pos, const ByteSet& set) {
+    return detail::scan(data, pos, set, false);
+}
+
+/**
+ * @brief Skip a run of bytes not in a set
+ * @return The first position at or after pos whose byte is in the set, or data.size()
+ */
+inline size_t skipUntil(std::string_view data, size_t pos, const ByteSet& set) {
+    return detail::scan(data, pos, set, true);
+}
+
+/**
+ * @brief Find a keyword, like std::string_view::find
+ * @return Position of the first occurrence at or after pos, or std::string_view::npos
+ */
+inline size_t find(std::string_view data, std::string_view keyword, size_t pos = 0) {
+    if (pos > data.size() || keyword.size() > data.size() - pos) {
+        return std::string_view::npos;
+    }
+    if (keyword.size() < 2) {
+        return data.find(keyword, pos);
+    }
+    size_t size = data.size() - pos;
+    size_t found = detail::active().find(data.data() + pos, size, keyword.data(), keyword.size());
+    return found == size ? std::string_view::npos : pos + found;
+}
+
+} // namespace ByteScan
+
+#endif // BYTE_SCAN_H
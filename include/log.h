@@ -0,0 +1,121 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <sstream>
+#include <string>
+
+/**
+ * @brief Diagnostic logging shared by the PostScript and PDF components
+ *
+ * Messages are written through the PS_LOG_* macros, which compile to
+ * nothing unless PS_ENABLE_LOGGING is defined (make LOGGING=1, or the
+ * PS_ENABLE_LOGGING CMake option). When enabled, output goes to stderr
+ * without flushing and can be filtered at run time by level and category.
+ */
+namespace Log {
+
+/**
+ * @brief Message severity, from most to least important
+ */
+enum class Level {
+    Error,
+    Warning,
+    Info,
+    Debug,
+    Trace
+};
+
+/**
+ * @brief Subsystem a message belongs to
+ */
+enum class Category {
+    Parser,     // tokenizers and object parsing
+    XRef,       // cross-reference tables and streams
+    Exec,       // token and operator execution
+    Graphics,   // path construction and painting
+    Page        // page tree and content streams
+};
+
+/**
+ * @brief Set the most verbose level that is still written (default: Debug)
+ */
+void setLevel(Level level);
+
+/**
+ * @brief Turn a category on or off (all are on by default)
+ */
+void setCategoryEnabled(Category category, bool enabled);
+
+/**
+ * @brief Whether a message at this level and category would be written
+ */
+bool isEnabled(Category category, Level level);
+
+/**
+ * @brief Write one message line
+ *
+ * Goes to the innermost Capture of the calling thread if there is one,
+ * to stderr otherwise.
+ */
+void write(Category category, Level level, const std::string& message);
+
+/**
+ * @brief Collects the messages the current thread writes while in scope
+ *
+ * Work running in parallel (one page per worker, say) keeps its
+ * diagnostics apart this way instead of interleaving them on stderr.
+ * Captures nest; each takes the messages written while it is innermost.
+ */
+class Capture {
+public:
+    /**
+     * @param messages Receives each message as a formatted line
+     */
+    explicit Capture(std::string& messages);
+    ~Capture();
+
+    Capture(const Capture&) = delete;
+    Capture& operator=(const Capture&) = delete;
+
+private:
+    std::string* previous_;
+};
+
+} // namespace Log
+
+#ifdef PS_ENABLE_LOGGING
+
+#define PS_LOG_ENABLED(category, level) \
+    ::Log::isEnabled(::Log::Category::category, ::Log::Level::level)
+
+#define PS_LOG(level, category, message) \
+    do { \
+        if (PS_LOG_ENABLED(category, level)) { \
+            std::ostringstream psLogStream_; \
+            psLogStream_ << message; \
+            ::Log::write(::Log::Category::category, ::Log::Level::level, psLogStream_.str()); \
+        } \
+    } while (0)
+
+#else
+
+// Disabled messages are still type-checked (and keep their operands "used")
+// but sit behind a constant false condition, so no code is generated.
+#define PS_LOG_ENABLED(category, level) false
+#define PS_LOG(level, category, message) \
+    do { \
+        if (false) { \
+            std::ostringstream psLogStream_; \
+            psLogStream_ << message; \
+        } \
+    } while (0)
+
+#endif // PS_ENABLE_LOGGING
+
+#define PS_LOG_ERROR(category, message) PS_LOG(Error, category, message)
+#define PS_LOG_WARNING(category, message) PS_LOG(Warning, category, message)
+#define PS_LOG_INFO(category, message) PS_LOG(Info, category, message)
+#define PS_LOG_DEBUG(category, message) PS_LOG(Debug, category, message)
+#define PS_LOG_TRACE(category, message) PS_LOG(Trace, category, message)
+
+#endif // LOG_H
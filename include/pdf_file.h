@@ -0,0 +1,163 @@
+#ifndef PDF_FILE_H
+#define PDF_FILE_H
+
+#include "pdf_types.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <vector>
+
+namespace PDF {
+
+class PDFByteSource;
+
+/**
+ * @brief Read-only contents of a PDF file
+ *
+ * The file is memory-mapped when the platform supports it, so opening a
+ * document costs no copy at all; otherwise it is read once into an owned
+ * buffer. Everything parsed from the file can borrow slices of it (see
+ * PDFBytes), and the mapping stays alive until the last slice is released.
+ *
+ * A file opened from a PDFByteSource is sparse: view() spans the whole
+ * file, but only the ranges passed to fetch() hold its bytes (the rest
+ * reads as zeros). Fetched bytes never move, so slices of them stay valid.
+ */
+class PDFFileData : public std::enable_shared_from_this<PDFFileData> {
+public:
+    /**
+     * @brief Open a file
+     * @param filename Path to the file
+     * @param memoryMap Map the file instead of reading it into memory
+     * @return Shared handle to the file contents
+     */
+    static std::shared_ptr<const PDFFileData> open(const std::string& filename, bool memoryMap = true);
+
+    /**
+     * @brief Wrap an in-memory buffer
+     * @param bytes The file contents
+     * @return Shared handle to the contents
+     */
+    static std::shared_ptr<const PDFFileData> fromString(std::string bytes);
+
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+    /**
+     * @brief Open a file through a byte source; nothing is read until fetch()
+     * @param source Where the bytes come from
+     * @param blockSize Granularity of fetches
+     * @return Shared handle to the (sparse) contents
+     */
+    static std::shared_ptr<const PDFFileData> fromSource(std::shared_ptr<PDFByteSource> source,
+                                                         size_t blockSize = DEFAULT_BLOCK_SIZE);
+
+    ~PDFFileData();
+
+    PDFFileData(const PDFFileData&) = delete;
+    PDFFileData& operator=(const PDFFileData&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    std::string_view view() const { return std::string_view(data_, size_); }
+
+    /**
+     * @brief Whether the contents are a memory mapping rather than a copy
+     */
+    bool isMapped() const { return mapped_; }
+
+    /**
+     * @brief Whether the contents are read from a byte source as they are fetched
+     */
+    bool isSparse() const { return source_ != nullptr; }
+
+    /**
+     * @brief Make sure a range holds the file's bytes, reading whatever is missing
+     *
+     * Thread-safe. The missing blocks of the range are read in contiguous
+     * runs, one source read per run; blocks another thread is reading are
+     * waited for rather than read twice. Does nothing unless the file is sparse.
+     * @param offset Start of the range
+     * @param count Length of the range (clamped to the end of the file)
+     * @throws std::runtime_error if the source fails
+     */
+    void fetch(size_t offset, size_t count) const;
+
+    /**
+     * @brief Whether a range holds the file's bytes (always true unless sparse)
+     */
+    bool isFetched(size_t offset, size_t count) const;
+
+    /**
+     * @brief Bytes read from the source so far
+     */
+    uint64_t getFetchedBytes() const;
+
+    size_t getBlockSize() const { return blockSize_; }
+
+    /**
+     * @brief Borrow a range of the file; the range keeps the file alive
+     * @param offset Start of the range
+     * @param count Length of the range (clamped to the end of the file)
+     */
+    PDFBytes slice(size_t offset, size_t count = std::string_view::npos) const;
+
+private:
+    PDFFileData() = default;
+
+    static constexpr uint8_t MISSING = 0, READING = 1, FETCHED = 2;
+
+    // Whether blocks [first, last] are all fetched
+    bool blocksFetched(size_t first, size_t last) const;
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    bool reserved_ = false; // data_ is an anonymous mapping holding a sparse file
+    std::string buffer_; // Used when the file is not mapped
+
+    std::shared_ptr<PDFByteSource> source_;          // Sparse files only
+    size_t blockSize_ = DEFAULT_BLOCK_SIZE;
+    std::unique_ptr<std::atomic<uint8_t>[]> blocks_; // State of each block
+    mutable std::mutex fetchMutex_;
+    mutable std::condition_variable fetchDone_;
+    mutable uint64_t fetchedBytes_ = 0;
+};
+
+/**
+ * @brief Byte ranges of the objects of a sparse file, for fetching objects whole
+ *
+ * An object is taken to run from its offset to the next offset the xref
+ * lists (or the end of the file), which holds for files written object
+ * after object. fetch() widens the range when "endobj" is not inside it,
+ * so a damaged or unusual layout costs extra reads rather than bad data.
+ */
+class PDFObjectExtents {
+public:
+    /**
+     * @param offsets Offsets of the objects (and of anything else that bounds them, such as xref sections)
+     * @param fileSize Length of the file
+     */
+    PDFObjectExtents(std::vector<uint64_t> offsets, uint64_t fileSize);
+
+    /**
+     * @brief Expected length of the object at an offset (at least 1)
+     */
+    size_t lengthAt(uint64_t offset) const;
+
+    /**
+     * @brief Fetch the object at an offset whole
+     * @throws std::runtime_error if the file's source fails
+     */
+    void fetch(const PDFFileData& file, uint64_t offset) const;
+
+private:
+    std::vector<uint64_t> boundaries_; // Sorted and unique; ends with the file size
+};
+
+} // namespace PDF
+
+#endif // PDF_FILE_H
@@ -0,0 +1,247 @@
+#ifndef PDF_FILTERS_H
+#define PDF_FILTERS_H
+
+#include "pdf_types.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace PDF {
+
+/**
+ * @brief Pull-based stage of a stream decode pipeline
+ *
+ * A pipeline is a chain of filters ending in a source that reads the raw
+ * stream bytes. Each read() decodes just enough input to fill the caller's
+ * buffer, so a stream never has to exist fully decoded in memory.
+ */
+class PDFFilter {
+public:
+    virtual ~PDFFilter() = default;
+
+    /**
+     * @brief Decode up to size bytes
+     * @param buffer Destination
+     * @param size Capacity of the destination
+     * @return Number of bytes written; 0 only at the end of the data
+     */
+    virtual size_t read(char* buffer, size_t size) = 0;
+
+    /**
+     * @brief Build the decode pipeline for a stream from its /Filter and /DecodeParms
+     * @param stream The stream; its data must outlive the pipeline unless it is owned
+     * @return Filter producing the decoded bytes
+     */
+    static std::unique_ptr<PDFFilter> open(const PDFStream& stream);
+
+    /**
+     * @brief Wrap a filter stage around an input
+     * @param name Filter name, full or abbreviated (e.g. "FlateDecode", "Fl")
+     * @param input Stage to read encoded bytes from
+     * @param params The filter's /DecodeParms dictionary (may be null)
+     * @return The new stage
+     */
+    static std::unique_ptr<PDFFilter> create(const std::string& name, std::unique_ptr<PDFFilter> input,
+                                             const PDFObjectPtr& params);
+
+    /**
+     * @brief Read everything a filter produces
+     */
+    static std::string readAll(PDFFilter& filter);
+
+    /**
+     * @brief Decode a whole stream into memory
+     */
+    static std::string decodeAll(const PDFStream& stream);
+};
+
+/**
+ * @brief Pipeline source reading from bytes in memory
+ */
+class PDFMemorySource : public PDFFilter {
+public:
+    /**
+     * @brief Read from borrowed bytes (the caller keeps them alive)
+     */
+    explicit PDFMemorySource(std::string_view data) : data_(data) {}
+
+    /**
+     * @brief Read from stream data, sharing its owner
+     */
+    explicit PDFMemorySource(PDFBytes data) : bytes_(std::move(data)), data_(bytes_.view()) {}
+
+    size_t read(char* buffer, size_t size) override;
+
+private:
+    PDFBytes bytes_;
+    std::string_view data_;
+};
+
+/**
+ * @brief Incremental FlateDecode (zlib) stage
+ *
+ * Inflates with Z_NO_FLUSH straight into the caller's buffer, pulling
+ * compressed input in fixed-size chunks.
+ */
+class FlateFilter : public PDFFilter {
+public:
+    explicit FlateFilter(std::unique_ptr<PDFFilter> input);
+    ~FlateFilter() override;
+
+    size_t read(char* buffer, size_t size) override;
+
+private:
+    struct State;
+    std::unique_ptr<PDFFilter> input_;
+    std::unique_ptr<State> state_;
+};
+
+/**
+ * @brief Base for stages that decode into a small internal buffer
+ *
+ * Subclasses implement refill(), which appends the next piece of decoded
+ * output (a row, a run, a chunk of codes); read() hands it out.
+ */
+class PDFBufferedFilter : public PDFFilter {
+public:
+    explicit PDFBufferedFilter(std::unique_ptr<PDFFilter> input);
+
+    size_t read(char* buffer, size_t size) override;
+
+protected:
+    /**
+     * @brief Append more decoded bytes to out
+     * @return false once the input is exhausted and nothing was appended
+     */
+    virtual bool refill(std::string& out) = 0;
+
+    /**
+     * @brief Next encoded input byte, or -1 at the end of the input
+     */
+    int nextByte() {
+        if (inputPos_ == inputEnd_ && !fillInput()) {
+            return -1;
+        }
+        return static_cast<unsigned char>(input_[inputPos_++]);
+    }
+
+private:
+    bool fillInput();
+
+    std::unique_ptr<PDFFilter> source_;
+    std::vector<char> input_;
+    size_t inputPos_ = 0;
+    size_t inputEnd_ = 0;
+    std::string pending_;
+    size_t pendingPos_ = 0;
+    bool finished_ = false;
+};
+
+/**
+ * @brief ASCIIHexDecode stage
+ */
+class ASCIIHexFilter : public PDFBufferedFilter {
+public:
+    using PDFBufferedFilter::PDFBufferedFilter;
+
+protected:
+    bool refill(std::string& out) override;
+
+private:
+    int high_ = -1;  // First digit of an unfinished pair
+    bool done_ = false;
+};
+
+/**
+ * @brief ASCII85Decode stage
+ */
+class ASCII85Filter : public PDFBufferedFilter {
+public:
+    using PDFBufferedFilter::PDFBufferedFilter;
+
+protected:
+    bool refill(std::string& out) override;
+
+private:
+    bool done_ = false;
+};
+
+/**
+ * @brief LZWDecode stage
+ */
+class LZWFilter : public PDFBufferedFilter {
+public:
+    /**
+     * @param input Encoded input
+     * @param earlyChange The /EarlyChange parameter (1 by default)
+     */
+    LZWFilter(std::unique_ptr<PDFFilter> input, int earlyChange = 1);
+
+protected:
+    bool refill(std::string& out) override;
+
+private:
+    void resetTable();
+    int readCode();
+
+    static constexpr int MAX_CODES = 4096;
+    int earlyChange_;
+    int codeWidth_ = 9;
+    int nextCode_ = 258;
+    int previous_ = -1;
+    uint32_t bitBuffer_ = 0;
+    int bitCount_ = 0;
+    bool done_ = false;
+    std::vector<int> prefix_;
+    std::vector<unsigned char> suffix_;
+    std::vector<unsigned char> first_;
+    std::vector<int> length_;
+};
+
+/**
+ * @brief RunLengthDecode stage
+ */
+class RunLengthFilter : public PDFBufferedFilter {
+public:
+    using PDFBufferedFilter::PDFBufferedFilter;
+
+protected:
+    bool refill(std::string& out) override;
+
+private:
+    bool done_ = false;
+};
+
+/**
+ * @brief TIFF (2) and PNG (10-15) predictor stage for Flate and LZW output
+ */
+class PredictorFilter : public PDFBufferedFilter {
+public:
+    /**
+     * @param input Output of the Flate/LZW stage
+     * @param predictor The /Predictor parameter
+     * @param colors The /Colors parameter
+     * @param bitsPerComponent The /BitsPerComponent parameter
+     * @param columns The /Columns parameter
+     */
+    PredictorFilter(std::unique_ptr<PDFFilter> input, int predictor, int colors,
+                    int bitsPerComponent, int columns);
+
+protected:
+    bool refill(std::string& out) override;
+
+private:
+    int predictor_;
+    int bitsPerComponent_;
+    size_t bytesPerPixel_;
+    size_t rowBytes_;
+    std::vector<unsigned char> previousRow_;
+    std::vector<unsigned char> row_;
+};
+
+} // namespace PDF
+
+#endif // PDF_FILTERS_H
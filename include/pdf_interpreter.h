@@ -3,10 +3,27 @@
 
 #include "pdf_parser.h"
 #include "ps_interpreter.h"
+#include "pdf_page_cache.h"
+#include "pdf_text.h"
+#include <functional>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace PDF {
 
+/**
+ * @brief Result of executing one page's content streams
+ */
+struct PageResult {
+    size_t pageIndex = 0;
+    std::string output;     // Everything the page's program wrote
+    bool succeeded = true;
+    std::string error;      // Set when execution failed
+    std::string diagnostics; // Log messages written while the page ran, one per line
+};
+
 /**
  * @brief PDF interpreter that bridges PDF parsing with PostScript execution
  */
@@ -17,15 +34,63 @@ public:
 
     /**
      * @brief Process a PDF file and execute its content streams
+     *
+     * Pages are executed by processPages and their output is written to
+     * std::cout in page order, each page's diagnostics to std::clog.
      * @param filename Path to the PDF file
      */
     void processFile(const std::string& filename);
 
+    /**
+     * @brief Execute every page of a parsed document
+     *
+     * The page tree is walked once, then pages are handed out to worker
+     * threads. Each worker owns a PostScript interpreter that is reset
+     * between pages, so pages never share operand, dictionary or graphics
+     * state. The document's object cache is shared between workers. Log
+     * messages are collected per page rather than written to stderr.
+     * @param document The parsed document
+     * @return One result per page, in page order
+     */
+    std::vector<PageResult> processPages(PDFDocument& document);
+
+    /**
+     * @brief Extract the text of every page without executing its content
+     *
+     * Content streams go through PDFTextExtractor instead of the PostScript
+     * interpreter, so only text operators are looked at. Pages are scanned
+     * in order on the calling thread; a page that cannot be read is logged
+     * and skipped.
+     * @param document The parsed document
+     * @param onRun Called for each text run with the zero-based page index
+     * @return Number of runs
+     */
+    size_t extractText(PDFDocument& document, const std::function<void(size_t pageIndex, const TextRun& run)>& onRun);
+
+    /**
+     * @brief Set the number of worker threads used by processPages
+     * @param count Thread count (0 = one per hardware thread, 1 = run on the calling thread)
+     */
+    void setThreadCount(size_t count) { threadCount_ = count; }
+
+    /**
+     * @brief Number of worker threads used by processPages (0 = hardware threads)
+     */
+    size_t getThreadCount() const { return threadCount_; }
+
     /**
      * @brief Execute a PDF content stream using the PostScript interpreter
      * @param streamData The content stream data
      */
-    void executeContentStream(const std::string& streamData);
+    void executeContentStream(std::string_view streamData);
+
+    /**
+     * @brief Get the cache of executed content streams
+     *
+     * Shared by all page workers; use setMemoryBudget(0) to disable it.
+     * @return Reference to the cache
+     */
+    ContentStreamCache& getCache() { return cache_; }
 
     /**
      * @brief Get access to the underlying PostScript interpreter
@@ -42,25 +107,58 @@ public:
 private:
     PDFParser parser_;
     PostScript::PSInterpreter psInterpreter_;
+    size_t threadCount_ = 0;
+    ContentStreamCache cache_;
 
     /**
      * @brief Map PDF operators to PostScript equivalents
      * @param pdfOperator The PDF operator name
      * @return The corresponding PostScript operator name, or empty if no mapping
      */
-    std::string mapPDFOperatorToPS(const std::string& pdfOperator);
+    static std::string mapPDFOperatorToPS(const std::string& pdfOperator);
+
+    /**
+     * @brief Execute a content stream on a given interpreter, through the cache
+     *
+     * The operand stack the stream starts from is part of the key and the
+     * operands it leaves are stored, so a page whose unmapped operators
+     * leave values behind is cached as well. Streams are not cached when
+     * they use the dictionary stack, or when an operand is a composite
+     * other than a string.
+     * @param content Identity of the stream's bytes
+     * @param resourcesHash Hash of the resources the stream is executed with
+     * @param interpreter Interpreter to run the stream on
+     * @param openSource Builds the pipeline producing the decoded stream (not called on a hit)
+     */
+    void executeContentStream(const ContentStreamCache::Content& content, uint64_t resourcesHash,
+                              PostScript::PSInterpreter& interpreter,
+                              const std::function<std::unique_ptr<PDFFilter>()>& openSource);
+
+    /**
+     * @brief Execute a content stream without consulting the cache
+     * @param source Decoded content stream bytes
+     * @param interpreter Interpreter to run the stream on
+     */
+    static void runContentStream(PDFFilter& source, PostScript::PSInterpreter& interpreter);
 
     /**
-     * @brief Process a PDF page object
+     * @brief Execute all content streams of a page
+     * @param document Document used to resolve references
      * @param pageObject The page object to process
+     * @param interpreter Interpreter to run the page on
+     * @param resourceHashes Resource hashes by object number, kept by the caller for the document
      */
-    void processPage(const PDFObjectPtr& pageObject);
+    void processPage(PDFDocument& document, const PDFObjectPtr& pageObject,
+                     PostScript::PSInterpreter& interpreter, std::unordered_map<int, uint64_t>& resourceHashes);
 
     /**
-     * @brief Process a PDF content stream object
+     * @brief Execute one content stream object, decoding it on demand
      * @param streamObject The stream object to process
+     * @param resourcesHash Hash of the page resources
+     * @param interpreter Interpreter to run the stream on
      */
-    void processStream(const PDFObjectPtr& streamObject);
+    void processStream(const PDFObjectPtr& streamObject, uint64_t resourcesHash,
+                       PostScript::PSInterpreter& interpreter);
 };
 
 } // namespace PDF
@@ -0,0 +1,150 @@
+#ifndef PDF_OBJECT_STREAM_H
+#define PDF_OBJECT_STREAM_H
+
+#include "pdf_types.h"
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace PDF {
+
+/**
+ * @brief A decoded object stream (/Type /ObjStm) and the index from its header
+ *
+ * The stream data starts with /N pairs of integers, each an object number
+ * and the offset of that object relative to /First; the objects follow.
+ * Decoding inflates the data and reads the header once; each object is
+ * then parsed straight from the decoded bytes on request.
+ */
+class ObjectStream {
+public:
+    /**
+     * @brief Decode a stream's data and index its header
+     * @param stream The object stream
+     * @return The decoded stream
+     * @throws std::runtime_error if /N or /First is missing or the header is unreadable
+     */
+    static std::shared_ptr<const ObjectStream> decode(const PDFStream& stream);
+
+    /**
+     * @brief Number of objects in the header
+     */
+    size_t size() const { return entries_.size(); }
+
+    /**
+     * @brief Object number of the object at an index
+     */
+    int objectNumber(size_t index) const { return entries_[index].first; }
+
+    /**
+     * @brief Find where an object is stored
+     * @param objectNumber Object to look for
+     * @param hint Expected index (from the xref entry), checked first
+     * @return Its index, or size() if the stream does not hold it
+     */
+    size_t find(int objectNumber, size_t hint) const;
+
+    /**
+     * @brief Parse one object from the decoded data
+     * @param index Index into the header
+     * @return The object (a null object if it is malformed)
+     */
+    PDFObjectPtr parseObject(size_t index) const;
+
+    /**
+     * @brief Estimated memory held, for cache budgeting
+     */
+    size_t memoryUsage() const;
+
+private:
+    std::string data_;                             // Decoded stream data
+    std::vector<std::pair<int, size_t>> entries_;  // Object number, offset into data_
+};
+
+/**
+ * @brief Decoded object streams of one document, keyed by stream object number
+ *
+ * Resolving an object stored in an object stream needs the whole stream
+ * decoded; the cache keeps decoded streams so that resolving every object
+ * in a stream costs one decode. Concurrent requests for a stream that is
+ * being decoded wait for that decode instead of starting their own.
+ * Streams are evicted least-recently-used first once the memory budget is
+ * exceeded. All methods are thread-safe.
+ */
+class ObjectStreamCache {
+public:
+    using Loader = std::function<std::shared_ptr<const ObjectStream>()>;
+
+    /**
+     * @brief Usage counters
+     */
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t decodes = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;     // Estimated memory held by decoded streams
+    };
+
+    static constexpr size_t DEFAULT_MEMORY_BUDGET = 32 * 1024 * 1024;
+
+    /**
+     * @brief Create a cache
+     * @param memoryBudget Maximum estimated bytes held (0 decodes on every request)
+     */
+    explicit ObjectStreamCache(size_t memoryBudget = DEFAULT_MEMORY_BUDGET);
+
+    /**
+     * @brief Get a decoded stream, decoding it on first use
+     * @param streamNumber Object number of the object stream
+     * @param load Decodes the stream; only called on a miss, outside the lock
+     * @return The decoded stream
+     * @throws Whatever load throws, to every request waiting on that decode
+     */
+    std::shared_ptr<const ObjectStream> get(int streamNumber, const Loader& load);
+
+    /**
+     * @brief Change the memory budget, evicting streams if needed
+     * @param bytes New budget (0 disables caching)
+     */
+    void setMemoryBudget(size_t bytes);
+
+    size_t getMemoryBudget() const;
+
+    Stats getStats() const;
+
+    /**
+     * @brief Drop all decoded streams (counters are kept)
+     */
+    void clear();
+
+private:
+    using Value = std::shared_ptr<const ObjectStream>;
+
+    struct Node {
+        int streamNumber;
+        uint64_t id;                      // Tells a reinserted stream from an evicted one
+        std::shared_future<Value> value;  // Ready once the decode finishes
+        size_t bytes;                     // 0 while decoding
+    };
+
+    void evictToBudget();
+
+    mutable std::mutex mutex_;
+    std::list<Node> lru_;  // Most recently used at the front
+    std::unordered_map<int, std::list<Node>::iterator> index_;
+    size_t memoryBudget_;
+    uint64_t nextId_ = 0;
+    Stats stats_;
+};
+
+} // namespace PDF
+
+#endif // PDF_OBJECT_STREAM_H
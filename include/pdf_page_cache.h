@@ -0,0 +1,214 @@
+#ifndef PDF_PAGE_CACHE_H
+#define PDF_PAGE_CACHE_H
+
+#include "pdf_types.h"
+#include "ps_stack.h"
+#include "ps_types.h"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace PDF {
+
+/**
+ * @brief Content-addressed cache of executed content streams
+ *
+ * Entries are keyed by the stream's content (for stream objects, the
+ * encoded bytes and dictionary) together with everything else that can
+ * change the result: the page resources, the graphics state and the
+ * operand stack the stream starts from. The content is identified by two
+ * independently seeded 64-bit hashes plus its length, all compared on
+ * lookup, so one colliding hash cannot replay another stream. Resources
+ * are hashed with their references followed (see hashResolved), so equal
+ * pages of different documents share entries whatever their object
+ * numbers. A hit replays the stored output, final graphics state and the
+ * operands the stream left, without tokenizing or executing it. Entries
+ * are evicted least-recently-used first once the memory budget is
+ * exceeded. All methods are thread-safe.
+ */
+class ContentStreamCache {
+public:
+    /**
+     * @brief Identity of a stream's bytes
+     */
+    struct Content {
+        uint64_t hash = 0;   // hashObject of the stream object, or hashBytes of raw data
+        uint64_t check = 0;  // Second hash of the bytes, with another seed
+        uint64_t length = 0; // Number of bytes
+        bool operator==(const Content& other) const {
+            return hash == other.hash && check == other.check && length == other.length;
+        }
+    };
+
+    struct Key {
+        Content content;
+        uint64_t context = 0; // Resources, graphics state and operand stack the stream starts from
+        bool operator==(const Key& other) const { return content == other.content && context == other.context; }
+    };
+
+    /**
+     * @brief An operand a stream left on the stack, held apart from any interpreter
+     *
+     * Only operands without shared storage of their own to preserve are
+     * cached: numbers, booleans, names, null and strings.
+     */
+    struct Operand {
+        PostScript::ObjectType type = PostScript::ObjectType::NULL_OBJECT;
+        double number = 0.0; // INTEGER, REAL and BOOLEAN values
+        std::string text;    // STRING contents or NAME text
+    };
+
+    /**
+     * @brief What executing a stream produced
+     */
+    struct Entry {
+        std::string output;                                  // Text written to the interpreter output
+        std::vector<PostScript::GraphicsState> graphicsStack; // Graphics state stack afterwards
+        size_t keptOperands = 0;                             // Operands at the bottom the stream left alone
+        std::vector<Operand> operands;                       // Operands above those afterwards
+    };
+
+    /**
+     * @brief Usage counters
+     */
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t insertions = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;     // Estimated memory held by entries
+    };
+
+    static constexpr size_t DEFAULT_MEMORY_BUDGET = 64 * 1024 * 1024;
+
+    /**
+     * @brief Create a cache
+     * @param memoryBudget Maximum estimated bytes held (0 disables caching)
+     */
+    explicit ContentStreamCache(size_t memoryBudget = DEFAULT_MEMORY_BUDGET);
+
+    /**
+     * @brief Look up an entry and mark it most recently used
+     * @param key Key from makeKey
+     * @return The entry, or nullptr on a miss
+     */
+    std::shared_ptr<const Entry> find(const Key& key);
+
+    /**
+     * @brief Store an entry, evicting old ones to stay within the budget
+     * @param key Key from makeKey
+     * @param entry Result to store (dropped if larger than the whole budget)
+     */
+    void insert(const Key& key, Entry entry);
+
+    /**
+     * @brief Change the memory budget, evicting entries if needed
+     * @param bytes New budget (0 disables caching)
+     */
+    void setMemoryBudget(size_t bytes);
+
+    size_t getMemoryBudget() const;
+    bool isEnabled() const { return getMemoryBudget() > 0; }
+
+    Stats getStats() const;
+
+    /**
+     * @brief Drop all entries (counters are kept)
+     */
+    void clear();
+
+    /**
+     * @brief Identify raw content stream bytes
+     */
+    static Content hashContent(std::string_view data);
+
+    /**
+     * @brief Identify a stream object by its dictionary and encoded bytes
+     */
+    static Content hashStream(const PDFObjectPtr& streamObject);
+
+    /**
+     * @brief Build the cache key for a stream execution
+     * @param content Identity of the stream (hashContent or hashStream)
+     * @param resourcesHash Hash of the page resources (see hashResolved)
+     * @param graphicsStack Graphics state stack the stream starts from
+     * @param operandsHash Hash of the operand stack the stream starts from (see hashOperands)
+     */
+    static Key makeKey(const Content& content, uint64_t resourcesHash,
+                       const std::vector<PostScript::GraphicsState>& graphicsStack, uint64_t operandsHash);
+
+    /**
+     * @brief Hash the values on an operand stack
+     * @param hash Set to the hash
+     * @return false if an operand is of a type Operand cannot hold
+     */
+    static bool hashOperands(const PostScript::PSStack& operands, uint64_t& hash);
+
+    /**
+     * @brief Record the operands from index first up, for an Entry
+     * @return false if an operand is of a type Operand cannot hold
+     */
+    static bool saveOperands(const PostScript::PSStack& operands, size_t first, std::vector<Operand>& saved);
+
+    /**
+     * @brief Push recorded operands
+     */
+    static void restoreOperands(const std::vector<Operand>& saved, PostScript::PSStack& operands);
+
+    /**
+     * @brief Fast non-cryptographic 64-bit hash of a byte range
+     */
+    static uint64_t hashBytes(std::string_view data, uint64_t seed = 0);
+
+    /**
+     * @brief Structural hash of a PDF object
+     *
+     * References are hashed by object and generation number, not followed.
+     */
+    static uint64_t hashObject(const PDFObjectPtr& object, uint64_t seed = 0);
+
+    /**
+     * @brief Structural hash of a PDF object and everything it refers to
+     *
+     * References are resolved through the document and hashed by what they
+     * point to, so the hash does not depend on object numbering.
+     * @param document Document the references belong to
+     * @param object Object to hash
+     * @param memo Hashes of the objects visited so far, by object number;
+     *             keep it across calls for the same document to hash shared objects once
+     */
+    static uint64_t hashResolved(PDFDocument& document, const PDFObjectPtr& object,
+                                 std::unordered_map<int, uint64_t>& memo);
+
+private:
+    struct Node {
+        Key key;
+        std::shared_ptr<const Entry> entry;
+        size_t bytes;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const { return static_cast<size_t>(key.content.hash ^ key.context); }
+    };
+
+    static uint64_t hashResolved(PDFDocument& document, const PDFObjectPtr& object,
+                                 std::unordered_map<int, uint64_t>& memo, uint64_t seed, int depth);
+    static size_t entrySize(const Entry& entry);
+    void evictToBudget();
+
+    mutable std::mutex mutex_;
+    std::list<Node> lru_;  // Most recently used at the front
+    std::unordered_map<Key, std::list<Node>::iterator, KeyHash> index_;
+    size_t memoryBudget_;
+    Stats stats_;
+};
+
+} // namespace PDF
+
+#endif // PDF_PAGE_CACHE_H
@@ -2,12 +2,28 @@
 #define PDF_PARSER_H
 
 #include "pdf_types.h"
+#include "pdf_filters.h"
 #include <string>
-#include <fstream>
+#include <istream>
 #include <memory>
+#include <string_view>
+#include <vector>
 
 namespace PDF {
 
+class PDFByteSource;
+class PDFFileData;
+
+/**
+ * @brief Tokens of every content stream of one page, in order
+ */
+struct PageTokens {
+    size_t pageIndex = 0;
+    std::vector<std::string> tokens;
+    bool succeeded = true;
+    std::string error;      // Set when a content stream could not be decoded
+};
+
 /**
  * @brief PDF parser class for parsing PDF files and objects
  */
@@ -16,13 +32,70 @@ public:
     PDFParser();
     ~PDFParser() = default;
 
+    /**
+     * @brief Choose between memory-mapping the file (default) and reading it into memory
+     * @param enabled true to map files; stream data then borrows from the mapping
+     */
+    void setMemoryMapped(bool enabled) { memoryMapped_ = enabled; }
+
+    /**
+     * @brief Whether files are memory-mapped
+     */
+    bool isMemoryMapped() const { return memoryMapped_; }
+
+    /**
+     * @brief Enable lazy loading
+     *
+     * In lazy mode parseFile only reads the xref and trailer; objects are
+     * parsed when first resolved through the returned document.
+     * @param enabled true to defer object parsing
+     */
+    void setLazyLoading(bool enabled) { lazyLoading_ = enabled; }
+
+    /**
+     * @brief Whether lazy loading is enabled
+     */
+    bool isLazyLoading() const { return lazyLoading_; }
+
+    /**
+     * @brief Set the number of threads used by parseFile and tokenizePages
+     *
+     * With more than one thread, parseFile splits the xref into ranges of
+     * object numbers and parses the ranges concurrently. Every object is
+     * stored in its own xref slot, so the table is filled without locking;
+     * objects in object streams still share one decode per stream. Lazy
+     * parsing is unaffected.
+     * @param count Thread count (0 = one per hardware thread, 1 = parse on the calling thread)
+     */
+    void setThreadCount(size_t count) { threadCount_ = count; }
+
+    /**
+     * @brief Number of threads used by parseFile and tokenizePages (0 = hardware threads)
+     */
+    size_t getThreadCount() const { return threadCount_; }
+
     /**
      * @brief Parse a PDF file and return the document structure
-     * @param filename Path to the PDF file
+     *
+     * An http:// URL is read through an HTTPRangeSource (see parseSource).
+     * @param filename Path to the PDF file, or its URL
      * @return PDFDocument containing the parsed structure
      */
     PDFDocument parseFile(const std::string& filename);
 
+    /**
+     * @brief Parse a PDF file read through a byte source
+     *
+     * Only the ranges the parser needs are read: the end of the file, the
+     * xref sections, and then each object as it is resolved (or everything
+     * at once unless lazy loading is on). The source is read from other
+     * threads as well, through the document and any PDFPrefetcher.
+     * @param source Where the bytes come from
+     * @param name Name used in log messages
+     * @return PDFDocument whose file is sparse (see PDFFileData::fromSource)
+     */
+    PDFDocument parseSource(std::shared_ptr<PDFByteSource> source, const std::string& name = "byte source");
+
     /**
      * @brief Parse a PDF object from a string
      * @param input String containing PDF object syntax
@@ -32,10 +105,24 @@ public:
 
     /**
      * @brief Parse a PDF content stream
+     *
+     * Collects every token at once; use PDFContentTokenizer to stream them.
      * @param streamData The content stream data
      * @return Vector of tokens from the content stream
      */
-    std::vector<std::string> parseContentStream(const std::string& streamData);
+    static std::vector<std::string> parseContentStream(std::string_view streamData);
+
+    /**
+     * @brief Decode and tokenize the content streams of every page
+     *
+     * Pages are spread over the threads set with setThreadCount; each page's
+     * streams are decoded through their filters and tokenized as with
+     * PDFContentTokenizer. A page whose content cannot be decoded reports
+     * the error without affecting the others.
+     * @param document Parsed (or lazily opened) document
+     * @return One entry per page, in document order
+     */
+    std::vector<PageTokens> tokenizePages(PDFDocument& document) const;
 
     /**
      * @brief Parse an object from a stream (helper method)
@@ -44,104 +131,137 @@ public:
      */
     PDFObjectPtr parseObjectFromStream(std::istream& stream);
 
-private:
-    /**
-     * @brief Parse the PDF header and version
-     * @param file Input file stream
-     */
-    void parseHeader(std::ifstream& file);
-
-    /**
-     * @brief Parse the xref table
-     * @param file Input file stream
-     * @param document Document to populate
-     */
-    void parseXRef(std::ifstream& file, PDFDocument& document);
+    // --- Object lexer ---
+    // Single-pass recursive-descent parsing over raw bytes. Each function
+    // starts at pos and leaves pos just past what it consumed.
 
     /**
-     * @brief Parse the trailer dictionary
-     * @param file Input file stream
-     * @param document Document to populate
+     * @brief Deepest nesting of arrays and dictionaries the lexer accepts
      */
-    void parseTrailer(std::ifstream& file, PDFDocument& document);
+    static constexpr int MAX_NESTING_DEPTH = 256;
 
     /**
-     * @brief Parse an indirect object
-     * @param file Input file stream
-     * @param objectNumber Object number
-     * @param generation Generation number
-     * @return Parsed PDF object
+     * @brief Parse any direct object, including "n g R" references
+     * @param data Bytes to parse
+     * @param pos Current position, advanced past the object
+     * @param depth Arrays and dictionaries enclosing the object
+     * @return Parsed PDF object (null object at end of data)
+     * @throws std::runtime_error if nesting exceeds MAX_NESTING_DEPTH
      */
-    PDFObjectPtr parseIndirectObject(std::ifstream& file, int objectNumber, int generation);
+    static PDFObjectPtr parseValue(std::string_view data, size_t& pos, int depth = 0);
 
     /**
-     * @brief Parse a dictionary
-     * @param file Input file stream
+     * @brief Parse a dictionary starting at "<<"
+     * @param data Bytes to parse
+     * @param pos Current position, advanced past ">>"
+     * @param depth Arrays and dictionaries enclosing this one
      * @return Parsed dictionary
      */
-    PDFDictionary parseDictionary(std::ifstream& file);
+    static PDFDictionary parseDictionary(std::string_view data, size_t& pos, int depth = 0);
 
     /**
-     * @brief Parse an array
-     * @param file Input file stream
+     * @brief Parse an array starting at "["
+     * @param data Bytes to parse
+     * @param pos Current position, advanced past "]"
+     * @param depth Arrays and dictionaries enclosing this one
      * @return Parsed array
      */
-    PDFArray parseArray(std::ifstream& file);
+    static PDFArray parseArray(std::string_view data, size_t& pos, int depth = 0);
 
     /**
      * @brief Parse a string (literal or hexadecimal)
-     * @param file Input file stream
-     * @return Parsed string
+     * @param data Bytes to parse
+     * @param pos Current position at "(" or "<"
+     * @return Parsed string with escapes / hex digits decoded
      */
-    PDFString parseString(std::ifstream& file);
+    static PDFString parseString(std::string_view data, size_t& pos);
 
     /**
-     * @brief Parse a name
-     * @param file Input file stream
-     * @return Parsed name
+     * @brief Parse a name starting at "/"
+     * @param data Bytes to parse
+     * @param pos Current position, advanced past the name
+     * @return Parsed name with #xx escapes decoded
      */
-    PDFName parseName(std::ifstream& file);
+    static PDFName parseName(std::string_view data, size_t& pos);
 
     /**
      * @brief Parse a number (integer or real)
-     * @param file Input file stream
+     * @param data Bytes to parse
+     * @param pos Current position, advanced past the number
      * @return Parsed number object
      */
-    PDFObjectPtr parseNumber(std::ifstream& file);
+    static PDFObjectPtr parseNumber(std::string_view data, size_t& pos);
 
     /**
-     * @brief Parse a reference
-     * @param file Input file stream
-     * @return Parsed reference
+     * @brief Read a bare keyword (obj, stream, R, true, ...)
+     * @param data Bytes to parse
+     * @param pos Current position, advanced past the keyword
+     * @return View of the keyword (empty if pos is at a delimiter)
      */
-    PDFReference parseReference(std::ifstream& file);
+    static std::string_view readKeyword(std::string_view data, size_t& pos);
 
     /**
      * @brief Skip whitespace and comments
-     * @param file Input file stream
-     */
-    void skipWhitespace(std::ifstream& file);
-
-    /**
-     * @brief Read a token (word or delimiter)
-     * @param file Input file stream
-     * @return Token string
+     * @param data Bytes to scan
+     * @param pos Current position, advanced to the next token
      */
-    std::string readToken(std::ifstream& file);
+    static void skipWhitespace(std::string_view data, size_t& pos);
 
     /**
      * @brief Check if character is whitespace
      * @param c Character to check
      * @return true if whitespace
      */
-    bool isWhitespace(char c) const;
+    static bool isWhitespace(char c);
 
     /**
      * @brief Check if character is a delimiter
      * @param c Character to check
      * @return true if delimiter
      */
-    bool isDelimiter(char c) const;
+    static bool isDelimiter(char c);
+
+private:
+    PDFDocument parseData(std::shared_ptr<const PDFFileData> file, const std::string& filename);
+
+    bool memoryMapped_ = true;
+    bool lazyLoading_ = false;
+    size_t threadCount_ = 1;
+};
+
+/**
+ * @brief Incremental tokenizer for decoded content streams
+ *
+ * Pulls decoded bytes from a filter pipeline one chunk at a time and splits
+ * them into whitespace-separated tokens, skipping % comments. Only the
+ * current chunk (plus any token straddling it) is held in memory.
+ */
+class PDFContentTokenizer {
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 16 * 1024;
+
+    /**
+     * @brief Tokenize the output of a filter
+     * @param source Decoded bytes (must outlive the tokenizer)
+     * @param chunkSize Bytes requested from the source per read
+     */
+    explicit PDFContentTokenizer(PDFFilter& source, size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+    /**
+     * @brief Read the next token
+     * @param token Set to the token; valid until the next call
+     * @return false at the end of the stream
+     */
+    bool next(std::string_view& token);
+
+private:
+    bool fill();
+
+    PDFFilter& source_;
+    size_t chunkSize_;
+    std::string buffer_;
+    size_t pos_ = 0;
+    bool eof_ = false;
 };
 
 } // namespace PDF
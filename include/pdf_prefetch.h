@@ -0,0 +1,93 @@
+#ifndef PDF_PREFETCH_H
+#define PDF_PREFETCH_H
+
+#include "pdf_types.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <vector>
+
+namespace PDF {
+
+/**
+ * @brief Fetches the objects a page needs from a sparse file in batched rounds
+ *
+ * Resolving a page of a document on network storage one object at a time
+ * costs a round trip per object. The prefetcher works level by level
+ * instead: it takes every reference of the current level that is not
+ * loaded yet, fetches their byte ranges in parallel (ranges that are close
+ * together are merged into one read), parses the objects, and moves on to
+ * the references they contain. A page then costs one round per level of
+ * the page tree, plus one per level below its /Contents and /Resources,
+ * however many objects each level holds.
+ *
+ * Every call is thread-safe. For documents that are not sparse nothing is
+ * fetched; the objects are only parsed.
+ */
+class PDFPrefetcher {
+public:
+    static constexpr size_t DEFAULT_IO_THREADS = 8;
+
+    /**
+     * @brief Levels of references followed below a page's /Contents and /Resources
+     */
+    static constexpr int MAX_DEPTH = 4;
+
+    struct Stats {
+        uint64_t rounds = 0;   // Batches of reads waited for
+        uint64_t reads = 0;    // Merged ranges fetched
+        uint64_t objects = 0;  // Objects parsed by the prefetcher
+    };
+
+    /**
+     * @param document Document to fetch for; must outlive the prefetcher
+     * @param ioThreads Reads in flight at once
+     */
+    explicit PDFPrefetcher(PDFDocument& document, size_t ioThreads = DEFAULT_IO_THREADS);
+
+    PDFPrefetcher(const PDFPrefetcher&) = delete;
+    PDFPrefetcher& operator=(const PDFPrefetcher&) = delete;
+
+    /**
+     * @brief Fetch and parse a page with its contents and resources; blocks until done
+     * @param index Zero-based page index
+     * @return The page dictionary, or nullptr if out of range
+     * @throws std::runtime_error if the file's source fails
+     */
+    PDFObjectPtr fetchPage(size_t index);
+
+    /**
+     * @brief Start fetchPage on the prefetcher's threads
+     */
+    std::future<PDFObjectPtr> prefetchPage(size_t index);
+
+    /**
+     * @brief Fetch and parse the whole page tree, one round per level
+     *
+     * Afterwards PDFDocument::getPages needs no reads.
+     */
+    void fetchPageTree();
+
+    /**
+     * @brief Fetch and parse a set of objects in one round
+     * @param objectNumbers Objects to load; loaded or unknown ones are skipped
+     */
+    void fetchObjects(const std::vector<int>& objectNumbers);
+
+    Stats getStats() const;
+
+private:
+    // Fetch the object a dictionary entry refers to, then resolve the entry
+    PDFObjectPtr fetchEntry(const PDFObjectPtr& dictionary, const char* key);
+
+    PDFDocument& document_;
+    Threading::ThreadPool threads_;
+    std::atomic<uint64_t> rounds_{0};
+    std::atomic<uint64_t> reads_{0};
+    std::atomic<uint64_t> objects_{0};
+};
+
+} // namespace PDF
+
+#endif // PDF_PREFETCH_H
@@ -0,0 +1,127 @@
+#ifndef PDF_SOURCE_H
+#define PDF_SOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace PDF {
+
+/**
+ * @brief Random-access bytes of a file that cannot (or should not) be mapped
+ *
+ * A source backs a sparse PDFFileData (see PDFFileData::fromSource): only
+ * the ranges the parser touches are read, so a document on network storage
+ * costs a few range reads rather than a download. Local files are normally
+ * memory-mapped instead, which needs no source at all.
+ */
+class PDFByteSource {
+public:
+    virtual ~PDFByteSource() = default;
+
+    /**
+     * @brief Total length of the file
+     */
+    virtual uint64_t size() const = 0;
+
+    /**
+     * @brief Read a range; called from several threads at once
+     * @param offset Start of the range
+     * @param count Number of bytes (the range lies within size())
+     * @param buffer Receives exactly count bytes
+     * @throws std::runtime_error if the range cannot be read in full
+     */
+    virtual void read(uint64_t offset, size_t count, char* buffer) = 0;
+
+    /**
+     * @brief Open an http:// URL as an HTTPRangeSource, anything else as a PReadSource
+     * @param location URL or file path
+     */
+    static std::shared_ptr<PDFByteSource> open(const std::string& location);
+
+    /**
+     * @brief Whether a location names a URL rather than a local path
+     */
+    static bool isURL(const std::string& location);
+};
+
+/**
+ * @brief Local file read with positional reads (pread), without mapping it
+ */
+class PReadSource : public PDFByteSource {
+public:
+    /**
+     * @throws std::runtime_error if the file cannot be opened
+     */
+    explicit PReadSource(const std::string& filename);
+    ~PReadSource() override;
+
+    PReadSource(const PReadSource&) = delete;
+    PReadSource& operator=(const PReadSource&) = delete;
+
+    uint64_t size() const override { return size_; }
+    void read(uint64_t offset, size_t count, char* buffer) override;
+
+private:
+    std::string filename_;
+    uint64_t size_ = 0;
+#if defined(__unix__) || defined(__APPLE__)
+    int fd_ = -1;
+#else
+    std::ifstream stream_;
+    std::mutex mutex_; // Serializes seek + read where there is no pread
+#endif
+};
+
+/**
+ * @brief File served over HTTP/1.1, read with Range requests
+ *
+ * Connections are kept alive and reused by later reads; concurrent reads
+ * each use a connection of their own. Only plain http:// is supported,
+ * which is what object-storage gateways inside a cluster usually speak.
+ */
+class HTTPRangeSource : public PDFByteSource {
+public:
+    /**
+     * @brief Connect and learn the file size
+     * @param url http://host[:port]/path
+     * @throws std::runtime_error if the URL is not usable or the server does not honour ranges
+     */
+    explicit HTTPRangeSource(const std::string& url);
+    ~HTTPRangeSource() override;
+
+    HTTPRangeSource(const HTTPRangeSource&) = delete;
+    HTTPRangeSource& operator=(const HTTPRangeSource&) = delete;
+
+    uint64_t size() const override { return size_; }
+    void read(uint64_t offset, size_t count, char* buffer) override;
+
+    /**
+     * @brief Number of range requests sent so far
+     */
+    uint64_t getRequestCount() const;
+
+private:
+    struct Response;
+
+    // One ranged GET; the body goes to buffer (at most capacity bytes)
+    Response request(uint64_t first, uint64_t last, char* buffer, size_t capacity);
+    int connect();
+
+    std::string url_;
+    std::string host_;
+    std::string port_;
+    std::string path_;
+    uint64_t size_ = 0;
+    mutable std::mutex mutex_;
+    std::vector<int> idle_;     // Kept-alive connections
+    uint64_t requests_ = 0;
+};
+
+} // namespace PDF
+
+#endif // PDF_SOURCE_H
@@ -0,0 +1,136 @@
+#ifndef PDF_TEXT_H
+#define PDF_TEXT_H
+
+#include "pdf_filters.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace PDF {
+
+/**
+ * @brief A string shown by a text operator, with where it starts on the page
+ *
+ * The views are only valid during the callback that receives the run.
+ */
+struct TextRun {
+    std::string_view text;  // Shown bytes in the font's encoding (escapes and hex digits decoded)
+    std::string_view font;  // Font resource name set by Tf, without the slash
+    double fontSize = 0.0;  // Size operand of Tf
+    double size = 0.0;      // fontSize scaled by the text matrix and CTM: the text height on the page
+    double x = 0.0;         // Start of the run in default user space
+    double y = 0.0;
+};
+
+using TextRunHandler = std::function<void(const TextRun& run)>;
+
+/**
+ * @brief Content-stream scanner for text extraction
+ *
+ * Lexes decoded content directly and acts only on what text extraction
+ * needs: BT/ET, Tf, TL, Td/TD/Tm/T*, the show operators Tj, TJ, ' and ",
+ * and cm with q/Q so that positions land in user space. Every other
+ * operator, painting and path construction included, only clears the
+ * operands; inline image data is skipped. Nothing is executed or mapped
+ * to PostScript.
+ *
+ * Tokens are views into the current chunk, and the operand, string and
+ * state buffers are reused, so a warm extractor does not allocate. Glyph
+ * widths depend on the font program, which is not loaded: a run reports
+ * where its show operator starts, and within a TJ array a negative
+ * adjustment wider than WORD_GAP becomes a space.
+ */
+class PDFTextExtractor {
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 16 * 1024;
+
+    /**
+     * @brief TJ adjustment (thousandths of text space) taken as a word break
+     */
+    static constexpr double WORD_GAP = 250.0;
+
+    /**
+     * @param chunkSize Bytes requested from a filter per read
+     */
+    explicit PDFTextExtractor(size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+    /**
+     * @brief Scan a content stream as it is decoded
+     *
+     * State carries over from the previous call, as between the streams of
+     * one page's /Contents array; call reset() between pages.
+     * @param source Decoded content bytes
+     * @param onRun Called for each run, in content order
+     * @return Number of runs
+     */
+    size_t extract(PDFFilter& source, const TextRunHandler& onRun);
+
+    /**
+     * @brief Scan decoded content held in memory
+     */
+    size_t extract(std::string_view content, const TextRunHandler& onRun);
+
+    /**
+     * @brief Reset the graphics and text state to that of a new page
+     */
+    void reset();
+
+private:
+    struct Matrix {
+        double a = 1, b = 0, c = 0, d = 1, e = 0, f = 0;
+    };
+
+    // The parts of the graphics state that q and Q save
+    struct State {
+        Matrix ctm;
+        std::string font;
+        double fontSize = 0.0;
+        double leading = 0.0;
+    };
+
+    enum class Kind : uint8_t { Number, String, HexString, Name, ArrayBegin, ArrayEnd, Operator, Other };
+
+    // Offsets rather than views, so operands survive the buffer being refilled
+    struct Token {
+        Kind kind = Kind::Other;
+        double number = 0.0;
+        size_t offset = 0;
+        size_t length = 0;
+    };
+
+    enum class Scan { Token, NeedMore, End };
+
+    size_t run(const TextRunHandler& onRun);
+    Scan scan(Token& token);
+    Scan skipInlineImage();
+    bool fill();
+    void execute(std::string_view op, const TextRunHandler& onRun);
+    void show(const TextRunHandler& onRun);
+    void nextLine(double tx, double ty);
+    double number(size_t fromEnd) const;
+    void appendString(const Token& token);
+
+    std::string_view data_;     // Content scanned (buffer_ unless extracting from memory)
+    std::string buffer_;
+    size_t pos_ = 0;
+    bool eof_ = true;
+    bool inImage_ = false;      // Inside inline image data
+    PDFFilter* source_ = nullptr;
+    size_t chunkSize_;
+    size_t runs_ = 0;
+
+    std::vector<Token> operands_;
+    std::vector<State> stack_;  // Saved states; only the first depth_ are in use
+    size_t depth_ = 0;
+    State state_;
+    Matrix textMatrix_;
+    Matrix lineMatrix_;
+    std::string text_;          // Decoded bytes of the run being shown
+};
+
+} // namespace PDF
+
+#endif // PDF_TEXT_H
@@ -6,6 +6,11 @@
 #include <map>
 #include <memory>
 #include <variant>
+#include <string_view>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+#include "arena.h"
 
 namespace PDF {
 
@@ -53,14 +58,15 @@ struct PDFName {
 };
 
 /**
- * @brief PDF array
+ * @brief PDF array (storage from the document arena while parsing)
  */
-using PDFArray = std::vector<PDFObjectPtr>;
+using PDFArray = std::vector<PDFObjectPtr, Memory::ArenaAllocator<PDFObjectPtr>>;
 
 /**
- * @brief PDF dictionary
+ * @brief PDF dictionary (nodes from the document arena while parsing)
  */
-using PDFDictionary = std::map<std::string, PDFObjectPtr>;
+using PDFDictionary = std::map<std::string, PDFObjectPtr, std::less<std::string>,
+                               Memory::ArenaAllocator<std::pair<const std::string, PDFObjectPtr>>>;
 
 /**
  * @brief PDF reference (object number and generation)
@@ -71,14 +77,59 @@ struct PDFReference {
     PDFReference(int objNum, int gen) : objectNumber(objNum), generation(gen) {}
 };
 
+/**
+ * @brief Immutable byte range that either owns its bytes or borrows them
+ *
+ * Borrowed ranges point into a buffer (typically a memory-mapped file) and
+ * keep it alive through a shared owner handle, so slices of a document can be
+ * passed around without copying. Copying a PDFBytes never copies the bytes;
+ * call str() when an owned std::string is actually needed.
+ */
+class PDFBytes {
+public:
+    PDFBytes() = default;
+    PDFBytes(std::string bytes);
+    PDFBytes(const char* bytes) : PDFBytes(std::string(bytes)) {}
+    PDFBytes(std::string_view view, std::shared_ptr<const void> owner)
+        : view_(view), owner_(std::move(owner)) {}
+
+    const char* data() const { return view_.data(); }
+    size_t size() const { return view_.size(); }
+    size_t length() const { return view_.size(); }
+    bool empty() const { return view_.empty(); }
+    std::string_view view() const { return view_; }
+    operator std::string_view() const { return view_; }
+
+    /**
+     * @brief Make an owned copy of the bytes
+     */
+    std::string str() const { return std::string(view_); }
+
+    /**
+     * @brief Slice of this range sharing the same owner
+     */
+    PDFBytes slice(size_t offset, size_t count = std::string_view::npos) const {
+        return PDFBytes(view_.substr(offset, count), owner_);
+    }
+
+private:
+    std::string_view view_;
+    std::shared_ptr<const void> owner_;
+};
+
 /**
  * @brief PDF stream (dictionary + data)
+ *
+ * The data borrows from the document's file buffer when the document was
+ * parsed from a mapped file.
  */
 struct PDFStream {
     PDFDictionary dict;
-    std::string data;
+    PDFBytes data;
     PDFStream(const PDFDictionary& d, const std::string& streamData) 
         : dict(d), data(streamData) {}
+    PDFStream(const PDFDictionary& d, PDFBytes streamData)
+        : dict(d), data(std::move(streamData)) {}
 };
 
 /**
@@ -137,6 +188,11 @@ public:
     PDFStream asStream() const;
     PDFReference asReference() const;
 
+    // Borrowed access to composite values (no copy)
+    const PDFArray& getArray() const;
+    const PDFDictionary& getDictionary() const;
+    const PDFStream& getStream() const;
+
     // Dictionary operations
     bool hasKey(const std::string& key) const;
     PDFObjectPtr getValue(const std::string& key) const;
@@ -155,17 +211,181 @@ private:
     ValueType value_;
 };
 
+/**
+ * @brief Create an object in the current arena (see Memory::ArenaScope), or
+ *        on the heap when none is installed
+ */
+template <typename... Args>
+PDFObjectPtr makeObject(Args&&... args) {
+    return std::allocate_shared<PDFObject>(Memory::ArenaAllocator<PDFObject>(Memory::Arena::current()),
+                                           std::forward<Args>(args)...);
+}
+
+class PDFFileData;
+class ObjectStreamCache;
+class PDFObjectExtents;
+
+/**
+ * @brief One cross-reference entry and the object it resolves to
+ *
+ * The object slot is filled once, on first resolution; the state flag
+ * publishes it so that resolved objects are read without locking. Copying
+ * or moving an entry is only safe while no other thread resolves it.
+ */
+struct XRefEntry {
+    enum class Type : uint8_t {
+        Free,        // Not in use (or not listed in the xref)
+        InUse,       // Stored in the file at offset
+        Compressed   // Stored in object stream streamNumber at index
+    };
+
+    Type type = Type::Free;
+    uint16_t generation = 0;   // InUse only
+    uint32_t index = 0;        // Compressed: position of the object in the stream's header
+    uint64_t offset = 0;       // InUse: byte offset of "n g obj"
+    int streamNumber = 0;      // Compressed: object number of the object stream
+    PDFObjectPtr object;       // The parsed object, once state is Ready
+
+    XRefEntry() = default;
+    XRefEntry(const XRefEntry& other) { *this = other; }
+    XRefEntry& operator=(const XRefEntry& other);
+
+    static XRefEntry inUse(uint64_t offset, uint16_t generation);
+    static XRefEntry compressed(int streamNumber, uint32_t index);
+
+    /**
+     * @brief Whether the object has been parsed
+     */
+    bool isLoaded() const { return state_.load(std::memory_order_acquire) == READY; }
+
+    /**
+     * @brief Store a freshly parsed object unless another thread got there first
+     * @return The object kept in the slot
+     */
+    PDFObjectPtr publish(PDFObjectPtr parsed);
+
+private:
+    static constexpr uint8_t EMPTY = 0, WRITING = 1, READY = 2;
+    std::atomic<uint8_t> state_{EMPTY};
+};
+
 /**
  * @brief PDF document structure
+ *
+ * Objects are resolved through the document: getObject() returns the cached
+ * object or parses it from its xref entry on first use. The xref is a flat
+ * table indexed by object number (sized from the trailer's /Size), so
+ * resolving a reference is one index and one flag check. A document opened
+ * in lazy mode starts with only the xref and trailer loaded, so the cost of
+ * working with it is proportional to the objects actually touched. When
+ * the file is sparse (read through a PDFByteSource), each object's bytes
+ * are fetched whole just before it is parsed; see PDFPrefetcher for
+ * fetching a page's objects in a few batched rounds instead.
+ *
+ * Objects are allocated from the document's arena rather than one by one
+ * from the heap; the arena is released wholesale once the document and every
+ * object taken from it are gone.
  */
 struct PDFDocument {
+    /**
+     * @brief Highest object number accepted from an xref (the PDF implementation limit)
+     */
+    static constexpr int MAX_OBJECT_NUMBER = 8388607;
+
+    std::shared_ptr<const PDFFileData> file; // Source bytes that borrowed streams point into
+    Memory::ArenaRef arena;                  // Backs parsed objects; freed with the last of them
     PDFDictionary trailer;
-    std::map<int, PDFObjectPtr> objects;
+    std::vector<XRefEntry> xref;             // Indexed by object number
+    // Parses the object at an offset, or returns a null object if the header there names another one
+    std::function<PDFObjectPtr(size_t offset, int objectNumber, uint16_t generation)> objectLoader;
+    std::shared_ptr<ObjectStreamCache> objectStreams; // Decoded object streams (shared by copies)
+    std::shared_ptr<const PDFObjectExtents> extents;  // Where objects end, when the file is sparse
     int rootObjectNumber;
     int infoObjectNumber;
     int catalogObjectNumber;
     
     PDFDocument() : rootObjectNumber(0), infoObjectNumber(0), catalogObjectNumber(0) {}
+
+    /**
+     * @brief Get an indirect object, parsing and caching it on first access
+     *
+     * Safe to call from several threads once parsing has finished; the
+     * object is parsed outside the lock and the first result is kept.
+     * Objects stored in object streams are parsed from the decoded stream
+     * held in objectStreams, so the stream is decoded once for all of them.
+     * An object whose header at its xref offset names another object or
+     * generation (a stale or shifted entry) loads as a null object.
+     * @param objectNumber The object number
+     * @return The object, or nullptr if it is not in the xref
+     */
+    PDFObjectPtr getObject(int objectNumber);
+
+    /**
+     * @brief Number of objects the xref locates, in the file or in object streams
+     */
+    size_t getObjectCount() const;
+
+    /**
+     * @brief Number of objects parsed so far
+     */
+    size_t getLoadedObjectCount() const;
+
+    /**
+     * @brief Follow a reference; other objects are returned unchanged
+     * @param obj Object that may be a reference
+     * @return The referenced object (nullptr if it cannot be resolved)
+     */
+    PDFObjectPtr resolve(const PDFObjectPtr& obj);
+
+    /**
+     * @brief Look up a dictionary entry and resolve it
+     * @param dict Dictionary or stream object
+     * @param key Entry name
+     * @return The resolved value, or nullptr if absent
+     */
+    PDFObjectPtr resolveKey(const PDFObjectPtr& dict, const std::string& key);
+
+    /**
+     * @brief Get the document catalog (the trailer's /Root)
+     */
+    PDFObjectPtr getCatalog();
+
+    /**
+     * @brief Number of pages, from the root page tree node's /Count
+     *
+     * Walks the tree as getPages does when the root has no usable /Count.
+     */
+    size_t getPageCount();
+
+    /**
+     * @brief Get a single page without loading the rest of the page tree
+     *
+     * Descends the page tree using each node's /Count, so only the nodes on
+     * the path to the page (and their direct kids) are parsed.
+     * @param index Zero-based page index
+     * @return The page dictionary, or nullptr if out of range
+     */
+    PDFObjectPtr getPage(size_t index);
+
+    /**
+     * @brief Collect every page in document order
+     *
+     * Nodes referred to more than once are only visited the first time, and
+     * the list stops at the root's /Count.
+     */
+    std::vector<PDFObjectPtr> getPages();
+
+    /**
+     * @brief Look up a page attribute that may be inherited through the page tree
+     *
+     * /Resources, /MediaBox, /CropBox and /Rotate may be set on a /Pages
+     * ancestor instead of the page; the nearest node up the /Parent chain
+     * that has the key supplies it.
+     * @param page Page (or page tree node) dictionary
+     * @param key Entry name
+     * @return The entry as stored (a reference is not followed), or nullptr if no node has it
+     */
+    PDFObjectPtr findInheritedEntry(const PDFObjectPtr& page, const std::string& key);
 };
 
 } // namespace PDF
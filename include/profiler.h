@@ -0,0 +1,129 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Run-time profiling of PostScript execution and PDF processing
+ *
+ * Collection is off by default and costs one relaxed atomic load per
+ * instrumented call while off. When on, every operator and named procedure
+ * call, and the PDF phases (xref parsing, object parsing, decompression and
+ * page execution), are counted and timed with a monotonic nanosecond clock.
+ * Each thread records into its own tables, so pages executed in parallel
+ * do not contend; report() merges them.
+ */
+namespace Profiling {
+
+/**
+ * @brief What a timed region is
+ */
+enum class Kind {
+    Operator,   // id is the operator's NameId
+    Procedure,  // id is the NameId the procedure was executed through
+    Phase       // id is a Phase
+};
+
+/**
+ * @brief Timed stages of PDF processing
+ */
+enum class Phase : uint32_t {
+    XRef,        // Locating and parsing the xref table or stream and the trailer
+    Object,      // Parsing one indirect object
+    Decompress,  // One read from a decoding filter stage
+    Page         // Executing one page's content streams
+};
+
+namespace detail {
+extern std::atomic<bool> enabled;
+}
+
+/**
+ * @brief Turn collection on or off (counts are kept across off periods)
+ */
+void setEnabled(bool enabled);
+
+/**
+ * @brief Whether collection is on
+ */
+inline bool isEnabled() {
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Discard everything collected so far
+ */
+void reset();
+
+/**
+ * @brief Times one call from construction to destruction
+ *
+ * Scopes on one thread must nest, which RAII guarantees. A scope created
+ * while collection is off records nothing.
+ */
+class Scope {
+public:
+    Scope(Kind kind, uint32_t id) {
+        if (isEnabled()) {
+            enter(kind, id);
+        }
+    }
+    Scope(Phase phase) : Scope(Kind::Phase, static_cast<uint32_t>(phase)) {}
+    ~Scope() { end(); }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    /**
+     * @brief Stop timing before the scope is left
+     */
+    void end() {
+        if (active_) {
+            leave();
+        }
+    }
+
+private:
+    void enter(Kind kind, uint32_t id);
+    void leave();
+
+    bool active_ = false;
+};
+
+/**
+ * @brief Totals for one operator, procedure or phase
+ */
+struct Entry {
+    std::string name;
+    uint64_t calls = 0;
+    uint64_t totalNanoseconds = 0; // Including nested calls (recursion counted once)
+    uint64_t selfNanoseconds = 0;  // Excluding time spent in nested timed calls
+};
+
+/**
+ * @brief Collected profile; each list is ordered by self time, highest first
+ */
+struct Report {
+    std::vector<Entry> operators;
+    std::vector<Entry> procedures;
+    std::vector<Entry> phases;
+    uint64_t elapsedNanoseconds = 0; // Time collection has been on since the last reset
+
+    /**
+     * @brief Write as a JSON object with "elapsed_ns", "operators", "procedures" and "phases"
+     */
+    void writeJSON(std::ostream& out) const;
+};
+
+/**
+ * @brief Snapshot of everything collected so far, from all threads
+ */
+Report report();
+
+} // namespace Profiling
+
+#endif // PROFILER_H
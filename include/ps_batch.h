@@ -0,0 +1,130 @@
+#ifndef PS_BATCH_H
+#define PS_BATCH_H
+
+#include "ps_interpreter.h"
+#include "thread_pool.h"
+#include <condition_variable>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace PostScript {
+
+/**
+ * @brief One job for the batch server: a file to run or an in-line program
+ */
+struct BatchJob {
+    uint64_t id = 0;
+    std::string path;     // Run this file when program is empty
+    std::string program;  // In-line program text
+};
+
+/**
+ * @brief Outcome of one job
+ */
+struct BatchResult {
+    uint64_t id = 0;
+    bool succeeded = true;
+    std::string output;  // What the job wrote to the interpreter's output
+    std::string error;   // Why it failed
+};
+
+/**
+ * @brief Warm interpreters that run jobs from a common starting state
+ *
+ * Each interpreter is built once and runs the prolog once. Every job then
+ * runs inside a save level that is restored when it ends (see
+ * PSInterpreter::save), so it starts from the state the prolog left. Jobs
+ * therefore pay neither for building the operator table nor for the
+ * prolog, and restoring only undoes what the job changed. run() is
+ * thread-safe and blocks while every interpreter is busy.
+ */
+class InterpreterPool {
+public:
+    /**
+     * @brief Build the interpreters and run the prolog in each
+     * @param size Number of interpreters (0 = one per hardware thread)
+     * @param prolog Program run once per interpreter before any job
+     * @throws std::runtime_error if the prolog fails
+     */
+    explicit InterpreterPool(size_t size = 0, const std::string& prolog = "");
+
+    InterpreterPool(const InterpreterPool&) = delete;
+    InterpreterPool& operator=(const InterpreterPool&) = delete;
+
+    /**
+     * @brief Run a job on the next free interpreter
+     * @return Its output, and the error if it failed (a failure does not affect later jobs)
+     */
+    BatchResult run(const BatchJob& job);
+
+    size_t size() const { return workers_.size(); }
+
+private:
+    struct Worker {
+        PSInterpreter interpreter;
+        std::ostringstream output;
+        PSStack operands; // What the prolog left on the operand stack
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<Worker*> idle_;
+    std::mutex mutex_;
+    std::condition_variable available_;
+};
+
+/**
+ * @brief Serves jobs from a stream or a socket on an InterpreterPool
+ *
+ * Requests are read one per line:
+ *
+ *     <path>                 run the PostScript file at path
+ *     exec <length>          run the <length> bytes that follow the line
+ *
+ * Empty lines are ignored. Jobs are numbered from 1 per connection and run
+ * concurrently, one per interpreter; each gets one response, in request
+ * order, as soon as it and every job before it have finished:
+ *
+ *     job <id> ok <length>
+ *     job <id> error <length> <message>
+ *
+ * followed by <length> bytes of job output.
+ *
+ * A malformed exec line gets an error response and ends the input: the
+ * payload after it cannot be delimited, so it is not read as requests.
+ */
+class BatchServer {
+public:
+    /**
+     * @param interpreters Pool that must outlive the server
+     */
+    explicit BatchServer(InterpreterPool& interpreters);
+
+    /**
+     * @brief Serve requests until the input ends; may be called from several threads
+     * @return Number of jobs served
+     */
+    uint64_t serve(std::istream& in, std::ostream& out);
+
+    /**
+     * @brief Accept connections on a Unix domain socket and serve each on its own thread
+     *
+     * Does not return unless the socket cannot be set up.
+     * @param path Socket path (an existing socket file there is replaced)
+     * @throws std::runtime_error if the socket cannot be created
+     */
+    void listen(const std::string& path);
+
+private:
+    InterpreterPool& interpreters_;
+    Threading::ThreadPool threads_;
+};
+
+} // namespace PostScript
+
+#endif // PS_BATCH_H
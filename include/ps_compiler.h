@@ -0,0 +1,66 @@
+#ifndef PS_COMPILER_H
+#define PS_COMPILER_H
+
+#include "ps_types.h"
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace PostScript {
+
+class PSInterpreter;
+
+/**
+ * @brief A single pre-resolved instruction of a compiled procedure
+ */
+struct PSInstruction {
+    enum class Opcode {
+        PushLiteral,  // Push a pre-parsed literal (number, string, name, procedure)
+        PushCopy,     // Push a fresh copy of a pre-parsed array or dictionary literal
+        CallOperator, // Call an operator directly unless a dictionary shadows its name
+        ExecName      // Resolve a name through the dictionary stack at run time
+    };
+
+    Opcode opcode;
+    PSObject literal;          // PushLiteral / PushCopy
+    OperatorFunction function; // CallOperator
+    NameId name;               // CallOperator / ExecName
+
+    PSInstruction(Opcode op, PSObject lit, OperatorFunction fn, NameId nm)
+        : opcode(op), literal(std::move(lit)), function(fn), name(nm) {}
+};
+
+/**
+ * @brief Instruction array produced from a procedure's tokens
+ */
+class PSCompiledProcedure {
+public:
+    std::vector<PSInstruction, Memory::ArenaAllocator<PSInstruction>> code;
+};
+
+/**
+ * @brief Compiles procedure bodies into instruction arrays
+ *
+ * Every token is classified exactly once: operator names become direct
+ * function calls (which fall back to a lookup once a user dictionary shadows
+ * an operator), literals are parsed up front, and anything else is interned
+ * and becomes a name lookup performed when the instruction executes.
+ */
+class PSCompiler {
+public:
+    explicit PSCompiler(PSInterpreter& interpreter) : interpreter_(interpreter) {}
+
+    /**
+     * @brief Compile a procedure body
+     * @param tokens The tokens between the procedure braces
+     * @return The compiled instruction array
+     */
+    std::shared_ptr<const PSCompiledProcedure> compile(const std::vector<std::string>& tokens);
+
+private:
+    PSInterpreter& interpreter_;
+};
+
+} // namespace PostScript
+
+#endif // PS_COMPILER_H
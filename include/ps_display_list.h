@@ -0,0 +1,92 @@
+#ifndef PS_DISPLAY_LIST_H
+#define PS_DISPLAY_LIST_H
+
+#include "ps_types.h"
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+namespace PostScript {
+
+/**
+ * @brief One painting operation with the graphics state it needs
+ *
+ * Commands are self-contained and device-independent: the path stays in
+ * user space next to the CTM it is drawn with, so a list can be rendered
+ * at any resolution and any command can be rasterized on its own.
+ */
+struct PaintCommand {
+    enum class Operation : uint8_t { Fill, EOFill, Stroke };
+
+    Operation operation;
+    PSPath path;                // Shared with the graphics state (copy-on-write)
+    std::array<double, 6> ctm;
+    double lineWidth;
+    double r, g, b;
+
+    /**
+     * @brief Capture what painting the current path of a state needs
+     */
+    static PaintCommand fromState(Operation operation, const GraphicsState& gs) {
+        return PaintCommand{operation, gs.currentPath, gs.ctm, gs.lineWidth, gs.r, gs.g, gs.b};
+    }
+};
+
+/**
+ * @brief Painting operations in painting order, split into pages
+ *
+ * An interpreter in record mode (PSInterpreter::setRecorder) appends to a
+ * list instead of painting, and RasterDevice::replay renders it at the
+ * device's resolution, so a page interpreted once can be rasterized any
+ * number of times. write and read give a compact binary form for caching
+ * a list or passing it to another process.
+ */
+class DisplayList {
+public:
+    void add(PaintCommand command) { commands_.push_back(std::move(command)); }
+
+    /**
+     * @brief End the current page; later commands belong to the next one
+     */
+    void showpage() { pageEnds_.push_back(commands_.size()); }
+
+    void clear() {
+        commands_.clear();
+        pageEnds_.clear();
+    }
+    bool empty() const { return commands_.empty() && pageEnds_.empty(); }
+    size_t size() const { return commands_.size(); }
+    const std::vector<PaintCommand>& commands() const { return commands_; }
+    const PaintCommand& operator[](size_t index) const { return commands_[index]; }
+
+    /**
+     * @brief Command count at each showpage, in order (one entry per completed page)
+     */
+    const std::vector<size_t>& pageEnds() const { return pageEnds_; }
+
+    /**
+     * @brief Serialize independently of the host's byte order
+     *
+     * The CTM, colour and line width are only written when they change, and
+     * a path shared with the previous command (e.g. fill then stroke) is
+     * written once.
+     */
+    void write(std::ostream& out) const;
+
+    /**
+     * @brief Deserialize a list produced by write
+     * @throws std::runtime_error if the data is truncated or malformed
+     */
+    static DisplayList read(std::istream& in);
+
+private:
+    std::vector<PaintCommand> commands_;
+    std::vector<size_t> pageEnds_;
+};
+
+} // namespace PostScript
+
+#endif // PS_DISPLAY_LIST_H
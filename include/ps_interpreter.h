@@ -7,19 +7,38 @@
 #include "ps_types.h"
 #include <string>
 #include <memory>
+#include <optional>
+#include <ostream>
 #include <vector>
 
 namespace PostScript {
 
+class DisplayList;
+class RasterDevice;
+
 /**
  * @brief Main PostScript interpreter class
  * 
  * This class orchestrates the execution of PostScript programs.
- * It manages the operand stack, operator registry, and execution context.
+ * The operator registry and systemdict are sealed and shared by every
+ * interpreter using them; everything an interpreter changes while it runs
+ * is kept in its own execution context. Creating an interpreter therefore
+ * costs little more than an empty userdict, and interpreters on different
+ * threads share nothing they write to.
  */
 class PSInterpreter {
 public:
+    /**
+     * @brief An interpreter with the built-in operators (OperatorRegistry::standard())
+     */
     PSInterpreter();
+
+    /**
+     * @brief An interpreter with a custom operator set
+     * @param operators A sealed registry (see OperatorRegistry::seal)
+     * @throws std::runtime_error if the registry is missing or not sealed
+     */
+    explicit PSInterpreter(std::shared_ptr<const OperatorRegistry> operators);
     ~PSInterpreter() = default;
 
     /**
@@ -38,69 +57,312 @@ public:
      * @brief Get access to the operand stack
      * @return Reference to the operand stack
      */
-    PSStack& getStack() { return stack_; }
+    PSStack& getStack() { return context_.operands; }
 
     /**
      * @brief Get access to the operand stack (const version)
      * @return Const reference to the operand stack
      */
-    const PSStack& getStack() const { return stack_; }
+    const PSStack& getStack() const { return context_.operands; }
 
     /**
      * @brief Get access to the operator registry
-     * @return Reference to the operator registry
+     * @return Reference to the shared, read-only operator registry
      */
-    OperatorRegistry& getOperators() { return operators_; }
+    const OperatorRegistry& getOperators() const { return *operators_; }
 
     /**
      * @brief Print the current state of the interpreter
      */
     void printState() const;
 
+    /**
+     * @brief Redirect program output (show, stroke/fill reports, stack)
+     * @param out Stream that must outlive its use by the interpreter
+     */
+    void setOutput(std::ostream& out) { context_.output = &out; }
+
+    /**
+     * @brief Stream that program output is written to (std::cout by default)
+     */
+    std::ostream& getOutput() const { return *context_.output; }
+
+    /**
+     * @brief Paint fill, stroke and showpage into a raster device as well
+     * @param device Device that must outlive its use, or nullptr for none
+     */
+    void setDevice(RasterDevice* device) { context_.device = device; }
+
+    /**
+     * @brief The raster device being painted, if any (none by default)
+     */
+    RasterDevice* getDevice() const { return context_.device; }
+
+    /**
+     * @brief Record fill, stroke and showpage into a display list instead of painting
+     *
+     * While recording, the device set with setDevice is not painted; the
+     * list can be rendered later with RasterDevice::replay.
+     * @param list List that must outlive its use, or nullptr to stop recording
+     */
+    void setRecorder(DisplayList* list) { context_.recorder = list; }
+
+    /**
+     * @brief The display list being recorded into, if any (none by default)
+     */
+    DisplayList* getRecorder() const { return context_.recorder; }
+
+    /**
+     * @brief Discard all execution state
+     *
+     * Clears the operand stack, restores the initial dictionary stack
+     * (systemdict and a fresh userdict), resets the graphics state stack and
+     * closes every save level, so the interpreter can run another independent job (e.g. the next page).
+     * The job's arena is rewound once nothing references its objects. Must
+     * not be called while the interpreter is executing.
+     */
+    void reset();
+
+    /**
+     * @brief Open a save level (what save does)
+     *
+     * Costs the same however much state there is: the dictionary and
+     * graphics stacks are copied (they hold handles), and arrays and
+     * dictionaries are only copied when first changed afterwards (see
+     * PSSaveLog). Composite objects created after the save come from an
+     * arena of their own, which restore releases.
+     * @return The save object to pass to restore
+     */
+    PSSave save();
+
+    /**
+     * @brief Return to the state at a save (what restore does)
+     *
+     * Undoes every change made since to arrays and dictionaries, and puts
+     * back the dictionary and graphics stacks. Save levels opened after it
+     * are closed too. The operand stack is left alone. Changes are recorded
+     * while the interpreter executes (execute, executeFile, executeToken).
+     * @throws std::runtime_error if the save is not active
+     */
+    void restore(PSSave save);
+
+    /**
+     * @brief Number of open save levels
+     */
+    size_t getSaveDepth() const { return context_.saves.size(); }
+
     /**
      * @brief Execute a single token
      * @param token The token to execute
      */
     void executeToken(const std::string& token);
 
+    /**
+     * @brief Execute a procedure object
+     * @param procedure The procedure to run (its compiled form when available)
+     */
+    void executeProcedure(const PSObject& procedure);
+
+    /**
+     * @brief Parse a literal token (number, string, name, boolean, array,
+     *        dictionary or procedure) without executing anything
+     * @param token The token to parse
+     * @return The literal object, or nothing if the token is an executable name
+     */
+    std::optional<PSObject> parseLiteral(const std::string& token);
+
     /**
      * @brief Get the current dictionary (top of dictionary stack)
-     * @return Current dictionary or nullptr if stack is empty
+     * @return Current dictionary, or a null object if the stack is empty
+     */
+    const PSObject& getCurrentDictionary() const;
+
+    /**
+     * @brief The read-only dictionary of operators (bottom of the dictionary stack)
+     */
+    const PSObject& getSystemDictionary() const { return operators_->getSystemDictionary(); }
+
+    /**
+     * @brief The default dictionary for user definitions (above systemdict)
+     */
+    const PSObject& getUserDictionary() const { return context_.dictionaries[1]; }
+
+    /**
+     * @brief Number of dictionaries on the dictionary stack
      */
-    PSObjectPtr getCurrentDictionary() const;
+    size_t getDictionaryStackDepth() const { return context_.dictionaries.size(); }
 
     /**
      * @brief Push a dictionary onto the dictionary stack
      * @param dict The dictionary to push
      */
-    void pushDictionary(const PSObjectPtr& dict);
+    void pushDictionary(const PSObject& dict);
 
     /**
      * @brief Pop a dictionary from the dictionary stack
      * @return The popped dictionary
+     * @throws std::runtime_error if only systemdict and userdict remain
      */
-    PSObjectPtr popDictionary();
+    PSObject popDictionary();
+
+    /**
+     * @brief Resolve a name through the dictionary stack, top to bottom
+     *
+     * Results (including misses) are cached per name, so resolving a hot
+     * name costs the same at any stack depth. The cache is discarded when
+     * the dictionary stack changes and per name when a key is added. It
+     * grows with the atoms actually resolved, up to MAX_CACHED_BINDINGS;
+     * names interned later than that (by a long-running batch server, say)
+     * are searched for on every lookup.
+     *
+     * @param name The name atom to look up
+     * @return The bound value, or nullptr if no dictionary defines it;
+     *         valid until the dictionary holding it is next modified
+     */
+    const PSObject* lookup(NameId name) {
+        if (name < context_.bindings.size() && context_.bindings[name].epoch == context_.dictionaryEpoch) {
+            return context_.bindings[name].value;
+        }
+        return resolve(name);
+    }
+
+    /**
+     * @brief Find the topmost dictionary on the stack that defines a name
+     * @return That dictionary, or nullptr if none does
+     */
+    const PSObject* findDefiningDictionary(NameId name) const;
+
+    /**
+     * @brief Define a name in the current dictionary (what def does)
+     * @param name The name atom
+     * @param value The value to bind
+     */
+    void define(NameId name, const PSObject& value);
+
+    /**
+     * @brief Drop the cached binding for a name
+     *
+     * Needed after adding or removing a key in a dictionary other than
+     * through define(), and after replacing the value of an operator name;
+     * replacing any other existing value needs no invalidation.
+     */
+    void invalidateBinding(NameId name);
 
     /**
      * @brief Get the current graphics state
      * @return Reference to the current graphics state
      */
-    GraphicsState& getCurrentGraphicsState() { return graphicsStack_.back(); }
+    GraphicsState& getCurrentGraphicsState() { return context_.graphics.back(); }
 
     /**
      * @brief Get the current graphics state (const version)
      * @return Const reference to the current graphics state
      */
-    const GraphicsState& getCurrentGraphicsState() const { return graphicsStack_.back(); }
+    const GraphicsState& getCurrentGraphicsState() const { return context_.graphics.back(); }
 
-    // Graphics state stack
-    std::vector<GraphicsState> graphicsStack_;
+    /**
+     * @brief Push a copy of the current graphics state (what gsave does)
+     */
+    void pushGraphicsState() { context_.graphics.push_back(context_.graphics.back()); }
+
+    /**
+     * @brief Return to the previous graphics state (what grestore does)
+     * @throws std::runtime_error if only the initial state is left
+     */
+    void popGraphicsState();
+
+    /**
+     * @brief The graphics state stack, bottom first
+     */
+    const std::vector<GraphicsState>& getGraphicsStack() const { return context_.graphics; }
+
+    /**
+     * @brief Replace the graphics state stack (e.g. with one saved after an earlier run)
+     * @throws std::runtime_error if the stack is empty
+     */
+    void setGraphicsStack(std::vector<GraphicsState> graphics);
 
 private:
-    PSStack stack_;
-    OperatorRegistry operators_;
-    std::unique_ptr<PSParser> parser_;
-    std::vector<PSObjectPtr> dictionaryStack_; // Dictionary stack for PostScript
+    /**
+     * @brief Atoms below this get cached bindings, bounding the cache as a long-lived process interns names
+     */
+    static constexpr size_t MAX_CACHED_BINDINGS = 1 << 16;
+
+    /**
+     * @brief Cached result of resolving a name through the dictionary stack
+     */
+    struct Binding {
+        const PSObject* value = nullptr; // nullptr caches a miss
+        uint64_t epoch = 0;              // Valid while equal to the context's dictionaryEpoch
+    };
+
+    /**
+     * @brief What save keeps beyond the undo log
+     */
+    struct SaveLevel {
+        uint64_t serial;
+        Memory::ArenaRef arena;               // Arena in use before the save
+        std::vector<PSObject> dictionaries;   // Above systemdict, which never changes
+        std::vector<GraphicsState> graphics;
+        bool operatorsShadowed;
+    };
+
+    /**
+     * @brief Everything an interpreter changes while it runs
+     *
+     * Cache-line aligned, so interpreters working on different threads
+     * never write to the same line.
+     */
+    struct alignas(64) ExecutionContext {
+        Memory::ArenaRef arena;              // Backs composite objects created by jobs
+        Memory::ArenaRef spareArena;         // Rewound arena of the last restored save, for the next one
+        PSSaveLog saveLog;
+        std::vector<SaveLevel> saves;        // Open save levels, innermost last
+        PSStack operands;
+        std::vector<PSObject> dictionaries;  // systemdict, userdict, then begin'd dictionaries
+        std::vector<Binding> bindings;       // Indexed by NameId, below MAX_CACHED_BINDINGS
+        uint64_t dictionaryEpoch = 1;        // Bumped whenever dictionaries changes
+        bool operatorsShadowed = false;      // Some dictionary redefines an operator name
+        std::vector<GraphicsState> graphics;
+        std::ostream* output = nullptr;
+        RasterDevice* device = nullptr;
+        DisplayList* recorder = nullptr;
+    };
+
+    /**
+     * @brief Execute a name through the dictionary stack
+     * @param name The name atom to resolve
+     */
+    void executeName(NameId name);
+
+    /**
+     * @brief Execute the value a name is bound to
+     *
+     * Procedures are run, operators are called and anything else is pushed.
+     */
+    void executeValue(const PSObject& value);
+
+    /**
+     * @brief executeValue for the value bound to a name, timed under that name when profiling
+     */
+    void executeBinding(NameId name, const PSObject& value);
+
+    /**
+     * @brief One element of an array or dictionary literal
+     *
+     * Nested literals are parsed; an operator name becomes the operator and
+     * any other name becomes a string, as an unknown token would.
+     */
+    PSObject parseElement(const std::string& token);
+
+    /**
+     * @brief Uncached dictionary stack search; refreshes the name's binding
+     */
+    const PSObject* resolve(NameId name);
+
+    std::shared_ptr<const OperatorRegistry> operators_; // Sealed, shared with other interpreters
+    PSParser parser_;
+    ExecutionContext context_;
 };
 
 } // namespace PostScript
@@ -0,0 +1,121 @@
+#ifndef PS_NAMES_H
+#define PS_NAMES_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace PostScript {
+
+/**
+ * @brief Integer atom standing for an interned name
+ */
+using NameId = uint32_t;
+
+/**
+ * @brief Returned by NameTable::find for names that were never interned
+ */
+constexpr NameId NO_NAME = UINT32_MAX;
+
+/**
+ * @brief A PostScript name object's value (the atom, without the leading '/')
+ */
+struct PSName {
+    NameId id;
+};
+
+/**
+ * @brief Process-wide table mapping names to dense integer atoms
+ *
+ * Each distinct name is hashed once, when it is first interned; after that,
+ * operator tables and dictionaries compare and index by NameId. Atoms are
+ * never freed, so they are stable for the life of the process and can be
+ * shared between interpreters on different threads. A process that keeps
+ * running untrusted programs (the batch server) should therefore cap the
+ * table with setLimit: every name any job interns stays in it. All methods
+ * are thread-safe.
+ *
+ * Names are looked up far more often than they are added, so lookups take
+ * no lock. Names live in chunks that never move, each twice the size of
+ * the last, and the index is an open-addressed table of atomic slots.
+ * intern adds under a mutex, filling the name before publishing its slot
+ * and the new size; when the index grows, a rehashed copy is published
+ * and the old one is kept until the table is destroyed, since readers may
+ * still be probing it.
+ */
+class NameTable {
+public:
+    NameTable();
+    ~NameTable();
+
+    NameTable(const NameTable&) = delete;
+    NameTable& operator=(const NameTable&) = delete;
+
+    static NameTable& global();
+
+    /**
+     * @brief Get the atom for a name, adding it if needed
+     * @param name The name (without a leading '/')
+     * @return Its atom
+     * @throws std::runtime_error if the name is new and the table is at its limit
+     */
+    NameId intern(std::string_view name);
+
+    /**
+     * @brief Get the atom for a name without adding it
+     * @param name The name to look up
+     * @return Its atom, or NO_NAME if it was never interned
+     */
+    NameId find(std::string_view name) const;
+
+    /**
+     * @brief Text of an atom (valid for the life of the table)
+     */
+    const std::string& name(NameId id) const;
+
+    /**
+     * @brief Number of interned names (atoms are 0 .. size()-1)
+     */
+    size_t size() const;
+
+    /**
+     * @brief Cap the number of names; intern then fails rather than grow past it
+     * @param limit Most names the table may hold (names already interned are kept)
+     */
+    void setLimit(size_t limit) { limit_.store(limit, std::memory_order_relaxed); }
+
+    /**
+     * @brief Most names the table may hold (default: every NameId)
+     */
+    size_t limit() const { return limit_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr unsigned FIRST_CHUNK_BITS = 8;  // The first chunk holds 256 names
+    static constexpr unsigned CHUNK_COUNT = 33 - FIRST_CHUNK_BITS; // Enough for every NameId
+
+    // Slot value: hash bits above, atom + 1 in the low 32 bits (0 = empty)
+    struct Index {
+        explicit Index(size_t capacity);
+        size_t mask;
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    };
+
+    NameId lookup(std::string_view name, uint32_t hash) const;
+    void insert(Index& index, NameId id, uint32_t hash);
+    std::string& slot(NameId id) const;
+
+    std::mutex mutex_;                          // Serializes intern
+    std::atomic<std::string*> chunks_[CHUNK_COUNT];
+    std::atomic<size_t> size_{0};
+    std::atomic<size_t> limit_{NO_NAME};
+    std::atomic<Index*> index_;
+    std::vector<std::unique_ptr<Index>> indexes_; // Current index last; older ones may still be read
+};
+
+} // namespace PostScript
+
+#endif // PS_NAMES_H
@@ -2,33 +2,41 @@
 #define PS_OPERATORS_H
 
 #include "ps_stack.h"
-#include <functional>
-#include <unordered_map>
+#include "ps_names.h"
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace PostScript {
 
-/**
- * @brief Forward declaration of the interpreter class
- */
-class PSInterpreter;
-
-/**
- * @brief Type definition for operator functions
- * 
- * Each operator is a function that takes a reference to the interpreter
- * and performs the operation using the interpreter's stack and context.
- */
-using OperatorFunction = std::function<void(PSInterpreter&)>;
-
 /**
  * @brief Operator registry that maps operator names to their implementations
+ *
+ * Indexed directly by name atom, so resolving an interned name is one load.
+ * Interpreters use a sealed registry (see seal()), which is immutable and
+ * carries a read-only systemdict, so any number of interpreters on any
+ * threads share one table by pointer. The built-in table is standard().
  */
 class OperatorRegistry {
 public:
+    /**
+     * @brief A registry of the built-in operators, to extend before sealing
+     */
     OperatorRegistry();
     ~OperatorRegistry() = default;
 
+    /**
+     * @brief Freeze a registry for sharing and build its read-only systemdict
+     * @param registry The operators interpreters using it will see
+     * @return A registry that is safe to use from any number of threads
+     */
+    static std::shared_ptr<const OperatorRegistry> seal(OperatorRegistry registry);
+
+    /**
+     * @brief The sealed registry of built-in operators, built once per process
+     */
+    static const std::shared_ptr<const OperatorRegistry>& standard();
+
     /**
      * @brief Register an operator function
      * @param name The name of the operator (e.g., "add", "sub", "show")
@@ -43,6 +51,20 @@ public:
      */
     OperatorFunction getOperator(const std::string& name) const;
 
+    /**
+     * @brief Get an operator function by name atom
+     * @param name The interned operator name (NO_NAME is allowed)
+     * @return The operator function, or nullptr if not found
+     */
+    OperatorFunction getOperator(NameId name) const {
+        return name < operators_.size() ? operators_[name] : nullptr;
+    }
+
+    /**
+     * @brief Read-only dictionary of every registered operator (null until sealed)
+     */
+    const PSObject& getSystemDictionary() const { return systemDictionary_; }
+
     /**
      * @brief Check if an operator exists
      * @param name The name of the operator
@@ -51,7 +73,8 @@ public:
     bool hasOperator(const std::string& name) const;
 
 private:
-    std::unordered_map<std::string, OperatorFunction> operators_;
+    std::vector<OperatorFunction> operators_; // Indexed by NameId; nullptr where unbound
+    PSObject systemDictionary_;
 };
 
 // Operator function declarations
@@ -95,6 +118,12 @@ namespace Operators {
     void store(PSInterpreter& interpreter);
     void known(PSInterpreter& interpreter);
     void keys(PSInterpreter& interpreter);
+    void begin(PSInterpreter& interpreter);
+    void end(PSInterpreter& interpreter);
+    void currentdict(PSInterpreter& interpreter);
+    void userdict(PSInterpreter& interpreter);
+    void systemdict(PSInterpreter& interpreter);
+    void where(PSInterpreter& interpreter);
     
     // Procedure operations
     void exec(PSInterpreter& interpreter);
@@ -110,11 +139,17 @@ namespace Operators {
     void moveto(PSInterpreter& interpreter);
     void lineto(PSInterpreter& interpreter);
     void closepath(PSInterpreter& interpreter);
+    void curveto(PSInterpreter& interpreter);
+    void arc(PSInterpreter& interpreter);
+    void arcn(PSInterpreter& interpreter);
     void stroke(PSInterpreter& interpreter);
     void fill(PSInterpreter& interpreter);
+    void eofill(PSInterpreter& interpreter);
     void newpath(PSInterpreter& interpreter);
     void gsave(PSInterpreter& interpreter);
     void grestore(PSInterpreter& interpreter);
+    void save(PSInterpreter& interpreter);
+    void restore(PSInterpreter& interpreter);
     void translate(PSInterpreter& interpreter);
     void scale(PSInterpreter& interpreter);
     void rotate(PSInterpreter& interpreter);
@@ -2,11 +2,94 @@
 #define PS_PARSER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <sstream>
+#include <istream>
+#include <memory>
 
 namespace PostScript {
 
+/**
+ * @brief Pull-based PostScript tokenizer
+ *
+ * Tokens are produced one at a time as the input is read. Stream input is
+ * consumed in fixed-size chunks, so memory use is bounded by the chunk size
+ * plus the largest single token, and the first token is available as soon as
+ * the first chunk has been read. Tokens are returned as views into the chunk
+ * buffer whenever they do not straddle a chunk boundary or contain escapes.
+ */
+class PSTokenStream {
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+    /**
+     * @brief Tokenize an input stream without taking ownership of it
+     * @param input The stream to read from
+     * @param chunkSize Number of bytes read per refill
+     */
+    explicit PSTokenStream(std::istream& input, size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+    /**
+     * @brief Tokenize an input stream, taking ownership of it
+     * @param input The stream to read from
+     * @param chunkSize Number of bytes read per refill
+     */
+    explicit PSTokenStream(std::unique_ptr<std::istream> input, size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+    /**
+     * @brief Tokenize an in-memory buffer (no copy is made; it must outlive the stream)
+     * @param input The PostScript source
+     */
+    explicit PSTokenStream(std::string_view input);
+
+    PSTokenStream(const PSTokenStream&) = delete;
+    PSTokenStream& operator=(const PSTokenStream&) = delete;
+
+    /**
+     * @brief Read the next token
+     * @param token Receives the token; the view stays valid until the next call
+     * @return false when the input is exhausted
+     */
+    bool next(std::string_view& token);
+
+private:
+    bool refill();
+    bool available(size_t count);
+    void append(size_t index, size_t count = 1);
+    void moveTokenToScratch();
+    void resetToken();
+    std::string_view currentToken() const;
+    static bool isWhitespace(char c);
+    static bool isDelimiter(char c);
+
+    std::unique_ptr<std::istream> ownedInput_;
+    std::istream* input_ = nullptr;
+    size_t chunkSize_ = DEFAULT_CHUNK_SIZE;
+    std::string chunk_;        // Refill buffer for stream input
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t pos_ = 0;
+
+    // Token under construction: a range of data_ until it has to be copied
+    size_t tokenStart_ = 0;
+    size_t tokenLength_ = 0;
+    bool tokenInScratch_ = false;
+    std::string scratch_;
+    char pendingDelimiter_ = '\0';
+    char delimiterToken_ = '\0';
+
+    // Tokenizer state carried across calls
+    bool inString_ = false;
+    bool escapeNext_ = false;
+    bool inArray_ = false;
+    bool inDict_ = false;
+    bool inProc_ = false;
+    int braceLevel_ = 0;
+    int bracketLevel_ = 0;
+    int dictLevel_ = 0;
+};
+
 /**
  * @brief Simple PostScript parser/tokenizer
  * 
@@ -32,6 +115,13 @@ public:
      */
     std::vector<std::string> parseFile(const std::string& filename);
 
+    /**
+     * @brief Open a PostScript file for incremental tokenization
+     * @param filename The path to the PostScript file
+     * @return Token stream reading the file in chunks
+     */
+    std::unique_ptr<PSTokenStream> openFile(const std::string& filename);
+
 private:
     /**
      * @brief Tokenize a string into individual tokens
@@ -39,22 +129,8 @@ private:
      * @return Vector of tokens
      */
     std::vector<std::string> tokenize(const std::string& input);
-
-    /**
-     * @brief Check if a character is whitespace
-     * @param c The character to check
-     * @return true if the character is whitespace
-     */
-    bool isWhitespace(char c) const;
-
-    /**
-     * @brief Check if a character is a delimiter
-     * @param c The character to check
-     * @return true if the character is a delimiter
-     */
-    bool isDelimiter(char c) const;
 };
 
 } // namespace PostScript
 
-#endif // PS_PARSER_H 
\ No newline at end of file
+#endif // PS_PARSER_H 
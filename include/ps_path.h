@@ -0,0 +1,153 @@
+#ifndef PS_PATH_H
+#define PS_PATH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace PostScript {
+
+struct Point {
+    double x, y;
+    Point(double x_ = 0, double y_ = 0) : x(x_), y(y_) {}
+};
+
+/**
+ * @brief A PostScript path stored as parallel verb and point arrays
+ *
+ * Each verb consumes a fixed number of points (see pointsPerVerb), so a path
+ * of any length is two flat buffers rather than one allocation per segment.
+ * Copies share the buffers and only the copy that is modified clones them,
+ * which makes gsave/grestore constant time while the path is unchanged.
+ * Shared storage is never written, so copies may be used from different
+ * threads; a single PSPath object is not thread-safe.
+ */
+class PSPath {
+public:
+    enum class Verb : uint8_t { MoveTo, LineTo, CurveTo, ClosePath };
+
+    /**
+     * @brief Number of points stored for a verb (curveto: two controls, then the end)
+     */
+    static constexpr size_t pointsPerVerb(Verb verb) {
+        return verb == Verb::CurveTo ? 3 : verb == Verb::ClosePath ? 0 : 1;
+    }
+
+    /**
+     * @brief A segment as seen while iterating: its verb and its points
+     */
+    struct Segment {
+        Verb verb;
+        const Point* points;
+    };
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Segment;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Segment*;
+        using reference = Segment;
+
+        const_iterator(const Verb* verb, const Point* points) : verb_(verb), points_(points) {}
+        Segment operator*() const { return Segment{*verb_, points_}; }
+        const_iterator& operator++() {
+            points_ += pointsPerVerb(*verb_++);
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+        bool operator==(const const_iterator& other) const { return verb_ == other.verb_; }
+        bool operator!=(const const_iterator& other) const { return verb_ != other.verb_; }
+
+    private:
+        const Verb* verb_;
+        const Point* points_;
+    };
+
+    PSPath() = default;
+    PSPath(const PSPath& other);
+    PSPath(PSPath&& other) noexcept;
+    PSPath& operator=(PSPath other) noexcept;
+    ~PSPath();
+
+    void moveTo(const Point& point);
+    void lineTo(const Point& point);
+    void curveTo(const Point& control1, const Point& control2, const Point& end);
+    void closePath();
+
+    /**
+     * @brief Append a circular arc as Bezier curves, each spanning at most 90 degrees
+     *
+     * Starts with a lineto from the current point to the arc's start, or a
+     * moveto if the path is empty, as the arc and arcn operators require.
+     * The sweep is reduced to at most one full turn in the arc's direction.
+     * @param center Centre of the circle
+     * @param radius Radius
+     * @param angle1 Start angle in degrees
+     * @param angle2 End angle in degrees
+     * @param clockwise true for arcn, false for arc
+     * @return The arc's end point
+     * @throws std::runtime_error (rangecheck) if an angle is not finite
+     */
+    Point arc(const Point& center, double radius, double angle1, double angle2, bool clockwise);
+
+    /**
+     * @brief Remove all segments; buffers are kept when not shared
+     */
+    void clear();
+
+    bool empty() const { return !storage_ || storage_->verbs.empty(); }
+
+    /**
+     * @brief Number of segments
+     */
+    size_t size() const { return storage_ ? storage_->verbs.size() : 0; }
+
+    /**
+     * @brief Number of points across all segments
+     */
+    size_t pointCount() const { return storage_ ? storage_->points.size() : 0; }
+
+    /**
+     * @brief The verb array (size() entries)
+     */
+    const Verb* verbs() const { return storage_ ? storage_->verbs.data() : nullptr; }
+
+    /**
+     * @brief The packed point array (pointCount() entries, in verb order)
+     */
+    const Point* points() const { return storage_ ? storage_->points.data() : nullptr; }
+
+    const_iterator begin() const { return const_iterator(verbs(), points()); }
+    const_iterator end() const { return const_iterator(verbs() + size(), nullptr); }
+
+    /**
+     * @brief Heap bytes held by the buffers (counted in full even when shared)
+     */
+    size_t memoryUsage() const;
+
+private:
+    struct Storage {
+        std::atomic<uint32_t> refs{1};
+        std::vector<Verb> verbs;
+        std::vector<Point> points;
+    };
+
+    /**
+     * @brief Storage this path may write to, cloned first if it is shared
+     */
+    Storage& writable();
+    void release();
+
+    Storage* storage_ = nullptr;
+};
+
+} // namespace PostScript
+
+#endif // PS_PATH_H
@@ -0,0 +1,243 @@
+#ifndef PS_RASTER_H
+#define PS_RASTER_H
+
+#include "ps_display_list.h"
+#include "ps_types.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace Threading {
+class ThreadPool;
+}
+
+namespace PostScript {
+
+/**
+ * @brief Rule deciding which regions of a path are inside
+ */
+enum class FillRule { NonZero, EvenOdd };
+
+/**
+ * @brief Affine transformation [a b c d e f]: x' = a*x + c*y + e, y' = b*x + d*y + f
+ */
+struct Matrix {
+    double a = 1, b = 0, c = 0, d = 1, e = 0, f = 0;
+
+    Point apply(const Point& p) const { return Point(a * p.x + c * p.y + e, b * p.x + d * p.y + f); }
+
+    /**
+     * @brief This transformation followed by next
+     */
+    Matrix then(const Matrix& next) const;
+
+    double determinant() const { return a * d - b * c; }
+};
+
+/**
+ * @brief An RGBA8 image, rows top to bottom, four bytes per pixel
+ */
+class Framebuffer {
+public:
+    Framebuffer() = default;
+    Framebuffer(int width, int height);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    uint8_t* row(int y) { return pixels_.data() + static_cast<size_t>(y) * width_ * 4; }
+    const uint8_t* row(int y) const { return pixels_.data() + static_cast<size_t>(y) * width_ * 4; }
+    const std::vector<uint8_t>& pixels() const { return pixels_; }
+
+    /**
+     * @brief Fill every pixel with one colour
+     */
+    void clear(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255);
+
+    /**
+     * @brief Write as a PAM (P7, RGB_ALPHA) image
+     */
+    void writePAM(std::ostream& out) const;
+
+    /**
+     * @brief Write as a binary PPM (P6) image, dropping alpha
+     */
+    void writePPM(std::ostream& out) const;
+
+private:
+    int width_ = 0;
+    int height_ = 0;
+    std::vector<uint8_t> pixels_;
+};
+
+/**
+ * @brief Anti-aliased polygon filler based on signed-area accumulation
+ *
+ * Edges are added in pixels relative to the rasterizer's own origin. Each
+ * edge deposits, per pixel, the area it sweeps times its direction; a
+ * running sum along each row then yields the exact winding-weighted
+ * coverage of every pixel, which the fill rule maps to an alpha. Edges may
+ * extend beyond the rasterizer's area; they are clipped.
+ */
+class Rasterizer {
+public:
+    /**
+     * @brief Prepare for an area of the given size, dropping edges so far
+     *
+     * The accumulation buffer only grows, so one rasterizer can serve
+     * areas of different sizes (e.g. the tiles of a page) without
+     * reallocating.
+     */
+    void reset(int width, int height);
+
+    /**
+     * @brief Add one directed edge (pixels, y down)
+     */
+    void addLine(const Point& p0, const Point& p1);
+
+    /**
+     * @brief Composite the accumulated shape in one colour and clear it
+     * @param target Framebuffer containing the rasterizer's area
+     * @param rule How winding numbers map to inside and outside
+     * @param color Straight RGBA colour
+     * @param originX Column of target where the area starts
+     * @param originY Row of target where the area starts
+     */
+    void fill(Framebuffer& target, FillRule rule, const uint8_t color[4], int originX = 0, int originY = 0);
+
+private:
+    void addClippedLine(double x0, double y0, double x1, double y1);
+    void accumulate(double x0, double y0, double x1, double y1);
+    void clearTouched();
+
+    int width_ = 0;
+    int height_ = 0;
+    size_t stride_ = 0;            // width_ + 2: edges at the right border spill into two extra cells
+    std::vector<float> cells_;     // Signed area per pixel; all zero between fills
+    std::vector<float> coverage_;  // One row of resolved coverage
+    int minX_ = 0, maxX_ = -1;     // Bounds of the touched cells
+    int minY_ = 0, maxY_ = -1;
+};
+
+/**
+ * @brief A paint command resolved to device-space edges (see RasterDevice)
+ */
+struct PreparedPaint;
+
+/**
+ * @brief Output device that paints into a framebuffer, one per page
+ *
+ * fill and stroke record commands into the page's display list; the list
+ * is rasterized when the page is needed (showpage or page()). Rendering
+ * resolves every command to device-space edges (paths mapped through the
+ * command's CTM and the device's default matrix of 72 units per inch with
+ * the origin at the bottom left, then flattened and, for strokes,
+ * outlined), bins the commands by bounding box into square tiles and
+ * rasterizes the tiles in parallel. A tile only visits the commands that
+ * touch it, in painting order, so the result is identical to painting the
+ * whole page serially.
+ */
+class RasterDevice {
+public:
+    using PageHandler = std::function<void(const Framebuffer& page, int pageNumber)>;
+
+    static constexpr int TILE_SIZE = 256;
+
+    /**
+     * @param widthPoints Page width in PostScript units (1/72 inch)
+     * @param heightPoints Page height in PostScript units
+     * @param resolution Pixels per inch
+     */
+    RasterDevice(double widthPoints = 612, double heightPoints = 792, double resolution = 72);
+    ~RasterDevice();
+
+    RasterDevice(const RasterDevice&) = delete;
+    RasterDevice& operator=(const RasterDevice&) = delete;
+
+    /**
+     * @brief Called with each page at showpage
+     */
+    void setPageHandler(PageHandler handler) { pageHandler_ = std::move(handler); }
+
+    /**
+     * @brief Set how many threads rasterize tiles
+     * @param count Thread count (0 = one per hardware thread, 1 = no workers)
+     */
+    void setThreadCount(size_t count);
+
+    /**
+     * @brief Get the configured rasterization thread count (0 = hardware threads)
+     */
+    size_t getThreadCount() const { return threadCount_; }
+
+    /**
+     * @brief Record one paint command for the current page
+     */
+    void paint(PaintCommand command);
+
+    /**
+     * @brief Paint a recorded list, emitting a page at each of its page ends
+     *
+     * Commands after the list's last page end stay on the current page.
+     */
+    void replay(const DisplayList& list);
+
+    /**
+     * @brief Fill the current path of a graphics state
+     */
+    void fill(const GraphicsState& gs, FillRule rule);
+
+    /**
+     * @brief Stroke the current path with the state's line width (butt caps, miter joins)
+     */
+    void stroke(const GraphicsState& gs);
+
+    /**
+     * @brief Emit the page and start a new, white one
+     */
+    void showpage();
+
+    /**
+     * @brief The page being painted, with everything recorded so far rendered
+     */
+    const Framebuffer& page();
+
+    /**
+     * @brief Commands recorded since the page was last rendered
+     */
+    const DisplayList& displayList() const { return displayList_; }
+
+    /**
+     * @brief Pages emitted so far
+     */
+    int pageCount() const { return pageCount_; }
+
+    /**
+     * @brief User space to device pixels for a CTM
+     */
+    Matrix deviceMatrix(const std::array<double, 6>& ctm) const;
+
+private:
+    /**
+     * @brief Rasterize and then drop the recorded commands
+     */
+    void render();
+
+    size_t participants() const;
+
+    Matrix defaultMatrix_;
+    Framebuffer page_;
+    PageHandler pageHandler_;
+    int pageCount_ = 0;
+    DisplayList displayList_;
+    size_t threadCount_ = 0;
+    std::unique_ptr<Threading::ThreadPool> pool_;     // Created on first parallel render
+    std::vector<PreparedPaint> prepared_;             // Reused between renders
+    std::vector<std::vector<uint32_t>> bins_;         // Command indices per tile
+    std::vector<Rasterizer> rasterizers_;             // One per rendering thread
+};
+
+} // namespace PostScript
+
+#endif // PS_RASTER_H
@@ -3,6 +3,7 @@
 
 #include "ps_types.h"
 #include <vector>
+#include <ostream>
 #include <stdexcept>
 
 namespace PostScript {
@@ -18,10 +19,19 @@ public:
     PSStack() = default;
     ~PSStack() = default;
 
-    // Stack operations
-    void push(const PSObjectPtr& obj);
-    PSObjectPtr pop();
-    PSObjectPtr peek() const;
+    // Stack operations (objects are stored by value)
+    void push(const PSObject& obj) { stack_.push_back(obj); }
+    void push(PSObject&& obj) { stack_.push_back(std::move(obj)); }
+    PSObject pop() {
+        if (stack_.empty()) underflow("cannot pop from empty stack");
+        PSObject top = std::move(stack_.back());
+        stack_.pop_back();
+        return top;
+    }
+    const PSObject& peek() const {
+        if (stack_.empty()) underflow("cannot peek empty stack");
+        return stack_.back();
+    }
     
     // Stack manipulation
     void dup();  // Duplicate top element
@@ -31,12 +41,16 @@ public:
     // Stack information
     size_t size() const { return stack_.size(); }
     bool empty() const { return stack_.empty(); }
+    const PSObject& operator[](size_t index) const { return stack_[index]; } // From the bottom, index < size()
     
     // Debugging
     void print() const;
+    void print(std::ostream& out) const;
 
 private:
-    std::vector<PSObjectPtr> stack_;
+    [[noreturn]] static void underflow(const char* detail);
+
+    std::vector<PSObject> stack_;
 };
 
 } // namespace PostScript
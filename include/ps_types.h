@@ -1,21 +1,26 @@
 #ifndef PS_TYPES_H
 #define PS_TYPES_H
 
+#include <atomic>
+#include <cstdint>
 #include <string>
-#include <variant>
 #include <memory>
 #include <vector>
 #include <unordered_map>
 #include <map>
 #include <optional>
 #include <array>
+#include <variant>
+#include "ps_names.h"
+#include "ps_path.h"
+#include "arena.h"
 
 namespace PostScript {
 
 /**
  * @brief Represents the different types of PostScript objects
  */
-enum class ObjectType {
+enum class ObjectType : uint8_t {
     INTEGER,
     REAL,
     STRING,
@@ -23,7 +28,10 @@ enum class ObjectType {
     ARRAY,
     DICTIONARY,
     PROCEDURE,
-    NULL_OBJECT
+    NAME,
+    OPERATOR,
+    NULL_OBJECT,
+    SAVE
 };
 
 /**
@@ -31,45 +39,56 @@ enum class ObjectType {
  */
 class PSObject;
 
+class PSInterpreter;
+
 /**
- * @brief Type alias for shared pointer to PSObject
+ * @brief Type definition for operator functions
+ * 
+ * Each operator is a function that takes a reference to the interpreter
+ * and performs the operation using the interpreter's stack and context.
+ * Operators are plain function pointers so they fit inline in a PSObject
+ * and can be called without going through the registry.
  */
-using PSObjectPtr = std::shared_ptr<PSObject>;
+using OperatorFunction = void (*)(PSInterpreter&);
 
 /**
- * @brief Type alias for array of PostScript objects
+ * @brief Type alias for array of PostScript objects (storage from the job arena)
  */
-using PSArray = std::vector<PSObjectPtr>;
+using PSArray = std::vector<PSObject, Memory::ArenaAllocator<PSObject>>;
 
 /**
- * @brief Type alias for dictionary of PostScript objects
+ * @brief Type alias for dictionary of PostScript objects, keyed by name atom
+ *        (nodes from the job arena)
  */
-using PSDictionary = std::unordered_map<std::string, PSObjectPtr>;
+using PSDictionary = std::unordered_map<NameId, PSObject, std::hash<NameId>, std::equal_to<NameId>,
+                                        Memory::ArenaAllocator<std::pair<const NameId, PSObject>>>;
 
 /**
- * @brief Type alias for procedure (array of tokens/objects)
+ * @brief Forward declaration of the compiled procedure body (see ps_compiler.h)
  */
-using PSProcedure = std::vector<std::string>;
+class PSCompiledProcedure;
 
 /**
- * @brief Union type for storing primitive values
+ * @brief A save level, as pushed by save and consumed by restore
  */
-using PrimitiveValue = std::variant<int, double, std::string, bool, PSArray, PSDictionary, PSProcedure>;
-
-struct Point {
-    double x, y;
-    Point(double x_ = 0, double y_ = 0) : x(x_), y(y_) {}
+struct PSSave {
+    uint64_t serial;
 };
 
-struct PathSegment {
-    enum class Type { MoveTo, LineTo, CurveTo, ClosePath } type;
-    std::vector<Point> points; // 1 for moveto/lineto, 3 for curveto, 0 for closepath
-    PathSegment(Type t, std::vector<Point> pts) : type(t), points(std::move(pts)) {}
+/**
+ * @brief Procedure: source tokens plus the instruction array compiled from them
+ *
+ * The tokens are kept for printing; execution uses the compiled form, which is
+ * built once when the procedure literal is created and shared by all copies.
+ */
+struct PSProcedure {
+    std::vector<std::string> tokens;
+    std::shared_ptr<const PSCompiledProcedure> code;
 };
 
 struct GraphicsState {
     Point currentPoint;
-    std::vector<PathSegment> currentPath;
+    PSPath currentPath; // Shared with saved states until either one changes it
     std::array<double, 6> ctm; // Current transformation matrix (a, b, c, d, e, f)
     double lineWidth;
     double r, g, b; // Color (RGB)
@@ -77,58 +96,337 @@ struct GraphicsState {
         : currentPoint(0, 0), ctm{1,0,0,1,0,0}, lineWidth(1.0), r(0), g(0), b(0) {}
 };
 
+namespace detail {
+
+/**
+ * @brief Serial of the innermost save level active on this thread (0 if none)
+ */
+uint64_t activeSaveSerial();
+
+/**
+ * @brief Heap storage shared by copies of a composite PSObject
+ *
+ * The reference count is intrusive so a composite handle is a single pointer.
+ * Payloads are released by the owning PSObject, which knows the stored type.
+ * A payload created while an arena is installed (see Memory::ArenaScope)
+ * lives in that arena and holds a reference to it.
+ */
+template <typename T>
+struct PSPayload {
+    std::atomic<uint32_t> refs{1};
+    bool readOnly = false;          // Set once before the value is shared; never cleared
+    Memory::Arena* arena = nullptr; // nullptr: allocated with new
+    uint64_t saved = 0;             // Save level that recorded (or created) this value
+    T value;
+    explicit PSPayload(T v) : saved(activeSaveSerial()), value(std::move(v)) {}
+
+    static PSPayload* create(T v) {
+        Memory::Arena* current = Memory::Arena::current();
+        if (!current) {
+            return new PSPayload(std::move(v));
+        }
+        PSPayload* payload = new (current->allocate(sizeof(PSPayload), alignof(PSPayload)))
+            PSPayload(std::move(v));
+        payload->arena = current;
+        current->retain();
+        return payload;
+    }
+
+    static void destroy(PSPayload* payload) {
+        Memory::Arena* owner = payload->arena;
+        if (!owner) {
+            delete payload;
+            return;
+        }
+        payload->~PSPayload();
+        owner->release();
+    }
+};
+
+} // namespace detail
+
 /**
  * @brief Represents a PostScript object that can be pushed onto the stack
+ *
+ * A two-word tagged value. Integers, reals, booleans, names, operators, save
+ * objects and null are stored inline, so pushing and popping them never allocates. Strings, arrays,
+ * dictionaries and procedures live in a reference-counted payload that
+ * copies of the object share, giving them PostScript's reference semantics;
+ * duplicate() makes an independent container.
  */
 class PSObject {
 public:
     // Constructors for primitive types
-    PSObject() : type_(ObjectType::NULL_OBJECT) {}
-    explicit PSObject(int value) : type_(ObjectType::INTEGER), value_(value) {}
-    explicit PSObject(double value) : type_(ObjectType::REAL), value_(value) {}
-    explicit PSObject(const std::string& value) : type_(ObjectType::STRING), value_(value) {}
-    explicit PSObject(bool value) : type_(ObjectType::BOOLEAN), value_(value) {}
+    PSObject() : bits_(0), type_(ObjectType::NULL_OBJECT) {}
+    explicit PSObject(int value) : bits_(0), type_(ObjectType::INTEGER) { integer_ = value; }
+    explicit PSObject(double value) : real_(value), type_(ObjectType::REAL) {}
+    explicit PSObject(bool value) : bits_(0), type_(ObjectType::BOOLEAN) { boolean_ = value; }
+    explicit PSObject(std::string value);
+    explicit PSObject(const char* value) : PSObject(std::string(value)) {}
+    explicit PSObject(PSName name) : bits_(0), type_(ObjectType::NAME) { name_ = name.id; }
+    PSObject(OperatorFunction function, NameId name) : type_(ObjectType::OPERATOR), aux_(name) {
+        function_ = function;
+    }
+    explicit PSObject(PSSave save) : type_(ObjectType::SAVE) { bits_ = save.serial; }
     
     // Constructors for composite types
-    explicit PSObject(const PSArray& array) : type_(ObjectType::ARRAY), value_(array) {}
-    explicit PSObject(const PSDictionary& dict) : type_(ObjectType::DICTIONARY), value_(dict) {}
-    explicit PSObject(const PSProcedure& proc) : type_(ObjectType::PROCEDURE), value_(proc) {}
+    explicit PSObject(PSArray array);
+    explicit PSObject(PSDictionary dict);
+    explicit PSObject(PSProcedure proc);
+
+    PSObject(const PSObject& other) : type_(other.type_), aux_(other.aux_) {
+        bits_ = other.bits_;
+        retain();
+    }
+    PSObject(PSObject&& other) noexcept : type_(other.type_), aux_(other.aux_) {
+        bits_ = other.bits_;
+        other.type_ = ObjectType::NULL_OBJECT;
+    }
+    PSObject& operator=(const PSObject& other) {
+        if (this != &other) {
+            PSObject copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+    PSObject& operator=(PSObject&& other) noexcept {
+        PSObject moved(std::move(other));
+        swap(moved);
+        return *this;
+    }
+    ~PSObject() { release(); }
+
+    void swap(PSObject& other) noexcept {
+        std::swap(type_, other.type_);
+        std::swap(bits_, other.bits_);
+        std::swap(aux_, other.aux_);
+    }
 
     ObjectType getType() const { return type_; }
-    const PrimitiveValue& getValue() const { return value_; }
+    bool isNull() const { return type_ == ObjectType::NULL_OBJECT; }
+    bool isNumber() const { return type_ == ObjectType::INTEGER || type_ == ObjectType::REAL; }
 
     // Type-safe getters for primitive types
-    int asInteger() const;
-    double asReal() const;
-    std::string asString() const;
-    bool asBoolean() const;
+    int asInteger() const {
+        if (type_ != ObjectType::INTEGER) typeError("an integer");
+        return integer_;
+    }
+    double asReal() const {
+        if (type_ != ObjectType::REAL) typeError("a real number");
+        return real_;
+    }
+    bool asBoolean() const {
+        if (type_ != ObjectType::BOOLEAN) typeError("a boolean");
+        return boolean_;
+    }
+    NameId asName() const {
+        if (type_ != ObjectType::NAME) typeError("a name");
+        return name_;
+    }
+    OperatorFunction asOperator() const {
+        if (type_ != ObjectType::OPERATOR) typeError("an operator");
+        return function_;
+    }
+    PSSave asSave() const {
+        if (type_ != ObjectType::SAVE) typeError("a save object");
+        return PSSave{bits_};
+    }
     
-    // Type-safe getters for composite types
-    PSArray asArray() const;
-    PSDictionary asDictionary() const;
-    PSProcedure asProcedure() const;
+    // Type-safe borrowed access to heap values. Copies of an object share
+    // them, so a change made through one copy is seen by all of them.
+    const std::string& asString() const;
+    const PSArray& asArray() const;
+    const PSDictionary& asDictionary() const;
+    const PSProcedure& asProcedure() const;
+
+    /**
+     * @brief Whether both objects are handles to the same composite value
+     */
+    bool sharesStorage(const PSObject& other) const {
+        return isComposite() && type_ == other.type_ && payload_ == other.payload_;
+    }
+
+    /**
+     * @brief Reject every later change to this array or dictionary
+     *
+     * A read-only value can be shared between threads, since nothing writes
+     * to it. Copies made with duplicate() are writable again.
+     */
+    void setReadOnly();
+    bool isReadOnly() const;
+
+    /**
+     * @brief Copy with its own string/container storage
+     *
+     * Elements of a copied array or dictionary are shared with the original.
+     */
+    PSObject duplicate() const;
 
     // String representation for debugging
     std::string toString() const;
 
     // Array operations
-    void arrayAppend(const PSObjectPtr& obj);
-    PSObjectPtr arrayGet(size_t index) const;
-    void arraySet(size_t index, const PSObjectPtr& obj);
+    void arrayAppend(const PSObject& obj);
+    PSObject arrayGet(size_t index) const;
+    void arraySet(size_t index, const PSObject& obj);
     size_t arrayLength() const;
     
     // Dictionary operations
-    void dictPut(const std::string& key, const PSObjectPtr& value);
-    PSObjectPtr dictGet(const std::string& key) const;
+
+    /**
+     * @brief Set a dictionary entry
+     * @return true if the key was added, false if an existing value was replaced
+     */
+    bool dictPut(NameId key, const PSObject& value);
+    PSObject dictGet(NameId key) const;
+    bool dictHas(NameId key) const;
+
+    /**
+     * @brief Borrow a dictionary value
+     * @return The value, or nullptr if the key is missing (or this is not a dictionary);
+     *         valid until the dictionary is next modified
+     */
+    const PSObject* dictFind(NameId key) const;
+    void dictRemove(NameId key);
+    std::vector<NameId> dictKeys() const;
+
+    // Convenience overloads that intern the key first
+    bool dictPut(const std::string& key, const PSObject& value) {
+        return dictPut(NameTable::global().intern(key), value);
+    }
+    PSObject dictGet(const std::string& key) const;
     bool dictHas(const std::string& key) const;
-    void dictRemove(const std::string& key);
-    std::vector<std::string> dictKeys() const;
+    const PSObject* dictFind(const std::string& key) const;
 
 private:
+    friend class PSSaveLog;
+
+    using StringPayload = detail::PSPayload<std::string>;
+    using ArrayPayload = detail::PSPayload<PSArray>;
+    using DictionaryPayload = detail::PSPayload<PSDictionary>;
+    using ProcedurePayload = detail::PSPayload<PSProcedure>;
+
+    bool isComposite() const {
+        return type_ == ObjectType::STRING || type_ == ObjectType::ARRAY ||
+               type_ == ObjectType::DICTIONARY || type_ == ObjectType::PROCEDURE;
+    }
+    std::atomic<uint32_t>& refs() const;
+    void retain() {
+        if (isComposite()) refs().fetch_add(1, std::memory_order_relaxed);
+    }
+    void release() {
+        if (isComposite() && refs().fetch_sub(1, std::memory_order_acq_rel) == 1) destroy();
+    }
+    void destroy();
+    void beforeChange();
+    [[noreturn]] void typeError(const char* expected) const;
+
+    const std::string& stringValue() const { return static_cast<StringPayload*>(payload_)->value; }
+    PSArray& arrayValue() const;
+    PSDictionary& dictionaryValue() const;
+
+    union {
+        int integer_;
+        double real_;
+        bool boolean_;
+        NameId name_;
+        OperatorFunction function_;
+        void* payload_;
+        uint64_t bits_;
+    };
     ObjectType type_;
-    PrimitiveValue value_;
+    uint32_t aux_ = 0; // Operator name; fills what would otherwise be padding
+};
+
+static_assert(sizeof(PSObject) == 16, "PSObject should stay two words");
+
+/**
+ * @brief Undo log behind save and restore
+ *
+ * Saving costs nothing up front: while the log is active (see Scope), the
+ * first change to an array or dictionary after the innermost save copies
+ * its previous contents into the log, and later changes to it are free.
+ * Objects created after the save are never copied. Rolling back puts the
+ * recorded contents back, newest first. Strings and procedures cannot be
+ * changed, so they are never recorded.
+ */
+class PSSaveLog {
+public:
+    PSSaveLog() = default;
+    PSSaveLog(const PSSaveLog&) = delete;
+    PSSaveLog& operator=(const PSSaveLog&) = delete;
+
+    /**
+     * @brief Open a save level
+     * @return Its serial, unique across all logs
+     */
+    uint64_t push();
+
+    /**
+     * @brief Undo every change recorded since a level was opened and close it,
+     *        along with the levels opened after it
+     * @throws std::runtime_error if the level is not open
+     */
+    void rollBack(uint64_t serial);
+
+    /**
+     * @brief Close every level without undoing anything
+     */
+    void clear();
+
+    bool isOpen(uint64_t serial) const;
+    size_t depth() const { return levels_.size(); }
+
+    /**
+     * @brief Serial of the innermost open level (0 if none)
+     */
+    uint64_t serial() const { return levels_.empty() ? 0 : levels_.back().serial; }
+
+    /**
+     * @brief Number of objects whose contents are recorded
+     */
+    size_t size() const { return entries_.size(); }
+
+    /**
+     * @brief The log that records changes made on this thread, if any
+     */
+    static PSSaveLog* active();
+
+    /**
+     * @brief Makes a log the thread's active log until the scope ends
+     */
+    class Scope {
+    public:
+        explicit Scope(PSSaveLog& log);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        PSSaveLog* previous_;
+    };
+
+private:
+    friend class PSObject;
+
+    struct Level {
+        uint64_t serial;
+        size_t firstEntry; // Entries recorded since this level was opened start here
+    };
+
+    struct Entry {
+        PSObject object;
+        std::variant<PSArray, PSDictionary> contents; // Before the first change (on the heap)
+    };
+
+    // Copy an object's contents before its first change in the current level
+    void record(const PSObject& object);
+
+    std::vector<Level> levels_;
+    std::vector<Entry> entries_;
 };
 
 } // namespace PostScript
 
-#endif // PS_TYPES_H 
\ No newline at end of file
+#endif // PS_TYPES_H
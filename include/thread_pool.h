@@ -0,0 +1,92 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Threading {
+
+/**
+ * @brief Fixed-size pool of worker threads fed from a shared task queue
+ *
+ * Tasks are run in submission order by whichever worker is free; data-parallel
+ * loops can use parallelFor instead. The destructor finishes all queued tasks
+ * before joining the workers.
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Start the workers
+     * @param threadCount Number of threads (0 = one per hardware thread)
+     */
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Number of worker threads
+     */
+    size_t size() const { return workers_.size(); }
+
+    /**
+     * @brief Queue a task
+     * @param task Callable taking no arguments
+     * @return Future for the task's result; exceptions are rethrown from get()
+     */
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F task) {
+        using Result = std::invoke_result_t<F>;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        std::future<Result> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.emplace([packaged]() { (*packaged)(); });
+        }
+        available_.notify_one();
+        return result;
+    }
+
+    /**
+     * @brief Run fn(index, slot) for every index in [0, count) and wait for all
+     *
+     * The indices are split into one contiguous block per participant (the
+     * workers plus the calling thread, which takes part too, so this may be
+     * called from inside a task). A participant works through its own block
+     * from the front and, once it is empty, steals the back half of another
+     * block, so uneven items balance out without a shared queue.
+     *
+     * @param count Number of items
+     * @param fn Called once per item; slot (0..size()) identifies the
+     *        participating thread, for per-thread scratch state
+     * @throws The first exception thrown by fn, after all calls have finished
+     */
+    void parallelFor(size_t count, const std::function<void(size_t index, size_t slot)>& fn);
+
+    /**
+     * @brief Default worker count for this machine (at least 1)
+     */
+    static size_t hardwareThreads();
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable available_;
+    bool stopping_ = false;
+};
+
+} // namespace Threading
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,158 @@
+#include "arena.h"
+#include <algorithm>
+
+namespace Memory {
+
+namespace {
+
+thread_local Arena* currentArena = nullptr;
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+} // namespace
+
+Arena::~Arena() {
+    Chunk* chunk = head_.load(std::memory_order_relaxed);
+    while (chunk) {
+        Chunk* next = chunk->next;
+        ::operator delete(chunk);
+        chunk = next;
+    }
+}
+
+Arena::Chunk* Arena::newChunk(size_t size, size_t used) {
+    void* memory = ::operator new(sizeof(Chunk) + size);
+    Chunk* chunk = new (memory) Chunk;
+    chunk->next = nullptr;
+    chunk->size = size;
+    chunk->used.store(used, std::memory_order_relaxed);
+    return chunk;
+}
+
+void* Arena::bump(Chunk* chunk, size_t bytes, size_t alignment) {
+    // Chunk data is max_align_t-aligned, so aligning the offset aligns the address
+    size_t used = chunk->used.load(std::memory_order_relaxed);
+    while (true) {
+        size_t offset = alignUp(used, alignment);
+        if (offset + bytes > chunk->size) {
+            return nullptr;
+        }
+        if (chunk->used.compare_exchange_weak(used, offset + bytes, std::memory_order_relaxed)) {
+            return chunk->data() + offset;
+        }
+    }
+}
+
+void* Arena::allocate(size_t bytes, size_t alignment) {
+    Chunk* chunk = head_.load(std::memory_order_acquire);
+    if (chunk) {
+        if (void* memory = bump(chunk, bytes, alignment)) {
+            return memory;
+        }
+    }
+    return allocateSlow(bytes, alignment);
+}
+
+void* Arena::allocateSlow(size_t bytes, size_t alignment) {
+    std::lock_guard<std::mutex> lock(growMutex_);
+    Chunk* head = head_.load(std::memory_order_acquire);
+    if (head) {
+        // Another thread may have added a chunk while we waited
+        if (void* memory = bump(head, bytes, alignment)) {
+            return memory;
+        }
+    }
+
+    size_t size = head ? std::min(head->size * 2, MAX_CHUNK_SIZE) : INITIAL_CHUNK_SIZE;
+    if (bytes > size / 4) {
+        // Large request: a chunk of its own, so the current chunk keeps being used
+        Chunk* chunk = newChunk(bytes, bytes);
+        if (head) {
+            chunk->next = head->next;
+            head->next = chunk;
+        } else {
+            head_.store(chunk, std::memory_order_release);
+        }
+        return chunk->data();
+    }
+
+    // Carve the request out before other threads can see the chunk
+    Chunk* chunk = newChunk(size, bytes);
+    chunk->next = head;
+    head_.store(chunk, std::memory_order_release);
+    return chunk->data();
+}
+
+bool Arena::rewind() {
+    if (refs_.load(std::memory_order_acquire) != 1) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(growMutex_);
+    Chunk* keep = nullptr;
+    Chunk* chunk = head_.load(std::memory_order_relaxed);
+    while (chunk) {
+        Chunk* next = chunk->next;
+        if (!keep || chunk->size > keep->size) {
+            if (keep) ::operator delete(keep);
+            keep = chunk;
+        } else {
+            ::operator delete(chunk);
+        }
+        chunk = next;
+    }
+    if (keep) {
+        keep->next = nullptr;
+        keep->used.store(0, std::memory_order_relaxed);
+    }
+    head_.store(keep, std::memory_order_release);
+    return true;
+}
+
+size_t Arena::capacity() const {
+    std::lock_guard<std::mutex> lock(growMutex_);
+    size_t total = 0;
+    for (Chunk* chunk = head_.load(std::memory_order_acquire); chunk; chunk = chunk->next) {
+        total += chunk->size;
+    }
+    return total;
+}
+
+Arena* Arena::current() {
+    return currentArena;
+}
+
+ArenaRef ArenaRef::create() {
+    // A new arena starts with the one reference this handle adopts
+    ArenaRef ref;
+    ref.arena_ = new Arena();
+    return ref;
+}
+
+void ArenaRef::recycle() {
+    if (!arena_ || !arena_->rewind()) {
+        *this = create();
+    }
+}
+
+ArenaScope::ArenaScope(Arena* arena, bool nested)
+    : previous_(currentArena), installed_(nested || !currentArena) {
+    if (installed_) {
+        currentArena = arena;
+    }
+}
+
+ArenaScope::~ArenaScope() {
+    if (installed_) {
+        currentArena = previous_;
+    }
+}
+
+void ArenaScope::replace(Arena* from, Arena* to) {
+    if (currentArena == from) {
+        currentArena = to;
+    }
+}
+
+} // namespace Memory
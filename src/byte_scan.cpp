@@ -0,0 +1,287 @@
+#include "byte_scan.h"
+#include <cstring>
+#include <string>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BYTE_SCAN_X86 1
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(PS_ENABLE_NEON_SCAN)
+// Opt-in until the NEON path has been checked against the scalar one on ARM
+#define BYTE_SCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace ByteScan {
+
+namespace detail {
+std::atomic<const Implementation*> current{nullptr};
+}
+
+namespace {
+
+using detail::Implementation;
+
+// --- Scalar ---
+
+size_t scanScalar(const char* data, size_t size, const ByteSet& set, bool inSet) {
+    size_t i = 0;
+    while (i < size && set.contains(data[i]) != inSet) {
+        ++i;
+    }
+    return i;
+}
+
+size_t findScalar(const char* data, size_t size, const char* keyword, size_t keywordSize) {
+    size_t found = std::string_view(data, size).find(std::string_view(keyword, keywordSize));
+    return found == std::string_view::npos ? size : found;
+}
+
+#if BYTE_SCAN_X86 || BYTE_SCAN_NEON
+
+// Check the candidates in a mask of first/last byte matches (bitsPerByte mask bits per position)
+template <typename Mask>
+bool matchCandidates(const char* block, const char* keyword, size_t keywordSize, Mask mask, int bitsPerByte,
+                     size_t& offset) {
+    while (mask != 0) {
+        size_t bit = static_cast<size_t>(__builtin_ctzll(static_cast<unsigned long long>(mask))) / bitsPerByte;
+        if (std::memcmp(block + bit + 1, keyword + 1, keywordSize - 2) == 0) {
+            offset = bit;
+            return true;
+        }
+        // Clear every bit of this position
+        mask &= ~(((Mask(1) << bitsPerByte) - 1) << (bit * bitsPerByte));
+    }
+    return false;
+}
+
+#endif
+
+constexpr Implementation SCALAR{Level::Scalar, scanScalar, findScalar};
+
+#if BYTE_SCAN_X86
+
+// --- SSE2: compare against each member ---
+
+size_t scanSSE2(const char* data, size_t size, const ByteSet& set, bool inSet) {
+    __m128i members[ByteSet::MAX_MEMBERS];
+    const size_t count = set.size();
+    for (size_t m = 0; m < count; ++m) {
+        members[m] = _mm_set1_epi8(static_cast<char>(set.members()[m]));
+    }
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i hit = _mm_setzero_si128();
+        for (size_t m = 0; m < count; ++m) {
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(bytes, members[m]));
+        }
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+        if (!inSet) {
+            mask = ~mask & 0xffffu;
+        }
+        if (mask != 0) {
+            return i + static_cast<size_t>(__builtin_ctz(mask));
+        }
+    }
+    return i + scanScalar(data + i, size - i, set, inSet);
+}
+
+size_t findSSE2(const char* data, size_t size, const char* keyword, size_t keywordSize) {
+    const __m128i first = _mm_set1_epi8(keyword[0]);
+    const __m128i last = _mm_set1_epi8(keyword[keywordSize - 1]);
+    auto candidates = [&](size_t at) {
+        __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + at));
+        __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + at + keywordSize - 1));
+        return _mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last));
+    };
+    const size_t count = size - keywordSize + 1;
+    size_t i = 0;
+    // Two blocks per iteration: nearly every block has no candidate at all
+    for (; i + 32 <= count; i += 32) {
+        __m128i low = candidates(i);
+        __m128i high = candidates(i + 16);
+        if (_mm_movemask_epi8(_mm_or_si128(low, high)) == 0) {
+            continue;
+        }
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(low)) |
+                        static_cast<unsigned>(_mm_movemask_epi8(high)) << 16;
+        size_t offset = 0;
+        if (matchCandidates(data + i, keyword, keywordSize, mask, 1, offset)) {
+            return i + offset;
+        }
+    }
+    return i + findScalar(data + i, size - i, keyword, keywordSize);
+}
+
+constexpr Implementation SSE2{Level::SSE2, scanSSE2, findSSE2};
+
+// --- AVX2: nibble table lookup, 32 bytes at a time ---
+
+__attribute__((target("avx2")))
+size_t scanAVX2(const char* data, size_t size, const ByteSet& set, bool inSet) {
+    const __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(set.lowNibbles())));
+    const __m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(set.highNibbles())));
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i lowBits = _mm256_shuffle_epi8(low, _mm256_and_si256(bytes, nibble));
+        __m256i highBits = _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble));
+        __m256i outside = _mm256_cmpeq_epi8(_mm256_and_si256(lowBits, highBits), zero);
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(outside));
+        if (inSet) {
+            mask = ~mask;
+        }
+        if (mask != 0) {
+            return i + static_cast<size_t>(__builtin_ctz(mask));
+        }
+    }
+    return i + scanSSE2(data + i, size - i, set, inSet);
+}
+
+// Positions in a 32-byte block where the keyword's first and last bytes both match
+__attribute__((target("avx2")))
+inline __m256i candidatesAVX2(const char* block, size_t keywordSize, __m256i first, __m256i last) {
+    __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + keywordSize - 1));
+    return _mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last));
+}
+
+__attribute__((target("avx2")))
+size_t findAVX2(const char* data, size_t size, const char* keyword, size_t keywordSize) {
+    const __m256i first = _mm256_set1_epi8(keyword[0]);
+    const __m256i last = _mm256_set1_epi8(keyword[keywordSize - 1]);
+    const size_t count = size - keywordSize + 1;
+    size_t i = 0;
+    // Two blocks per iteration: nearly every block has no candidate at all
+    for (; i + 64 <= count; i += 64) {
+        __m256i low = candidatesAVX2(data + i, keywordSize, first, last);
+        __m256i high = candidatesAVX2(data + i + 32, keywordSize, first, last);
+        if (_mm256_testz_si256(_mm256_or_si256(low, high), _mm256_or_si256(low, high))) {
+            continue;
+        }
+        uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(low)) |
+                        static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(high))) << 32;
+        size_t offset = 0;
+        if (matchCandidates(data + i, keyword, keywordSize, mask, 1, offset)) {
+            return i + offset;
+        }
+    }
+    return i + findSSE2(data + i, size - i, keyword, keywordSize);
+}
+
+constexpr Implementation AVX2{Level::AVX2, scanAVX2, findAVX2};
+
+#endif // BYTE_SCAN_X86
+
+#if BYTE_SCAN_NEON
+
+// --- NEON: nibble table lookup, 16 bytes at a time ---
+
+// Four mask bits per byte, since NEON has no movemask
+uint64_t nibbleMask(uint8x16_t lanes) {
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(lanes), 4)), 0);
+}
+
+size_t scanNEON(const char* data, size_t size, const ByteSet& set, bool inSet) {
+    const uint8x16_t low = vld1q_u8(set.lowNibbles());
+    const uint8x16_t high = vld1q_u8(set.highNibbles());
+    const uint8x16_t nibble = vdupq_n_u8(0x0f);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(data + i));
+        uint8x16_t inside = vtstq_u8(vqtbl1q_u8(low, vandq_u8(bytes, nibble)), vqtbl1q_u8(high, vshrq_n_u8(bytes, 4)));
+        uint64_t mask = nibbleMask(inSet ? inside : vmvnq_u8(inside));
+        if (mask != 0) {
+            return i + static_cast<size_t>(__builtin_ctzll(mask)) / 4;
+        }
+    }
+    return i + scanScalar(data + i, size - i, set, inSet);
+}
+
+size_t findNEON(const char* data, size_t size, const char* keyword, size_t keywordSize) {
+    const uint8x16_t first = vdupq_n_u8(static_cast<uint8_t>(keyword[0]));
+    const uint8x16_t last = vdupq_n_u8(static_cast<uint8_t>(keyword[keywordSize - 1]));
+    const size_t candidates = size - keywordSize + 1;
+    size_t i = 0;
+    for (; i + 16 <= candidates; i += 16) {
+        uint8x16_t head = vld1q_u8(reinterpret_cast<const uint8_t*>(data + i));
+        uint8x16_t tail = vld1q_u8(reinterpret_cast<const uint8_t*>(data + i + keywordSize - 1));
+        uint64_t mask = nibbleMask(vandq_u8(vceqq_u8(head, first), vceqq_u8(tail, last)));
+        size_t offset = 0;
+        if (matchCandidates(data + i, keyword, keywordSize, mask, 4, offset)) {
+            return i + offset;
+        }
+    }
+    return i + findScalar(data + i, size - i, keyword, keywordSize);
+}
+
+constexpr Implementation NEON{Level::NEON, scanNEON, findNEON};
+
+#endif // BYTE_SCAN_NEON
+
+const Implementation* implementation(Level level) {
+    switch (level) {
+        case Level::Scalar:
+            return &SCALAR;
+#if BYTE_SCAN_X86
+        case Level::SSE2:
+            return &SSE2;
+        case Level::AVX2:
+            return __builtin_cpu_supports("avx2") ? &AVX2 : nullptr;
+#endif
+#if BYTE_SCAN_NEON
+        case Level::NEON:
+            return &NEON;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+} // namespace
+
+namespace detail {
+
+const Implementation& select() {
+    const Implementation* best = nullptr;
+    for (Level level : {Level::AVX2, Level::NEON, Level::SSE2, Level::Scalar}) {
+        if ((best = implementation(level)) != nullptr) {
+            break;
+        }
+    }
+    // Every thread selects the same implementation, so a race here is harmless
+    current.store(best, std::memory_order_relaxed);
+    return *best;
+}
+
+} // namespace detail
+
+bool isSupported(Level level) {
+    return implementation(level) != nullptr;
+}
+
+Level getLevel() {
+    return detail::active().level;
+}
+
+void setLevel(Level level) {
+    const Implementation* chosen = implementation(level);
+    if (!chosen) {
+        throw std::invalid_argument(std::string("Byte scanning level not supported: ") + levelName(level));
+    }
+    detail::current.store(chosen, std::memory_order_relaxed);
+}
+
+const char* levelName(Level level) {
+    switch (level) {
+        case Level::Scalar: return "scalar";
+        case Level::SSE2: return "sse2";
+        case Level::AVX2: return "avx2";
+        case Level::NEON: return "neon";
+    }
+    return "?";
+}
+
+} // namespace ByteScan
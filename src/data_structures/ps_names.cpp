@@ -0,0 +1,138 @@
+#include "ps_names.h"
+#include <functional>
+#include <stdexcept>
+
+namespace PostScript {
+
+namespace {
+
+constexpr size_t INITIAL_INDEX_CAPACITY = 1024;
+
+uint32_t hashName(std::string_view name) {
+    uint64_t h = std::hash<std::string_view>{}(name);
+    return static_cast<uint32_t>(h ^ (h >> 32));
+}
+
+// Chunk k holds the 256 << k atoms starting at 256 * (2^k - 1); position is atom + 256
+uint64_t chunkPosition(NameId id, unsigned firstChunkBits) {
+    return static_cast<uint64_t>(id) + (uint64_t{1} << firstChunkBits);
+}
+
+unsigned chunkOf(uint64_t position, unsigned firstChunkBits) {
+    return 63 - static_cast<unsigned>(__builtin_clzll(position)) - firstChunkBits;
+}
+
+} // namespace
+
+NameTable::Index::Index(size_t capacity)
+    : mask(capacity - 1), slots(new std::atomic<uint64_t>[capacity]()) {}
+
+NameTable::NameTable() {
+    for (auto& chunk : chunks_) {
+        chunk.store(nullptr, std::memory_order_relaxed);
+    }
+    indexes_.push_back(std::make_unique<Index>(INITIAL_INDEX_CAPACITY));
+    index_.store(indexes_.back().get(), std::memory_order_release);
+}
+
+NameTable::~NameTable() {
+    for (auto& chunk : chunks_) {
+        delete[] chunk.load(std::memory_order_relaxed);
+    }
+}
+
+NameTable& NameTable::global() {
+    static NameTable table;
+    return table;
+}
+
+std::string& NameTable::slot(NameId id) const {
+    uint64_t position = chunkPosition(id, FIRST_CHUNK_BITS);
+    unsigned chunk = chunkOf(position, FIRST_CHUNK_BITS);
+    return chunks_[chunk].load(std::memory_order_acquire)[position - (uint64_t{1} << (chunk + FIRST_CHUNK_BITS))];
+}
+
+NameId NameTable::lookup(std::string_view name, uint32_t hash) const {
+    const Index* index = index_.load(std::memory_order_acquire);
+    for (size_t i = hash & index->mask;; i = (i + 1) & index->mask) {
+        uint64_t entry = index->slots[i].load(std::memory_order_acquire);
+        if (entry == 0) {
+            return NO_NAME;
+        }
+        if ((entry >> 32) == hash) {
+            NameId id = static_cast<NameId>(entry) - 1;
+            if (slot(id) == name) {
+                return id;
+            }
+        }
+    }
+}
+
+void NameTable::insert(Index& index, NameId id, uint32_t hash) {
+    size_t i = hash & index.mask;
+    while (index.slots[i].load(std::memory_order_relaxed) != 0) {
+        i = (i + 1) & index.mask;
+    }
+    index.slots[i].store(static_cast<uint64_t>(hash) << 32 | (static_cast<uint64_t>(id) + 1), std::memory_order_release);
+}
+
+NameId NameTable::intern(std::string_view name) {
+    uint32_t hash = hashName(name);
+    NameId id = lookup(name, hash);
+    if (id != NO_NAME) {
+        return id;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Another thread may have added it since the lookup
+    id = lookup(name, hash);
+    if (id != NO_NAME) {
+        return id;
+    }
+    size_t size = size_.load(std::memory_order_relaxed);
+    if (size >= limit()) {
+        throw std::runtime_error("Name table full");
+    }
+    id = static_cast<NameId>(size);
+
+    unsigned chunk = chunkOf(chunkPosition(id, FIRST_CHUNK_BITS), FIRST_CHUNK_BITS);
+    if (!chunks_[chunk].load(std::memory_order_relaxed)) {
+        chunks_[chunk].store(new std::string[size_t{1} << (chunk + FIRST_CHUNK_BITS)], std::memory_order_release);
+    }
+    slot(id) = std::string(name);
+    // Publish the size first, so name() accepts any atom a lookup can return
+    size_.store(size + 1, std::memory_order_release);
+
+    // Keep the index at most half full; readers of the old one just miss the new name
+    Index* index = indexes_.back().get();
+    if ((size + 1) * 2 > index->mask + 1) {
+        auto grown = std::make_unique<Index>((index->mask + 1) * 2);
+        for (size_t i = 0; i <= index->mask; ++i) {
+            uint64_t entry = index->slots[i].load(std::memory_order_relaxed);
+            if (entry != 0) {
+                insert(*grown, static_cast<NameId>(entry) - 1, static_cast<uint32_t>(entry >> 32));
+            }
+        }
+        index = grown.get();
+        indexes_.push_back(std::move(grown));
+    }
+    insert(*index, id, hash);
+    index_.store(index, std::memory_order_release);
+    return id;
+}
+
+NameId NameTable::find(std::string_view name) const {
+    return lookup(name, hashName(name));
+}
+
+const std::string& NameTable::name(NameId id) const {
+    if (id >= size_.load(std::memory_order_acquire)) {
+        throw std::runtime_error("Invalid name id");
+    }
+    return slot(id);
+}
+
+size_t NameTable::size() const {
+    return size_.load(std::memory_order_acquire);
+}
+
+} // namespace PostScript
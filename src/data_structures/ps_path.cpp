@@ -0,0 +1,144 @@
+#include "ps_path.h"
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace PostScript {
+
+PSPath::PSPath(const PSPath& other) : storage_(other.storage_) {
+    if (storage_) {
+        storage_->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+PSPath::PSPath(PSPath&& other) noexcept : storage_(std::exchange(other.storage_, nullptr)) {}
+
+PSPath& PSPath::operator=(PSPath other) noexcept {
+    std::swap(storage_, other.storage_);
+    return *this;
+}
+
+PSPath::~PSPath() {
+    release();
+}
+
+void PSPath::release() {
+    if (storage_ && storage_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete storage_;
+    }
+    storage_ = nullptr;
+}
+
+PSPath::Storage& PSPath::writable() {
+    if (!storage_) {
+        storage_ = new Storage();
+    } else if (storage_->refs.load(std::memory_order_acquire) != 1) {
+        // Another graphics state still sees the old contents
+        Storage* copy = new Storage();
+        copy->verbs = storage_->verbs;
+        copy->points = storage_->points;
+        release();
+        storage_ = copy;
+    }
+    return *storage_;
+}
+
+void PSPath::moveTo(const Point& point) {
+    Storage& storage = writable();
+    storage.verbs.push_back(Verb::MoveTo);
+    storage.points.push_back(point);
+}
+
+void PSPath::lineTo(const Point& point) {
+    Storage& storage = writable();
+    storage.verbs.push_back(Verb::LineTo);
+    storage.points.push_back(point);
+}
+
+void PSPath::curveTo(const Point& control1, const Point& control2, const Point& end) {
+    Storage& storage = writable();
+    storage.verbs.push_back(Verb::CurveTo);
+    storage.points.push_back(control1);
+    storage.points.push_back(control2);
+    storage.points.push_back(end);
+}
+
+void PSPath::closePath() {
+    writable().verbs.push_back(Verb::ClosePath);
+}
+
+Point PSPath::arc(const Point& center, double radius, double angle1, double angle2, bool clockwise) {
+    // arc sweeps counterclockwise from angle1 to angle2, arcn clockwise: the
+    // end angle is moved by whole turns to within one turn past the start
+    double degrees = clockwise ? angle1 - angle2 : angle2 - angle1;
+    if (!std::isfinite(degrees)) {
+        throw std::runtime_error("rangecheck: arc angles must be finite");
+    }
+    if (degrees < 0.0) {
+        degrees = std::fmod(degrees, 360.0);
+        if (degrees < 0.0) degrees += 360.0;
+    } else if (degrees > 360.0) {
+        degrees = std::fmod(degrees, 360.0);
+        if (degrees == 0.0) degrees = 360.0;
+    }
+    if (clockwise) degrees = -degrees;
+    const double start = std::fmod(angle1, 360.0) * M_PI / 180.0;
+    const double sweep = degrees * M_PI / 180.0;
+
+    auto pointAt = [&](double angle) {
+        return Point(center.x + radius * std::cos(angle), center.y + radius * std::sin(angle));
+    };
+
+    Point first = pointAt(start);
+    if (empty()) {
+        moveTo(first);
+    } else {
+        lineTo(first);
+    }
+
+    // Quarter circles or less keep the cubic approximation's error below 0.03%
+    const int pieces = static_cast<int>(std::ceil(std::fabs(sweep) / (M_PI / 2) - 1e-9));
+    if (pieces == 0) {
+        return first;
+    }
+    const double step = sweep / pieces;
+    const double handle = 4.0 / 3.0 * std::tan(step / 4.0) * radius;
+    Storage& storage = writable();
+    storage.verbs.reserve(storage.verbs.size() + pieces);
+    storage.points.reserve(storage.points.size() + 3 * pieces);
+
+    double angle = start;
+    Point from = first;
+    for (int i = 0; i < pieces; ++i) {
+        double next = angle + step;
+        Point to = pointAt(next);
+        curveTo(Point(from.x - handle * std::sin(angle), from.y + handle * std::cos(angle)),
+                Point(to.x + handle * std::sin(next), to.y - handle * std::cos(next)),
+                to);
+        angle = next;
+        from = to;
+    }
+    return from;
+}
+
+void PSPath::clear() {
+    if (!storage_) {
+        return;
+    }
+    if (storage_->refs.load(std::memory_order_acquire) == 1) {
+        storage_->verbs.clear();
+        storage_->points.clear();
+    } else {
+        release();
+    }
+}
+
+size_t PSPath::memoryUsage() const {
+    if (!storage_) {
+        return 0;
+    }
+    return sizeof(Storage) + storage_->verbs.capacity() * sizeof(Verb) +
+           storage_->points.capacity() * sizeof(Point);
+}
+
+} // namespace PostScript
@@ -4,26 +4,8 @@
 
 namespace PostScript {
 
-void PSStack::push(const PSObjectPtr& obj) {
-    stack_.push_back(obj);
-}
-
-PSObjectPtr PSStack::pop() {
-    if (stack_.empty()) {
-        throw std::runtime_error("Stack underflow: cannot pop from empty stack");
-    }
-    
-    PSObjectPtr top = stack_.back();
-    stack_.pop_back();
-    return top;
-}
-
-PSObjectPtr PSStack::peek() const {
-    if (stack_.empty()) {
-        throw std::runtime_error("Stack underflow: cannot peek empty stack");
-    }
-    
-    return stack_.back();
+void PSStack::underflow(const char* detail) {
+    throw std::runtime_error(std::string("Stack underflow: ") + detail);
 }
 
 void PSStack::dup() {
@@ -31,10 +13,9 @@ void PSStack::dup() {
         throw std::runtime_error("Stack underflow: cannot dup empty stack");
     }
     
-    // Create a new copy of the top element
-    PSObjectPtr top = stack_.back();
-    PSObjectPtr copy = std::make_shared<PSObject>(*top);
-    stack_.push_back(copy);
+    // The copy shares composite values with the original, as in PostScript
+    PSObject copy = stack_.back();
+    stack_.push_back(std::move(copy));
 }
 
 void PSStack::exch() {
@@ -51,17 +32,21 @@ void PSStack::clear() {
 }
 
 void PSStack::print() const {
-    std::cout << "Stack (" << stack_.size() << " elements): ";
+    print(std::cout);
+}
+
+void PSStack::print(std::ostream& out) const {
+    out << "Stack (" << stack_.size() << " elements): ";
     
     if (stack_.empty()) {
-        std::cout << "empty";
+        out << "empty";
     } else {
         for (size_t i = 0; i < stack_.size(); ++i) {
-            if (i > 0) std::cout << " ";
-            std::cout << stack_[i]->toString();
+            if (i > 0) out << " ";
+            out << stack_[i].toString();
         }
     }
-    std::cout << std::endl;
+    out << '\n';
 }
 
 } // namespace PostScript 
\ No newline at end of file
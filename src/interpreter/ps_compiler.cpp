@@ -0,0 +1,42 @@
+#include "ps_compiler.h"
+#include "ps_interpreter.h"
+
+namespace PostScript {
+
+std::shared_ptr<const PSCompiledProcedure> PSCompiler::compile(const std::vector<std::string>& tokens) {
+    // Compiled in the job arena when one is installed, like the procedure itself
+    auto compiled = std::allocate_shared<PSCompiledProcedure>(Memory::ArenaAllocator<PSCompiledProcedure>());
+    compiled->code.reserve(tokens.size());
+
+    for (const auto& token : tokens) {
+        if (token.empty()) {
+            continue;
+        }
+
+        // Operators are bound at compile time, exactly as executeToken checks them first
+        NameId id = NameTable::global().find(token);
+        OperatorFunction op = interpreter_.getOperators().getOperator(id);
+        if (op) {
+            compiled->code.emplace_back(PSInstruction::Opcode::CallOperator, PSObject(), op, id);
+            continue;
+        }
+
+        std::optional<PSObject> literal = interpreter_.parseLiteral(token);
+        if (literal) {
+            // Array and dictionary literals build a new object each time they execute
+            bool mutableComposite = literal->getType() == ObjectType::ARRAY ||
+                                    literal->getType() == ObjectType::DICTIONARY;
+            compiled->code.emplace_back(mutableComposite ? PSInstruction::Opcode::PushCopy
+                                                         : PSInstruction::Opcode::PushLiteral,
+                                        std::move(*literal), nullptr, NO_NAME);
+            continue;
+        }
+
+        compiled->code.emplace_back(PSInstruction::Opcode::ExecName, PSObject(), nullptr,
+                                    NameTable::global().intern(token));
+    }
+
+    return compiled;
+}
+
+} // namespace PostScript
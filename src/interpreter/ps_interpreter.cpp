@@ -1,24 +1,100 @@
 #include "ps_interpreter.h"
+#include "ps_compiler.h"
+#include "log.h"
+#include "profiler.h"
+#include <algorithm>
+#include <iterator>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
 
 namespace PostScript {
 
-PSInterpreter::PSInterpreter() : parser_(std::make_unique<PSParser>()) {
-    // Initialize with a default dictionary
-    PSDictionary defaultDict;
-    dictionaryStack_.push_back(std::make_shared<PSObject>(defaultDict));
+namespace {
+
+// Unbound names become strings; PDF content hits this for every unmapped operator
+void warnUnknownToken(std::string_view token) {
+    PS_LOG_WARNING(Exec, "Unknown token '" << token << "' - treating as literal string");
+}
+
+} // namespace
+
+PSInterpreter::PSInterpreter() : PSInterpreter(OperatorRegistry::standard()) {}
+
+PSInterpreter::PSInterpreter(std::shared_ptr<const OperatorRegistry> operators)
+    : operators_(std::move(operators)) {
+    if (!operators_ || operators_->getSystemDictionary().isNull()) {
+        throw std::runtime_error("Operator registry is not sealed");
+    }
+    context_.arena = Memory::ArenaRef::create();
+    context_.output = &std::cout;
+    reset();
+}
+
+void PSInterpreter::reset() {
+    context_.operands.clear();
+    context_.dictionaries.clear();
+    ++context_.dictionaryEpoch;
+    context_.operatorsShadowed = false;
     // Initialize graphics state stack with one default state
-    graphicsStack_.push_back(GraphicsState());
+    context_.graphics.clear();
+    context_.graphics.push_back(GraphicsState());
+    context_.saveLog.clear();
+    context_.saves.clear();
+    // The job's objects are gone, so its memory can be reused wholesale
+    context_.arena.recycle();
+    
+    // systemdict is kept; userdict starts empty, in the new job's arena
+    Memory::ArenaScope scope(context_.arena.get(), false);
+    context_.dictionaries.push_back(getSystemDictionary());
+    context_.dictionaries.push_back(PSObject(PSDictionary()));
+}
+
+PSSave PSInterpreter::save() {
+    // systemdict is shared and never replaced, so only the dictionaries above it are kept
+    SaveLevel level{context_.saveLog.push(), context_.arena,
+                    std::vector<PSObject>(context_.dictionaries.begin() + 1, context_.dictionaries.end()),
+                    context_.graphics, context_.operatorsShadowed};
+    PSSave save{level.serial};
+    context_.saves.push_back(std::move(level));
+    
+    // What the job creates from here on can be released wholesale by restore
+    Memory::ArenaRef fresh = context_.spareArena ? std::move(context_.spareArena) : Memory::ArenaRef::create();
+    Memory::ArenaScope::replace(context_.arena.get(), fresh.get());
+    context_.arena = std::move(fresh);
+    return save;
+}
+
+void PSInterpreter::restore(PSSave save) {
+    auto level = std::find_if(context_.saves.begin(), context_.saves.end(),
+                              [&save](const SaveLevel& open) { return open.serial == save.serial; });
+    if (level == context_.saves.end()) {
+        throw std::runtime_error("Invalid restore: save level is not active");
+    }
+    context_.saveLog.rollBack(save.serial);
+    context_.dictionaries.resize(1);
+    std::move(level->dictionaries.begin(), level->dictionaries.end(), std::back_inserter(context_.dictionaries));
+    context_.graphics = std::move(level->graphics);
+    context_.operatorsShadowed = level->operatorsShadowed;
+    // Rolled-back dictionaries hold new entries, so every cached binding is stale
+    ++context_.dictionaryEpoch;
+    
+    Memory::ArenaRef released = std::move(context_.arena);
+    context_.arena = std::move(level->arena);
+    Memory::ArenaScope::replace(released.get(), context_.arena.get());
+    context_.saves.erase(level, context_.saves.end());
+    // Nothing created since the save is left unless the operand stack still holds it
+    if (released->rewind()) {
+        context_.spareArena = std::move(released);
+    }
 }
 
 void PSInterpreter::execute(const std::string& program) {
+    Memory::ArenaScope scope(context_.arena.get(), false);
+    PSSaveLog::Scope changes(context_.saveLog);
     try {
-        std::vector<std::string> tokens = parser_->parse(program);
-        std::cout << "[DEBUG] Parsed tokens (execute): ";
-        for (const auto& t : tokens) std::cout << "'" << t << "' ";
-        std::cout << std::endl;
+        std::vector<std::string> tokens = parser_.parse(program);
+        PS_LOG_DEBUG(Exec, "Parsed " << tokens.size() << " tokens (execute)");
         for (const auto& token : tokens) {
             executeToken(token);
         }
@@ -29,13 +105,14 @@ void PSInterpreter::execute(const std::string& program) {
 }
 
 void PSInterpreter::executeFile(const std::string& filename) {
+    Memory::ArenaScope scope(context_.arena.get(), false);
+    PSSaveLog::Scope changes(context_.saveLog);
     try {
-        std::vector<std::string> tokens = parser_->parseFile(filename);
-        std::cout << "[DEBUG] Parsed tokens (executeFile): ";
-        for (const auto& t : tokens) std::cout << "'" << t << "' ";
-        std::cout << std::endl;
-        for (const auto& token : tokens) {
-            executeToken(token);
+        // Tokens are pulled from the file as execution proceeds
+        std::unique_ptr<PSTokenStream> tokens = parser_.openFile(filename);
+        std::string_view token;
+        while (tokens->next(token)) {
+            executeToken(std::string(token));
         }
     } catch (const std::exception& e) {
         std::cerr << "Error executing PostScript file '" << filename << "': " << e.what() << std::endl;
@@ -44,51 +121,185 @@ void PSInterpreter::executeFile(const std::string& filename) {
 }
 
 void PSInterpreter::executeToken(const std::string& token) {
-    std::cout << "[DEBUG] Executing token: '" << token << "'" << std::endl;
+    PS_LOG_TRACE(Exec, "Executing token: '" << token << "'");
+    // Objects created for the job come from its arena (an enclosing job's, if any)
+    Memory::ArenaScope scope(context_.arena.get(), false);
+    PSSaveLog::Scope changes(context_.saveLog);
     // Skip empty tokens
     if (token.empty()) {
         return;
     }
     
-    // Check if it's an operator
-    if (operators_.hasOperator(token)) {
-        OperatorFunction op = operators_.getOperator(token);
-        if (op) {
-            op(*this);
+    // Hash the token once; names never interned cannot be bound anywhere
+    NameId id = NameTable::global().find(token);
+    
+    // Operators and user definitions, searched through the dictionary stack
+    if (id != NO_NAME) {
+        if (const PSObject* value = lookup(id)) {
+            executeBinding(id, *value);
+            return;
         }
-        return;
     }
     
-    // Check if it's a dictionary key (starts with /)
+    // Check if it's a literal name (starts with /)
     if (token.length() > 1 && token[0] == '/') {
-        std::string key = token.substr(1); // Remove the leading slash
-        stack_.push(std::make_shared<PSObject>(token)); // Push the full token including /
+        context_.operands.push(PSObject(PSName{NameTable::global().intern(std::string_view(token).substr(1))}));
+        return;
+    }
+    
+    // Numbers, strings, booleans and composite literals
+    std::optional<PSObject> literal = parseLiteral(token);
+    if (literal) {
+        context_.operands.push(std::move(*literal));
+        return;
+    }
+    
+    // If we get here, it's an unknown token
+    warnUnknownToken(token);
+    context_.operands.push(PSObject(token));
+}
+
+void PSInterpreter::executeName(NameId name) {
+    if (const PSObject* value = lookup(name)) {
+        executeBinding(name, *value);
+        return;
+    }
+    
+    const std::string& token = NameTable::global().name(name);
+    warnUnknownToken(token);
+    context_.operands.push(PSObject(token));
+}
+
+void PSInterpreter::executeValue(const PSObject& value) {
+    switch (value.getType()) {
+        case ObjectType::OPERATOR:
+            value.asOperator()(*this);
+            break;
+        case ObjectType::PROCEDURE: {
+            // Hold a reference: the procedure may redefine its own name while running
+            PSObject proc = value;
+            executeProcedure(proc);
+            break;
+        }
+        default:
+            context_.operands.push(value);
+            break;
+    }
+}
+
+void PSInterpreter::executeBinding(NameId name, const PSObject& value) {
+    ObjectType type = value.getType();
+    if (Profiling::isEnabled() && (type == ObjectType::OPERATOR || type == ObjectType::PROCEDURE)) {
+        Profiling::Scope scope(type == ObjectType::OPERATOR ? Profiling::Kind::Operator : Profiling::Kind::Procedure,
+                               name);
+        executeValue(value);
+        return;
+    }
+    executeValue(value);
+}
+
+const PSObject* PSInterpreter::resolve(NameId name) {
+    const PSObject* value = nullptr;
+    for (auto it = context_.dictionaries.rbegin(); it != context_.dictionaries.rend() && !value; ++it) {
+        value = it->dictFind(name);
+    }
+    if (name >= MAX_CACHED_BINDINGS) {
+        return value;
+    }
+    if (name >= context_.bindings.size()) {
+        context_.bindings.resize(name + 1);
+    }
+    // Dictionary entries are nodes, so the pointer survives rehashing
+    context_.bindings[name] = Binding{value, context_.dictionaryEpoch};
+    return value;
+}
+
+const PSObject* PSInterpreter::findDefiningDictionary(NameId name) const {
+    for (auto it = context_.dictionaries.rbegin(); it != context_.dictionaries.rend(); ++it) {
+        if (it->dictHas(name)) {
+            return &*it;
+        }
+    }
+    return nullptr;
+}
+
+void PSInterpreter::define(NameId name, const PSObject& value) {
+    PSObject& current = context_.dictionaries.back();
+    if (current.getType() != ObjectType::DICTIONARY) {
+        throw std::runtime_error("No current dictionary available");
+    }
+    // Replacing a value leaves cached pointers to its entry valid
+    if (current.dictPut(name, value) || operators_->getOperator(name)) {
+        invalidateBinding(name);
+    }
+}
+
+void PSInterpreter::invalidateBinding(NameId name) {
+    if (name < context_.bindings.size()) {
+        context_.bindings[name].epoch = 0;
+    }
+    if (operators_->getOperator(name)) {
+        context_.operatorsShadowed = true;
+    }
+}
+
+void PSInterpreter::executeProcedure(const PSObject& procedure) {
+    if (procedure.getType() != ObjectType::PROCEDURE) {
+        throw std::runtime_error("Object is not a procedure");
+    }
+    
+    const PSProcedure& proc = procedure.asProcedure();
+    if (!proc.code) {
+        // Procedures built without going through the compiler run from their tokens
+        for (const auto& token : proc.tokens) {
+            executeToken(token);
+        }
         return;
     }
     
-    // Check if it's a procedure name (look it up in the current dictionary)
-    PSObjectPtr currentDict = getCurrentDictionary();
-    if (currentDict && currentDict->getType() == ObjectType::DICTIONARY) {
-        if (currentDict->dictHas(token)) {
-            PSObjectPtr proc = currentDict->dictGet(token);
-            if (proc->getType() == ObjectType::PROCEDURE) {
-                // Execute the procedure
-                PSProcedure procedure = proc->asProcedure();
-                for (const auto& procToken : procedure) {
-                    executeToken(procToken);
+    // Hold a reference so the code stays alive even if the procedure is redefined while running
+    std::shared_ptr<const PSCompiledProcedure> compiled = proc.code;
+    for (const auto& instruction : compiled->code) {
+        switch (instruction.opcode) {
+            case PSInstruction::Opcode::PushLiteral:
+                context_.operands.push(instruction.literal);
+                break;
+            case PSInstruction::Opcode::PushCopy:
+                context_.operands.push(instruction.literal.duplicate());
+                break;
+            case PSInstruction::Opcode::CallOperator:
+                if (context_.operatorsShadowed) {
+                    executeName(instruction.name);
+                } else if (Profiling::isEnabled()) {
+                    Profiling::Scope scope(Profiling::Kind::Operator, instruction.name);
+                    instruction.function(*this);
+                } else {
+                    instruction.function(*this);
                 }
-                return;
-            }
+                break;
+            case PSInstruction::Opcode::ExecName:
+                executeName(instruction.name);
+                break;
         }
     }
+}
+
+std::optional<PSObject> PSInterpreter::parseLiteral(const std::string& token) {
+    if (token.empty()) {
+        return std::nullopt;
+    }
+    
+    // Literal names (starts with /)
+    if (token.length() > 1 && token[0] == '/') {
+        return PSObject(PSName{NameTable::global().intern(std::string_view(token).substr(1))});
+    }
     
     // Check if it's a number (integer or real)
     if (token.find('.') != std::string::npos) {
         // Try to parse as real number
         try {
             double value = std::stod(token);
-            stack_.push(std::make_shared<PSObject>(value));
-            return;
+            return PSObject(value);
         } catch (const std::exception&) {
             // Not a valid real number, continue to other checks
         }
@@ -96,8 +307,7 @@ void PSInterpreter::executeToken(const std::string& token) {
         // Try to parse as integer
         try {
             int value = std::stoi(token);
-            stack_.push(std::make_shared<PSObject>(value));
-            return;
+            return PSObject(value);
         } catch (const std::exception&) {
             // Not a valid integer, continue to other checks
         }
@@ -105,119 +315,148 @@ void PSInterpreter::executeToken(const std::string& token) {
     
     // Check if it's a string literal (enclosed in parentheses)
     if (token.length() >= 2 && token[0] == '(' && token[token.length()-1] == ')') {
-        stack_.push(std::make_shared<PSObject>(token));
-        return;
+        return PSObject(token);
     }
     
     // Check if it's an array literal (enclosed in square brackets)
     if (token.length() >= 2 && token[0] == '[' && token[token.length()-1] == ']') {
         // Parse array contents
         std::string arrayContent = token.substr(1, token.length() - 2);
-        std::vector<std::string> elementTokens = parser_->parse(arrayContent);
+        std::vector<std::string> elementTokens = parser_.parse(arrayContent);
         
         PSArray array;
         for (const auto& elementToken : elementTokens) {
             if (!elementToken.empty()) {
-                // Create a temporary interpreter to parse each element
-                PSInterpreter tempInterpreter;
-                tempInterpreter.executeToken(elementToken);
-                if (!tempInterpreter.getStack().empty()) {
-                    array.push_back(tempInterpreter.getStack().pop());
-                }
+                array.push_back(parseElement(elementToken));
             }
         }
         
-        stack_.push(std::make_shared<PSObject>(array));
-        return;
+        return PSObject(std::move(array));
     }
     
     // Check if it's a dictionary literal (enclosed in << >>)
     if (token.length() >= 4 && token.substr(0, 2) == "<<" && token.substr(token.length()-2) == ">>") {
         // Parse dictionary contents
         std::string dictContent = token.substr(2, token.length() - 4);
-        std::vector<std::string> elementTokens = parser_->parse(dictContent);
+        std::vector<std::string> elementTokens = parser_.parse(dictContent);
         
         PSDictionary dict;
         for (size_t i = 0; i < elementTokens.size(); i += 2) {
             if (i + 1 < elementTokens.size()) {
-                std::string key = elementTokens[i];
-                std::string valueToken = elementTokens[i + 1];
+                std::string_view key = elementTokens[i];
+                const std::string& valueToken = elementTokens[i + 1];
                 
                 // Remove leading slash from key
                 if (key.length() > 0 && key[0] == '/') {
-                    key = key.substr(1);
+                    key.remove_prefix(1);
                 }
                 
-                // Parse value
-                PSInterpreter tempInterpreter;
-                tempInterpreter.executeToken(valueToken);
-                if (!tempInterpreter.getStack().empty()) {
-                    dict[key] = tempInterpreter.getStack().pop();
-                }
+                dict[NameTable::global().intern(key)] = parseElement(valueToken);
             }
         }
         
-        stack_.push(std::make_shared<PSObject>(dict));
-        return;
+        return PSObject(std::move(dict));
     }
     
     // Check if it's a procedure literal (enclosed in braces)
     if (token.length() >= 2 && token[0] == '{' && token[token.length()-1] == '}') {
         // Parse procedure contents
         std::string procContent = token.substr(1, token.length() - 2);
-        std::vector<std::string> procTokens = parser_->parse(procContent);
+        std::vector<std::string> procTokens = parser_.parse(procContent);
         
         PSProcedure procedure;
         for (const auto& procToken : procTokens) {
             if (!procToken.empty()) {
-                procedure.push_back(procToken);
+                procedure.tokens.push_back(procToken);
             }
         }
+        // Compile once here so every later execution skips token classification
+        procedure.code = PSCompiler(*this).compile(procedure.tokens);
         
-        stack_.push(std::make_shared<PSObject>(procedure));
-        return;
+        return PSObject(std::move(procedure));
     }
     
     // Check if it's a boolean literal
     if (token == "true") {
-        stack_.push(std::make_shared<PSObject>(true));
-        return;
+        return PSObject(true);
     }
     
     if (token == "false") {
-        stack_.push(std::make_shared<PSObject>(false));
-        return;
+        return PSObject(false);
     }
     
-    // If we get here, it's an unknown token
-    std::cerr << "Warning: Unknown token '" << token << "' - treating as literal string" << std::endl;
-    stack_.push(std::make_shared<PSObject>(token));
+    return std::nullopt;
+}
+
+PSObject PSInterpreter::parseElement(const std::string& token) {
+    std::optional<PSObject> literal = parseLiteral(token);
+    if (literal) {
+        return std::move(*literal);
+    }
+    // Nothing runs while a literal is parsed: operator names are bound, others kept as text
+    NameId id = NameTable::global().find(token);
+    if (OperatorFunction op = operators_->getOperator(id)) {
+        return PSObject(op, id);
+    }
+    warnUnknownToken(token);
+    return PSObject(token);
 }
 
 void PSInterpreter::printState() const {
-    std::cout << "=== PostScript Interpreter State ===" << std::endl;
-    stack_.print();
-    std::cout << "Dictionary stack size: " << dictionaryStack_.size() << std::endl;
-    std::cout << "===================================" << std::endl;
+    std::ostream& out = *context_.output;
+    out << "=== PostScript Interpreter State ===\n";
+    context_.operands.print(out);
+    out << "Dictionary stack size: " << context_.dictionaries.size() << '\n';
+    out << "===================================" << std::endl;
+}
+
+const PSObject& PSInterpreter::getCurrentDictionary() const {
+    static const PSObject none;
+    if (context_.dictionaries.empty()) {
+        return none;
+    }
+    return context_.dictionaries.back();
+}
+
+void PSInterpreter::pushDictionary(const PSObject& dict) {
+    if (dict.getType() != ObjectType::DICTIONARY) {
+        throw std::runtime_error("Object is not a dictionary");
+    }
+    context_.dictionaries.push_back(dict);
+    ++context_.dictionaryEpoch;
+    // Compiled operator calls stay direct only while no operator name is redefined
+    if (!context_.operatorsShadowed && !dict.sharesStorage(getSystemDictionary())) {
+        for (const auto& entry : dict.asDictionary()) {
+            if (operators_->getOperator(entry.first)) {
+                context_.operatorsShadowed = true;
+                break;
+            }
+        }
+    }
 }
 
-PSObjectPtr PSInterpreter::getCurrentDictionary() const {
-    if (dictionaryStack_.empty()) {
-        return nullptr;
+void PSInterpreter::popGraphicsState() {
+    if (context_.graphics.size() <= 1) {
+        throw std::runtime_error("Graphics state stack underflow");
     }
-    return dictionaryStack_.back();
+    context_.graphics.pop_back();
 }
 
-void PSInterpreter::pushDictionary(const PSObjectPtr& dict) {
-    dictionaryStack_.push_back(dict);
+void PSInterpreter::setGraphicsStack(std::vector<GraphicsState> graphics) {
+    if (graphics.empty()) {
+        throw std::runtime_error("Graphics state stack cannot be empty");
+    }
+    context_.graphics = std::move(graphics);
 }
 
-PSObjectPtr PSInterpreter::popDictionary() {
-    if (dictionaryStack_.empty()) {
+PSObject PSInterpreter::popDictionary() {
+    // systemdict and userdict are permanent
+    if (context_.dictionaries.size() <= 2) {
         throw std::runtime_error("Dictionary stack underflow");
     }
-    PSObjectPtr dict = dictionaryStack_.back();
-    dictionaryStack_.pop_back();
+    PSObject dict = std::move(context_.dictionaries.back());
+    context_.dictionaries.pop_back();
+    ++context_.dictionaryEpoch;
     return dict;
 }
 
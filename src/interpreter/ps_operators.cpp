@@ -1,9 +1,12 @@
 #include "ps_operators.h"
 #include "ps_interpreter.h"
+#include "ps_raster.h"
+#include "log.h"
 #include <iostream>
 #include <stdexcept>
 #include <sstream>
 #include <cmath>
+#include <string_view>
 
 namespace PostScript {
 
@@ -47,6 +50,12 @@ OperatorRegistry::OperatorRegistry() {
     registerOperator("store", Operators::store);
     registerOperator("known", Operators::known);
     registerOperator("keys", Operators::keys);
+    registerOperator("begin", Operators::begin);
+    registerOperator("end", Operators::end);
+    registerOperator("currentdict", Operators::currentdict);
+    registerOperator("userdict", Operators::userdict);
+    registerOperator("systemdict", Operators::systemdict);
+    registerOperator("where", Operators::where);
     
     // Register control flow operators
     registerOperator("exec", Operators::exec);
@@ -60,11 +69,17 @@ OperatorRegistry::OperatorRegistry() {
     registerOperator("moveto", Operators::moveto);
     registerOperator("lineto", Operators::lineto);
     registerOperator("closepath", Operators::closepath);
+    registerOperator("curveto", Operators::curveto);
+    registerOperator("arc", Operators::arc);
+    registerOperator("arcn", Operators::arcn);
     registerOperator("stroke", Operators::stroke);
     registerOperator("fill", Operators::fill);
+    registerOperator("eofill", Operators::eofill);
     registerOperator("newpath", Operators::newpath);
     registerOperator("gsave", Operators::gsave);
     registerOperator("grestore", Operators::grestore);
+    registerOperator("save", Operators::save);
+    registerOperator("restore", Operators::restore);
     registerOperator("translate", Operators::translate);
     registerOperator("scale", Operators::scale);
     registerOperator("rotate", Operators::rotate);
@@ -74,21 +89,142 @@ OperatorRegistry::OperatorRegistry() {
 }
 
 void OperatorRegistry::registerOperator(const std::string& name, OperatorFunction func) {
-    operators_[name] = func;
+    NameId id = NameTable::global().intern(name);
+    if (id >= operators_.size()) {
+        operators_.resize(id + 1, nullptr);
+    }
+    operators_[id] = func;
 }
 
 OperatorFunction OperatorRegistry::getOperator(const std::string& name) const {
-    auto it = operators_.find(name);
-    if (it != operators_.end()) {
-        return it->second;
-    }
-    return nullptr;
+    return getOperator(NameTable::global().find(name));
 }
 
 bool OperatorRegistry::hasOperator(const std::string& name) const {
-    return operators_.find(name) != operators_.end();
+    return getOperator(name) != nullptr;
+}
+
+std::shared_ptr<const OperatorRegistry> OperatorRegistry::seal(OperatorRegistry registry) {
+    // Shared by every interpreter, so it must not live in whichever job's arena is installed
+    Memory::ArenaScope scope(nullptr);
+    PSDictionary dict;
+    for (NameId id = 0; id < registry.operators_.size(); ++id) {
+        if (registry.operators_[id]) {
+            dict.emplace(id, PSObject(registry.operators_[id], id));
+        }
+    }
+    registry.systemDictionary_ = PSObject(std::move(dict));
+    registry.systemDictionary_.setReadOnly();
+    return std::make_shared<const OperatorRegistry>(std::move(registry));
+}
+
+const std::shared_ptr<const OperatorRegistry>& OperatorRegistry::standard() {
+    static const std::shared_ptr<const OperatorRegistry> registry = seal(OperatorRegistry());
+    return registry;
+}
+
+namespace {
+
+// Dictionary key of a name operand; strings are accepted the way def always has
+NameId keyName(const PSObject& keyObj) {
+    if (keyObj.getType() == ObjectType::NAME) {
+        return keyObj.asName();
+    }
+    if (keyObj.getType() != ObjectType::STRING) {
+        throw std::runtime_error("Key must be a name");
+    }
+    std::string_view key = keyObj.asString();
+    // Remove leading slash if present
+    if (key.length() > 0 && key[0] == '/') {
+        key.remove_prefix(1);
+    }
+    return NameTable::global().intern(key);
+}
+
+// Numeric operand as a double
+double popNumber(PSStack& stack, const char* op) {
+    PSObject obj = stack.pop();
+    if (obj.getType() == ObjectType::INTEGER) {
+        return obj.asInteger();
+    }
+    if (obj.getType() != ObjectType::REAL) {
+        throw std::runtime_error(std::string("Operand of ") + op + " must be a number");
+    }
+    return obj.asReal();
+}
+
+// Shared by arc and arcn, which differ only in sweep direction
+void appendArc(PSInterpreter& interpreter, bool clockwise, const char* name) {
+    PSStack& stack = interpreter.getStack();
+    
+    if (stack.size() < 5) {
+        throw std::runtime_error(std::string("Stack underflow: need x y r angle1 angle2 for ") + name);
+    }
+    
+    double angle2 = popNumber(stack, name);
+    double angle1 = popNumber(stack, name);
+    double radius = popNumber(stack, name);
+    double y = popNumber(stack, name);
+    double x = popNumber(stack, name);
+    
+    GraphicsState& gs = interpreter.getCurrentGraphicsState();
+    gs.currentPoint = gs.currentPath.arc(Point(x, y), radius, angle1, angle2, clockwise);
+}
+
+
+// Segment listing written by stroke and fill
+void printPath(std::ostream& out, const PSPath& path) {
+    size_t i = 0;
+    for (PSPath::Segment segment : path) {
+        const Point* p = segment.points;
+        switch (segment.verb) {
+            case PSPath::Verb::MoveTo:
+                out << "  " << i << ": moveto(" << p[0].x << ", " << p[0].y << ")\n";
+                break;
+            case PSPath::Verb::LineTo:
+                out << "  " << i << ": lineto(" << p[0].x << ", " << p[0].y << ")\n";
+                break;
+            case PSPath::Verb::CurveTo:
+                out << "  " << i << ": curveto(" << p[0].x << ", " << p[0].y << ", " << p[1].x << ", "
+                    << p[1].y << ", " << p[2].x << ", " << p[2].y << ")\n";
+                break;
+            case PSPath::Verb::ClosePath:
+                out << "  " << i << ": closepath\n";
+                break;
+        }
+        ++i;
+    }
+}
+
+// Hand a paint operation on the current path to the recorder, or else the device
+void emitPaint(PSInterpreter& interpreter, PaintCommand::Operation operation) {
+    const GraphicsState& gs = interpreter.getCurrentGraphicsState();
+    if (DisplayList* list = interpreter.getRecorder()) {
+        if (!gs.currentPath.empty()) {
+            list->add(PaintCommand::fromState(operation, gs));
+        }
+    } else if (RasterDevice* device = interpreter.getDevice()) {
+        device->paint(PaintCommand::fromState(operation, gs));
+    }
 }
 
+// Shared by fill and eofill: report the path, paint it, then clear it
+void paint(PSInterpreter& interpreter, const char* label, PaintCommand::Operation operation) {
+    GraphicsState& gs = interpreter.getCurrentGraphicsState();
+    std::ostream& out = interpreter.getOutput();
+    
+    out << label << ": Path with " << gs.currentPath.size() << " segments\n";
+    printPath(out, gs.currentPath);
+    out << "  Fill color: RGB(" << gs.r << ", " << gs.g << ", " << gs.b << ")\n";
+    
+    emitPaint(interpreter, operation);
+    
+    // Clear the current path after filling
+    gs.currentPath.clear();
+}
+
+} // namespace
+
 // Operator implementations
 namespace Operators {
 
@@ -99,18 +235,18 @@ void add(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need 2 operands for add");
     }
     
-    PSObjectPtr b = stack.pop();
-    PSObjectPtr a = stack.pop();
+    PSObject b = stack.pop();
+    PSObject a = stack.pop();
     
     // Handle different type combinations
-    if (a->getType() == ObjectType::INTEGER && b->getType() == ObjectType::INTEGER) {
-        int result = a->asInteger() + b->asInteger();
-        stack.push(std::make_shared<PSObject>(result));
-    } else if (a->getType() == ObjectType::REAL || b->getType() == ObjectType::REAL) {
-        double aVal = (a->getType() == ObjectType::INTEGER) ? a->asInteger() : a->asReal();
-        double bVal = (b->getType() == ObjectType::INTEGER) ? b->asInteger() : b->asReal();
+    if (a.getType() == ObjectType::INTEGER && b.getType() == ObjectType::INTEGER) {
+        int result = a.asInteger() + b.asInteger();
+        stack.push(PSObject(result));
+    } else if (a.getType() == ObjectType::REAL || b.getType() == ObjectType::REAL) {
+        double aVal = (a.getType() == ObjectType::INTEGER) ? a.asInteger() : a.asReal();
+        double bVal = (b.getType() == ObjectType::INTEGER) ? b.asInteger() : b.asReal();
         double result = aVal + bVal;
-        stack.push(std::make_shared<PSObject>(result));
+        stack.push(PSObject(result));
     } else {
         throw std::runtime_error("Invalid operands for add operation");
     }
@@ -123,18 +259,18 @@ void sub(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need 2 operands for sub");
     }
     
-    PSObjectPtr b = stack.pop();
-    PSObjectPtr a = stack.pop();
+    PSObject b = stack.pop();
+    PSObject a = stack.pop();
     
     // Handle different type combinations
-    if (a->getType() == ObjectType::INTEGER && b->getType() == ObjectType::INTEGER) {
-        int result = a->asInteger() - b->asInteger();
-        stack.push(std::make_shared<PSObject>(result));
-    } else if (a->getType() == ObjectType::REAL || b->getType() == ObjectType::REAL) {
-        double aVal = (a->getType() == ObjectType::INTEGER) ? a->asInteger() : a->asReal();
-        double bVal = (b->getType() == ObjectType::INTEGER) ? b->asInteger() : b->asReal();
+    if (a.getType() == ObjectType::INTEGER && b.getType() == ObjectType::INTEGER) {
+        int result = a.asInteger() - b.asInteger();
+        stack.push(PSObject(result));
+    } else if (a.getType() == ObjectType::REAL || b.getType() == ObjectType::REAL) {
+        double aVal = (a.getType() == ObjectType::INTEGER) ? a.asInteger() : a.asReal();
+        double bVal = (b.getType() == ObjectType::INTEGER) ? b.asInteger() : b.asReal();
         double result = aVal - bVal;
-        stack.push(std::make_shared<PSObject>(result));
+        stack.push(PSObject(result));
     } else {
         throw std::runtime_error("Invalid operands for sub operation");
     }
@@ -147,18 +283,18 @@ void mul(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need 2 operands for mul");
     }
     
-    PSObjectPtr b = stack.pop();
-    PSObjectPtr a = stack.pop();
+    PSObject b = stack.pop();
+    PSObject a = stack.pop();
     
     // Handle different type combinations
-    if (a->getType() == ObjectType::INTEGER && b->getType() == ObjectType::INTEGER) {
-        int result = a->asInteger() * b->asInteger();
-        stack.push(std::make_shared<PSObject>(result));
-    } else if (a->getType() == ObjectType::REAL || b->getType() == ObjectType::REAL) {
-        double aVal = (a->getType() == ObjectType::INTEGER) ? a->asInteger() : a->asReal();
-        double bVal = (b->getType() == ObjectType::INTEGER) ? b->asInteger() : b->asReal();
+    if (a.getType() == ObjectType::INTEGER && b.getType() == ObjectType::INTEGER) {
+        int result = a.asInteger() * b.asInteger();
+        stack.push(PSObject(result));
+    } else if (a.getType() == ObjectType::REAL || b.getType() == ObjectType::REAL) {
+        double aVal = (a.getType() == ObjectType::INTEGER) ? a.asInteger() : a.asReal();
+        double bVal = (b.getType() == ObjectType::INTEGER) ? b.asInteger() : b.asReal();
         double result = aVal * bVal;
-        stack.push(std::make_shared<PSObject>(result));
+        stack.push(PSObject(result));
     } else {
         throw std::runtime_error("Invalid operands for mul operation");
     }
@@ -171,26 +307,26 @@ void div(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need 2 operands for div");
     }
     
-    PSObjectPtr b = stack.pop();
-    PSObjectPtr a = stack.pop();
+    PSObject b = stack.pop();
+    PSObject a = stack.pop();
     
     // Check for division by zero
-    if ((b->getType() == ObjectType::INTEGER && b->asInteger() == 0) ||
-        (b->getType() == ObjectType::REAL && b->asReal() == 0.0)) {
+    if ((b.getType() == ObjectType::INTEGER && b.asInteger() == 0) ||
+        (b.getType() == ObjectType::REAL && b.asReal() == 0.0)) {
         throw std::runtime_error("Division by zero");
     }
     
     // Handle different type combinations
-    if (a->getType() == ObjectType::INTEGER && b->getType() == ObjectType::INTEGER) {
+    if (a.getType() == ObjectType::INTEGER && b.getType() == ObjectType::INTEGER) {
         // Integer division
-        int result = a->asInteger() / b->asInteger();
-        stack.push(std::make_shared<PSObject>(result));
+        int result = a.asInteger() / b.asInteger();
+        stack.push(PSObject(result));
     } else {
         // Real division
-        double aVal = (a->getType() == ObjectType::INTEGER) ? a->asInteger() : a->asReal();
-        double bVal = (b->getType() == ObjectType::INTEGER) ? b->asInteger() : b->asReal();
+        double aVal = (a.getType() == ObjectType::INTEGER) ? a.asInteger() : a.asReal();
+        double bVal = (b.getType() == ObjectType::INTEGER) ? b.asInteger() : b.asReal();
         double result = aVal / bVal;
-        stack.push(std::make_shared<PSObject>(result));
+        stack.push(PSObject(result));
     }
 }
 
@@ -211,17 +347,17 @@ void show(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need 1 operand for show");
     }
     
-    PSObjectPtr obj = stack.pop();
+    PSObject obj = stack.pop();
     
-    if (obj->getType() == ObjectType::STRING) {
+    if (obj.getType() == ObjectType::STRING) {
         // Remove the parentheses from the string literal
-        std::string str = obj->asString();
+        std::string_view str = obj.asString();
         if (str.length() >= 2 && str[0] == '(' && str[str.length()-1] == ')') {
             str = str.substr(1, str.length() - 2);
         }
-        std::cout << str;
+        interpreter.getOutput() << str;
     } else {
-        std::cout << obj->toString();
+        interpreter.getOutput() << obj.toString();
     }
 }
 
@@ -238,7 +374,7 @@ void clear(PSInterpreter& interpreter) {
 // Output and debugging operators
 void stack(PSInterpreter& interpreter) {
     PSStack& stack = interpreter.getStack();
-    stack.print();
+    stack.print(interpreter.getOutput());
 }
 
 // Comparison operators
@@ -249,37 +385,49 @@ void eq(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need 2 operands for eq");
     }
     
-    PSObjectPtr b = stack.pop();
-    PSObjectPtr a = stack.pop();
+    PSObject b = stack.pop();
+    PSObject a = stack.pop();
     
     bool result = false;
-    if (a->getType() == b->getType()) {
-        switch (a->getType()) {
+    if (a.getType() == b.getType()) {
+        switch (a.getType()) {
             case ObjectType::INTEGER:
-                result = a->asInteger() == b->asInteger();
+                result = a.asInteger() == b.asInteger();
                 break;
             case ObjectType::REAL:
-                result = a->asReal() == b->asReal();
+                result = a.asReal() == b.asReal();
                 break;
             case ObjectType::STRING:
-                result = a->asString() == b->asString();
+                result = a.asString() == b.asString();
+                break;
+            case ObjectType::NAME:
+                result = a.asName() == b.asName();
+                break;
+            case ObjectType::OPERATOR:
+                result = a.asOperator() == b.asOperator();
+                break;
+            case ObjectType::ARRAY:
+            case ObjectType::DICTIONARY:
+            case ObjectType::PROCEDURE:
+                // Composites are equal only when they are the same object
+                result = a.sharesStorage(b);
                 break;
             case ObjectType::BOOLEAN:
-                result = a->asBoolean() == b->asBoolean();
+                result = a.asBoolean() == b.asBoolean();
                 break;
             default:
                 result = false;
         }
     }
     
-    stack.push(std::make_shared<PSObject>(result));
+    stack.push(PSObject(result));
 }
 
 void ne(PSInterpreter& interpreter) {
     eq(interpreter);
     PSStack& stack = interpreter.getStack();
-    PSObjectPtr result = stack.pop();
-    stack.push(std::make_shared<PSObject>(!result->asBoolean()));
+    PSObject result = stack.pop();
+    stack.push(PSObject(!result.asBoolean()));
 }
 
 void lt(PSInterpreter& interpreter) {
@@ -289,21 +437,21 @@ void lt(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need 2 operands for lt");
     }
     
-    PSObjectPtr b = stack.pop();
-    PSObjectPtr a = stack.pop();
+    PSObject b = stack.pop();
+    PSObject a = stack.pop();
     
     bool result = false;
-    if (a->getType() == ObjectType::INTEGER && b->getType() == ObjectType::INTEGER) {
-        result = a->asInteger() < b->asInteger();
-    } else if (a->getType() == ObjectType::REAL || b->getType() == ObjectType::REAL) {
-        double aVal = (a->getType() == ObjectType::INTEGER) ? a->asInteger() : a->asReal();
-        double bVal = (b->getType() == ObjectType::INTEGER) ? b->asInteger() : b->asReal();
+    if (a.getType() == ObjectType::INTEGER && b.getType() == ObjectType::INTEGER) {
+        result = a.asInteger() < b.asInteger();
+    } else if (a.getType() == ObjectType::REAL || b.getType() == ObjectType::REAL) {
+        double aVal = (a.getType() == ObjectType::INTEGER) ? a.asInteger() : a.asReal();
+        double bVal = (b.getType() == ObjectType::INTEGER) ? b.asInteger() : b.asReal();
         result = aVal < bVal;
     } else {
         throw std::runtime_error("Invalid operands for lt operation");
     }
     
-    stack.push(std::make_shared<PSObject>(result));
+    stack.push(PSObject(result));
 }
 
 void le(PSInterpreter& interpreter) {
@@ -313,21 +461,21 @@ void le(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need 2 operands for le");
     }
     
-    PSObjectPtr b = stack.pop();
-    PSObjectPtr a = stack.pop();
+    PSObject b = stack.pop();
+    PSObject a = stack.pop();
     
     bool result = false;
-    if (a->getType() == ObjectType::INTEGER && b->getType() == ObjectType::INTEGER) {
-        result = a->asInteger() <= b->asInteger();
-    } else if (a->getType() == ObjectType::REAL || b->getType() == ObjectType::REAL) {
-        double aVal = (a->getType() == ObjectType::INTEGER) ? a->asInteger() : a->asReal();
-        double bVal = (b->getType() == ObjectType::INTEGER) ? b->asInteger() : b->asReal();
+    if (a.getType() == ObjectType::INTEGER && b.getType() == ObjectType::INTEGER) {
+        result = a.asInteger() <= b.asInteger();
+    } else if (a.getType() == ObjectType::REAL || b.getType() == ObjectType::REAL) {
+        double aVal = (a.getType() == ObjectType::INTEGER) ? a.asInteger() : a.asReal();
+        double bVal = (b.getType() == ObjectType::INTEGER) ? b.asInteger() : b.asReal();
         result = aVal <= bVal;
     } else {
         throw std::runtime_error("Invalid operands for le operation");
     }
     
-    stack.push(std::make_shared<PSObject>(result));
+    stack.push(PSObject(result));
 }
 
 void gt(PSInterpreter& interpreter) {
@@ -337,21 +485,21 @@ void gt(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need 2 operands for gt");
     }
     
-    PSObjectPtr b = stack.pop();
-    PSObjectPtr a = stack.pop();
+    PSObject b = stack.pop();
+    PSObject a = stack.pop();
     
     bool result = false;
-    if (a->getType() == ObjectType::INTEGER && b->getType() == ObjectType::INTEGER) {
-        result = a->asInteger() > b->asInteger();
-    } else if (a->getType() == ObjectType::REAL || b->getType() == ObjectType::REAL) {
-        double aVal = (a->getType() == ObjectType::INTEGER) ? a->asInteger() : a->asReal();
-        double bVal = (b->getType() == ObjectType::INTEGER) ? b->asInteger() : b->asReal();
+    if (a.getType() == ObjectType::INTEGER && b.getType() == ObjectType::INTEGER) {
+        result = a.asInteger() > b.asInteger();
+    } else if (a.getType() == ObjectType::REAL || b.getType() == ObjectType::REAL) {
+        double aVal = (a.getType() == ObjectType::INTEGER) ? a.asInteger() : a.asReal();
+        double bVal = (b.getType() == ObjectType::INTEGER) ? b.asInteger() : b.asReal();
         result = aVal > bVal;
     } else {
         throw std::runtime_error("Invalid operands for gt operation");
     }
     
-    stack.push(std::make_shared<PSObject>(result));
+    stack.push(PSObject(result));
 }
 
 void ge(PSInterpreter& interpreter) {
@@ -361,21 +509,21 @@ void ge(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need 2 operands for ge");
     }
     
-    PSObjectPtr b = stack.pop();
-    PSObjectPtr a = stack.pop();
+    PSObject b = stack.pop();
+    PSObject a = stack.pop();
     
     bool result = false;
-    if (a->getType() == ObjectType::INTEGER && b->getType() == ObjectType::INTEGER) {
-        result = a->asInteger() >= b->asInteger();
-    } else if (a->getType() == ObjectType::REAL || b->getType() == ObjectType::REAL) {
-        double aVal = (a->getType() == ObjectType::INTEGER) ? a->asInteger() : a->asReal();
-        double bVal = (b->getType() == ObjectType::INTEGER) ? b->asInteger() : b->asReal();
+    if (a.getType() == ObjectType::INTEGER && b.getType() == ObjectType::INTEGER) {
+        result = a.asInteger() >= b.asInteger();
+    } else if (a.getType() == ObjectType::REAL || b.getType() == ObjectType::REAL) {
+        double aVal = (a.getType() == ObjectType::INTEGER) ? a.asInteger() : a.asReal();
+        double bVal = (b.getType() == ObjectType::INTEGER) ? b.asInteger() : b.asReal();
         result = aVal >= bVal;
     } else {
         throw std::runtime_error("Invalid operands for ge operation");
     }
     
-    stack.push(std::make_shared<PSObject>(result));
+    stack.push(PSObject(result));
 }
 
 // Array operations
@@ -386,12 +534,12 @@ void array(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need size for array");
     }
     
-    PSObjectPtr sizeObj = stack.pop();
-    if (sizeObj->getType() != ObjectType::INTEGER) {
+    PSObject sizeObj = stack.pop();
+    if (sizeObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("Array size must be an integer");
     }
     
-    int size = sizeObj->asInteger();
+    int size = sizeObj.asInteger();
     if (size < 0) {
         throw std::runtime_error("Array size cannot be negative");
     }
@@ -399,10 +547,10 @@ void array(PSInterpreter& interpreter) {
     PSArray array;
     array.resize(size);
     for (int i = 0; i < size; ++i) {
-        array[i] = std::make_shared<PSObject>(); // null objects
+        array[i] = PSObject(); // null objects
     }
     
-    stack.push(std::make_shared<PSObject>(array));
+    stack.push(PSObject(array));
 }
 
 void get(PSInterpreter& interpreter) {
@@ -412,23 +560,23 @@ void get(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need array and index for get");
     }
     
-    PSObjectPtr indexObj = stack.pop();
-    PSObjectPtr arrayObj = stack.pop();
+    PSObject indexObj = stack.pop();
+    PSObject arrayObj = stack.pop();
     
-    if (arrayObj->getType() != ObjectType::ARRAY) {
+    if (arrayObj.getType() != ObjectType::ARRAY) {
         throw std::runtime_error("First operand must be an array");
     }
     
-    if (indexObj->getType() != ObjectType::INTEGER) {
+    if (indexObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("Index must be an integer");
     }
     
-    int index = indexObj->asInteger();
-    if (index < 0 || static_cast<size_t>(index) >= arrayObj->arrayLength()) {
+    int index = indexObj.asInteger();
+    if (index < 0 || static_cast<size_t>(index) >= arrayObj.arrayLength()) {
         throw std::runtime_error("Array index out of bounds");
     }
     
-    stack.push(arrayObj->arrayGet(index));
+    stack.push(arrayObj.arrayGet(index));
 }
 
 void put(PSInterpreter& interpreter) {
@@ -438,30 +586,26 @@ void put(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need array, index, and value for put");
     }
     
-    PSObjectPtr value = stack.pop();
-    PSObjectPtr indexObj = stack.pop();
-    PSObjectPtr arrayObj = stack.pop();
+    PSObject value = stack.pop();
+    PSObject indexObj = stack.pop();
+    PSObject arrayObj = stack.pop();
     
-    if (arrayObj->getType() != ObjectType::ARRAY) {
+    if (arrayObj.getType() != ObjectType::ARRAY) {
         throw std::runtime_error("First operand must be an array");
     }
     
-    if (indexObj->getType() != ObjectType::INTEGER) {
+    if (indexObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("Index must be an integer");
     }
     
-    int index = indexObj->asInteger();
-    if (index < 0 || static_cast<size_t>(index) >= arrayObj->arrayLength()) {
+    int index = indexObj.asInteger();
+    if (index < 0 || static_cast<size_t>(index) >= arrayObj.arrayLength()) {
         throw std::runtime_error("Array index out of bounds");
     }
     
-    // Debug output
-    std::cout << "DEBUG: Setting array[" << index << "] = " << value->toString() << std::endl;
-    
-    arrayObj->arraySet(index, value);
+    PS_LOG_TRACE(Exec, "Setting array[" << index << "] = " << value.toString());
     
-    // Debug output after setting
-    std::cout << "DEBUG: Array after set: " << arrayObj->toString() << std::endl;
+    arrayObj.arraySet(index, value);
     
     // Push the array back onto the stack to preserve reference
     stack.push(arrayObj);
@@ -474,17 +618,20 @@ void length(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need operand for length");
     }
     
-    PSObjectPtr obj = stack.pop();
+    PSObject obj = stack.pop();
     
-    if (obj->getType() == ObjectType::ARRAY) {
-        stack.push(std::make_shared<PSObject>(static_cast<int>(obj->arrayLength())));
-    } else if (obj->getType() == ObjectType::STRING) {
-        std::string str = obj->asString();
+    if (obj.getType() == ObjectType::ARRAY) {
+        stack.push(PSObject(static_cast<int>(obj.arrayLength())));
+    } else if (obj.getType() == ObjectType::STRING) {
+        const std::string& str = obj.asString();
         // Remove parentheses for string length
-        if (str.length() >= 2 && str[0] == '(' && str[str.length()-1] == ')') {
-            str = str.substr(1, str.length() - 2);
+        size_t length = str.length();
+        if (length >= 2 && str[0] == '(' && str[length-1] == ')') {
+            length -= 2;
         }
-        stack.push(std::make_shared<PSObject>(static_cast<int>(str.length())));
+        stack.push(PSObject(static_cast<int>(length)));
+    } else if (obj.getType() == ObjectType::NAME) {
+        stack.push(PSObject(static_cast<int>(NameTable::global().name(obj.asName()).length())));
     } else {
         throw std::runtime_error("Length operation not supported for this type");
     }
@@ -497,16 +644,14 @@ void aload(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need array for aload");
     }
     
-    PSObjectPtr arrayObj = stack.pop();
+    PSObject arrayObj = stack.pop();
     
-    if (arrayObj->getType() != ObjectType::ARRAY) {
+    if (arrayObj.getType() != ObjectType::ARRAY) {
         throw std::runtime_error("Operand must be an array");
     }
     
-    PSArray array = arrayObj->asArray();
-    
     // Push all array elements onto the stack
-    for (const auto& element : array) {
+    for (const auto& element : arrayObj.asArray()) {
         stack.push(element);
     }
     
@@ -521,13 +666,13 @@ void astore(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need array for astore");
     }
     
-    PSObjectPtr arrayObj = stack.pop();
+    PSObject arrayObj = stack.pop();
     
-    if (arrayObj->getType() != ObjectType::ARRAY) {
+    if (arrayObj.getType() != ObjectType::ARRAY) {
         throw std::runtime_error("Operand must be an array");
     }
     
-    size_t arraySize = arrayObj->arrayLength();
+    size_t arraySize = arrayObj.arrayLength();
     
     if (stack.size() < arraySize) {
         throw std::runtime_error("Stack underflow: not enough elements for astore");
@@ -535,8 +680,8 @@ void astore(PSInterpreter& interpreter) {
     
     // Pop elements from stack and store in array (in reverse order)
     for (size_t i = arraySize; i > 0; --i) {
-        PSObjectPtr element = stack.pop();
-        arrayObj->arraySet(i - 1, element);
+        PSObject element = stack.pop();
+        arrayObj.arraySet(i - 1, element);
     }
     
     stack.push(arrayObj);
@@ -550,18 +695,18 @@ void dict(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need size for dict");
     }
     
-    PSObjectPtr sizeObj = stack.pop();
-    if (sizeObj->getType() != ObjectType::INTEGER) {
+    PSObject sizeObj = stack.pop();
+    if (sizeObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("Dictionary size must be an integer");
     }
     
-    int size = sizeObj->asInteger();
+    int size = sizeObj.asInteger();
     if (size < 0) {
         throw std::runtime_error("Dictionary size cannot be negative");
     }
     
     PSDictionary dict;
-    stack.push(std::make_shared<PSObject>(dict));
+    stack.push(PSObject(dict));
 }
 
 void def(PSInterpreter& interpreter) {
@@ -571,26 +716,13 @@ void def(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need key and value for def");
     }
     
-    PSObjectPtr value = stack.pop();
-    PSObjectPtr keyObj = stack.pop();
+    PSObject value = stack.pop();
+    PSObject keyObj = stack.pop();
     
-    if (keyObj->getType() != ObjectType::STRING) {
-        throw std::runtime_error("Key must be a string");
-    }
+    NameId key = keyName(keyObj);
     
-    std::string key = keyObj->asString();
-    // Remove leading slash if present
-    if (key.length() > 0 && key[0] == '/') {
-        key = key.substr(1);
-    }
-    
-    // Get the current dictionary from the dictionary stack
-    PSObjectPtr currentDict = interpreter.getCurrentDictionary();
-    if (!currentDict || currentDict->getType() != ObjectType::DICTIONARY) {
-        throw std::runtime_error("No current dictionary available");
-    }
-    
-    currentDict->dictPut(key, value);
+    // Define in the current dictionary (top of the dictionary stack)
+    interpreter.define(key, value);
 }
 
 void load(PSInterpreter& interpreter) {
@@ -600,29 +732,17 @@ void load(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need key for load");
     }
     
-    PSObjectPtr keyObj = stack.pop();
-    
-    if (keyObj->getType() != ObjectType::STRING) {
-        throw std::runtime_error("Key must be a string");
-    }
-    
-    std::string key = keyObj->asString();
-    // Remove leading slash if present
-    if (key.length() > 0 && key[0] == '/') {
-        key = key.substr(1);
-    }
+    PSObject keyObj = stack.pop();
     
-    // Look up the key in the current dictionary
-    PSObjectPtr currentDict = interpreter.getCurrentDictionary();
-    if (!currentDict || currentDict->getType() != ObjectType::DICTIONARY) {
-        throw std::runtime_error("No current dictionary available");
-    }
+    NameId key = keyName(keyObj);
     
-    if (!currentDict->dictHas(key)) {
-        throw std::runtime_error("Key not found in dictionary: " + key);
+    // Search the dictionary stack from the top
+    const PSObject* value = interpreter.lookup(key);
+    if (!value) {
+        throw std::runtime_error("Key not found in dictionary: " + NameTable::global().name(key));
     }
     
-    stack.push(currentDict->dictGet(key));
+    stack.push(*value);
 }
 
 void store(PSInterpreter& interpreter) {
@@ -632,25 +752,20 @@ void store(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need dictionary, key, and value for store");
     }
     
-    PSObjectPtr value = stack.pop();
-    PSObjectPtr keyObj = stack.pop();
-    PSObjectPtr dictObj = stack.pop();
+    PSObject value = stack.pop();
+    PSObject keyObj = stack.pop();
+    PSObject dictObj = stack.pop();
     
-    if (dictObj->getType() != ObjectType::DICTIONARY) {
+    if (dictObj.getType() != ObjectType::DICTIONARY) {
         throw std::runtime_error("First operand must be a dictionary");
     }
     
-    if (keyObj->getType() != ObjectType::STRING) {
-        throw std::runtime_error("Key must be a string");
-    }
+    NameId key = keyName(keyObj);
     
-    std::string key = keyObj->asString();
-    // Remove leading slash if present
-    if (key.length() > 0 && key[0] == '/') {
-        key = key.substr(1);
+    // A new key may shadow a binding further down the dictionary stack
+    if (dictObj.dictPut(key, value) || interpreter.getOperators().getOperator(key)) {
+        interpreter.invalidateBinding(key);
     }
-    
-    dictObj->dictPut(key, value);
 }
 
 void known(PSInterpreter& interpreter) {
@@ -660,25 +775,17 @@ void known(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need dictionary and key for known");
     }
     
-    PSObjectPtr keyObj = stack.pop();
-    PSObjectPtr dictObj = stack.pop();
+    PSObject keyObj = stack.pop();
+    PSObject dictObj = stack.pop();
     
-    if (dictObj->getType() != ObjectType::DICTIONARY) {
+    if (dictObj.getType() != ObjectType::DICTIONARY) {
         throw std::runtime_error("First operand must be a dictionary");
     }
     
-    if (keyObj->getType() != ObjectType::STRING) {
-        throw std::runtime_error("Key must be a string");
-    }
-    
-    std::string key = keyObj->asString();
-    // Remove leading slash if present
-    if (key.length() > 0 && key[0] == '/') {
-        key = key.substr(1);
-    }
+    NameId key = keyName(keyObj);
     
-    bool hasKey = dictObj->dictHas(key);
-    stack.push(std::make_shared<PSObject>(hasKey));
+    bool hasKey = dictObj.dictHas(key);
+    stack.push(PSObject(hasKey));
 }
 
 void keys(PSInterpreter& interpreter) {
@@ -688,21 +795,75 @@ void keys(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need dictionary for keys");
     }
     
-    PSObjectPtr dictObj = stack.pop();
+    PSObject dictObj = stack.pop();
     
-    if (dictObj->getType() != ObjectType::DICTIONARY) {
+    if (dictObj.getType() != ObjectType::DICTIONARY) {
         throw std::runtime_error("Operand must be a dictionary");
     }
     
-    std::vector<std::string> keyList = dictObj->dictKeys();
+    std::vector<NameId> keyList = dictObj.dictKeys();
     
-    // Create an array of key strings
+    // Create an array of key names
     PSArray keyArray;
-    for (const auto& key : keyList) {
-        keyArray.push_back(std::make_shared<PSObject>("/" + key));
+    keyArray.reserve(keyList.size());
+    for (NameId key : keyList) {
+        keyArray.push_back(PSObject(PSName{key}));
     }
     
-    stack.push(std::make_shared<PSObject>(keyArray));
+    stack.push(PSObject(keyArray));
+}
+
+void begin(PSInterpreter& interpreter) {
+    PSStack& stack = interpreter.getStack();
+    
+    if (stack.empty()) {
+        throw std::runtime_error("Stack underflow: need dictionary for begin");
+    }
+    
+    PSObject dictObj = stack.pop();
+    
+    if (dictObj.getType() != ObjectType::DICTIONARY) {
+        throw std::runtime_error("Operand must be a dictionary");
+    }
+    
+    interpreter.pushDictionary(dictObj);
+}
+
+void end(PSInterpreter& interpreter) {
+    interpreter.popDictionary();
+}
+
+void currentdict(PSInterpreter& interpreter) {
+    interpreter.getStack().push(interpreter.getCurrentDictionary());
+}
+
+void userdict(PSInterpreter& interpreter) {
+    interpreter.getStack().push(interpreter.getUserDictionary());
+}
+
+void systemdict(PSInterpreter& interpreter) {
+    interpreter.getStack().push(interpreter.getSystemDictionary());
+}
+
+void where(PSInterpreter& interpreter) {
+    PSStack& stack = interpreter.getStack();
+    
+    if (stack.empty()) {
+        throw std::runtime_error("Stack underflow: need key for where");
+    }
+    
+    PSObject keyObj = stack.pop();
+    
+    NameId key = keyName(keyObj);
+    
+    // Pushes the defining dictionary and true, or just false
+    const PSObject* dictObj = interpreter.findDefiningDictionary(key);
+    if (dictObj) {
+        stack.push(*dictObj);
+        stack.push(PSObject(true));
+    } else {
+        stack.push(PSObject(false));
+    }
 }
 
 // Procedure operations
@@ -713,17 +874,14 @@ void exec(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need procedure for exec");
     }
     
-    PSObjectPtr procObj = stack.pop();
+    PSObject procObj = stack.pop();
     
-    if (procObj->getType() != ObjectType::PROCEDURE) {
+    if (procObj.getType() != ObjectType::PROCEDURE) {
         throw std::runtime_error("Operand must be a procedure");
     }
     
     // Execute the procedure
-    PSProcedure proc = procObj->asProcedure();
-    for (const auto& token : proc) {
-        interpreter.executeToken(token);
-    }
+    interpreter.executeProcedure(procObj);
 }
 
 void forall(PSInterpreter& interpreter) {
@@ -733,26 +891,23 @@ void forall(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need array and procedure for forall");
     }
     
-    PSObjectPtr procObj = stack.pop();
-    PSObjectPtr arrayObj = stack.pop();
+    PSObject procObj = stack.pop();
+    PSObject arrayObj = stack.pop();
     
-    if (arrayObj->getType() != ObjectType::ARRAY) {
+    if (arrayObj.getType() != ObjectType::ARRAY) {
         throw std::runtime_error("First operand must be an array");
     }
     
-    if (procObj->getType() != ObjectType::PROCEDURE) {
+    if (procObj.getType() != ObjectType::PROCEDURE) {
         throw std::runtime_error("Second operand must be a procedure");
     }
     
-    PSArray array = arrayObj->asArray();
-    PSProcedure proc = procObj->asProcedure();
-    
-    // Execute the procedure for each array element
-    for (const auto& element : array) {
-        stack.push(element);
-        for (const auto& token : proc) {
-            interpreter.executeToken(token);
-        }
+    // Execute the procedure for each array element. Arrays are shared, so
+    // the procedure may change this one while it runs: index it afresh each time.
+    const PSArray& array = arrayObj.asArray();
+    for (size_t i = 0; i < array.size(); ++i) {
+        stack.push(array[i]);
+        interpreter.executeProcedure(procObj);
     }
 }
 
@@ -764,27 +919,24 @@ void if_(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need condition and procedure for if");
     }
     
-    PSObjectPtr procObj = stack.pop();
-    PSObjectPtr conditionObj = stack.pop();
+    PSObject procObj = stack.pop();
+    PSObject conditionObj = stack.pop();
     
-    if (procObj->getType() != ObjectType::PROCEDURE) {
+    if (procObj.getType() != ObjectType::PROCEDURE) {
         throw std::runtime_error("Second operand must be a procedure");
     }
     
     bool condition = false;
-    if (conditionObj->getType() == ObjectType::BOOLEAN) {
-        condition = conditionObj->asBoolean();
-    } else if (conditionObj->getType() == ObjectType::INTEGER) {
-        condition = conditionObj->asInteger() != 0;
-    } else if (conditionObj->getType() == ObjectType::REAL) {
-        condition = conditionObj->asReal() != 0.0;
+    if (conditionObj.getType() == ObjectType::BOOLEAN) {
+        condition = conditionObj.asBoolean();
+    } else if (conditionObj.getType() == ObjectType::INTEGER) {
+        condition = conditionObj.asInteger() != 0;
+    } else if (conditionObj.getType() == ObjectType::REAL) {
+        condition = conditionObj.asReal() != 0.0;
     }
     
     if (condition) {
-        PSProcedure proc = procObj->asProcedure();
-        for (const auto& token : proc) {
-            interpreter.executeToken(token);
-        }
+        interpreter.executeProcedure(procObj);
     }
 }
 
@@ -795,31 +947,28 @@ void ifelse(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need condition and two procedures for ifelse");
     }
     
-    PSObjectPtr elseProcObj = stack.pop();
-    PSObjectPtr thenProcObj = stack.pop();
-    PSObjectPtr conditionObj = stack.pop();
+    PSObject elseProcObj = stack.pop();
+    PSObject thenProcObj = stack.pop();
+    PSObject conditionObj = stack.pop();
     
-    if (thenProcObj->getType() != ObjectType::PROCEDURE) {
+    if (thenProcObj.getType() != ObjectType::PROCEDURE) {
         throw std::runtime_error("Second operand must be a procedure");
     }
     
-    if (elseProcObj->getType() != ObjectType::PROCEDURE) {
+    if (elseProcObj.getType() != ObjectType::PROCEDURE) {
         throw std::runtime_error("Third operand must be a procedure");
     }
     
     bool condition = false;
-    if (conditionObj->getType() == ObjectType::BOOLEAN) {
-        condition = conditionObj->asBoolean();
-    } else if (conditionObj->getType() == ObjectType::INTEGER) {
-        condition = conditionObj->asInteger() != 0;
-    } else if (conditionObj->getType() == ObjectType::REAL) {
-        condition = conditionObj->asReal() != 0.0;
+    if (conditionObj.getType() == ObjectType::BOOLEAN) {
+        condition = conditionObj.asBoolean();
+    } else if (conditionObj.getType() == ObjectType::INTEGER) {
+        condition = conditionObj.asInteger() != 0;
+    } else if (conditionObj.getType() == ObjectType::REAL) {
+        condition = conditionObj.asReal() != 0.0;
     }
     
-    PSProcedure proc = condition ? thenProcObj->asProcedure() : elseProcObj->asProcedure();
-    for (const auto& token : proc) {
-        interpreter.executeToken(token);
-    }
+    interpreter.executeProcedure(condition ? thenProcObj : elseProcObj);
 }
 
 void repeat(PSInterpreter& interpreter) {
@@ -829,27 +978,24 @@ void repeat(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need count and procedure for repeat");
     }
     
-    PSObjectPtr procObj = stack.pop();
-    PSObjectPtr countObj = stack.pop();
+    PSObject procObj = stack.pop();
+    PSObject countObj = stack.pop();
     
-    if (procObj->getType() != ObjectType::PROCEDURE) {
+    if (procObj.getType() != ObjectType::PROCEDURE) {
         throw std::runtime_error("Second operand must be a procedure");
     }
     
-    if (countObj->getType() != ObjectType::INTEGER) {
+    if (countObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("Count must be an integer");
     }
     
-    int count = countObj->asInteger();
+    int count = countObj.asInteger();
     if (count < 0) {
         throw std::runtime_error("Repeat count cannot be negative");
     }
     
-    PSProcedure proc = procObj->asProcedure();
     for (int i = 0; i < count; ++i) {
-        for (const auto& token : proc) {
-            interpreter.executeToken(token);
-        }
+        interpreter.executeProcedure(procObj);
     }
 }
 
@@ -860,44 +1006,38 @@ void for_(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need start, end, increment, and procedure for for");
     }
     
-    PSObjectPtr procObj = stack.pop();
-    PSObjectPtr incrementObj = stack.pop();
-    PSObjectPtr endObj = stack.pop();
-    PSObjectPtr startObj = stack.pop();
+    PSObject procObj = stack.pop();
+    PSObject incrementObj = stack.pop();
+    PSObject endObj = stack.pop();
+    PSObject startObj = stack.pop();
     
-    if (procObj->getType() != ObjectType::PROCEDURE) {
+    if (procObj.getType() != ObjectType::PROCEDURE) {
         throw std::runtime_error("Fourth operand must be a procedure");
     }
     
-    if (startObj->getType() != ObjectType::INTEGER || 
-        endObj->getType() != ObjectType::INTEGER || 
-        incrementObj->getType() != ObjectType::INTEGER) {
+    if (startObj.getType() != ObjectType::INTEGER || 
+        endObj.getType() != ObjectType::INTEGER || 
+        incrementObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("Start, end, and increment must be integers");
     }
     
-    int start = startObj->asInteger();
-    int end = endObj->asInteger();
-    int increment = incrementObj->asInteger();
+    int start = startObj.asInteger();
+    int end = endObj.asInteger();
+    int increment = incrementObj.asInteger();
     
     if (increment == 0) {
         throw std::runtime_error("Increment cannot be zero");
     }
     
-    PSProcedure proc = procObj->asProcedure();
-    
     if (increment > 0) {
         for (int i = start; i <= end; i += increment) {
-            stack.push(std::make_shared<PSObject>(i));
-            for (const auto& token : proc) {
-                interpreter.executeToken(token);
-            }
+            stack.push(PSObject(i));
+            interpreter.executeProcedure(procObj);
         }
     } else {
         for (int i = start; i >= end; i += increment) {
-            stack.push(std::make_shared<PSObject>(i));
-            for (const auto& token : proc) {
-                interpreter.executeToken(token);
-            }
+            stack.push(PSObject(i));
+            interpreter.executeProcedure(procObj);
         }
     }
 }
@@ -910,25 +1050,25 @@ void moveto(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need x and y for moveto");
     }
     
-    PSObjectPtr yObj = stack.pop();
-    PSObjectPtr xObj = stack.pop();
+    PSObject yObj = stack.pop();
+    PSObject xObj = stack.pop();
     
-    if (xObj->getType() != ObjectType::REAL && xObj->getType() != ObjectType::INTEGER) {
+    if (xObj.getType() != ObjectType::REAL && xObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("X coordinate must be a number");
     }
-    if (yObj->getType() != ObjectType::REAL && yObj->getType() != ObjectType::INTEGER) {
+    if (yObj.getType() != ObjectType::REAL && yObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("Y coordinate must be a number");
     }
     
-    double x = (xObj->getType() == ObjectType::INTEGER) ? xObj->asInteger() : xObj->asReal();
-    double y = (yObj->getType() == ObjectType::INTEGER) ? yObj->asInteger() : yObj->asReal();
+    double x = (xObj.getType() == ObjectType::INTEGER) ? xObj.asInteger() : xObj.asReal();
+    double y = (yObj.getType() == ObjectType::INTEGER) ? yObj.asInteger() : yObj.asReal();
     
     // Get current graphics state
     GraphicsState& gs = interpreter.getCurrentGraphicsState();
     gs.currentPoint = Point(x, y);
     
     // Add moveto segment to current path
-    gs.currentPath.emplace_back(PathSegment::Type::MoveTo, std::vector<Point>{{x, y}});
+    gs.currentPath.moveTo(Point(x, y));
 }
 
 void lineto(PSInterpreter& interpreter) {
@@ -938,102 +1078,113 @@ void lineto(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need x and y for lineto");
     }
     
-    PSObjectPtr yObj = stack.pop();
-    PSObjectPtr xObj = stack.pop();
+    PSObject yObj = stack.pop();
+    PSObject xObj = stack.pop();
     
-    if (xObj->getType() != ObjectType::REAL && xObj->getType() != ObjectType::INTEGER) {
+    if (xObj.getType() != ObjectType::REAL && xObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("X coordinate must be a number");
     }
-    if (yObj->getType() != ObjectType::REAL && yObj->getType() != ObjectType::INTEGER) {
+    if (yObj.getType() != ObjectType::REAL && yObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("Y coordinate must be a number");
     }
     
-    double x = (xObj->getType() == ObjectType::INTEGER) ? xObj->asInteger() : xObj->asReal();
-    double y = (yObj->getType() == ObjectType::INTEGER) ? yObj->asInteger() : yObj->asReal();
+    double x = (xObj.getType() == ObjectType::INTEGER) ? xObj.asInteger() : xObj.asReal();
+    double y = (yObj.getType() == ObjectType::INTEGER) ? yObj.asInteger() : yObj.asReal();
     
     // Get current graphics state
     GraphicsState& gs = interpreter.getCurrentGraphicsState();
     gs.currentPoint = Point(x, y);
     
     // Add lineto segment to current path
-    gs.currentPath.emplace_back(PathSegment::Type::LineTo, std::vector<Point>{{x, y}});
+    gs.currentPath.lineTo(Point(x, y));
 }
 
 void closepath(PSInterpreter& interpreter) {
     GraphicsState& gs = interpreter.getCurrentGraphicsState();
-    gs.currentPath.emplace_back(PathSegment::Type::ClosePath, std::vector<Point>{});
+    gs.currentPath.closePath();
 }
 
-void stroke(PSInterpreter& interpreter) {
-    std::cout << "[DEBUG] stroke called" << std::endl;
-    GraphicsState& gs = interpreter.getCurrentGraphicsState();
+void curveto(PSInterpreter& interpreter) {
+    PSStack& stack = interpreter.getStack();
     
-    std::cout << "STROKE: Path with " << gs.currentPath.size() << " segments" << std::endl;
-    for (size_t i = 0; i < gs.currentPath.size(); ++i) {
-        const auto& segment = gs.currentPath[i];
-        switch (segment.type) {
-            case PathSegment::Type::MoveTo:
-                std::cout << "  " << i << ": moveto(" << segment.points[0].x << ", " << segment.points[0].y << ")" << std::endl;
-                break;
-            case PathSegment::Type::LineTo:
-                std::cout << "  " << i << ": lineto(" << segment.points[0].x << ", " << segment.points[0].y << ")" << std::endl;
-                break;
-            case PathSegment::Type::ClosePath:
-                std::cout << "  " << i << ": closepath" << std::endl;
-                break;
-            default:
-                std::cout << "  " << i << ": unknown segment type" << std::endl;
-        }
+    if (stack.size() < 6) {
+        throw std::runtime_error("Stack underflow: need x1 y1 x2 y2 x3 y3 for curveto");
     }
-    std::cout << "  Color: RGB(" << gs.r << ", " << gs.g << ", " << gs.b << ")" << std::endl;
-    std::cout << "  Line width: " << gs.lineWidth << std::endl;
     
-    // Clear the current path after stroking
-    gs.currentPath.clear();
+    double coords[6];
+    for (int i = 5; i >= 0; --i) {
+        coords[i] = popNumber(stack, "curveto");
+    }
+    
+    GraphicsState& gs = interpreter.getCurrentGraphicsState();
+    gs.currentPoint = Point(coords[4], coords[5]);
+    gs.currentPath.curveTo(Point(coords[0], coords[1]), Point(coords[2], coords[3]), gs.currentPoint);
 }
 
-void fill(PSInterpreter& interpreter) {
-    std::cout << "[DEBUG] fill called" << std::endl;
+void arc(PSInterpreter& interpreter) {
+    appendArc(interpreter, false, "arc");
+}
+
+void arcn(PSInterpreter& interpreter) {
+    appendArc(interpreter, true, "arcn");
+}
+
+void stroke(PSInterpreter& interpreter) {
+    PS_LOG_DEBUG(Graphics, "stroke called");
     GraphicsState& gs = interpreter.getCurrentGraphicsState();
+    std::ostream& out = interpreter.getOutput();
     
-    std::cout << "FILL: Path with " << gs.currentPath.size() << " segments" << std::endl;
-    for (size_t i = 0; i < gs.currentPath.size(); ++i) {
-        const auto& segment = gs.currentPath[i];
-        switch (segment.type) {
-            case PathSegment::Type::MoveTo:
-                std::cout << "  " << i << ": moveto(" << segment.points[0].x << ", " << segment.points[0].y << ")" << std::endl;
-                break;
-            case PathSegment::Type::LineTo:
-                std::cout << "  " << i << ": lineto(" << segment.points[0].x << ", " << segment.points[0].y << ")" << std::endl;
-                break;
-            case PathSegment::Type::ClosePath:
-                std::cout << "  " << i << ": closepath" << std::endl;
-                break;
-            default:
-                std::cout << "  " << i << ": unknown segment type" << std::endl;
-        }
-    }
-    std::cout << "  Fill color: RGB(" << gs.r << ", " << gs.g << ", " << gs.b << ")" << std::endl;
+    out << "STROKE: Path with " << gs.currentPath.size() << " segments\n";
+    printPath(out, gs.currentPath);
+    out << "  Color: RGB(" << gs.r << ", " << gs.g << ", " << gs.b << ")\n";
+    out << "  Line width: " << gs.lineWidth << '\n';
     
-    // Clear the current path after filling
+    emitPaint(interpreter, PaintCommand::Operation::Stroke);
+    
+    // Clear the current path after stroking
     gs.currentPath.clear();
 }
 
+void fill(PSInterpreter& interpreter) {
+    PS_LOG_DEBUG(Graphics, "fill called");
+    paint(interpreter, "FILL", PaintCommand::Operation::Fill);
+}
+
+void eofill(PSInterpreter& interpreter) {
+    PS_LOG_DEBUG(Graphics, "eofill called");
+    paint(interpreter, "EOFILL", PaintCommand::Operation::EOFill);
+}
+
 void newpath(PSInterpreter& interpreter) {
     GraphicsState& gs = interpreter.getCurrentGraphicsState();
     gs.currentPath.clear();
 }
 
 void gsave(PSInterpreter& interpreter) {
-    // Push a copy of the current graphics state
-    interpreter.graphicsStack_.push_back(interpreter.getCurrentGraphicsState());
+    interpreter.pushGraphicsState();
 }
 
 void grestore(PSInterpreter& interpreter) {
-    if (interpreter.graphicsStack_.size() <= 1) {
-        throw std::runtime_error("Graphics state stack underflow");
+    interpreter.popGraphicsState();
+}
+
+void save(PSInterpreter& interpreter) {
+    interpreter.getStack().push(PSObject(interpreter.save()));
+}
+
+void restore(PSInterpreter& interpreter) {
+    PSStack& stack = interpreter.getStack();
+    
+    if (stack.empty()) {
+        throw std::runtime_error("Stack underflow: need save object for restore");
+    }
+    
+    PSObject saveObj = stack.pop();
+    if (saveObj.getType() != ObjectType::SAVE) {
+        throw std::runtime_error("Operand must be a save object");
     }
-    interpreter.graphicsStack_.pop_back();
+    
+    interpreter.restore(saveObj.asSave());
 }
 
 void translate(PSInterpreter& interpreter) {
@@ -1043,18 +1194,18 @@ void translate(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need tx and ty for translate");
     }
     
-    PSObjectPtr tyObj = stack.pop();
-    PSObjectPtr txObj = stack.pop();
+    PSObject tyObj = stack.pop();
+    PSObject txObj = stack.pop();
     
-    if (txObj->getType() != ObjectType::REAL && txObj->getType() != ObjectType::INTEGER) {
+    if (txObj.getType() != ObjectType::REAL && txObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("TX must be a number");
     }
-    if (tyObj->getType() != ObjectType::REAL && tyObj->getType() != ObjectType::INTEGER) {
+    if (tyObj.getType() != ObjectType::REAL && tyObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("TY must be a number");
     }
     
-    double tx = (txObj->getType() == ObjectType::INTEGER) ? txObj->asInteger() : txObj->asReal();
-    double ty = (tyObj->getType() == ObjectType::INTEGER) ? tyObj->asInteger() : tyObj->asReal();
+    double tx = (txObj.getType() == ObjectType::INTEGER) ? txObj.asInteger() : txObj.asReal();
+    double ty = (tyObj.getType() == ObjectType::INTEGER) ? tyObj.asInteger() : tyObj.asReal();
     
     // Get current transformation matrix
     GraphicsState& gs = interpreter.getCurrentGraphicsState();
@@ -1074,18 +1225,18 @@ void scale(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need sx and sy for scale");
     }
     
-    PSObjectPtr syObj = stack.pop();
-    PSObjectPtr sxObj = stack.pop();
+    PSObject syObj = stack.pop();
+    PSObject sxObj = stack.pop();
     
-    if (sxObj->getType() != ObjectType::REAL && sxObj->getType() != ObjectType::INTEGER) {
+    if (sxObj.getType() != ObjectType::REAL && sxObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("SX must be a number");
     }
-    if (syObj->getType() != ObjectType::REAL && syObj->getType() != ObjectType::INTEGER) {
+    if (syObj.getType() != ObjectType::REAL && syObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("SY must be a number");
     }
     
-    double sx = (sxObj->getType() == ObjectType::INTEGER) ? sxObj->asInteger() : sxObj->asReal();
-    double sy = (syObj->getType() == ObjectType::INTEGER) ? syObj->asInteger() : syObj->asReal();
+    double sx = (sxObj.getType() == ObjectType::INTEGER) ? sxObj.asInteger() : sxObj.asReal();
+    double sy = (syObj.getType() == ObjectType::INTEGER) ? syObj.asInteger() : syObj.asReal();
     
     // Get current transformation matrix
     GraphicsState& gs = interpreter.getCurrentGraphicsState();
@@ -1109,13 +1260,13 @@ void rotate(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need angle for rotate");
     }
     
-    PSObjectPtr angleObj = stack.pop();
+    PSObject angleObj = stack.pop();
     
-    if (angleObj->getType() != ObjectType::REAL && angleObj->getType() != ObjectType::INTEGER) {
+    if (angleObj.getType() != ObjectType::REAL && angleObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("Angle must be a number");
     }
     
-    double angle = (angleObj->getType() == ObjectType::INTEGER) ? angleObj->asInteger() : angleObj->asReal();
+    double angle = (angleObj.getType() == ObjectType::INTEGER) ? angleObj.asInteger() : angleObj.asReal();
     
     // Convert degrees to radians
     double radians = angle * M_PI / 180.0;
@@ -1144,24 +1295,24 @@ void setrgbcolor(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need r, g, b for setrgbcolor");
     }
     
-    PSObjectPtr bObj = stack.pop();
-    PSObjectPtr gObj = stack.pop();
-    PSObjectPtr rObj = stack.pop();
+    PSObject bObj = stack.pop();
+    PSObject gObj = stack.pop();
+    PSObject rObj = stack.pop();
     
-    if (rObj->getType() != ObjectType::REAL && rObj->getType() != ObjectType::INTEGER) {
+    if (rObj.getType() != ObjectType::REAL && rObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("R must be a number");
     }
-    if (gObj->getType() != ObjectType::REAL && gObj->getType() != ObjectType::INTEGER) {
+    if (gObj.getType() != ObjectType::REAL && gObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("G must be a number");
     }
-    if (bObj->getType() != ObjectType::REAL && bObj->getType() != ObjectType::INTEGER) {
+    if (bObj.getType() != ObjectType::REAL && bObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("B must be a number");
     }
     
     GraphicsState& gs = interpreter.getCurrentGraphicsState();
-    gs.r = (rObj->getType() == ObjectType::INTEGER) ? rObj->asInteger() : rObj->asReal();
-    gs.g = (gObj->getType() == ObjectType::INTEGER) ? gObj->asInteger() : gObj->asReal();
-    gs.b = (bObj->getType() == ObjectType::INTEGER) ? bObj->asInteger() : bObj->asReal();
+    gs.r = (rObj.getType() == ObjectType::INTEGER) ? rObj.asInteger() : rObj.asReal();
+    gs.g = (gObj.getType() == ObjectType::INTEGER) ? gObj.asInteger() : gObj.asReal();
+    gs.b = (bObj.getType() == ObjectType::INTEGER) ? bObj.asInteger() : bObj.asReal();
 }
 
 void setlinewidth(PSInterpreter& interpreter) {
@@ -1171,20 +1322,24 @@ void setlinewidth(PSInterpreter& interpreter) {
         throw std::runtime_error("Stack underflow: need width for setlinewidth");
     }
     
-    PSObjectPtr widthObj = stack.pop();
+    PSObject widthObj = stack.pop();
     
-    if (widthObj->getType() != ObjectType::REAL && widthObj->getType() != ObjectType::INTEGER) {
+    if (widthObj.getType() != ObjectType::REAL && widthObj.getType() != ObjectType::INTEGER) {
         throw std::runtime_error("Width must be a number");
     }
     
     GraphicsState& gs = interpreter.getCurrentGraphicsState();
-    gs.lineWidth = (widthObj->getType() == ObjectType::INTEGER) ? widthObj->asInteger() : widthObj->asReal();
+    gs.lineWidth = (widthObj.getType() == ObjectType::INTEGER) ? widthObj.asInteger() : widthObj.asReal();
 }
 
 void showpage(PSInterpreter& interpreter) {
-    std::cout << "[DEBUG] showpage called" << std::endl;
-    std::cout << "SHOWPAGE: End of page" << std::endl;
-    // In a real implementation, this would trigger page output to the device
+    PS_LOG_DEBUG(Graphics, "showpage called");
+    interpreter.getOutput() << "SHOWPAGE: End of page\n";
+    if (DisplayList* list = interpreter.getRecorder()) {
+        list->showpage();
+    } else if (RasterDevice* device = interpreter.getDevice()) {
+        device->showpage();
+    }
 }
 
 } // namespace Operators
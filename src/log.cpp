@@ -0,0 +1,78 @@
+#include "log.h"
+#include <atomic>
+#include <iostream>
+#include <mutex>
+
+namespace Log {
+
+namespace {
+
+std::atomic<int> currentLevel{static_cast<int>(Level::Debug)};
+std::atomic<unsigned> enabledCategories{~0u};
+std::mutex writeMutex;
+thread_local std::string* captured = nullptr; // Innermost Capture of this thread
+
+const char* levelName(Level level) {
+    switch (level) {
+        case Level::Error: return "ERROR";
+        case Level::Warning: return "WARNING";
+        case Level::Info: return "INFO";
+        case Level::Debug: return "DEBUG";
+        case Level::Trace: return "TRACE";
+    }
+    return "?";
+}
+
+const char* categoryName(Category category) {
+    switch (category) {
+        case Category::Parser: return "parser";
+        case Category::XRef: return "xref";
+        case Category::Exec: return "exec";
+        case Category::Graphics: return "graphics";
+        case Category::Page: return "page";
+    }
+    return "?";
+}
+
+unsigned categoryBit(Category category) {
+    return 1u << static_cast<unsigned>(category);
+}
+
+} // namespace
+
+void setLevel(Level level) {
+    currentLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+void setCategoryEnabled(Category category, bool enabled) {
+    if (enabled) {
+        enabledCategories.fetch_or(categoryBit(category), std::memory_order_relaxed);
+    } else {
+        enabledCategories.fetch_and(~categoryBit(category), std::memory_order_relaxed);
+    }
+}
+
+bool isEnabled(Category category, Level level) {
+    return static_cast<int>(level) <= currentLevel.load(std::memory_order_relaxed) &&
+           (enabledCategories.load(std::memory_order_relaxed) & categoryBit(category)) != 0;
+}
+
+void write(Category category, Level level, const std::string& message) {
+    if (captured) {
+        captured->append("[").append(levelName(level)).append("][").append(categoryName(category)).append("] ");
+        captured->append(message).push_back('\n');
+        return;
+    }
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::clog << '[' << levelName(level) << "][" << categoryName(category) << "] " << message << '\n';
+}
+
+Capture::Capture(std::string& messages) : previous_(captured) {
+    captured = &messages;
+}
+
+Capture::~Capture() {
+    captured = previous_;
+}
+
+} // namespace Log
@@ -1,40 +1,284 @@
+#include "profiler.h"
+#include "ps_batch.h"
 #include "ps_interpreter.h"
+#include "ps_names.h"
+#include "ps_raster.h"
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
 #include <string>
 
+namespace {
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--output PATTERN] [--resolution DPI] [--threads N]\n"
+              << "       [--record FILE] [--profile FILE] [file.ps | --replay FILE]\n"
+              << "       " << program << " --batch [--socket PATH] [--prolog FILE] [--jobs N]\n"
+              << "       [--max-names N] [--profile FILE]\n"
+              << "  --output PATTERN   Render each page to an image; PATTERN may contain %d for the\n"
+              << "                     page number, and a .ppm extension selects PPM over PAM\n"
+              << "  --resolution DPI   Raster resolution (default 72)\n"
+              << "  --threads N        Threads rasterizing each page (default: one per core)\n"
+              << "  --record FILE      Save the program's display list to FILE\n"
+              << "  --replay FILE      Render a saved display list instead of running a program\n"
+              << "  --profile FILE     Write per-operator and per-procedure timings to FILE as\n"
+              << "                     JSON (- for standard error)\n"
+              << "  --batch            Run jobs read from standard input (a file path per line,\n"
+              << "                     or 'exec LENGTH' and LENGTH bytes of program) on warm\n"
+              << "                     interpreters, writing 'job ID ok|error LENGTH' and the\n"
+              << "                     job's output for each\n"
+              << "  --socket PATH      With --batch, serve connections on a Unix socket instead\n"
+              << "  --prolog FILE      With --batch, run FILE once per interpreter before any job\n"
+              << "  --jobs N           With --batch, interpreters running jobs (default: one per core)\n"
+              << "  --max-names N      With --batch, names jobs may add to the process-wide name\n"
+              << "                     table; a job needing more fails (default: no limit)\n";
+}
+
+// Writes one rendered page according to the --output pattern
+void writePage(const std::string& pattern, const PostScript::Framebuffer& page, int pageNumber) {
+    std::string filename = pattern;
+    size_t marker = filename.find("%d");
+    if (marker != std::string::npos) {
+        filename.replace(marker, 2, std::to_string(pageNumber));
+    } else if (pageNumber > 1) {
+        // Later pages must not overwrite the first
+        size_t dot = filename.rfind('.');
+        filename.insert(dot == std::string::npos ? filename.size() : dot, "-" + std::to_string(pageNumber));
+    }
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        std::cerr << "Error: cannot write " << filename << std::endl;
+        return;
+    }
+    bool ppm = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".ppm") == 0;
+    if (ppm) {
+        page.writePPM(out);
+    } else {
+        page.writePAM(out);
+    }
+    std::cout << "Wrote page " << pageNumber << " to " << filename << std::endl;
+}
+
+// Writes the profiling report as JSON; "-" means standard error
+void writeProfile(const std::string& filename, const Profiling::Report& report) {
+    if (filename == "-") {
+        report.writeJSON(std::cerr);
+        return;
+    }
+    std::ofstream out(filename);
+    if (!out) {
+        std::cerr << "Error: cannot write " << filename << std::endl;
+        return;
+    }
+    report.writeJSON(out);
+}
+
+// Serves jobs until standard input ends (or forever, on a socket)
+int runBatch(const std::string& socketPath, const std::string& prologFile, size_t jobs,
+             size_t maxNames, const std::string& profileFile) {
+    std::string prolog;
+    if (!prologFile.empty()) {
+        std::ifstream in(prologFile, std::ios::binary);
+        if (!in) {
+            std::cerr << "Error: cannot read " << prologFile << std::endl;
+            return 1;
+        }
+        prolog.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    if (!profileFile.empty()) {
+        Profiling::setEnabled(true);
+    }
+    try {
+        PostScript::InterpreterPool interpreters(jobs, prolog);
+        // Names are never freed, so this bounds what jobs can make the table grow by
+        if (maxNames > 0) {
+            PostScript::NameTable& names = PostScript::NameTable::global();
+            names.setLimit(names.size() + maxNames);
+        }
+        PostScript::BatchServer server(interpreters);
+        if (!socketPath.empty()) {
+            server.listen(socketPath);
+        } else {
+            server.serve(std::cin, std::cout);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    if (!profileFile.empty()) {
+        Profiling::setEnabled(false);
+        writeProfile(profileFile, Profiling::report());
+    }
+    return 0;
+}
+
+} // namespace
+
 int main(int argc, char* argv[]) {
+    std::string filename;
+    std::string outputPattern;
+    double resolution = 72;
+    size_t threads = 0;
+    std::string recordFile;
+    std::string replayFile;
+    std::string profileFile;
+    bool batch = false;
+    std::string socketPath;
+    std::string prologFile;
+    size_t jobs = 0;
+    size_t maxNames = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "--output" || arg == "-o") && i + 1 < argc) {
+            outputPattern = argv[++i];
+        } else if (arg == "--resolution" && i + 1 < argc) {
+            resolution = std::stod(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::stoul(argv[++i]);
+        } else if (arg == "--record" && i + 1 < argc) {
+            recordFile = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replayFile = argv[++i];
+        } else if (arg == "--profile" && i + 1 < argc) {
+            profileFile = argv[++i];
+        } else if (arg == "--batch") {
+            batch = true;
+        } else if (arg == "--socket" && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (arg == "--prolog" && i + 1 < argc) {
+            prologFile = argv[++i];
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            jobs = std::stoul(argv[++i]);
+        } else if (arg == "--max-names" && i + 1 < argc) {
+            maxNames = std::stoul(argv[++i]);
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (filename.empty() && (arg.empty() || arg[0] != '-')) {
+            filename = arg;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (!replayFile.empty() && (!filename.empty() || !recordFile.empty() || outputPattern.empty())) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    // Jobs only produce text output; the other options apply to single runs
+    bool batchOnly = !socketPath.empty() || !prologFile.empty() || jobs > 0 || maxNames > 0;
+    if (batch ? (!filename.empty() || !outputPattern.empty() || !recordFile.empty() || !replayFile.empty())
+              : batchOnly) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (batch) {
+        return runBatch(socketPath, prologFile, jobs, maxNames, profileFile);
+    }
+
     PostScript::PSInterpreter interpreter;
-    
+
+    std::unique_ptr<PostScript::RasterDevice> device;
+    if (!outputPattern.empty()) {
+        device = std::make_unique<PostScript::RasterDevice>(612, 792, resolution);
+        device->setThreadCount(threads);
+        device->setPageHandler([&outputPattern](const PostScript::Framebuffer& page, int pageNumber) {
+            writePage(outputPattern, page, pageNumber);
+        });
+        interpreter.setDevice(device.get());
+    }
+
+    if (!replayFile.empty()) {
+        std::ifstream in(replayFile, std::ios::binary);
+        try {
+            if (!in) {
+                throw std::runtime_error("cannot read " + replayFile);
+            }
+            device->replay(PostScript::DisplayList::read(in));
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        if (device->pageCount() == 0) {
+            device->showpage();
+        }
+        return 0;
+    }
+
+    // Record the whole program, then save it and render it from the list
+    PostScript::DisplayList recording;
+    if (!recordFile.empty()) {
+        interpreter.setRecorder(&recording);
+    }
+
     std::cout << "PostScript Interpreter v1.0.0" << std::endl;
     std::cout << "=============================" << std::endl;
-    
-    if (argc > 1) {
+
+    if (!profileFile.empty()) {
+        Profiling::setEnabled(true);
+    }
+
+    bool failed = false;
+    if (!filename.empty()) {
         // Execute PostScript file
-        std::string filename = argv[1];
         std::cout << "Executing file: " << filename << std::endl;
         try {
             interpreter.executeFile(filename);
         } catch (const std::exception& e) {
             std::cerr << "Error: " << e.what() << std::endl;
-            return 1;
+            failed = true;
         }
     } else {
         // Execute example PostScript program
         std::cout << "Executing example PostScript program..." << std::endl;
-        
+
         std::string exampleProgram = "(Hello, PostScript!) show\n5 3 add show";
-        
+
         try {
             interpreter.execute(exampleProgram);
             std::cout << std::endl; // Add newline after show operations
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            failed = true;
+        }
+
+        if (!failed) {
+            std::cout << "\nFinal stack state:" << std::endl;
+            interpreter.printState();
+        }
+    }
+
+    // The profile is most useful when a job fails, so it is written regardless
+    if (!profileFile.empty()) {
+        Profiling::setEnabled(false);
+        writeProfile(profileFile, Profiling::report());
+    }
+    if (failed) {
+        return 1;
+    }
+
+    if (!recordFile.empty()) {
+        std::ofstream out(recordFile, std::ios::binary);
+        try {
+            if (!out) {
+                throw std::runtime_error("cannot write " + recordFile);
+            }
+            recording.write(out);
         } catch (const std::exception& e) {
             std::cerr << "Error: " << e.what() << std::endl;
             return 1;
         }
-        
-        std::cout << "\nFinal stack state:" << std::endl;
-        interpreter.printState();
+        if (device) {
+            device->replay(recording);
+        }
     }
-    
+
+    // A page painted but never shown is still worth writing out
+    if (device && device->pageCount() == 0) {
+        device->showpage();
+    }
+
     return 0;
-} 
\ No newline at end of file
+}
@@ -1,200 +1,320 @@
 #include "ps_parser.h"
+#include "log.h"
+#include "byte_scan.h"
 #include <fstream>
 #include <sstream>
 #include <cctype>
-#include <iostream>
+#include <cstring>
 
 namespace PostScript {
 
-std::vector<std::string> PSParser::parse(const std::string& program) {
-    return tokenize(program);
+namespace {
+
+// Byte classes of the tokenizer; WHITESPACE matches isWhitespace. The stop
+// sets hold every byte that can change the tokenizer's state, so the bytes
+// before one can be taken in bulk.
+constexpr ByteScan::ByteSet WHITESPACE(" \t\n\v\f\r");
+constexpr ByteScan::ByteSet NEWLINE("\n");
+constexpr ByteScan::ByteSet TOKEN_STOP(" \t\n\v\f\r%()[]{}<>");
+constexpr ByteScan::ByteSet STRING_STOP("\\)");
+constexpr ByteScan::ByteSet COMPOSITE_STOP("[]{}<>");
+
+} // namespace
+
+PSTokenStream::PSTokenStream(std::istream& input, size_t chunkSize)
+    : input_(&input), chunkSize_(chunkSize > 0 ? chunkSize : DEFAULT_CHUNK_SIZE) {}
+
+PSTokenStream::PSTokenStream(std::unique_ptr<std::istream> input, size_t chunkSize)
+    : ownedInput_(std::move(input)), chunkSize_(chunkSize > 0 ? chunkSize : DEFAULT_CHUNK_SIZE) {
+    input_ = ownedInput_.get();
 }
 
-std::vector<std::string> PSParser::parseFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        throw std::runtime_error("Cannot open file: " + filename);
+PSTokenStream::PSTokenStream(std::string_view input)
+    : data_(input.data()), size_(input.size()) {}
+
+bool PSTokenStream::refill() {
+    if (!input_ || !*input_) {
+        return false;
     }
     
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return tokenize(buffer.str());
+    // The chunk is about to be overwritten, so a token still referring to it must be copied
+    if (!tokenInScratch_ && tokenLength_ > 0) {
+        moveTokenToScratch();
+    }
+    
+    // Keep unconsumed bytes (needed for two-character lookahead) at the front
+    size_t remaining = size_ - pos_;
+    if (remaining > 0 && pos_ > 0) {
+        std::memmove(&chunk_[0], &chunk_[pos_], remaining);
+    }
+    chunk_.resize(remaining + chunkSize_);
+    input_->read(&chunk_[remaining], static_cast<std::streamsize>(chunkSize_));
+    size_t got = static_cast<size_t>(input_->gcount());
+    chunk_.resize(remaining + got);
+    
+    data_ = chunk_.data();
+    size_ = chunk_.size();
+    pos_ = 0;
+    return got > 0;
 }
 
-std::vector<std::string> PSParser::tokenize(const std::string& input) {
-    std::cout << "[DEBUG] tokenize input length: " << input.length() << std::endl;
-    std::cout << "[DEBUG] tokenize input snippet: '" << input.substr(0, 100) << "'" << std::endl;
-    std::vector<std::string> tokens;
-    std::string currentToken;
-    bool inString = false;
-    bool escapeNext = false;
-    bool inComment = false;
-    bool inArray = false;
-    bool inDict = false;
-    bool inProc = false;
-    int braceLevel = 0;
-    int bracketLevel = 0;
-    int dictLevel = 0;
+bool PSTokenStream::available(size_t count) {
+    while (size_ - pos_ < count) {
+        if (!refill()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void PSTokenStream::append(size_t index, size_t count) {
+    if (!tokenInScratch_) {
+        if (tokenLength_ == 0) {
+            tokenStart_ = index;
+        }
+        if (tokenStart_ + tokenLength_ == index) {
+            tokenLength_ += count;
+            return;
+        }
+        // A character was dropped (escape), so the token is no longer a plain slice
+        moveTokenToScratch();
+    }
+    scratch_.append(data_ + index, count);
+}
+
+void PSTokenStream::moveTokenToScratch() {
+    scratch_.assign(data_ + tokenStart_, tokenLength_);
+    tokenLength_ = 0;
+    tokenInScratch_ = true;
+}
+
+void PSTokenStream::resetToken() {
+    tokenLength_ = 0;
+    tokenInScratch_ = false;
+    scratch_.clear();
+}
+
+std::string_view PSTokenStream::currentToken() const {
+    if (tokenInScratch_) {
+        return std::string_view(scratch_);
+    }
+    return std::string_view(data_ + tokenStart_, tokenLength_);
+}
+
+bool PSTokenStream::next(std::string_view& token) {
+    resetToken();
+    
+    if (pendingDelimiter_ != '\0') {
+        delimiterToken_ = pendingDelimiter_;
+        pendingDelimiter_ = '\0';
+        token = std::string_view(&delimiterToken_, 1);
+        return true;
+    }
     
-    for (size_t i = 0; i < input.length(); ++i) {
-        char c = input[i];
+    auto hasToken = [this]() { return tokenInScratch_ || tokenLength_ > 0; };
+    
+    while (pos_ < size_ || refill()) {
+        char c = data_[pos_];
         
-        // Handle comments
-        if (c == '%' && !inString && !escapeNext && !inArray && !inDict && !inProc) {
-            inComment = true;
-            // Skip the rest of the line
-            while (i < input.length() && input[i] != '\n') {
-                i++;
-            }
-            if (i < input.length()) {
-                i--; // Adjust for the loop increment
+        // Handle comments: skip the rest of the line; a comment also ends the current token
+        if (c == '%' && !inString_ && !escapeNext_ && !inArray_ && !inDict_ && !inProc_) {
+            while (true) {
+                pos_ = ByteScan::skipUntil(std::string_view(data_, size_), pos_, NEWLINE);
+                if (pos_ < size_) {
+                    ++pos_;
+                    break;
+                }
+                if (!refill()) {
+                    break;
+                }
             }
-            continue;
-        }
-        
-        if (inComment) {
-            if (c == '\n') {
-                inComment = false;
+            if (hasToken()) {
+                token = currentToken();
+                return true;
             }
             continue;
         }
         
-        if (escapeNext) {
-            currentToken += c;
-            escapeNext = false;
+        if (escapeNext_) {
+            append(pos_++);
+            escapeNext_ = false;
             continue;
         }
         
-        if (c == '\\' && inString) {
-            escapeNext = true;
+        if (c == '\\' && inString_) {
+            escapeNext_ = true;
+            ++pos_;
             continue;
         }
         
         // Handle array brackets
-        if (c == '[' && !inString && !escapeNext && !inDict && !inProc) {
-            if (!inArray) {
-                inArray = true;
-                bracketLevel = 1;
+        if (c == '[' && !inString_ && !inDict_ && !inProc_) {
+            if (!inArray_) {
+                inArray_ = true;
+                bracketLevel_ = 1;
             } else {
-                bracketLevel++;
+                bracketLevel_++;
             }
-            currentToken += c;
+            append(pos_++);
             continue;
         }
         
-        if (c == ']' && inArray && !inString && !escapeNext) {
-            bracketLevel--;
-            currentToken += c;
-            if (bracketLevel == 0) {
-                inArray = false;
+        if (c == ']' && inArray_ && !inString_) {
+            bracketLevel_--;
+            append(pos_++);
+            if (bracketLevel_ == 0) {
+                inArray_ = false;
             }
             continue;
         }
         
-        // Handle dictionary brackets
-        if (c == '<' && i + 1 < input.length() && input[i + 1] == '<' && 
-            !inString && !escapeNext && !inArray && !inProc) {
-            if (!inDict) {
-                inDict = true;
-                dictLevel = 1;
-            } else {
-                dictLevel++;
+        // Handle dictionary brackets (two-character lookahead)
+        if ((c == '<' || c == '>') && !inString_ && available(2) && data_[pos_ + 1] == c) {
+            if (c == '<' && !inArray_ && !inProc_) {
+                if (!inDict_) {
+                    inDict_ = true;
+                    dictLevel_ = 1;
+                } else {
+                    dictLevel_++;
+                }
+                append(pos_++);
+                append(pos_++);
+                continue;
             }
-            currentToken += c;
-            currentToken += input[++i]; // Skip the second '<'
-            continue;
-        }
-        
-        if (c == '>' && i + 1 < input.length() && input[i + 1] == '>' && 
-            inDict && !inString && !escapeNext) {
-            dictLevel--;
-            currentToken += c;
-            currentToken += input[++i]; // Skip the second '>'
-            if (dictLevel == 0) {
-                inDict = false;
+            if (c == '>' && inDict_) {
+                dictLevel_--;
+                append(pos_++);
+                append(pos_++);
+                if (dictLevel_ == 0) {
+                    inDict_ = false;
+                }
+                continue;
             }
-            continue;
         }
         
         // Handle procedure braces
-        if (c == '{' && !inString && !escapeNext && !inArray && !inDict) {
-            if (!inProc) {
-                inProc = true;
-                braceLevel = 1;
+        if (c == '{' && !inString_ && !inArray_ && !inDict_) {
+            if (!inProc_) {
+                inProc_ = true;
+                braceLevel_ = 1;
             } else {
-                braceLevel++;
+                braceLevel_++;
             }
-            currentToken += c;
+            append(pos_++);
             continue;
         }
         
-        if (c == '}' && inProc && !inString && !escapeNext) {
-            braceLevel--;
-            currentToken += c;
-            if (braceLevel == 0) {
-                inProc = false;
+        if (c == '}' && inProc_ && !inString_) {
+            braceLevel_--;
+            append(pos_++);
+            if (braceLevel_ == 0) {
+                inProc_ = false;
             }
             continue;
         }
         
-        if (c == '(' && !inString && !inArray && !inDict && !inProc) {
+        if (c == '(' && !inString_ && !inArray_ && !inDict_ && !inProc_) {
             // Start of string literal
-            inString = true;
-            currentToken += c;
+            inString_ = true;
+            append(pos_++);
             continue;
         }
         
-        if (c == ')' && inString) {
+        if (c == ')' && inString_) {
             // End of string literal
-            inString = false;
-            currentToken += c;
+            inString_ = false;
+            append(pos_++);
             continue;
         }
         
-        if (inString || inArray || inDict || inProc) {
-            // Inside a composite literal, add all characters
-            currentToken += c;
+        if (inString_ || inArray_ || inDict_ || inProc_) {
+            // Inside a composite literal, add all characters up to the next one that can end it
+            size_t end = ByteScan::skipUntil(std::string_view(data_, size_), pos_ + 1,
+                                             inString_ ? STRING_STOP : COMPOSITE_STOP);
+            append(pos_, end - pos_);
+            pos_ = end;
             continue;
         }
         
         if (isWhitespace(c)) {
             // End of current token
-            if (!currentToken.empty()) {
-                tokens.push_back(currentToken);
-                currentToken.clear();
+            if (hasToken()) {
+                ++pos_;
+                token = currentToken();
+                return true;
             }
+            pos_ = ByteScan::skipWhile(std::string_view(data_, size_), pos_ + 1, WHITESPACE);
             continue;
         }
         
         if (isDelimiter(c)) {
-            // End of current token, then add delimiter as separate token
-            if (!currentToken.empty()) {
-                tokens.push_back(currentToken);
-                currentToken.clear();
+            // End of current token, then the delimiter as a separate token
+            ++pos_;
+            if (hasToken()) {
+                pendingDelimiter_ = c;
+                token = currentToken();
+                return true;
             }
-            tokens.push_back(std::string(1, c));
-            continue;
+            delimiterToken_ = c;
+            token = std::string_view(&delimiterToken_, 1);
+            return true;
         }
         
-        // Regular character, add to current token
-        currentToken += c;
+        // Regular characters, add to current token
+        size_t end = ByteScan::skipUntil(std::string_view(data_, size_), pos_ + 1, TOKEN_STOP);
+        append(pos_, end - pos_);
+        pos_ = end;
     }
     
     // Don't forget the last token
-    if (!currentToken.empty()) {
-        tokens.push_back(currentToken);
+    if (hasToken()) {
+        token = currentToken();
+        return true;
     }
-    
-    return tokens;
+    return false;
 }
 
-bool PSParser::isWhitespace(char c) const {
+bool PSTokenStream::isWhitespace(char c) {
     return std::isspace(static_cast<unsigned char>(c));
 }
 
-bool PSParser::isDelimiter(char c) const {
+bool PSTokenStream::isDelimiter(char c) {
     // PostScript delimiters: whitespace, parentheses, brackets, braces
     return isWhitespace(c) || c == '(' || c == ')' || c == '[' || c == ']' || c == '{' || c == '}';
 }
 
-} // namespace PostScript 
\ No newline at end of file
+std::vector<std::string> PSParser::parse(const std::string& program) {
+    return tokenize(program);
+}
+
+std::vector<std::string> PSParser::parseFile(const std::string& filename) {
+    std::unique_ptr<PSTokenStream> stream = openFile(filename);
+    std::vector<std::string> tokens;
+    std::string_view token;
+    while (stream->next(token)) {
+        tokens.emplace_back(token);
+    }
+    return tokens;
+}
+
+std::unique_ptr<PSTokenStream> PSParser::openFile(const std::string& filename) {
+    auto file = std::make_unique<std::ifstream>(filename, std::ios::binary);
+    if (!file->is_open()) {
+        throw std::runtime_error("Cannot open file: " + filename);
+    }
+    return std::make_unique<PSTokenStream>(std::move(file));
+}
+
+std::vector<std::string> PSParser::tokenize(const std::string& input) {
+    PS_LOG_DEBUG(Parser, "tokenize input length: " << input.length());
+    PS_LOG_TRACE(Parser, "tokenize input snippet: '" << input.substr(0, 100) << "'");
+    std::vector<std::string> tokens;
+    PSTokenStream stream{std::string_view(input)};
+    std::string_view token;
+    while (stream.next(token)) {
+        tokens.emplace_back(token);
+    }
+    return tokens;
+}
+
+} // namespace PostScript 
@@ -0,0 +1,222 @@
+#include "pdf_file.h"
+#include "pdf_source.h"
+#include "byte_scan.h"
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PDF_HAVE_MMAP 1
+#endif
+
+namespace PDF {
+
+std::shared_ptr<const PDFFileData> PDFFileData::open(const std::string& filename, bool memoryMap) {
+    std::shared_ptr<PDFFileData> file(new PDFFileData());
+
+#ifdef PDF_HAVE_MMAP
+    if (memoryMap) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open PDF file: " + filename);
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                ::close(fd);
+                file->data_ = static_cast<const char*>(addr);
+                file->size_ = static_cast<size_t>(st.st_size);
+                file->mapped_ = true;
+                return file;
+            }
+        }
+        ::close(fd);
+        // Empty files and filesystems without mmap support fall through to a plain read
+    }
+#endif
+
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Cannot open PDF file: " + filename);
+    }
+    in.seekg(0, std::ios::end);
+    std::streamoff length = in.tellg();
+    in.seekg(0, std::ios::beg);
+    if (length > 0) {
+        file->buffer_.resize(static_cast<size_t>(length));
+        in.read(&file->buffer_[0], length);
+        file->buffer_.resize(static_cast<size_t>(in.gcount()));
+    }
+    file->data_ = file->buffer_.data();
+    file->size_ = file->buffer_.size();
+    return file;
+}
+
+std::shared_ptr<const PDFFileData> PDFFileData::fromString(std::string bytes) {
+    std::shared_ptr<PDFFileData> file(new PDFFileData());
+    file->buffer_ = std::move(bytes);
+    file->data_ = file->buffer_.data();
+    file->size_ = file->buffer_.size();
+    return file;
+}
+
+std::shared_ptr<const PDFFileData> PDFFileData::fromSource(std::shared_ptr<PDFByteSource> source,
+                                                           size_t blockSize) {
+    std::shared_ptr<PDFFileData> file(new PDFFileData());
+    file->source_ = std::move(source);
+    file->blockSize_ = std::max<size_t>(blockSize, 1);
+    file->size_ = static_cast<size_t>(file->source_->size());
+    file->blocks_.reset(new std::atomic<uint8_t>[file->size_ / file->blockSize_ + 1]());
+
+#ifdef PDF_HAVE_MMAP
+    // Anonymous memory is only committed as blocks are fetched into it
+    if (file->size_ > 0) {
+        void* addr = mmap(nullptr, file->size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr != MAP_FAILED) {
+            file->data_ = static_cast<const char*>(addr);
+            file->reserved_ = true;
+            return file;
+        }
+    }
+#endif
+    file->buffer_.assign(file->size_, '\0');
+    file->data_ = file->buffer_.data();
+    return file;
+}
+
+PDFFileData::~PDFFileData() {
+#ifdef PDF_HAVE_MMAP
+    if (mapped_ || reserved_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+}
+
+bool PDFFileData::blocksFetched(size_t first, size_t last) const {
+    for (size_t block = first; block <= last; ++block) {
+        if (blocks_[block].load(std::memory_order_acquire) != FETCHED) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PDFFileData::isFetched(size_t offset, size_t count) const {
+    if (!source_ || offset >= size_ || count == 0) {
+        return true;
+    }
+    count = std::min(count, size_ - offset);
+    return blocksFetched(offset / blockSize_, (offset + count - 1) / blockSize_);
+}
+
+void PDFFileData::fetch(size_t offset, size_t count) const {
+    if (isFetched(offset, count)) {
+        return;
+    }
+    count = std::min(count, size_ - offset);
+    const size_t first = offset / blockSize_;
+    const size_t last = (offset + count - 1) / blockSize_;
+
+    std::unique_lock<std::mutex> lock(fetchMutex_);
+    while (true) {
+        // Claim the missing blocks as runs of neighbours, each read with one request
+        std::vector<std::pair<size_t, size_t>> runs; // [first, end) blocks
+        bool othersReading = false;
+        for (size_t block = first; block <= last; ++block) {
+            uint8_t state = blocks_[block].load(std::memory_order_relaxed);
+            if (state == MISSING) {
+                blocks_[block].store(READING, std::memory_order_relaxed);
+                if (!runs.empty() && runs.back().second == block) {
+                    ++runs.back().second;
+                } else {
+                    runs.emplace_back(block, block + 1);
+                }
+            } else if (state == READING) {
+                othersReading = true;
+            }
+        }
+        if (runs.empty()) {
+            if (!othersReading) {
+                return;
+            }
+            fetchDone_.wait(lock);
+            continue;
+        }
+
+        // Read outside the lock so that other ranges are fetched concurrently
+        lock.unlock();
+        size_t completed = 0;
+        uint64_t bytes = 0;
+        std::exception_ptr error;
+        try {
+            for (const auto& [runFirst, runEnd] : runs) {
+                size_t start = runFirst * blockSize_;
+                size_t length = std::min(runEnd * blockSize_, size_) - start;
+                source_->read(start, length, const_cast<char*>(data_) + start);
+                bytes += length;
+                ++completed;
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+        for (size_t run = 0; run < runs.size(); ++run) {
+            for (size_t block = runs[run].first; block < runs[run].second; ++block) {
+                blocks_[block].store(run < completed ? FETCHED : MISSING, std::memory_order_release);
+            }
+        }
+        fetchedBytes_ += bytes;
+        fetchDone_.notify_all();
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+uint64_t PDFFileData::getFetchedBytes() const {
+    std::lock_guard<std::mutex> lock(fetchMutex_);
+    return fetchedBytes_;
+}
+
+PDFBytes PDFFileData::slice(size_t offset, size_t count) const {
+    if (offset > size_) {
+        offset = size_;
+    }
+    return PDFBytes(view().substr(offset, count), shared_from_this());
+}
+
+// --- PDFObjectExtents ---
+
+PDFObjectExtents::PDFObjectExtents(std::vector<uint64_t> offsets, uint64_t fileSize)
+    : boundaries_(std::move(offsets)) {
+    boundaries_.push_back(fileSize);
+    std::sort(boundaries_.begin(), boundaries_.end());
+    boundaries_.erase(std::unique(boundaries_.begin(), boundaries_.end()), boundaries_.end());
+}
+
+size_t PDFObjectExtents::lengthAt(uint64_t offset) const {
+    auto next = std::upper_bound(boundaries_.begin(), boundaries_.end(), offset);
+    return next == boundaries_.end() ? 1 : static_cast<size_t>(*next - offset);
+}
+
+void PDFObjectExtents::fetch(const PDFFileData& file, uint64_t offset) const {
+    if (offset >= file.size()) {
+        return;
+    }
+    const size_t start = static_cast<size_t>(offset);
+    for (size_t length = lengthAt(offset);; length *= 4) {
+        file.fetch(start, length);
+        if (start + length >= file.size() ||
+            ByteScan::find(file.view().substr(start, length), "endobj") != std::string_view::npos) {
+            return;
+        }
+    }
+}
+
+} // namespace PDF
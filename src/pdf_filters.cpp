@@ -0,0 +1,489 @@
+#include "pdf_filters.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <zlib.h>
+
+namespace PDF {
+
+namespace {
+
+// Size of the encoded-input chunks each stage pulls from the one below it
+constexpr size_t INPUT_CHUNK_SIZE = 16 * 1024;
+
+// Decoded bytes a buffered stage produces per refill() before handing them out
+constexpr size_t REFILL_TARGET = 4 * 1024;
+
+bool isPDFWhitespace(int c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\0';
+}
+
+int hexDigit(int c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+int integerParam(const PDFObjectPtr& params, const char* key, int defaultValue) {
+    if (!params || !params->isDictionary()) {
+        return defaultValue;
+    }
+    const PDFDictionary& dict = params->getDictionary();
+    auto it = dict.find(key);
+    if (it == dict.end() || !it->second->isInteger()) {
+        return defaultValue;
+    }
+    return it->second->asInteger();
+}
+
+// Flate and LZW output may be run through a predictor
+std::unique_ptr<PDFFilter> withPredictor(std::unique_ptr<PDFFilter> input, const PDFObjectPtr& params) {
+    int predictor = integerParam(params, "Predictor", 1);
+    if (predictor <= 1) {
+        return input;
+    }
+    return std::make_unique<PredictorFilter>(std::move(input), predictor,
+                                             integerParam(params, "Colors", 1),
+                                             integerParam(params, "BitsPerComponent", 8),
+                                             integerParam(params, "Columns", 1));
+}
+
+} // namespace
+
+// --- PDFFilter ---
+
+std::unique_ptr<PDFFilter> PDFFilter::open(const PDFStream& stream) {
+    std::unique_ptr<PDFFilter> filter = std::make_unique<PDFMemorySource>(stream.data);
+
+    auto filterIt = stream.dict.find("Filter");
+    if (filterIt == stream.dict.end()) {
+        return filter;
+    }
+    PDFObjectPtr params;
+    auto paramsIt = stream.dict.find("DecodeParms");
+    if (paramsIt != stream.dict.end()) {
+        params = paramsIt->second;
+    }
+
+    // /Filter and /DecodeParms are either single entries or parallel arrays
+    if (filterIt->second->isName()) {
+        return create(filterIt->second->asName().value, std::move(filter), params);
+    }
+    if (!filterIt->second->isArray()) {
+        throw std::runtime_error("Invalid /Filter entry");
+    }
+    const PDFArray& names = filterIt->second->getArray();
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (!names[i]->isName()) {
+            throw std::runtime_error("Invalid /Filter entry");
+        }
+        PDFObjectPtr stageParams;
+        if (params && params->isArray() && i < params->getArray().size()) {
+            stageParams = params->getArray()[i];
+        } else if (params && params->isDictionary() && names.size() == 1) {
+            stageParams = params;
+        }
+        filter = create(names[i]->asName().value, std::move(filter), stageParams);
+    }
+    return filter;
+}
+
+std::unique_ptr<PDFFilter> PDFFilter::create(const std::string& name, std::unique_ptr<PDFFilter> input,
+                                             const PDFObjectPtr& params) {
+    if (name == "FlateDecode" || name == "Fl") {
+        return withPredictor(std::make_unique<FlateFilter>(std::move(input)), params);
+    }
+    if (name == "LZWDecode" || name == "LZW") {
+        return withPredictor(std::make_unique<LZWFilter>(std::move(input), integerParam(params, "EarlyChange", 1)),
+                             params);
+    }
+    if (name == "ASCIIHexDecode" || name == "AHx") {
+        return std::make_unique<ASCIIHexFilter>(std::move(input));
+    }
+    if (name == "ASCII85Decode" || name == "A85") {
+        return std::make_unique<ASCII85Filter>(std::move(input));
+    }
+    if (name == "RunLengthDecode" || name == "RL") {
+        return std::make_unique<RunLengthFilter>(std::move(input));
+    }
+    throw std::runtime_error("Unsupported stream filter: " + name);
+}
+
+std::string PDFFilter::readAll(PDFFilter& filter) {
+    std::string out;
+    char buffer[INPUT_CHUNK_SIZE];
+    while (size_t n = filter.read(buffer, sizeof(buffer))) {
+        out.append(buffer, n);
+    }
+    return out;
+}
+
+std::string PDFFilter::decodeAll(const PDFStream& stream) {
+    return readAll(*open(stream));
+}
+
+// --- PDFMemorySource ---
+
+size_t PDFMemorySource::read(char* buffer, size_t size) {
+    size_t n = std::min(size, data_.size());
+    std::memcpy(buffer, data_.data(), n);
+    data_.remove_prefix(n);
+    return n;
+}
+
+// --- FlateFilter ---
+
+struct FlateFilter::State {
+    z_stream zs{};
+    std::vector<char> input = std::vector<char>(INPUT_CHUNK_SIZE);
+    bool inputDone = false;
+    bool finished = false;
+};
+
+FlateFilter::FlateFilter(std::unique_ptr<PDFFilter> input)
+    : input_(std::move(input)), state_(std::make_unique<State>()) {
+    // 15 window bits + 32: accept both zlib and gzip headers
+    if (inflateInit2(&state_->zs, 15 + 32) != Z_OK) {
+        throw std::runtime_error("zlib inflateInit failed");
+    }
+}
+
+FlateFilter::~FlateFilter() {
+    inflateEnd(&state_->zs);
+}
+
+size_t FlateFilter::read(char* buffer, size_t size) {
+    Profiling::Scope profile(Profiling::Phase::Decompress);
+    State& s = *state_;
+    if (s.finished || size == 0) {
+        return 0;
+    }
+    s.zs.next_out = reinterpret_cast<Bytef*>(buffer);
+    s.zs.avail_out = static_cast<uInt>(std::min<size_t>(size, UINT32_MAX));
+    uInt capacity = s.zs.avail_out;
+
+    while (s.zs.avail_out > 0 && !s.finished) {
+        if (s.zs.avail_in == 0 && !s.inputDone) {
+            size_t n = input_->read(s.input.data(), s.input.size());
+            s.inputDone = n == 0;
+            s.zs.next_in = reinterpret_cast<Bytef*>(s.input.data());
+            s.zs.avail_in = static_cast<uInt>(n);
+        }
+        int ret = inflate(&s.zs, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            s.finished = true;
+        } else if (ret == Z_BUF_ERROR) {
+            // No progress possible: a truncated stream ends with what was decoded
+            if (s.inputDone && s.zs.avail_in == 0) {
+                s.finished = true;
+            }
+        } else if (ret != Z_OK) {
+            throw std::runtime_error("FlateDecode: corrupt data");
+        }
+    }
+    return capacity - s.zs.avail_out;
+}
+
+// --- PDFBufferedFilter ---
+
+PDFBufferedFilter::PDFBufferedFilter(std::unique_ptr<PDFFilter> input)
+    : source_(std::move(input)), input_(INPUT_CHUNK_SIZE) {}
+
+bool PDFBufferedFilter::fillInput() {
+    inputPos_ = 0;
+    inputEnd_ = source_->read(input_.data(), input_.size());
+    return inputEnd_ > 0;
+}
+
+size_t PDFBufferedFilter::read(char* buffer, size_t size) {
+    Profiling::Scope profile(Profiling::Phase::Decompress);
+    size_t written = 0;
+    while (written < size) {
+        if (pendingPos_ == pending_.size()) {
+            if (finished_) {
+                break;
+            }
+            pending_.clear();
+            pendingPos_ = 0;
+            if (!refill(pending_) && pending_.empty()) {
+                finished_ = true;
+                break;
+            }
+        }
+        size_t n = std::min(size - written, pending_.size() - pendingPos_);
+        std::memcpy(buffer + written, pending_.data() + pendingPos_, n);
+        pendingPos_ += n;
+        written += n;
+    }
+    return written;
+}
+
+// --- ASCIIHexFilter ---
+
+bool ASCIIHexFilter::refill(std::string& out) {
+    while (!done_ && out.size() < REFILL_TARGET) {
+        int c = nextByte();
+        if (c < 0 || c == '>') {
+            // A lone final digit is padded with 0
+            if (high_ >= 0) {
+                out.push_back(static_cast<char>(high_ << 4));
+                high_ = -1;
+            }
+            done_ = true;
+            break;
+        }
+        int digit = hexDigit(c);
+        if (digit < 0) {
+            continue; // whitespace and stray bytes are ignored
+        }
+        if (high_ < 0) {
+            high_ = digit;
+        } else {
+            out.push_back(static_cast<char>((high_ << 4) | digit));
+            high_ = -1;
+        }
+    }
+    return !out.empty();
+}
+
+// --- ASCII85Filter ---
+
+bool ASCII85Filter::refill(std::string& out) {
+    while (!done_ && out.size() < REFILL_TARGET) {
+        uint32_t group[5];
+        int count = 0;
+        while (count < 5) {
+            int c = nextByte();
+            if (c < 0 || c == '~') {
+                done_ = true;
+                break;
+            }
+            if (isPDFWhitespace(c)) {
+                continue;
+            }
+            if (c == 'z' && count == 0) {
+                out.append(4, '\0');
+                continue;
+            }
+            if (c < '!' || c > 'u') {
+                throw std::runtime_error("ASCII85Decode: invalid character");
+            }
+            group[count++] = static_cast<uint32_t>(c - '!');
+        }
+        if (count == 0) {
+            continue;
+        }
+        if (count == 1) {
+            throw std::runtime_error("ASCII85Decode: truncated group");
+        }
+        // A final partial group is padded with 'u' and yields count-1 bytes
+        for (int i = count; i < 5; ++i) {
+            group[i] = 84;
+        }
+        uint32_t value = 0;
+        for (int i = 0; i < 5; ++i) {
+            value = value * 85 + group[i];
+        }
+        for (int i = 0; i < count - 1; ++i) {
+            out.push_back(static_cast<char>(value >> (24 - 8 * i)));
+        }
+    }
+    return !out.empty();
+}
+
+// --- LZWFilter ---
+
+LZWFilter::LZWFilter(std::unique_ptr<PDFFilter> input, int earlyChange)
+    : PDFBufferedFilter(std::move(input)), earlyChange_(earlyChange),
+      prefix_(MAX_CODES), suffix_(MAX_CODES), first_(MAX_CODES), length_(MAX_CODES) {
+    for (int i = 0; i < 256; ++i) {
+        prefix_[i] = -1;
+        suffix_[i] = static_cast<unsigned char>(i);
+        first_[i] = static_cast<unsigned char>(i);
+        length_[i] = 1;
+    }
+    resetTable();
+}
+
+void LZWFilter::resetTable() {
+    codeWidth_ = 9;
+    nextCode_ = 258;
+    previous_ = -1;
+}
+
+int LZWFilter::readCode() {
+    while (bitCount_ < codeWidth_) {
+        int c = nextByte();
+        if (c < 0) {
+            return -1;
+        }
+        bitBuffer_ = (bitBuffer_ << 8) | static_cast<uint32_t>(c);
+        bitCount_ += 8;
+    }
+    bitCount_ -= codeWidth_;
+    return static_cast<int>((bitBuffer_ >> bitCount_) & ((1u << codeWidth_) - 1));
+}
+
+bool LZWFilter::refill(std::string& out) {
+    while (!done_ && out.size() < REFILL_TARGET) {
+        int code = readCode();
+        if (code < 0 || code == 257) {
+            done_ = true;
+            break;
+        }
+        if (code == 256) {
+            resetTable();
+            continue;
+        }
+
+        if (previous_ < 0) {
+            if (code > 255) {
+                throw std::runtime_error("LZWDecode: invalid code");
+            }
+        } else {
+            if (code > nextCode_ || (code == nextCode_ && nextCode_ >= MAX_CODES)) {
+                throw std::runtime_error("LZWDecode: invalid code");
+            }
+            if (nextCode_ < MAX_CODES) {
+                // New entry: previous string + first byte of the current one.
+                // code == nextCode_ is the KwKwK case, where that byte is the previous string's first.
+                unsigned char firstByte = code == nextCode_ ? first_[previous_] : first_[code];
+                prefix_[nextCode_] = previous_;
+                suffix_[nextCode_] = firstByte;
+                first_[nextCode_] = first_[previous_];
+                length_[nextCode_] = length_[previous_] + 1;
+                ++nextCode_;
+                if (nextCode_ + earlyChange_ >= (1 << codeWidth_) && codeWidth_ < 12) {
+                    ++codeWidth_;
+                }
+            }
+        }
+
+        // Emit the string for this code by walking its prefix chain backwards
+        size_t start = out.size();
+        out.resize(start + static_cast<size_t>(length_[code]));
+        for (int c = code, i = length_[code] - 1; c >= 0; c = prefix_[c], --i) {
+            out[start + static_cast<size_t>(i)] = static_cast<char>(suffix_[c]);
+        }
+        previous_ = code;
+    }
+    return !out.empty();
+}
+
+// --- RunLengthFilter ---
+
+bool RunLengthFilter::refill(std::string& out) {
+    while (!done_ && out.size() < REFILL_TARGET) {
+        int length = nextByte();
+        if (length < 0 || length == 128) {
+            done_ = true;
+            break;
+        }
+        if (length < 128) {
+            for (int i = 0; i <= length; ++i) {
+                int c = nextByte();
+                if (c < 0) {
+                    done_ = true;
+                    break;
+                }
+                out.push_back(static_cast<char>(c));
+            }
+        } else {
+            int c = nextByte();
+            if (c < 0) {
+                done_ = true;
+                break;
+            }
+            out.append(static_cast<size_t>(257 - length), static_cast<char>(c));
+        }
+    }
+    return !out.empty();
+}
+
+// --- PredictorFilter ---
+
+PredictorFilter::PredictorFilter(std::unique_ptr<PDFFilter> input, int predictor, int colors,
+                                 int bitsPerComponent, int columns)
+    : PDFBufferedFilter(std::move(input)), predictor_(predictor), bitsPerComponent_(bitsPerComponent) {
+    if (colors < 1 || columns < 1 || (bitsPerComponent != 1 && bitsPerComponent != 2 &&
+        bitsPerComponent != 4 && bitsPerComponent != 8 && bitsPerComponent != 16)) {
+        throw std::runtime_error("Invalid predictor parameters");
+    }
+    size_t bitsPerPixel = static_cast<size_t>(colors) * static_cast<size_t>(bitsPerComponent);
+    bytesPerPixel_ = std::max<size_t>(1, bitsPerPixel / 8);
+    rowBytes_ = (bitsPerPixel * static_cast<size_t>(columns) + 7) / 8;
+    previousRow_.assign(rowBytes_, 0);
+    row_.resize(rowBytes_);
+}
+
+bool PredictorFilter::refill(std::string& out) {
+    // PNG rows carry a leading filter-type byte
+    int type = 0;
+    if (predictor_ >= 10) {
+        type = nextByte();
+        if (type < 0) {
+            return false;
+        }
+    }
+    size_t count = 0;
+    for (; count < rowBytes_; ++count) {
+        int c = nextByte();
+        if (c < 0) {
+            break;
+        }
+        row_[count] = static_cast<unsigned char>(c);
+    }
+    if (count == 0) {
+        return false;
+    }
+
+    const size_t bpp = bytesPerPixel_;
+    if (predictor_ == 2) {
+        if (bitsPerComponent_ == 8) {
+            for (size_t i = bpp; i < count; ++i) {
+                row_[i] = static_cast<unsigned char>(row_[i] + row_[i - bpp]);
+            }
+        } else if (bitsPerComponent_ == 16) {
+            for (size_t i = bpp; i + 1 < count; i += 2) {
+                unsigned value = ((row_[i] << 8) | row_[i + 1]) + ((row_[i - bpp] << 8) | row_[i - bpp + 1]);
+                row_[i] = static_cast<unsigned char>(value >> 8);
+                row_[i + 1] = static_cast<unsigned char>(value);
+            }
+        } else {
+            throw std::runtime_error("TIFF predictor with sub-byte components is not supported");
+        }
+    } else if (predictor_ >= 10) {
+        for (size_t i = 0; i < count; ++i) {
+            unsigned left = i >= bpp ? row_[i - bpp] : 0;
+            unsigned up = previousRow_[i];
+            unsigned upLeft = i >= bpp ? previousRow_[i - bpp] : 0;
+            unsigned predicted = 0;
+            switch (type) {
+                case 0: predicted = 0; break;
+                case 1: predicted = left; break;
+                case 2: predicted = up; break;
+                case 3: predicted = (left + up) / 2; break;
+                case 4: {
+                    int p = static_cast<int>(left + up) - static_cast<int>(upLeft);
+                    int pa = std::abs(p - static_cast<int>(left));
+                    int pb = std::abs(p - static_cast<int>(up));
+                    int pc = std::abs(p - static_cast<int>(upLeft));
+                    predicted = (pa <= pb && pa <= pc) ? left : (pb <= pc ? up : upLeft);
+                    break;
+                }
+                default:
+                    throw std::runtime_error("Invalid PNG predictor type");
+            }
+            row_[i] = static_cast<unsigned char>(row_[i] + predicted);
+        }
+    }
+
+    out.append(reinterpret_cast<const char*>(row_.data()), count);
+    std::copy(row_.begin(), row_.begin() + static_cast<std::ptrdiff_t>(count), previousRow_.begin());
+    return true;
+}
+
+} // namespace PDF
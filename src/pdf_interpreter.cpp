@@ -1,6 +1,17 @@
 #include "pdf_interpreter.h"
+#include "pdf_file.h"
+#include "pdf_prefetch.h"
+#include "log.h"
+#include "profiler.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
 
 namespace PDF {
 
@@ -21,10 +32,26 @@ void PDFInterpreter::processFile(const std::string& filename) {
         std::cout << "  Root object: " << document.rootObjectNumber << std::endl;
         std::cout << "  Info object: " << document.infoObjectNumber << std::endl;
         std::cout << "  Catalog object: " << document.catalogObjectNumber << std::endl;
-        std::cout << "  Total objects: " << document.objects.size() << std::endl;
+        std::cout << "  Objects in xref: " << document.getObjectCount() << std::endl;
+        std::cout << "  Objects loaded: " << document.getLoadedObjectCount() << std::endl;
         
-        // For now, we'll just demonstrate the basic structure
-        // In a full implementation, we'd process pages and content streams
+        std::vector<PageResult> results = processPages(document);
+        for (const PageResult& result : results) {
+            std::cout << "--- Page " << (result.pageIndex + 1) << " ---\n" << result.output;
+            if (!result.diagnostics.empty()) {
+                std::cout.flush();
+                std::clog << result.diagnostics;
+            }
+            if (!result.succeeded) {
+                std::cerr << "Error processing page " << (result.pageIndex + 1) << ": " << result.error << std::endl;
+            }
+        }
+        ContentStreamCache::Stats stats = cache_.getStats();
+        if (stats.hits + stats.misses > 0) {
+            std::cout << "Content stream cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+                      << stats.evictions << " evictions, " << stats.bytes << " bytes\n";
+        }
+        std::cout.flush();
         
     } catch (const std::exception& e) {
         std::cerr << "Error processing PDF file: " << e.what() << std::endl;
@@ -32,32 +59,224 @@ void PDFInterpreter::processFile(const std::string& filename) {
     }
 }
 
-void PDFInterpreter::executeContentStream(const std::string& streamData) {
+std::vector<PageResult> PDFInterpreter::processPages(PDFDocument& document) {
+    // A sparse file is fetched in batches: the page tree now, then each page before it runs
+    std::unique_ptr<PDFPrefetcher> prefetcher;
+    if (document.file && document.file->isSparse()) {
+        prefetcher = std::make_unique<PDFPrefetcher>(document);
+        prefetcher->fetchPageTree();
+    }
+
+    // Walk the page tree once up front; workers only resolve page contents
+    std::vector<PDFObjectPtr> pages = document.getPages();
+    std::vector<PageResult> results(pages.size());
+    
+    size_t threads = threadCount_ > 0 ? threadCount_ : Threading::ThreadPool::hardwareThreads();
+    threads = std::min(threads, pages.size());
+    
+    // Each worker pulls the next unclaimed page, so uneven pages balance out
+    std::atomic<size_t> nextPage{0};
+    auto worker = [this, &document, &pages, &results, &nextPage, &prefetcher]() {
+        PostScript::PSInterpreter interpreter;
+        std::unordered_map<int, uint64_t> resourceHashes; // Shared resources are hashed once per worker
+        std::ostringstream output;
+        interpreter.setOutput(output);
+        for (size_t i = nextPage++; i < pages.size(); i = nextPage++) {
+            PageResult& result = results[i];
+            result.pageIndex = i;
+            interpreter.reset();
+            output.str("");
+            Log::Capture diagnostics(result.diagnostics);
+            try {
+                if (prefetcher) {
+                    prefetcher->fetchPage(i);
+                }
+                processPage(document, pages[i], interpreter, resourceHashes);
+            } catch (const std::exception& e) {
+                result.succeeded = false;
+                result.error = e.what();
+            }
+            result.output = output.str();
+        }
+    };
+    
+    if (threads <= 1) {
+        worker();
+        return results;
+    }
+    
+    Threading::ThreadPool pool(threads);
+    std::vector<std::future<void>> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.push_back(pool.submit(worker));
+    }
+    for (auto& done : workers) {
+        done.get();
+    }
+    return results;
+}
+
+size_t PDFInterpreter::extractText(PDFDocument& document,
+                                   const std::function<void(size_t pageIndex, const TextRun& run)>& onRun) {
+    std::unique_ptr<PDFPrefetcher> prefetcher;
+    if (document.file && document.file->isSparse()) {
+        prefetcher = std::make_unique<PDFPrefetcher>(document);
+        prefetcher->fetchPageTree();
+    }
+
+    std::vector<PDFObjectPtr> pages = document.getPages();
+    PDFTextExtractor extractor;
+    size_t pageIndex = 0;
+    TextRunHandler handler = [&onRun, &pageIndex](const TextRun& run) { onRun(pageIndex, run); };
+    size_t runs = 0;
+    for (; pageIndex < pages.size(); ++pageIndex) {
+        extractor.reset();
+        try {
+            if (prefetcher) {
+                prefetcher->fetchPage(pageIndex);
+            }
+            PDFObjectPtr contents = document.resolveKey(pages[pageIndex], "Contents");
+            if (!contents) {
+                continue;
+            }
+            // Streams of a /Contents array continue one another
+            std::vector<PDFObjectPtr> streams;
+            if (contents->isArray()) {
+                for (const auto& stream : contents->getArray()) {
+                    streams.push_back(document.resolve(stream));
+                }
+            } else {
+                streams.push_back(contents);
+            }
+            for (const PDFObjectPtr& stream : streams) {
+                if (!stream || !stream->isStream()) {
+                    throw std::runtime_error("Invalid stream object");
+                }
+                runs += extractor.extract(*PDFFilter::open(stream->getStream()), handler);
+            }
+        } catch (const std::exception& e) {
+            PS_LOG_WARNING(Page, "Cannot extract text of page " << (pageIndex + 1) << ": " << e.what());
+        }
+    }
+    return runs;
+}
+
+void PDFInterpreter::executeContentStream(std::string_view streamData) {
+    ContentStreamCache::Content content;
+    if (cache_.isEnabled()) {
+        content = ContentStreamCache::hashContent(streamData);
+    }
+    executeContentStream(content, 0, psInterpreter_,
+                         [streamData]() { return std::make_unique<PDFMemorySource>(streamData); });
+}
+
+namespace {
+
+// Whether an operand is still the one that was there before the stream ran
+bool sameOperand(const PostScript::PSObject& before, const PostScript::PSObject& after) {
+    using PostScript::ObjectType;
+    if (before.getType() != after.getType()) {
+        return false;
+    }
+    switch (before.getType()) {
+        case ObjectType::INTEGER: return before.asInteger() == after.asInteger();
+        case ObjectType::REAL: return before.asReal() == after.asReal();
+        case ObjectType::BOOLEAN: return before.asBoolean() == after.asBoolean();
+        case ObjectType::NAME: return before.asName() == after.asName();
+        case ObjectType::NULL_OBJECT: return true;
+        default: return before.sharesStorage(after);
+    }
+}
+
+} // namespace
+
+void PDFInterpreter::executeContentStream(const ContentStreamCache::Content& content, uint64_t resourcesHash,
+                                          PostScript::PSInterpreter& interpreter,
+                                          const std::function<std::unique_ptr<PDFFilter>()>& openSource) {
+    // Replaying cached output would skip painting, so rendered or recorded streams always run
+    PostScript::PSStack& operands = interpreter.getStack();
+    uint64_t operandsHash = 0;
+    bool cacheable = cache_.isEnabled() && !interpreter.getDevice() && !interpreter.getRecorder() &&
+                     ContentStreamCache::hashOperands(operands, operandsHash);
+    if (!cacheable) {
+        runContentStream(*openSource(), interpreter);
+        return;
+    }
+    
+    // A hit never builds the decode pipeline; the stack equals the one the entry was made from
+    ContentStreamCache::Key key =
+        ContentStreamCache::makeKey(content, resourcesHash, interpreter.getGraphicsStack(), operandsHash);
+    if (auto entry = cache_.find(key)) {
+        interpreter.getOutput() << entry->output;
+        interpreter.setGraphicsStack(entry->graphicsStack);
+        while (operands.size() > entry->keptOperands) {
+            operands.pop();
+        }
+        ContentStreamCache::restoreOperands(entry->operands, operands);
+        return;
+    }
+    
+    // Run with the output captured so it can be stored, then pass it on
+    std::vector<PostScript::PSObject> before;
+    before.reserve(operands.size());
+    for (size_t i = 0; i < operands.size(); ++i) {
+        before.push_back(operands[i]);
+    }
+    std::ostream& output = interpreter.getOutput();
+    std::ostringstream captured;
+    size_t dictionaryDepth = interpreter.getDictionaryStackDepth();
+    interpreter.setOutput(captured);
+    try {
+        runContentStream(*openSource(), interpreter);
+    } catch (...) {
+        interpreter.setOutput(output);
+        output << captured.str();
+        throw;
+    }
+    interpreter.setOutput(output);
+    
+    ContentStreamCache::Entry entry;
+    entry.output = captured.str();
+    output << entry.output;
+    if (interpreter.getDictionaryStackDepth() != dictionaryDepth) {
+        return;
+    }
+    // Operands at the bottom the stream did not replace are kept as they are on a hit
+    while (entry.keptOperands < before.size() && entry.keptOperands < operands.size() &&
+           sameOperand(before[entry.keptOperands], operands[entry.keptOperands])) {
+        ++entry.keptOperands;
+    }
+    if (ContentStreamCache::saveOperands(operands, entry.keptOperands, entry.operands)) {
+        entry.graphicsStack = interpreter.getGraphicsStack();
+        cache_.insert(key, std::move(entry));
+    }
+}
+
+void PDFInterpreter::runContentStream(PDFFilter& source, PostScript::PSInterpreter& interpreter) {
     try {
-        std::cout << "=== Executing PDF Content Stream ===" << std::endl;
-        std::cout << "Stream data length: " << streamData.length() << " bytes" << std::endl;
-        
-        // Parse the content stream into tokens
-        std::vector<std::string> tokens = parser_.parseContentStream(streamData);
+        PS_LOG_DEBUG(Page, "Executing content stream");
         
-        std::cout << "Parsed " << tokens.size() << " tokens from content stream" << std::endl;
-        
-        // Execute each token through the PostScript interpreter
-        for (const auto& token : tokens) {
-            std::string psOperator = mapPDFOperatorToPS(token);
+        // Tokens are decoded and executed as they arrive through the pipeline
+        PDFContentTokenizer tokenizer(source);
+        std::string_view token;
+        size_t tokenCount = 0;
+        while (tokenizer.next(token)) {
+            std::string pdfToken(token);
+            std::string psOperator = mapPDFOperatorToPS(pdfToken);
             if (!psOperator.empty()) {
-                std::cout << "Mapping PDF operator '" << token << "' to PS operator '" << psOperator << "'" << std::endl;
-                psInterpreter_.executeToken(psOperator);
+                PS_LOG_TRACE(Exec, "Mapping PDF operator '" << pdfToken << "' to PS operator '" << psOperator << "'");
+                interpreter.executeToken(psOperator);
             } else {
                 // Pass through as-is (numbers, strings, etc.)
-                psInterpreter_.executeToken(token);
+                interpreter.executeToken(pdfToken);
             }
+            ++tokenCount;
         }
         
-        std::cout << "Content stream execution completed" << std::endl;
+        PS_LOG_DEBUG(Page, "Content stream execution completed after " << tokenCount << " tokens");
         
     } catch (const std::exception& e) {
-        std::cerr << "Error executing content stream: " << e.what() << std::endl;
+        PS_LOG_ERROR(Page, "Error executing content stream: " << e.what());
         throw;
     }
 }
@@ -138,52 +357,52 @@ std::string PDFInterpreter::mapPDFOperatorToPS(const std::string& pdfOperator) {
     return "";
 }
 
-void PDFInterpreter::processPage(const PDFObjectPtr& pageObject) {
+void PDFInterpreter::processPage(PDFDocument& document, const PDFObjectPtr& pageObject,
+                                 PostScript::PSInterpreter& interpreter,
+                                 std::unordered_map<int, uint64_t>& resourceHashes) {
+    Profiling::Scope profile(Profiling::Phase::Page);
     if (!pageObject || !pageObject->isDictionary()) {
-        std::cerr << "Invalid page object" << std::endl;
+        throw std::runtime_error("Invalid page object");
+    }
+    
+    // Look for content stream
+    PDFObjectPtr contents = document.resolveKey(pageObject, "Contents");
+    if (!contents) {
         return;
     }
     
-    try {
-        const auto& dict = pageObject->asDictionary();
-        
-        // Look for content stream
-        if (dict.find("Contents") != dict.end()) {
-            auto contents = dict.at("Contents");
-            if (contents->isStream()) {
-                processStream(contents);
-            } else if (contents->isArray()) {
-                // Multiple content streams
-                const auto& array = contents->asArray();
-                for (const auto& stream : array) {
-                    if (stream->isStream()) {
-                        processStream(stream);
-                    }
-                }
-            }
+    // Resources (the page's own or inherited) are part of the cache key: the same bytes can draw differently
+    uint64_t resourcesHash = 0;
+    if (cache_.isEnabled()) {
+        resourcesHash =
+            ContentStreamCache::hashResolved(document, document.resolve(document.findInheritedEntry(pageObject, "Resources")),
+                                             resourceHashes);
+    }
+    
+    if (contents->isStream()) {
+        processStream(contents, resourcesHash, interpreter);
+    } else if (contents->isArray()) {
+        // Multiple content streams
+        for (const auto& stream : contents->getArray()) {
+            processStream(document.resolve(stream), resourcesHash, interpreter);
         }
-        
-    } catch (const std::exception& e) {
-        std::cerr << "Error processing page: " << e.what() << std::endl;
     }
 }
 
-void PDFInterpreter::processStream(const PDFObjectPtr& streamObject) {
+void PDFInterpreter::processStream(const PDFObjectPtr& streamObject, uint64_t resourcesHash,
+                                   PostScript::PSInterpreter& interpreter) {
     if (!streamObject || !streamObject->isStream()) {
-        std::cerr << "Invalid stream object" << std::endl;
-        return;
+        throw std::runtime_error("Invalid stream object");
     }
     
-    try {
-        const auto& stream = streamObject->asStream();
-        std::cout << "Processing stream with " << stream.data.length() << " bytes of data" << std::endl;
-        
-        // Execute the content stream
-        executeContentStream(stream.data);
-        
-    } catch (const std::exception& e) {
-        std::cerr << "Error processing stream: " << e.what() << std::endl;
+    // The key covers the encoded bytes and filter parameters, so a hit skips decoding too
+    const PDFStream& stream = streamObject->getStream();
+    ContentStreamCache::Content content;
+    if (cache_.isEnabled()) {
+        content = ContentStreamCache::hashStream(streamObject);
     }
+    executeContentStream(content, resourcesHash, interpreter,
+                         [&stream]() { return PDFFilter::open(stream); });
 }
 
 } // namespace PDF 
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "pdf_object_stream.h"
+#include "pdf_filters.h"
+#include "pdf_parser.h"
+#include "log.h"
+#include "profiler.h"
+#include <algorithm>
+#include <charconv>
+#include <limits>
+#include <stdexcept>
+
+namespace PDF {
+
+namespace {
+
+// Rough per-allocation overhead of list/map nodes and the stream object
+constexpr size_t NODE_OVERHEAD = 128;
+
+int integerEntry(const PDFDictionary& dict, const char* key) {
+    auto it = dict.find(key);
+    if (it == dict.end() || !it->second->isInteger() || it->second->asInteger() < 0) {
+        throw std::runtime_error(std::string("Object stream has no valid /") + key);
+    }
+    return it->second->asInteger();
+}
+
+bool readNumber(std::string_view data, size_t& pos, size_t& value) {
+    std::string_view token = PDFParser::readKeyword(data, pos);
+    auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+    return !token.empty() && result.ec == std::errc() && result.ptr == token.data() + token.size();
+}
+
+} // namespace
+
+std::shared_ptr<const ObjectStream> ObjectStream::decode(const PDFStream& stream) {
+    const size_t count = static_cast<size_t>(integerEntry(stream.dict, "N"));
+    const size_t first = static_cast<size_t>(integerEntry(stream.dict, "First"));
+
+    auto result = std::make_shared<ObjectStream>();
+    result->data_ = PDFFilter::decodeAll(stream);
+    const std::string_view data = result->data_;
+    if (first > data.size()) {
+        throw std::runtime_error("Object stream /First is beyond its data");
+    }
+
+    // Keep the entries read before any damage in the header
+    const std::string_view header = data.substr(0, first);
+    size_t pos = 0;
+    result->entries_.reserve(std::min(count, first / 4 + 1));
+    for (size_t i = 0; i < count; ++i) {
+        size_t number = 0, offset = 0;
+        if (!readNumber(header, pos, number) || !readNumber(header, pos, offset) ||
+            number > static_cast<size_t>(std::numeric_limits<int>::max()) || offset > data.size() - first) {
+            PS_LOG_DEBUG(Parser, "Object stream header unreadable after " << i << " of " << count << " entries");
+            break;
+        }
+        result->entries_.emplace_back(static_cast<int>(number), first + offset);
+    }
+    if (result->entries_.empty() && count > 0) {
+        throw std::runtime_error("Object stream header is unreadable");
+    }
+    PS_LOG_TRACE(Parser, "Object stream with " << result->entries_.size() << " objects, "
+                 << data.size() << " bytes decoded");
+    return result;
+}
+
+size_t ObjectStream::find(int objectNumber, size_t hint) const {
+    if (hint < entries_.size() && entries_[hint].first == objectNumber) {
+        return hint;
+    }
+    // Some writers get the index wrong; the header is authoritative
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        if (entries_[i].first == objectNumber) {
+            return i;
+        }
+    }
+    return entries_.size();
+}
+
+PDFObjectPtr ObjectStream::parseObject(size_t index) const {
+    Profiling::Scope profile(Profiling::Phase::Object);
+    if (index >= entries_.size()) {
+        return makeObject();
+    }
+    try {
+        size_t pos = entries_[index].second;
+        return PDFParser::parseValue(data_, pos);
+    } catch (const std::exception& e) {
+        PS_LOG_DEBUG(Parser, "Malformed object " << entries_[index].first << " in object stream: " << e.what());
+        return makeObject();
+    }
+}
+
+size_t ObjectStream::memoryUsage() const {
+    return sizeof(ObjectStream) + NODE_OVERHEAD + data_.capacity() +
+           entries_.capacity() * sizeof(entries_[0]);
+}
+
+ObjectStreamCache::ObjectStreamCache(size_t memoryBudget) : memoryBudget_(memoryBudget) {}
+
+std::shared_ptr<const ObjectStream> ObjectStreamCache::get(int streamNumber, const Loader& load) {
+    std::promise<Value> promise;
+    std::shared_future<Value> pending;
+    uint64_t id = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(streamNumber);
+        if (it != index_.end()) {
+            ++stats_.hits;
+            lru_.splice(lru_.begin(), lru_, it->second);
+            pending = it->second->value;
+        } else {
+            ++stats_.decodes;
+            if (memoryBudget_ > 0) {
+                id = ++nextId_;
+                lru_.push_front(Node{streamNumber, id, promise.get_future().share(), 0});
+                index_[streamNumber] = lru_.begin();
+            }
+        }
+    }
+
+    if (pending.valid()) {
+        return pending.get();
+    }
+    if (id == 0) {
+        return load();
+    }
+
+    // Decode outside the lock; requests for the same stream wait on the future
+    Value value;
+    try {
+        value = load();
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(streamNumber);
+        if (it != index_.end() && it->second->id == id) {
+            lru_.erase(it->second);
+            index_.erase(it);
+        }
+        throw;
+    }
+    promise.set_value(value);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(streamNumber);
+    if (it != index_.end() && it->second->id == id) {
+        it->second->bytes = value->memoryUsage();
+        stats_.bytes += it->second->bytes;
+        evictToBudget();
+    }
+    return value;
+}
+
+void ObjectStreamCache::setMemoryBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    memoryBudget_ = bytes;
+    evictToBudget();
+}
+
+size_t ObjectStreamCache::getMemoryBudget() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return memoryBudget_;
+}
+
+ObjectStreamCache::Stats ObjectStreamCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.entries = index_.size();
+    return stats;
+}
+
+void ObjectStreamCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+    stats_.bytes = 0;
+}
+
+void ObjectStreamCache::evictToBudget() {
+    // Streams still being decoded hold no bytes yet; dropping one only
+    // means a later request decodes it again
+    while ((stats_.bytes > memoryBudget_ || memoryBudget_ == 0) && !lru_.empty()) {
+        const Node& victim = lru_.back();
+        stats_.bytes -= victim.bytes;
+        index_.erase(victim.streamNumber);
+        lru_.pop_back();
+        ++stats_.evictions;
+    }
+}
+
+} // namespace PDF
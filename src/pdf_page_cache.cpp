@@ -0,0 +1,365 @@
+#include "pdf_page_cache.h"
+#include "ps_names.h"
+#include <cstring>
+
+namespace PDF {
+
+namespace {
+
+constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+
+inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t finalize(uint64_t h) {
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+inline uint64_t combine(uint64_t h, uint64_t value) {
+    return rotl(h ^ (value * PRIME2), 31) * PRIME1;
+}
+
+inline uint64_t combineDouble(uint64_t h, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return combine(h, bits);
+}
+
+// Rough per-allocation overhead of list/map nodes and vectors
+constexpr size_t NODE_OVERHEAD = 96;
+
+// Seeds the second content hash, so it collides independently of the first
+constexpr uint64_t CHECK_SEED = 0x2545F4914F6CDD1DULL;
+
+// Resource trees are not deeper than this in practice; cycles are cut by the memo
+constexpr int MAX_RESOLVE_DEPTH = 64;
+
+bool isCacheable(PostScript::ObjectType type) {
+    using PostScript::ObjectType;
+    return type == ObjectType::INTEGER || type == ObjectType::REAL || type == ObjectType::BOOLEAN ||
+           type == ObjectType::NAME || type == ObjectType::STRING || type == ObjectType::NULL_OBJECT;
+}
+
+} // namespace
+
+ContentStreamCache::ContentStreamCache(size_t memoryBudget) : memoryBudget_(memoryBudget) {}
+
+std::shared_ptr<const ContentStreamCache::Entry> ContentStreamCache::find(const Key& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        ++stats_.misses;
+        return nullptr;
+    }
+    ++stats_.hits;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->entry;
+}
+
+void ContentStreamCache::insert(const Key& key, Entry entry) {
+    size_t bytes = entrySize(entry);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (bytes > memoryBudget_) {
+        return;
+    }
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        // Another worker stored the same result first
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return;
+    }
+    lru_.push_front(Node{key, std::make_shared<const Entry>(std::move(entry)), bytes});
+    index_[key] = lru_.begin();
+    stats_.bytes += bytes;
+    ++stats_.insertions;
+    evictToBudget();
+}
+
+void ContentStreamCache::setMemoryBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    memoryBudget_ = bytes;
+    evictToBudget();
+}
+
+size_t ContentStreamCache::getMemoryBudget() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return memoryBudget_;
+}
+
+ContentStreamCache::Stats ContentStreamCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.entries = index_.size();
+    return stats;
+}
+
+void ContentStreamCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+    stats_.bytes = 0;
+}
+
+void ContentStreamCache::evictToBudget() {
+    while (stats_.bytes > memoryBudget_ && !lru_.empty()) {
+        const Node& victim = lru_.back();
+        stats_.bytes -= victim.bytes;
+        index_.erase(victim.key);
+        lru_.pop_back();
+        ++stats_.evictions;
+    }
+}
+
+size_t ContentStreamCache::entrySize(const Entry& entry) {
+    size_t bytes = sizeof(Node) + NODE_OVERHEAD + entry.output.capacity();
+    for (const auto& state : entry.graphicsStack) {
+        bytes += sizeof(state) + state.currentPath.memoryUsage();
+    }
+    for (const auto& operand : entry.operands) {
+        bytes += sizeof(operand) + operand.text.capacity();
+    }
+    return bytes;
+}
+
+ContentStreamCache::Content ContentStreamCache::hashContent(std::string_view data) {
+    Content content;
+    content.hash = hashBytes(data);
+    content.check = hashBytes(data, CHECK_SEED);
+    content.length = data.size();
+    return content;
+}
+
+ContentStreamCache::Content ContentStreamCache::hashStream(const PDFObjectPtr& streamObject) {
+    std::string_view data = streamObject->getStream().data.view();
+    Content content;
+    content.hash = hashObject(streamObject);
+    content.check = hashBytes(data, CHECK_SEED);
+    content.length = data.size();
+    return content;
+}
+
+bool ContentStreamCache::hashOperands(const PostScript::PSStack& operands, uint64_t& hash) {
+    using PostScript::ObjectType;
+    const PostScript::NameTable& names = PostScript::NameTable::global();
+    uint64_t h = combine(PRIME3, operands.size());
+    for (size_t i = 0; i < operands.size(); ++i) {
+        const PostScript::PSObject& operand = operands[i];
+        ObjectType type = operand.getType();
+        if (!isCacheable(type)) {
+            return false;
+        }
+        h = combine(h, static_cast<uint64_t>(type));
+        switch (type) {
+            case ObjectType::INTEGER: h = combine(h, static_cast<uint64_t>(operand.asInteger())); break;
+            case ObjectType::REAL: h = combineDouble(h, operand.asReal()); break;
+            case ObjectType::BOOLEAN: h = combine(h, operand.asBoolean() ? 1 : 0); break;
+            case ObjectType::NAME: h = hashBytes(names.name(operand.asName()), h); break;
+            case ObjectType::STRING: h = hashBytes(operand.asString(), h); break;
+            default: break;
+        }
+    }
+    hash = finalize(h);
+    return true;
+}
+
+bool ContentStreamCache::saveOperands(const PostScript::PSStack& operands, size_t first,
+                                      std::vector<Operand>& saved) {
+    using PostScript::ObjectType;
+    saved.clear();
+    for (size_t i = first; i < operands.size(); ++i) {
+        const PostScript::PSObject& operand = operands[i];
+        Operand record;
+        record.type = operand.getType();
+        switch (record.type) {
+            case ObjectType::INTEGER: record.number = operand.asInteger(); break;
+            case ObjectType::REAL: record.number = operand.asReal(); break;
+            case ObjectType::BOOLEAN: record.number = operand.asBoolean() ? 1 : 0; break;
+            case ObjectType::NAME: record.text = PostScript::NameTable::global().name(operand.asName()); break;
+            case ObjectType::STRING: record.text = operand.asString(); break;
+            case ObjectType::NULL_OBJECT: break;
+            default: return false;
+        }
+        saved.push_back(std::move(record));
+    }
+    return true;
+}
+
+void ContentStreamCache::restoreOperands(const std::vector<Operand>& saved, PostScript::PSStack& operands) {
+    using PostScript::ObjectType;
+    using PostScript::PSObject;
+    for (const Operand& record : saved) {
+        switch (record.type) {
+            case ObjectType::INTEGER: operands.push(PSObject(static_cast<int>(record.number))); break;
+            case ObjectType::REAL: operands.push(PSObject(record.number)); break;
+            case ObjectType::BOOLEAN: operands.push(PSObject(record.number != 0)); break;
+            case ObjectType::NAME:
+                operands.push(PSObject(PostScript::PSName{PostScript::NameTable::global().intern(record.text)}));
+                break;
+            case ObjectType::STRING: operands.push(PSObject(record.text)); break;
+            default: operands.push(PSObject()); break;
+        }
+    }
+}
+
+ContentStreamCache::Key ContentStreamCache::makeKey(const Content& content, uint64_t resourcesHash,
+                                                    const std::vector<PostScript::GraphicsState>& graphicsStack,
+                                                    uint64_t operandsHash) {
+    uint64_t h = combine(combine(PRIME1, resourcesHash), operandsHash);
+    h = combine(h, graphicsStack.size());
+    for (const auto& state : graphicsStack) {
+        h = combineDouble(h, state.currentPoint.x);
+        h = combineDouble(h, state.currentPoint.y);
+        for (double m : state.ctm) {
+            h = combineDouble(h, m);
+        }
+        h = combineDouble(h, state.lineWidth);
+        h = combineDouble(h, state.r);
+        h = combineDouble(h, state.g);
+        h = combineDouble(h, state.b);
+        h = combine(h, state.currentPath.size());
+        const PostScript::PSPath::Verb* verbs = state.currentPath.verbs();
+        for (size_t i = 0; i < state.currentPath.size(); ++i) {
+            h = combine(h, static_cast<uint64_t>(verbs[i]));
+        }
+        const PostScript::Point* points = state.currentPath.points();
+        for (size_t i = 0; i < state.currentPath.pointCount(); ++i) {
+            h = combineDouble(h, points[i].x);
+            h = combineDouble(h, points[i].y);
+        }
+    }
+    Key key;
+    key.content = content;
+    key.context = finalize(h);
+    return key;
+}
+
+uint64_t ContentStreamCache::hashBytes(std::string_view data, uint64_t seed) {
+    const char* p = data.data();
+    size_t n = data.size();
+
+    // Four independent lanes over 32-byte blocks keep the multiplies pipelined
+    uint64_t h;
+    if (n >= 32) {
+        uint64_t v[4] = {seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1};
+        const char* end = p + (n & ~size_t(31));
+        for (; p < end; p += 32) {
+            for (int lane = 0; lane < 4; ++lane) {
+                uint64_t word;
+                std::memcpy(&word, p + lane * 8, sizeof(word));
+                v[lane] = rotl(v[lane] + word * PRIME2, 31) * PRIME1;
+            }
+        }
+        h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+    } else {
+        h = seed + PRIME3;
+    }
+    h += data.size();
+
+    for (; p + 8 <= data.data() + n; p += 8) {
+        uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        h = combine(h, word);
+    }
+    uint64_t tail = 0;
+    size_t remaining = static_cast<size_t>(data.data() + n - p);
+    std::memcpy(&tail, p, remaining);
+    h = combine(h, tail ^ remaining);
+    return finalize(h);
+}
+
+uint64_t ContentStreamCache::hashObject(const PDFObjectPtr& object, uint64_t seed) {
+    if (!object) {
+        return combine(seed, 0);
+    }
+    uint64_t h = combine(seed, static_cast<uint64_t>(object->getType()) + 1);
+    switch (object->getType()) {
+        case ObjectType::BOOLEAN:
+            return combine(h, object->asBoolean() ? 1 : 0);
+        case ObjectType::INTEGER:
+            return combine(h, static_cast<uint64_t>(object->asInteger()));
+        case ObjectType::REAL:
+            return combineDouble(h, object->asReal());
+        case ObjectType::STRING:
+            return hashBytes(object->asString().value, h);
+        case ObjectType::NAME:
+            return hashBytes(object->asName().value, h);
+        case ObjectType::ARRAY:
+            for (const auto& element : object->getArray()) {
+                h = hashObject(element, h);
+            }
+            return h;
+        case ObjectType::DICTIONARY:
+            for (const auto& [key, value] : object->getDictionary()) {
+                h = hashObject(value, hashBytes(key, h));
+            }
+            return h;
+        case ObjectType::STREAM: {
+            const PDFStream& stream = object->getStream();
+            for (const auto& [key, value] : stream.dict) {
+                h = hashObject(value, hashBytes(key, h));
+            }
+            return hashBytes(stream.data.view(), h);
+        }
+        case ObjectType::REFERENCE: {
+            const PDFReference ref = object->asReference();
+            return combine(combine(h, static_cast<uint64_t>(ref.objectNumber)), static_cast<uint64_t>(ref.generation));
+        }
+        default:
+            return h;
+    }
+}
+
+uint64_t ContentStreamCache::hashResolved(PDFDocument& document, const PDFObjectPtr& object,
+                                          std::unordered_map<int, uint64_t>& memo) {
+    return hashResolved(document, object, memo, 0, 0);
+}
+
+uint64_t ContentStreamCache::hashResolved(PDFDocument& document, const PDFObjectPtr& object,
+                                          std::unordered_map<int, uint64_t>& memo, uint64_t seed, int depth) {
+    if (!object || depth > MAX_RESOLVE_DEPTH) {
+        return combine(seed, 0);
+    }
+    uint64_t h = combine(seed, static_cast<uint64_t>(object->getType()) + 1);
+    switch (object->getType()) {
+        case ObjectType::ARRAY:
+            for (const auto& element : object->getArray()) {
+                h = hashResolved(document, element, memo, h, depth + 1);
+            }
+            return h;
+        case ObjectType::DICTIONARY:
+            for (const auto& [key, value] : object->getDictionary()) {
+                h = hashResolved(document, value, memo, hashBytes(key, h), depth + 1);
+            }
+            return h;
+        case ObjectType::STREAM: {
+            const PDFStream& stream = object->getStream();
+            for (const auto& [key, value] : stream.dict) {
+                h = hashResolved(document, value, memo, hashBytes(key, h), depth + 1);
+            }
+            return hashBytes(stream.data.view(), h);
+        }
+        case ObjectType::REFERENCE: {
+            const int number = object->asReference().objectNumber;
+            auto it = memo.find(number);
+            if (it == memo.end()) {
+                // A reference back into an object being hashed only contributes its position
+                memo.emplace(number, PRIME2);
+                uint64_t resolved = hashResolved(document, document.getObject(number), memo, 0, depth + 1);
+                it = memo.insert_or_assign(number, resolved).first;
+            }
+            return combine(h, it->second);
+        }
+        default:
+            return hashObject(object, seed);
+    }
+}
+
+} // namespace PDF
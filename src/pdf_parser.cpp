@@ -1,865 +1,789 @@
 #include "pdf_parser.h"
-#include <iostream>
+#include "pdf_file.h"
+#include "pdf_object_stream.h"
+#include "pdf_source.h"
+#include "byte_scan.h"
+#include "log.h"
+#include "profiler.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <functional>
 #include <sstream>
 #include <cctype>
+#include <charconv>
 #include <stdexcept>
-#include <regex>
-#include <zlib.h>
 #include <cstring>
+#include <iterator>
+#include <limits>
+#include <unordered_set>
 
 namespace PDF {
 
-// Forward declaration
-std::string flate_decompress(const std::string& data);
-
-// Helper function to parse xref stream dictionary
-PDFDictionary parseXRefStreamDictionary(const std::string& dictStr) {
-    PDFDictionary dict;
-    
-    // Parse simple key-value pairs (numeric values)
-    std::regex entry_regex(R"(/(\w+)\s+(\d+))");
-    std::smatch match;
-    std::string::const_iterator searchStart(dictStr.cbegin());
-    
-    while (std::regex_search(searchStart, dictStr.cend(), match, entry_regex)) {
-        std::string key = match[1].str();
-        int value = std::stoi(match[2].str());
-        dict[key] = std::make_shared<PDFObject>(value);
-        searchStart = match.suffix().first;
-    }
-    
-    // Parse name values (e.g., /Type /Pages or /Type/Page)
-    std::regex name_regex(R"(/(\w+)\s*/(\w+))");
-    searchStart = dictStr.cbegin();
-    while (std::regex_search(searchStart, dictStr.cend(), match, name_regex)) {
-        std::string key = match[1].str();
-        std::string nameValue = match[2].str();
-        dict[key] = std::make_shared<PDFObject>(PDFName(nameValue));
-        searchStart = match.suffix().first;
+// Helper function to format bytes as hex for log output
+std::string hexBytes(std::string_view bytes) {
+    static const char digits[] = "0123456789ABCDEF";
+    std::string out;
+    out.reserve(bytes.size() * 3);
+    for (unsigned char c : bytes) {
+        out.push_back(digits[c >> 4]);
+        out.push_back(digits[c & 0xF]);
+        out.push_back(' ');
     }
-    
-    // Parse references (e.g., "1 0 R")
-    std::regex ref_regex(R"(/(\w+)\s+(\d+)\s+(\d+)\s+R)");
-    searchStart = dictStr.cbegin();
-    while (std::regex_search(searchStart, dictStr.cend(), match, ref_regex)) {
-        std::string key = match[1].str();
-        int objNum = std::stoi(match[2].str());
-        int gen = std::stoi(match[3].str());
-        dict[key] = std::make_shared<PDFObject>(PDFReference(objNum, gen));
-        searchStart = match.suffix().first;
+    return out;
+}
+
+namespace {
+
+// Byte classes of the lexer; WHITESPACE and TOKEN_END match isWhitespace and isDelimiter
+constexpr ByteScan::ByteSet WHITESPACE(std::string_view(" \t\n\r\f\0", 6));
+constexpr ByteScan::ByteSet TOKEN_END(std::string_view(" \t\n\r\f\0()<>[]{}/%", 16));
+constexpr ByteScan::ByteSet LINE_END("\r\n");
+constexpr ByteScan::ByteSet NEWLINE("\n");
+
+bool parseInteger(std::string_view token, long long& value) {
+    auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+    return !token.empty() && result.ec == std::errc() && result.ptr == token.data() + token.size();
+}
+
+} // namespace
+
+// Parse indirect object at given offset; stream data borrows from the file. Unless
+// objectNumber is negative, a header naming another object or generation is rejected:
+// the xref entry that led here is stale.
+PDFObjectPtr parseIndirectObjectAtOffset(const PDFFileData& file, size_t offset, int objectNumber = -1,
+                                         int generation = -1) {
+    Profiling::Scope profile(Profiling::Phase::Object);
+    std::string_view content = file.view();
+    if (offset >= content.size()) {
+        return makeObject();
     }
     
-    // Parse arrays with references (e.g., "/Kids [4 0 R]")
-    std::regex array_ref_regex(R"(/(\w+)\s+\[([^\]]+)\])");
-    searchStart = dictStr.cbegin();
-    while (std::regex_search(searchStart, dictStr.cend(), match, array_ref_regex)) {
-        std::string key = match[1].str();
-        std::string arrayContent = match[2].str();
-        PDFArray array;
-        
-        // Parse array content for references
-        std::regex ref_in_array_regex(R"((\d+)\s+(\d+)\s+R)");
-        std::string::const_iterator arraySearchStart(arrayContent.cbegin());
-        while (std::regex_search(arraySearchStart, arrayContent.cend(), match, ref_in_array_regex)) {
-            int objNum = std::stoi(match[1].str());
-            int gen = std::stoi(match[2].str());
-            array.push_back(std::make_shared<PDFObject>(PDFReference(objNum, gen)));
-            arraySearchStart = match.suffix().first;
+    try {
+        // Object header: "<number> <generation> obj"
+        size_t pos = offset;
+        long long headerNumber = 0, headerGeneration = 0;
+        if (!parseInteger(PDFParser::readKeyword(content, pos), headerNumber) ||
+            !parseInteger(PDFParser::readKeyword(content, pos), headerGeneration) ||
+            PDFParser::readKeyword(content, pos) != "obj") {
+            PS_LOG_DEBUG(Parser, "No 'obj' found at offset " << offset);
+            return makeObject();
         }
-        
-        if (!array.empty()) {
-            dict[key] = std::make_shared<PDFObject>(array);
+        if (objectNumber >= 0 && (headerNumber != objectNumber || headerGeneration != generation)) {
+            PS_LOG_DEBUG(XRef, "Expected object " << objectNumber << " " << generation << " at offset " << offset
+                         << ", found " << headerNumber << " " << headerGeneration);
+            return makeObject();
         }
-        searchStart = match.suffix().first;
         
-        // Prevent infinite loop by checking if we've moved forward
-        if (searchStart == match.suffix().first) {
-            break;
-        }
-    }
-    
-    // Parse W array specifically
-    std::regex w_regex(R"(/W\s+\[([^\]]+)\])");
-    if (std::regex_search(dictStr, match, w_regex)) {
-        std::string wStr = match[1].str();
-        PDFArray wArray;
-        std::regex num_regex(R"((\d+))");
-        std::string::const_iterator searchStart(wStr.cbegin());
+        PDFParser::skipWhitespace(content, pos);
+        size_t body_start = pos;
+        PDFObjectPtr value = PDFParser::parseValue(content, pos);
         
-        while (std::regex_search(searchStart, wStr.cend(), match, num_regex)) {
-            wArray.push_back(std::make_shared<PDFObject>(std::stoi(match[1].str())));
-            searchStart = match.suffix().first;
+        size_t keyword_pos = pos;
+        if (!value->isDictionary() || PDFParser::readKeyword(content, keyword_pos) != "stream") {
+            PS_LOG_TRACE(Parser, "Regular object: " << content.substr(body_start, std::min<size_t>(100, pos - body_start)) << "...");
+            return value;
         }
-        dict["W"] = std::make_shared<PDFObject>(wArray);
-    }
-    
-    // Parse Index array
-    std::regex index_regex(R"(/Index\s+\[([^\]]+)\])");
-    if (std::regex_search(dictStr, match, index_regex)) {
-        std::string indexStr = match[1].str();
-        PDFArray indexArray;
-        std::regex pair_regex(R"((\d+)\s+(\d+))");
-        std::string::const_iterator searchStart(indexStr.cbegin());
         
-        while (std::regex_search(searchStart, indexStr.cend(), match, pair_regex)) {
-            indexArray.push_back(std::make_shared<PDFObject>(std::stoi(match[1].str())));
-            indexArray.push_back(std::make_shared<PDFObject>(std::stoi(match[2].str())));
-            searchStart = match.suffix().first;
+        // Stream data starts after the EOL that follows "stream"
+        size_t data_start = keyword_pos;
+        if (data_start < content.size() && content[data_start] == '\r') ++data_start;
+        if (data_start < content.size() && content[data_start] == '\n') ++data_start;
+        
+        // Trust a direct /Length when it lands on "endstream"; otherwise scan for it
+        const PDFDictionary& dict = value->getDictionary();
+        size_t data_length = std::string_view::npos;
+        auto lengthIt = dict.find("Length");
+        if (lengthIt != dict.end() && lengthIt->second->isInteger() && lengthIt->second->asInteger() >= 0) {
+            size_t length = static_cast<size_t>(lengthIt->second->asInteger());
+            if (length <= content.size() - data_start) {
+                size_t after = data_start + length;
+                if (PDFParser::readKeyword(content, after) == "endstream") {
+                    data_length = length;
+                }
+            }
         }
-        dict["Index"] = std::make_shared<PDFObject>(indexArray);
+        if (data_length == std::string_view::npos) {
+            size_t data_end = ByteScan::find(content, "endstream", data_start);
+            if (data_end == std::string_view::npos) {
+                PS_LOG_DEBUG(Parser, "No 'endstream' found in stream object");
+                return makeObject();
+            }
+            // The EOL before "endstream" is not part of the data
+            if (data_end > data_start && content[data_end - 1] == '\n') --data_end;
+            if (data_end > data_start && content[data_end - 1] == '\r') --data_end;
+            data_length = data_end - data_start;
+        }
+        
+        PDFBytes stream_data = file.slice(data_start, data_length);
+        PS_LOG_TRACE(Parser, "Stream object with " << stream_data.length() << " bytes of data");
+        
+        PDFStream stream(dict, stream_data);
+        return makeObject(stream);
+    } catch (const std::exception& e) {
+        PS_LOG_DEBUG(Parser, "Malformed object at offset " << offset << ": " << e.what());
+        return makeObject();
     }
-    
-    return dict;
 }
 
-// Helper function to parse Index array from xref stream dictionary
-std::vector<std::pair<int, int>> parseIndexArray(const std::string& dictStr) {
-    std::vector<std::pair<int, int>> index;
-    std::regex index_regex(R"(/Index\s+\[([^\]]+)\])");
-    std::smatch match;
-    
-    if (std::regex_search(dictStr, match, index_regex)) {
-        std::string indexStr = match[1].str();
-        std::regex pair_regex(R"((\d+)\s+(\d+))");
-        std::string::const_iterator searchStart(indexStr.cbegin());
-        
-        while (std::regex_search(searchStart, indexStr.cend(), match, pair_regex)) {
-            int first = std::stoi(match[1].str());
-            int count = std::stoi(match[2].str());
-            index.emplace_back(first, count);
-            searchStart = match.suffix().first;
-        }
+namespace {
+
+bool integerEntry(const PDFDictionary& dict, const char* key, long long& value) {
+    auto it = dict.find(key);
+    if (it == dict.end() || !it->second->isInteger()) {
+        return false;
     }
-    
-    return index;
+    value = it->second->asInteger();
+    return true;
 }
 
-// Helper function to parse W array from xref stream dictionary
-std::vector<int> parseWArray(const std::string& dictStr) {
-    std::vector<int> w;
-    std::regex w_regex(R"(/W\s+\[([^\]]+)\])");
-    std::smatch match;
-    
-    if (std::regex_search(dictStr, match, w_regex)) {
-        std::string wStr = match[1].str();
-        std::regex num_regex(R"((\d+))");
-        std::string::const_iterator searchStart(wStr.cbegin());
-        
-        while (std::regex_search(searchStart, wStr.cend(), match, num_regex)) {
-            w.push_back(std::stoi(match[1].str()));
-            searchStart = match.suffix().first;
+bool hasType(const PDFDictionary& dict, const char* type) {
+    auto it = dict.find("Type");
+    return it != dict.end() && it->second->isName() && it->second->asName().value == type;
+}
+
+// Collects xref sections newest first. An object keeps the entry of the
+// first section that lists it, free entries included, so a deletion in an
+// update hides the older definition. Object numbers above limit are
+// dropped: limit is the file size, which bounds how many objects a file can
+// hold, so a damaged entry cannot make the table outgrow the file.
+class XRefBuilder {
+public:
+    explicit XRefBuilder(long long limit) : limit_(limit) {}
+
+    /**
+     * @param replace Overwrite an earlier entry instead of keeping it
+     */
+    void add(long long objectNumber, const XRefEntry& entry, bool replace = false) {
+        if (objectNumber < 0 || objectNumber > limit_) {
+            PS_LOG_DEBUG(XRef, "Ignoring xref entry for object number " << objectNumber);
+            return;
+        }
+        const size_t index = static_cast<size_t>(objectNumber);
+        if (index >= entries_.size()) {
+            entries_.resize(index + 1);
+            listed_.resize(index + 1, false);
+        }
+        if (replace || !listed_[index]) {
+            entries_[index] = entry;
+            listed_[index] = true;
         }
     }
-    
-    return w;
-}
 
-// Helper function to read big-endian integers from binary data
-uint32_t readBigEndian32(const std::string& data, size_t offset) {
-    if (offset + 3 >= data.size()) return 0;
-    return (static_cast<uint8_t>(data[offset]) << 24) |
-           (static_cast<uint8_t>(data[offset + 1]) << 16) |
-           (static_cast<uint8_t>(data[offset + 2]) << 8) |
-           static_cast<uint8_t>(data[offset + 3]);
-}
+    size_t size() const { return entries_.size(); }
+
+    /**
+     * @brief The finished table, covering the trailer's /Size even where fewer entries were listed
+     */
+    std::vector<XRefEntry> take(const PDFDictionary& trailer) {
+        long long size = 0;
+        if (integerEntry(trailer, "Size", size) && size > static_cast<long long>(entries_.size()) &&
+            size <= limit_ + 1) {
+            entries_.resize(static_cast<size_t>(size));
+        }
+        listed_.clear();
+        return std::move(entries_);
+    }
+
+private:
+    long long limit_;
+    std::vector<XRefEntry> entries_;
+    std::vector<bool> listed_;
+};
 
-uint16_t readBigEndian16(const std::string& data, size_t offset) {
-    if (offset + 1 >= data.size()) return 0;
-    return (static_cast<uint8_t>(data[offset]) << 8) |
-           static_cast<uint8_t>(data[offset + 1]);
+// Big-endian field of an xref stream row
+uint64_t readField(std::string_view data, size_t offset, int width) {
+    uint64_t value = 0;
+    for (int i = 0; i < width; ++i) {
+        value = (value << 8) | static_cast<uint8_t>(data[offset + i]);
+    }
+    return value;
 }
 
-uint8_t readBigEndian8(const std::string& data, size_t offset) {
-    if (offset >= data.size()) return 0;
-    return static_cast<uint8_t>(data[offset]);
+// Classic "xref" table and the trailer after it
+PDFDictionary readXRefTable(std::string_view content, size_t offset, XRefBuilder& xref, size_t& end) {
+    size_t pos = offset;
+    if (PDFParser::readKeyword(content, pos) != "xref") {
+        throw std::runtime_error("no xref table at offset " + std::to_string(offset));
+    }
+    size_t entries = 0;
+    while (true) {
+        std::string_view word = PDFParser::readKeyword(content, pos);
+        if (word == "trailer") {
+            break;
+        }
+        long long first = 0, count = 0;
+        if (!parseInteger(word, first) || !parseInteger(PDFParser::readKeyword(content, pos), count) ||
+            first < 0 || count < 0) {
+            throw std::runtime_error("malformed xref subsection header");
+        }
+        PS_LOG_TRACE(XRef, "xref section: firstObj=" << first << ", count=" << count);
+        for (long long i = 0; i < count; ++i) {
+            long long entryOffset = 0, generation = 0;
+            bool numbers = parseInteger(PDFParser::readKeyword(content, pos), entryOffset) &&
+                           parseInteger(PDFParser::readKeyword(content, pos), generation);
+            std::string_view type = PDFParser::readKeyword(content, pos);
+            if (!numbers || entryOffset < 0 || (type != "n" && type != "f")) {
+                throw std::runtime_error("malformed xref entry for object " + std::to_string(first + i));
+            }
+            xref.add(first + i, type == "n" ? XRefEntry::inUse(static_cast<uint64_t>(entryOffset),
+                                                               static_cast<uint16_t>(generation))
+                                            : XRefEntry());
+        }
+        entries += static_cast<size_t>(count);
+    }
+    PS_LOG_DEBUG(XRef, "Parsed " << entries << " xref table entries at offset " << offset);
+    PDFDictionary trailer = PDFParser::parseDictionary(content, pos);
+    end = pos;
+    return trailer;
 }
 
-// Parse binary xref stream data
-std::map<int, size_t> parseXRefStreamData(const std::string& decompressedData, 
-                                         const PDFDictionary& dict,
-                                         const std::vector<std::pair<int, int>>& index) {
-    std::map<int, size_t> objectOffsets;
-    
-    // Get W array (field widths)
+// Cross-reference stream (PDF 1.5); its dictionary doubles as the trailer
+PDFDictionary readXRefStream(const PDFFileData& file, size_t offset, XRefBuilder& xref, size_t& end) {
+    PDFObjectPtr object = parseIndirectObjectAtOffset(file, offset);
+    if (!object->isStream()) {
+        throw std::runtime_error("no xref stream at offset " + std::to_string(offset));
+    }
+    const PDFStream& stream = object->getStream();
+    end = static_cast<size_t>(stream.data.data() - file.data()) + stream.data.size();
+    const PDFDictionary& dict = stream.dict;
+
     auto wIt = dict.find("W");
-    if (wIt == dict.end()) {
-        std::cout << "[DEBUG] No W array found in xref stream dictionary" << std::endl;
-        return objectOffsets;
+    if (wIt == dict.end() || !wIt->second->isArray() || wIt->second->getArray().size() < 3) {
+        throw std::runtime_error("xref stream has no /W array");
     }
-    
-    if (!wIt->second->isArray()) {
-        std::cout << "[DEBUG] W is not an array" << std::endl;
-        return objectOffsets;
+    int widths[3];
+    for (int i = 0; i < 3; ++i) {
+        const PDFObjectPtr& width = wIt->second->getArray()[i];
+        if (!width->isInteger() || width->asInteger() < 0 || width->asInteger() > 8) {
+            throw std::runtime_error("xref stream has an invalid /W array");
+        }
+        widths[i] = width->asInteger();
     }
-    
-    PDFArray wArray = wIt->second->asArray();
-    if (wArray.size() < 3) {
-        std::cout << "[DEBUG] W array too small: " << wArray.size() << " elements" << std::endl;
-        return objectOffsets;
+    const size_t rowSize = static_cast<size_t>(widths[0] + widths[1] + widths[2]);
+    if (rowSize == 0) {
+        throw std::runtime_error("xref stream has an empty /W array");
     }
-    
-    int typeWidth = wArray[0]->asInteger();
-    int field1Width = wArray[1]->asInteger();
-    int field2Width = wArray[2]->asInteger();
-    
-    std::cout << "[DEBUG] W array: type=" << typeWidth << ", field1=" << field1Width << ", field2=" << field2Width << std::endl;
-    
-    size_t dataOffset = 0;
-    
-    for (const auto& [firstObj, count] : index) {
-        std::cout << "[DEBUG] Processing index entry: firstObj=" << firstObj << ", count=" << count << std::endl;
-        
-        for (int i = 0; i < count; ++i) {
-            int objNum = firstObj + i;
-            
-            if (dataOffset >= decompressedData.size()) {
-                std::cout << "[DEBUG] Reached end of xref stream data" << std::endl;
-                break;
+
+    // /Index lists (first object, count) pairs; it defaults to [0 Size]
+    std::vector<std::pair<long long, long long>> index;
+    auto indexIt = dict.find("Index");
+    if (indexIt != dict.end() && indexIt->second->isArray()) {
+        const PDFArray& indexArray = indexIt->second->getArray();
+        for (size_t i = 0; i + 1 < indexArray.size(); i += 2) {
+            if (indexArray[i]->isInteger() && indexArray[i + 1]->isInteger()) {
+                index.emplace_back(indexArray[i]->asInteger(), indexArray[i + 1]->asInteger());
             }
-            
-            // Read type field
-            int type = 0;
-            if (typeWidth == 1) {
-                type = readBigEndian8(decompressedData, dataOffset);
-            } else if (typeWidth == 2) {
-                type = readBigEndian16(decompressedData, dataOffset);
-            } else if (typeWidth == 4) {
-                type = readBigEndian32(decompressedData, dataOffset);
+        }
+    } else {
+        long long size = 0;
+        if (integerEntry(dict, "Size", size)) {
+            index.emplace_back(0, size);
+        }
+    }
+
+    // Runs the stream's whole /Filter chain, including PNG predictors
+    const std::string data = PDFFilter::decodeAll(stream);
+    PS_LOG_DEBUG(XRef, "Decoded xref stream at offset " << offset << ": " << data.size() << " bytes");
+    PS_LOG_TRACE(XRef, "First 32 bytes: " << hexBytes(std::string_view(data).substr(0, 32)));
+
+    size_t pos = 0;
+    for (const auto& [first, count] : index) {
+        for (long long i = 0; i < count; ++i, pos += rowSize) {
+            if (pos + rowSize > data.size()) {
+                PS_LOG_DEBUG(XRef, "xref stream data ends before its /Index does");
+                return dict;
             }
-            dataOffset += typeWidth;
-            
-            // Read field1 (offset for type 1, object number for type 2)
-            uint32_t field1 = 0;
-            if (field1Width == 1) {
-                field1 = readBigEndian8(decompressedData, dataOffset);
-            } else if (field1Width == 2) {
-                field1 = readBigEndian16(decompressedData, dataOffset);
-            } else if (field1Width == 3) {
-                // 3-byte big-endian integer
-                field1 = (static_cast<uint8_t>(decompressedData[dataOffset]) << 16) |
-                         (static_cast<uint8_t>(decompressedData[dataOffset + 1]) << 8) |
-                         static_cast<uint8_t>(decompressedData[dataOffset + 2]);
-            } else if (field1Width == 4) {
-                field1 = readBigEndian32(decompressedData, dataOffset);
+            // A missing type field means type 1; a missing field 2 means 0
+            const uint64_t type = widths[0] ? readField(data, pos, widths[0]) : 1;
+            const uint64_t field1 = readField(data, pos + widths[0], widths[1]);
+            const uint64_t field2 = readField(data, pos + widths[0] + widths[1], widths[2]);
+            PS_LOG_TRACE(XRef, "Object " << (first + i) << ": type=" << type << ", field1=" << field1
+                         << ", field2=" << field2);
+            switch (type) {
+                case 1:  // In use: field 1 is the offset, field 2 the generation
+                    xref.add(first + i, XRefEntry::inUse(field1, static_cast<uint16_t>(field2)));
+                    break;
+                case 2:  // Compressed: field 1 is the object stream, field 2 the index in it
+                    if (field1 <= static_cast<uint64_t>(PDFDocument::MAX_OBJECT_NUMBER)) {
+                        xref.add(first + i, XRefEntry::compressed(static_cast<int>(field1),
+                                                                  static_cast<uint32_t>(field2)));
+                        break;
+                    }
+                    [[fallthrough]];
+                default:  // Free, or an unknown type, which the spec resolves to null
+                    xref.add(first + i, XRefEntry());
+                    break;
             }
-            dataOffset += field1Width;
-            
-            // Read field2 (generation for type 1, offset for type 2)
-            uint32_t field2 = 0;
-            if (field2Width == 1) {
-                field2 = readBigEndian8(decompressedData, dataOffset);
-            } else if (field2Width == 2) {
-                field2 = readBigEndian16(decompressedData, dataOffset);
-            } else if (field2Width == 3) {
-                field2 = (static_cast<uint8_t>(decompressedData[dataOffset]) << 16) |
-                         (static_cast<uint8_t>(decompressedData[dataOffset + 1]) << 8) |
-                         static_cast<uint8_t>(decompressedData[dataOffset + 2]);
-            } else if (field2Width == 4) {
-                field2 = readBigEndian32(decompressedData, dataOffset);
+        }
+    }
+    return dict;
+}
+
+PDFDictionary readXRefSection(const PDFFileData& file, size_t offset, XRefBuilder& xref, size_t& end) {
+    std::string_view content = file.view();
+    if (offset >= content.size()) {
+        throw std::runtime_error("xref offset " + std::to_string(offset) + " is beyond the end of the file");
+    }
+    size_t probe = offset;
+    if (PDFParser::readKeyword(content, probe) == "xref") {
+        return readXRefTable(content, offset, xref, end);
+    }
+    return readXRefStream(file, offset, xref, end);
+}
+
+// Bytes fetched at an xref section of a sparse file before trying to read it
+constexpr size_t XREF_WINDOW = 64 * 1024;
+
+// Bytes fetched at the end of a sparse file to find startxref
+constexpr size_t TAIL_WINDOW = 4 * 1024;
+
+/**
+ * Read an xref section with read(file, offset, xref, end). A sparse file
+ * only holds what was fetched, so a window at the section is fetched and
+ * widened until the section parses within fetched bytes. Each attempt
+ * fills a copy of the xref, so a misread from a short window leaves
+ * nothing behind.
+ */
+template <typename Read>
+PDFDictionary readFetchedSection(const PDFFileData& file, size_t offset, XRefBuilder& xref, Read read) {
+    size_t end = offset;
+    if (!file.isSparse()) {
+        return read(file, offset, xref, end);
+    }
+    for (size_t window = XREF_WINDOW;; window *= 4) {
+        file.fetch(offset, window);
+        const bool whole = offset >= file.size() || file.isFetched(offset, file.size() - offset);
+        XRefBuilder attempt = xref;
+        try {
+            PDFDictionary section = read(file, offset, attempt, end);
+            if (whole || file.isFetched(offset, end - offset)) {
+                xref = std::move(attempt);
+                return section;
             }
-            dataOffset += field2Width;
-            
-            std::cout << "[DEBUG] Object " << objNum << ": type=" << type << ", field1=" << field1 << ", field2=" << field2 << std::endl;
-            
-            // Type 1: free object, Type 2: in-use object
-            if (type == 1) {
-                // Free object, skip
-                std::cout << "[DEBUG] Free object " << objNum << std::endl;
-            } else if (type == 2) {
-                // In-use object, field1 is offset
-                objectOffsets[objNum] = field1;
-                std::cout << "[DEBUG] In-use object " << objNum << " at offset " << field1 << std::endl;
+        } catch (const std::exception&) {
+            if (whole) {
+                throw;
             }
         }
     }
-    
-    return objectOffsets;
 }
 
-// Parse indirect object at given offset
-PDFObjectPtr parseIndirectObjectAtOffset(const std::string& content, size_t offset) {
-    if (offset >= content.size()) {
-        return std::make_shared<PDFObject>();
+// Offset after the last "startxref", or npos
+size_t findStartXRef(std::string_view content) {
+    size_t pos = content.rfind("startxref");
+    if (pos == std::string_view::npos) {
+        return pos;
     }
-    
-    // Find object boundaries
-    size_t obj_start = content.find("obj", offset);
-    if (obj_start == std::string::npos) {
-        std::cout << "[DEBUG] No 'obj' found at offset " << offset << std::endl;
-        return std::make_shared<PDFObject>();
+    pos += 9;
+    long long offset = 0;
+    if (!parseInteger(PDFParser::readKeyword(content, pos), offset) || offset < 0) {
+        return std::string_view::npos;
     }
-    
-    // Find the start of the object (before "obj")
-    size_t obj_header_start = offset;
-    while (obj_header_start < obj_start && isspace(content[obj_header_start])) {
-        obj_header_start++;
+    return static_cast<size_t>(offset);
+}
+
+/**
+ * Walk the xref sections from the newest (at startxref) back through /Prev.
+ * In a hybrid file a table's /XRefStm stream ranks after the table and
+ * before the older sections. Trailer keys come from the newest trailer that
+ * has them. Returns false if the newest section is unreadable; a broken
+ * older link ends the chain with what was read so far.
+ */
+bool readXRefChain(const PDFFileData& file, size_t start, XRefBuilder& xref, PDFDictionary& trailer) {
+    std::unordered_set<size_t> visited;
+    size_t offset = start;
+    while (true) {
+        if (!visited.insert(offset).second) {
+            PS_LOG_WARNING(XRef, "xref chain loops back to offset " << offset);
+            return true;
+        }
+
+        PDFDictionary section;
+        try {
+            section = readFetchedSection(file, offset, xref, readXRefSection);
+        } catch (const std::exception& e) {
+            if (offset == start) {
+                PS_LOG_DEBUG(XRef, "xref at startxref unreadable: " << e.what());
+                return false;
+            }
+            PS_LOG_WARNING(XRef, "Ignoring xref sections from offset " << offset << " on: " << e.what());
+            return true;
+        }
+
+        long long value = 0;
+        if (integerEntry(section, "XRefStm", value) && value >= 0 &&
+            visited.insert(static_cast<size_t>(value)).second) {
+            try {
+                readFetchedSection(file, static_cast<size_t>(value), xref, readXRefStream);
+            } catch (const std::exception& e) {
+                PS_LOG_WARNING(XRef, "Ignoring /XRefStm at offset " << value << ": " << e.what());
+            }
+        }
+        trailer.insert(section.begin(), section.end());
+
+        if (!integerEntry(section, "Prev", value) || value < 0) {
+            return true;
+        }
+        offset = static_cast<size_t>(value);
     }
-    
-    // Find object end
-    size_t obj_end = content.find("endobj", obj_start);
-    if (obj_end == std::string::npos) {
-        std::cout << "[DEBUG] No 'endobj' found for object at offset " << offset << std::endl;
-        return std::make_shared<PDFObject>();
+}
+
+// Whether pos starts "<number> <generation> obj" for the given object
+bool isObjectHeader(std::string_view content, size_t pos, int objectNumber) {
+    long long number = 0, generation = 0;
+    return parseInteger(PDFParser::readKeyword(content, pos), number) && number == objectNumber &&
+           parseInteger(PDFParser::readKeyword(content, pos), generation) &&
+           PDFParser::readKeyword(content, pos) == "obj";
+}
+
+// Cheap check that the trailer's /Root is where the xref says, without parsing it
+bool rootLooksValid(const PDFDocument& document) {
+    const int root = document.rootObjectNumber;
+    if (root <= 0 || static_cast<size_t>(root) >= document.xref.size()) {
+        return false;
     }
-    
-    // Extract object content
-    std::string obj_content = content.substr(obj_start + 3, obj_end - obj_start - 3);
-    
-    // Skip whitespace after "obj"
-    size_t content_start = 0;
-    while (content_start < obj_content.size() && isspace(obj_content[content_start])) {
-        content_start++;
+    const XRefEntry& entry = document.xref[root];
+    switch (entry.type) {
+        case XRefEntry::Type::InUse:
+            if (document.extents) {
+                document.extents->fetch(*document.file, entry.offset);
+            }
+            return entry.offset < document.file->view().size() &&
+                   isObjectHeader(document.file->view(), static_cast<size_t>(entry.offset), root);
+        case XRefEntry::Type::Compressed:
+            return true;
+        case XRefEntry::Type::Free:
+            break;
     }
-    
-    // Check if it's a stream object
-    size_t stream_pos = obj_content.find("stream", content_start);
-    if (stream_pos != std::string::npos) {
-        // Parse stream object
-        std::string dict_str = obj_content.substr(content_start, stream_pos - content_start);
-        size_t stream_data_start = stream_pos + 6;
-        
-        // Skip newlines after "stream"
-        while (stream_data_start < obj_content.size() && 
-               (obj_content[stream_data_start] == '\r' || obj_content[stream_data_start] == '\n')) {
-            stream_data_start++;
+    return false;
+}
+
+void readDocumentReferences(PDFDocument& document) {
+    document.rootObjectNumber = 0;
+    document.infoObjectNumber = 0;
+    auto rootIt = document.trailer.find("Root");
+    if (rootIt != document.trailer.end() && rootIt->second->isReference()) {
+        document.rootObjectNumber = rootIt->second->asReference().objectNumber;
+    }
+    auto infoIt = document.trailer.find("Info");
+    if (infoIt != document.trailer.end() && infoIt->second->isReference()) {
+        document.infoObjectNumber = infoIt->second->asReference().objectNumber;
+    }
+    document.catalogObjectNumber = document.rootObjectNumber;
+}
+
+// If "obj" at pos ends an object header, the header's start, number and generation
+bool objectHeaderBefore(std::string_view content, size_t pos, size_t& start, long long& number,
+                        long long& generation) {
+    if (pos + 3 < content.size() && !PDFParser::isWhitespace(content[pos + 3]) &&
+        !PDFParser::isDelimiter(content[pos + 3])) {
+        return false;
+    }
+    // Walk back over "<number> <generation> "
+    auto digitsBefore = [&content](size_t& p, long long& value) {
+        size_t end = p;
+        while (p > 0 && end - p < 10 && std::isdigit(static_cast<unsigned char>(content[p - 1]))) {
+            --p;
         }
-        
-        size_t stream_data_end = obj_content.find("endstream", stream_data_start);
-        if (stream_data_end == std::string::npos) {
-            std::cout << "[DEBUG] No 'endstream' found in stream object" << std::endl;
-            return std::make_shared<PDFObject>();
+        return p < end && parseInteger(content.substr(p, end - p), value);
+    };
+    auto whitespaceBefore = [&content](size_t& p) {
+        size_t end = p;
+        while (p > 0 && PDFParser::isWhitespace(content[p - 1])) {
+            --p;
         }
-        
-        std::string stream_data = obj_content.substr(stream_data_start, stream_data_end - stream_data_start);
-        
-        // Parse dictionary (simplified)
-        PDFDictionary dict = parseXRefStreamDictionary(dict_str);
-        std::cout << "[DEBUG] Stream object with " << stream_data.length() << " bytes of data" << std::endl;
-        
-        PDFStream stream(dict, stream_data);
-        return std::make_shared<PDFObject>(stream);
-    } else {
-        // Parse regular object content
-        std::string obj_str = obj_content.substr(content_start);
-        std::cout << "[DEBUG] Regular object: " << obj_str.substr(0, 100) << "..." << std::endl;
-        
-        // Try to parse as different object types
-        std::string trimmed = obj_str;
-        // Remove leading/trailing whitespace
-        trimmed.erase(0, trimmed.find_first_not_of(" \t\r\n"));
-        trimmed.erase(trimmed.find_last_not_of(" \t\r\n") + 1);
-        
-        if (trimmed.empty()) {
-            return std::make_shared<PDFObject>();
+        return p < end;
+    };
+    size_t p = pos;
+    if (!whitespaceBefore(p) || !digitsBefore(p, generation) || !whitespaceBefore(p) || !digitsBefore(p, number)) {
+        return false;
+    }
+    if (p > 0 && !PDFParser::isWhitespace(content[p - 1]) && !PDFParser::isDelimiter(content[p - 1])) {
+        return false;
+    }
+    start = p;
+    return true;
+}
+
+/**
+ * Rebuild the xref of a damaged file from one pass over its "N G obj"
+ * headers; later definitions replace earlier ones, as in an incremental
+ * update. Every object is then parsed once to index object streams, to
+ * collect xref stream dictionaries as trailers and, if no trailer names a
+ * usable /Root, to find the catalog. Needs the document's loader and
+ * object stream cache installed.
+ */
+void reconstructXRef(PDFDocument& document, long long limit) {
+    // The whole file is scanned, so a sparse file is fetched in full
+    document.file->fetch(0, document.file->size());
+    std::string_view content = document.file->view();
+    XRefBuilder builder(limit);
+    size_t headers = 0;
+    for (size_t pos = ByteScan::find(content, "obj"); pos != std::string_view::npos;
+         pos = ByteScan::find(content, "obj", pos + 3)) {
+        size_t start = 0;
+        long long number = 0, generation = 0;
+        if (objectHeaderBefore(content, pos, start, number, generation)) {
+            builder.add(number, XRefEntry::inUse(start, static_cast<uint16_t>(generation)), true);
+            ++headers;
         }
-        
-        // Check if it's a dictionary (starts with <<)
-        if (trimmed.substr(0, 2) == "<<") {
-            std::cout << "[DEBUG] Parsing as dictionary: " << trimmed.substr(0, 100) << "..." << std::endl;
-            PDFDictionary dict = parseXRefStreamDictionary(trimmed);
-            std::cout << "[DEBUG] Dictionary parsed with " << dict.size() << " entries" << std::endl;
-            return std::make_shared<PDFObject>(dict);
+    }
+    PS_LOG_INFO(XRef, "Reconstructed xref from " << headers << " object headers");
+
+    // Candidate trailers with their file position; later ones are newer
+    std::vector<std::pair<size_t, PDFDictionary>> trailers;
+    for (size_t pos = ByteScan::find(content, "trailer"); pos != std::string_view::npos;
+         pos = ByteScan::find(content, "trailer", pos + 7)) {
+        size_t dictPos = pos + 7;
+        try {
+            trailers.emplace_back(pos, PDFParser::parseDictionary(content, dictPos));
+        } catch (const std::exception&) {
+            // Not a trailer after all
         }
-        
-        // Check if it's an array (starts with [)
-        if (trimmed[0] == '[') {
-            // Simple array parsing - just return as string for now
-            return std::make_shared<PDFObject>(PDFString(trimmed));
+    }
+
+    document.xref = builder.take(PDFDictionary());
+    const size_t directCount = document.xref.size();
+    for (size_t i = 0; i < directCount; ++i) {
+        if (document.xref[i].type != XRefEntry::Type::InUse) {
+            continue;
         }
-        
-        // Check if it's a number
-        if (std::isdigit(trimmed[0]) || trimmed[0] == '-' || trimmed[0] == '+') {
+        PDFObjectPtr object = document.getObject(static_cast<int>(i));
+        if (!object || !object->isStream()) {
+            continue;
+        }
+        const PDFStream& stream = object->getStream();
+        if (hasType(stream.dict, "XRef")) {
+            trailers.emplace_back(static_cast<size_t>(document.xref[i].offset), stream.dict);
+        } else if (hasType(stream.dict, "ObjStm")) {
+            // Directly stored objects win over copies in object streams
             try {
-                if (trimmed.find('.') != std::string::npos) {
-                    double value = std::stod(trimmed);
-                    return std::make_shared<PDFObject>(value);
-                } else {
-                    int value = std::stoi(trimmed);
-                    return std::make_shared<PDFObject>(value);
+                std::shared_ptr<const ObjectStream> decoded = ObjectStream::decode(stream);
+                document.objectStreams->get(static_cast<int>(i), [&decoded] { return decoded; });
+                for (size_t index = 0; index < decoded->size(); ++index) {
+                    const size_t number = static_cast<size_t>(decoded->objectNumber(index));
+                    if (number >= document.xref.size() && number <= static_cast<size_t>(limit)) {
+                        document.xref.resize(number + 1);
+                    }
+                    if (number < document.xref.size() && document.xref[number].type == XRefEntry::Type::Free) {
+                        document.xref[number] = XRefEntry::compressed(static_cast<int>(i), static_cast<uint32_t>(index));
+                    }
                 }
-            } catch (...) {
-                // Not a number, continue
+            } catch (const std::exception& e) {
+                PS_LOG_DEBUG(XRef, "Skipping unreadable object stream " << i << ": " << e.what());
             }
         }
-        
-        // Check if it's a boolean
-        if (trimmed == "true") {
-            return std::make_shared<PDFObject>(true);
-        }
-        if (trimmed == "false") {
-            return std::make_shared<PDFObject>(false);
-        }
-        
-        // Check if it's null
-        if (trimmed == "null") {
-            return std::make_shared<PDFObject>();
+    }
+
+    // Newest trailer first; keys it lacks come from older ones, then from the damaged chain
+    std::stable_sort(trailers.begin(), trailers.end(),
+                     [](const auto& a, const auto& b) { return a.first > b.first; });
+    PDFDictionary trailer;
+    for (const auto& candidate : trailers) {
+        trailer.insert(candidate.second.begin(), candidate.second.end());
+    }
+    trailer.insert(document.trailer.begin(), document.trailer.end());
+    document.trailer = std::move(trailer);
+    readDocumentReferences(document);
+
+    PDFObjectPtr root = document.getObject(document.rootObjectNumber);
+    if (root && root->isDictionary()) {
+        return;
+    }
+    // No usable /Root: take the last catalog in the table
+    int catalog = 0;
+    for (size_t i = 0; i < document.xref.size(); ++i) {
+        PDFObjectPtr object = document.xref[i].type != XRefEntry::Type::Free ? document.getObject(static_cast<int>(i))
+                                                                           : nullptr;
+        if (object && object->isDictionary() && hasType(object->getDictionary(), "Catalog")) {
+            catalog = static_cast<int>(i);
         }
-        
-        // Check if it's a name (starts with /)
-        if (trimmed[0] == '/') {
-            return std::make_shared<PDFObject>(PDFName(trimmed.substr(1)));
+    }
+    if (catalog > 0) {
+        PS_LOG_INFO(XRef, "Using object " << catalog << " as the catalog");
+        document.trailer["Root"] = makeObject(PDFReference(catalog, 0));
+        readDocumentReferences(document);
+    }
+}
+
+// Xref slots handed to a thread at a time; neighbouring objects tend to share an object stream
+constexpr size_t OBJECTS_PER_TASK = 256;
+
+size_t threadsFor(size_t requested, size_t items) {
+    size_t threads = requested > 0 ? requested : Threading::ThreadPool::hardwareThreads();
+    return std::max<size_t>(std::min(threads, items), 1);
+}
+
+// Run fn(index) for every index in [0, count) on threads threads, the caller included
+void runParallel(size_t threads, size_t count, const std::function<void(size_t)>& fn) {
+    if (threads <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            fn(i);
         }
-        
-        // Check if it's a reference (ends with R)
-        if (trimmed.back() == 'R') {
-            std::regex ref_regex(R"((\d+)\s+(\d+)\s+R)");
-            std::smatch match;
-            if (std::regex_match(trimmed, match, ref_regex)) {
-                int objNum = std::stoi(match[1].str());
-                int gen = std::stoi(match[2].str());
-                return std::make_shared<PDFObject>(PDFReference(objNum, gen));
+        return;
+    }
+    Threading::ThreadPool pool(threads - 1);
+    pool.parallelFor(count, [&fn](size_t index, size_t) { fn(index); });
+}
+
+// Parse every object the xref locates; each range only writes its own slots
+void loadObjects(PDFDocument& document, size_t requestedThreads) {
+    const size_t count = document.xref.size();
+    const size_t tasks = (count + OBJECTS_PER_TASK - 1) / OBJECTS_PER_TASK;
+    runParallel(threadsFor(requestedThreads, tasks), tasks, [&document, count](size_t task) {
+        const size_t end = std::min(count, (task + 1) * OBJECTS_PER_TASK);
+        for (size_t i = task * OBJECTS_PER_TASK; i < end; ++i) {
+            if (document.xref[i].type != XRefEntry::Type::Free) {
+                document.getObject(static_cast<int>(i));
             }
         }
-        
-        // Default: treat as string
-        return std::make_shared<PDFObject>(PDFString(trimmed));
+    });
+}
+
+void appendTokens(const PDFObjectPtr& streamObject, std::vector<std::string>& tokens) {
+    if (!streamObject || !streamObject->isStream()) {
+        throw std::runtime_error("Invalid stream object");
+    }
+    std::unique_ptr<PDFFilter> source = PDFFilter::open(streamObject->getStream());
+    PDFContentTokenizer tokenizer(*source);
+    std::string_view token;
+    while (tokenizer.next(token)) {
+        tokens.emplace_back(token);
     }
 }
 
+} // namespace
+
 PDFParser::PDFParser() {
     // Constructor
 }
 
 PDFDocument PDFParser::parseFile(const std::string& filename) {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file.is_open()) {
-        throw std::runtime_error("Cannot open PDF file: " + filename);
+    // Map (or read once) a local file; a URL is fetched piecemeal as it is parsed
+    if (PDFByteSource::isURL(filename)) {
+        return parseSource(PDFByteSource::open(filename), filename);
     }
+    return parseData(PDFFileData::open(filename, memoryMapped_), filename);
+}
+
+PDFDocument PDFParser::parseSource(std::shared_ptr<PDFByteSource> source, const std::string& name) {
+    return parseData(PDFFileData::fromSource(std::move(source)), name);
+}
 
+PDFDocument PDFParser::parseData(std::shared_ptr<const PDFFileData> file, const std::string& filename) {
+    // Everything below works on views of the file
     PDFDocument document;
+    document.file = file;
+    document.arena = Memory::ArenaRef::create();
+    Memory::ArenaScope scope(document.arena.get());
     try {
-        std::cout << "[DEBUG] Parsing PDF file: " << filename << std::endl;
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        std::string content = buffer.str();
-        std::cout << "[DEBUG] File size: " << content.length() << " bytes" << std::endl;
+        PS_LOG_DEBUG(Parser, "Parsing PDF file: " << filename);
+        std::string_view content = file->view();
+        PS_LOG_DEBUG(Parser, "File size: " << content.length() << " bytes"
+                     << (file->isMapped() ? " (memory-mapped)" : file->isSparse() ? " (fetched on demand)" : ""));
+        file->fetch(0, TAIL_WINDOW);
         if (content.substr(0, 4) != "%PDF") {
             throw std::runtime_error("Invalid PDF file: missing PDF header");
         }
-        std::cout << "[DEBUG] PDF header found" << std::endl;
-
-        // --- Locate startxref ---
-        size_t startxref_pos = content.rfind("startxref");
-        if (startxref_pos == std::string::npos) {
-            throw std::runtime_error("No startxref found in PDF");
-        }
-        size_t xref_offset_start = startxref_pos + 9;
-        while (xref_offset_start < content.size() && isspace(content[xref_offset_start])) ++xref_offset_start;
-        size_t xref_offset_end = xref_offset_start;
-        while (xref_offset_end < content.size() && isdigit(content[xref_offset_end])) ++xref_offset_end;
-        std::string xref_offset_str = content.substr(xref_offset_start, xref_offset_end - xref_offset_start);
-        size_t xref_offset = std::stoul(xref_offset_str);
-        std::cout << "[DEBUG] startxref at offset: " << xref_offset << std::endl;
-
-        // --- Parse xref table or xref stream ---
-        size_t xref_table_pos = content.find("xref", xref_offset);
-        bool is_xref_stream = false;
-        std::map<int, size_t> objectOffsets;
-        
-        // Check if the offset points to an indirect object (xref stream)
-        std::regex obj_regex(R"((\d+) (\d+) obj[\s\S]*?stream[\s\S]*?endstream[\s\S]*?endobj)");
-        std::smatch match;
-        std::string xref_area = content.substr(xref_offset, std::min(size_t(1000), content.size() - xref_offset));
-        if (std::regex_search(xref_area, match, obj_regex)) {
-            is_xref_stream = true;
-            std::cout << "[DEBUG] Detected xref stream at offset: " << xref_offset << std::endl;
-            std::string xref_obj_str = match.str(0);
-            std::cout << "[DEBUG] xref stream object (truncated):\n" << xref_obj_str.substr(0, 200) << "..." << std::endl;
-            
-            // Extract stream dictionary
-            size_t dict_start = xref_obj_str.find("<<");
-            size_t dict_end = xref_obj_str.find(">>", dict_start);
-            std::string dict_str = xref_obj_str.substr(dict_start, dict_end + 2 - dict_start);
-            std::cout << "[DEBUG] xref stream dictionary: " << dict_str << std::endl;
-            
-            // Parse xref stream dictionary
-            PDFDictionary xrefDict = parseXRefStreamDictionary(dict_str);
-            std::vector<std::pair<int, int>> index;
-            
-            // Parse Index array from dictionary
-            auto indexIt = xrefDict.find("Index");
-            if (indexIt != xrefDict.end() && indexIt->second->isArray()) {
-                PDFArray indexArray = indexIt->second->asArray();
-                for (size_t i = 0; i < indexArray.size(); i += 2) {
-                    if (i + 1 < indexArray.size()) {
-                        int first = indexArray[i]->asInteger();
-                        int count = indexArray[i + 1]->asInteger();
-                        index.emplace_back(first, count);
-                    }
-                }
-            } else {
-                // If no Index, default to [0 Size]
-                auto sizeIt = xrefDict.find("Size");
-                if (sizeIt != xrefDict.end() && sizeIt->second->isInteger()) {
-                    int size = sizeIt->second->asInteger();
-                    index.emplace_back(0, size);
+        PS_LOG_DEBUG(Parser, "PDF header found");
+
+        // --- Xref sections from startxref back through /Prev ---
+        Profiling::Scope xrefProfile(Profiling::Phase::XRef);
+        const long long objectLimit = std::min<long long>(PDFDocument::MAX_OBJECT_NUMBER,
+                                                          static_cast<long long>(content.size()));
+        XRefBuilder xref(objectLimit);
+        PDFDictionary trailer;
+        file->fetch(content.size() - std::min(content.size(), TAIL_WINDOW), TAIL_WINDOW);
+        const size_t startxref = findStartXRef(content);
+        PS_LOG_DEBUG(Parser, "startxref at offset: " << startxref);
+        const bool chained = startxref != std::string_view::npos && readXRefChain(*file, startxref, xref, trailer);
+        document.trailer = std::move(trailer);
+        document.xref = xref.take(document.trailer);
+        readDocumentReferences(document);
+
+        // --- Resolver: objects are parsed from their xref offset (or their object stream) on first use ---
+        if (file->isSparse()) {
+            // Objects end where the next one (or the xref) starts
+            std::vector<uint64_t> offsets;
+            for (const XRefEntry& entry : document.xref) {
+                if (entry.type == XRefEntry::Type::InUse) {
+                    offsets.push_back(entry.offset);
                 }
             }
-            
-            std::vector<int> wArray = parseWArray(dict_str);
-            
-            std::cout << "[DEBUG] Parsed " << index.size() << " index entries" << std::endl;
-            std::cout << "[DEBUG] W array has " << wArray.size() << " elements" << std::endl;
-            
-            // Extract stream data
-            size_t stream_start = xref_obj_str.find("stream", dict_end) + 6;
-            size_t stream_end = xref_obj_str.find("endstream", stream_start);
-            std::string stream_data = xref_obj_str.substr(stream_start, stream_end - stream_start);
-            // Remove leading newlines/spaces
-            stream_data.erase(0, stream_data.find_first_not_of("\r\n "));
-            std::cout << "[DEBUG] xref stream data length: " << stream_data.length() << std::endl;
-            
-            // Check for /Filter /FlateDecode
-            if (dict_str.find("/Filter /FlateDecode") != std::string::npos) {
-                std::cout << "[DEBUG] Decompressing xref stream with FlateDecode..." << std::endl;
-                try {
-                    std::string decompressed = flate_decompress(stream_data);
-                    std::cout << "[DEBUG] Decompressed xref stream length: " << decompressed.length() << std::endl;
-                    std::cout << "[DEBUG] First 32 bytes: ";
-                    for (size_t i = 0; i < std::min<size_t>(32, decompressed.size()); ++i) {
-                        printf("%02X ", (unsigned char)decompressed[i]);
-                    }
-                    std::cout << std::endl;
-                    
-                    // Parse binary xref data with enhanced debug
-                    objectOffsets.clear();
-                    // Get W array (field widths)
-                    auto wIt = xrefDict.find("W");
-                    if (wIt == xrefDict.end() || !wIt->second->isArray()) {
-                        std::cout << "[DEBUG] No W array found in xref stream dictionary" << std::endl;
-                    } else {
-                        PDFArray wArrayObj = wIt->second->asArray();
-                        int typeWidth = wArrayObj[0]->asInteger();
-                        int field1Width = wArrayObj[1]->asInteger();
-                        int field2Width = wArrayObj[2]->asInteger();
-                        size_t dataOffset = 0;
-                        for (const auto& [firstObj, count] : index) {
-                            for (int i = 0; i < count; ++i) {
-                                int objNum = firstObj + i;
-                                // Print raw bytes for this entry
-                                std::cout << "[DEBUG] Entry bytes for object " << objNum << ": ";
-                                for (int b = 0; b < typeWidth + field1Width + field2Width; ++b) {
-                                    if (dataOffset + b < decompressed.size())
-                                        printf("%02X ", (unsigned char)decompressed[dataOffset + b]);
-                                }
-                                std::cout << std::endl;
-                                // Read type
-                                int type = 0;
-                                if (typeWidth == 1) type = readBigEndian8(decompressed, dataOffset);
-                                else if (typeWidth == 2) type = readBigEndian16(decompressed, dataOffset);
-                                else if (typeWidth == 4) type = readBigEndian32(decompressed, dataOffset);
-                                dataOffset += typeWidth;
-                                // Read field1 (offset for type 1, object stream obj num for type 2)
-                                uint32_t field1 = 0;
-                                if (field1Width == 1) field1 = readBigEndian8(decompressed, dataOffset);
-                                else if (field1Width == 2) field1 = readBigEndian16(decompressed, dataOffset);
-                                else if (field1Width == 3) {
-                                    // 3-byte big-endian integer
-                                    field1 = (static_cast<uint8_t>(decompressed[dataOffset]) << 16) |
-                                             (static_cast<uint8_t>(decompressed[dataOffset + 1]) << 8) |
-                                             static_cast<uint8_t>(decompressed[dataOffset + 2]);
-                                } else if (field1Width == 4) field1 = readBigEndian32(decompressed, dataOffset);
-                                dataOffset += field1Width;
-                                // Read field2 (generation for type 1, index in object stream for type 2)
-                                uint32_t field2 = 0;
-                                if (field2Width == 1) field2 = readBigEndian8(decompressed, dataOffset);
-                                else if (field2Width == 2) field2 = readBigEndian16(decompressed, dataOffset);
-                                else if (field2Width == 3) {
-                                    field2 = (static_cast<uint8_t>(decompressed[dataOffset]) << 16) |
-                                             (static_cast<uint8_t>(decompressed[dataOffset + 1]) << 8) |
-                                             static_cast<uint8_t>(decompressed[dataOffset + 2]);
-                                } else if (field2Width == 4) field2 = readBigEndian32(decompressed, dataOffset);
-                                dataOffset += field2Width;
-                                // PDF spec: type 0 = free, type 1 = in-use (uncompressed), type 2 = compressed
-                                std::cout << "[DEBUG] Object " << objNum << ": type=" << type << ", field1=" << field1 << ", field2=" << field2 << std::endl;
-                                if (type == 0) {
-                                    // Free object
-                                    std::cout << "[DEBUG] Free object " << objNum << std::endl;
-                                } else if (type == 1) {
-                                    // In-use, field1 = offset, field2 = generation
-                                    objectOffsets[objNum] = field1;
-                                    std::cout << "[DEBUG] In-use object " << objNum << " at offset " << field1 << ", generation " << field2 << std::endl;
-                                } else if (type == 2) {
-                                    // Compressed object, skip for now
-                                    std::cout << "[DEBUG] Compressed object " << objNum << " in object stream " << field1 << ", index " << field2 << std::endl;
-                                } else {
-                                    std::cout << "[DEBUG] Unknown xref entry type: " << type << std::endl;
-                                }
-                            }
-                        }
-                    }
-                    std::cout << "[DEBUG] Extracted " << objectOffsets.size() << " object offsets from xref stream" << std::endl;
-                    
-                    // Use the xref stream dictionary as the trailer
-                    document.trailer = xrefDict;
-                    // Extract root object number
-                    auto rootIt = document.trailer.find("Root");
-                    if (rootIt != document.trailer.end() && rootIt->second->isReference()) {
-                        document.rootObjectNumber = rootIt->second->asReference().objectNumber;
-                        std::cout << "[DEBUG] Root object number: " << document.rootObjectNumber << std::endl;
-                    }
-                } catch (const std::exception& e) {
-                    std::cout << "[DEBUG] FlateDecode failed: " << e.what() << std::endl;
-                }
+            if (startxref != std::string_view::npos) {
+                offsets.push_back(startxref);
             }
+            document.extents = std::make_shared<const PDFObjectExtents>(std::move(offsets), content.size());
         }
-        
-        if (!is_xref_stream) {
-            // Fallback to classic xref parsing
-            if (xref_table_pos == std::string::npos) {
-                throw std::runtime_error("xref table not found at expected offset");
-            }
-            std::cout << "[DEBUG] xref table found at: " << xref_table_pos << std::endl;
-            
-            // Debug: Show content around xref table
-            size_t debug_start = std::max(xref_table_pos - 20, size_t(0));
-            size_t debug_end = std::min(xref_table_pos + 200, content.size());
-            std::string debug_content = content.substr(debug_start, debug_end - debug_start);
-            std::cout << "[DEBUG] Content around xref table:" << std::endl;
-            std::cout << debug_content << std::endl;
-            std::cout << "[DEBUG] End of debug content" << std::endl;
-
-            // Parse xref entries
-            size_t line_start = content.find("\n", xref_table_pos) + 1;
-            if (line_start == std::string::npos) line_start = content.find("\r\n", xref_table_pos) + 2;
-            std::cout << "[DEBUG] Starting xref parsing at position: " << line_start << std::endl;
-            
-            while (line_start < content.size()) {
-                // Read section header (e.g., "0 6")
-                size_t line_end = content.find("\n", line_start);
-                if (line_end == std::string::npos) line_end = content.find("\r\n", line_start);
-                if (line_end == std::string::npos) break;
-                
-                std::string line = content.substr(line_start, line_end - line_start);
-                std::cout << "[DEBUG] xref line: '" << line << "'" << std::endl;
-                
-                if (line.find("trailer") != std::string::npos) {
-                    std::cout << "[DEBUG] Found trailer, stopping xref parsing" << std::endl;
-                    break;
-                }
-                
-                std::istringstream iss(line);
-                int firstObj = 0, count = 0;
-                if (!(iss >> firstObj >> count)) {
-                    std::cout << "[DEBUG] Skipping non-section-header line" << std::endl;
-                    line_start = line_end + 1;
-                    continue;
-                }
-                
-                std::cout << "[DEBUG] xref section: firstObj=" << firstObj << ", count=" << count << std::endl;
-                
-                // Read count lines of xref entries
-                for (int i = 0; i < count; ++i) {
-                    line_start = line_end + 1;
-                    line_end = content.find("\n", line_start);
-                    if (line_end == std::string::npos) line_end = content.find("\r\n", line_start);
-                    if (line_end == std::string::npos) break;
-                    
-                    std::string entry = content.substr(line_start, line_end - line_start);
-                    std::cout << "[DEBUG] xref entry " << (firstObj + i) << ": '" << entry << "'" << std::endl;
-                    
-                    if (entry.length() < 18) {
-                        std::cout << "[DEBUG] Entry too short, skipping" << std::endl;
-                        continue;
-                    }
-                    
-                    try {
-                        size_t offset = std::stoul(entry.substr(0, 10));
-                        char inuse = entry[17];
-                        std::cout << "[DEBUG] Entry " << (firstObj + i) << ": offset=" << offset << ", inuse='" << inuse << "'" << std::endl;
-                        if (inuse == 'n') {
-                            objectOffsets[firstObj + i] = offset;
-                            std::cout << "[DEBUG] Added object " << (firstObj + i) << " at offset " << offset << std::endl;
-                        }
-                    } catch (const std::exception& e) {
-                        std::cout << "[DEBUG] Failed to parse entry: " << e.what() << std::endl;
-                    }
-                }
-                
-                line_start = line_end + 1;
+        document.objectStreams = std::make_shared<ObjectStreamCache>();
+        document.objectLoader = [file, arena = document.arena, extents = document.extents](
+                                    size_t offset, int objectNumber, uint16_t generation) {
+            if (extents) {
+                extents->fetch(*file, offset);
             }
-            std::cout << "[DEBUG] Parsed " << objectOffsets.size() << " xref entries" << std::endl;
-
-            // --- Parse trailer ---
-            size_t trailer_pos = content.find("trailer", xref_table_pos);
-            if (trailer_pos == std::string::npos) {
-                // Try alternative trailer location
-                trailer_pos = content.find("trailer", line_start);
-                if (trailer_pos == std::string::npos) {
-                    throw std::runtime_error("trailer not found after xref");
-                }
-            }
-            std::cout << "[DEBUG] trailer found at: " << trailer_pos << std::endl;
-            
-            size_t trailer_dict_start = content.find("<<", trailer_pos);
-            if (trailer_dict_start == std::string::npos) {
-                throw std::runtime_error("trailer dictionary not found");
-            }
-            size_t trailer_dict_end = content.find(">>", trailer_dict_start) + 2;
-            std::string trailer_dict_str = content.substr(trailer_dict_start, trailer_dict_end - trailer_dict_start);
-            std::cout << "[DEBUG] Trailer dictionary: " << trailer_dict_str << std::endl;
-            // (Parsing trailer dictionary into PDFDictionary is left as a future step)
-
-            // --- Parse indirect objects ---
-            for (const auto& [objNum, offset] : objectOffsets) {
-                // Find the object header at the offset
-                size_t obj_header_pos = content.find("obj", offset);
-                if (obj_header_pos == std::string::npos) continue;
-                size_t obj_start = content.rfind("\n", obj_header_pos);
-                if (obj_start == std::string::npos) obj_start = offset;
-                size_t obj_end = content.find("endobj", obj_header_pos);
-                if (obj_end == std::string::npos) continue;
-                std::string obj_str = content.substr(obj_start, obj_end + 6 - obj_start);
-                std::cout << "[DEBUG] Object " << objNum << ": " << obj_str.substr(0, 60) << "..." << std::endl;
-                // (Parsing object content into PDFObject is left as a future step)
+            Memory::ArenaScope scope(arena.get());
+            return parseIndirectObjectAtOffset(*file, offset, objectNumber, generation);
+        };
+
+        // --- Damaged xref: rebuild it from the object headers ---
+        if (!chained || !rootLooksValid(document)) {
+            PS_LOG_WARNING(XRef, "Cross-reference data is missing or damaged; reconstructing it");
+            reconstructXRef(document, objectLimit);
+            if (document.getObjectCount() == 0) {
+                throw std::runtime_error("No objects found in PDF");
             }
         }
+        xrefProfile.end();
 
-        // --- Parse indirect objects using extracted offsets ---
-        std::cout << "[DEBUG] Parsing " << objectOffsets.size() << " indirect objects..." << std::endl;
-        for (const auto& [objNum, offset] : objectOffsets) {
-            std::cout << "[DEBUG] Parsing object " << objNum << " at offset " << offset << std::endl;
-            PDFObjectPtr obj = parseIndirectObjectAtOffset(content, offset);
-            document.objects[objNum] = obj;
+        if (lazyLoading_) {
+            PS_LOG_DEBUG(Parser, "Lazy mode: " << document.getObjectCount()
+                         << " objects indexed, none parsed yet");
+            return document;
         }
 
-        // --- Page tree and content stream extraction ---
-        std::cout << "[NEXT] Extracting page tree and content streams from parsed objects." << std::endl;
-
-        // Helper lambda to resolve references
-        auto resolve = [&](const PDFObjectPtr& obj) -> PDFObjectPtr {
-            if (!obj) return nullptr;
-            if (obj->isReference()) {
-                int refNum = obj->asReference().objectNumber;
-                auto it = document.objects.find(refNum);
-                if (it != document.objects.end()) return it->second;
-                return nullptr;
-            }
-            return obj;
-        };
+        // --- Parse indirect objects using extracted offsets ---
+        // Every object is needed, so a sparse file is fetched in one go rather than object by object
+        file->fetch(0, content.size());
+        PS_LOG_DEBUG(Parser, "Parsing " << document.getObjectCount() << " indirect objects...");
+        loadObjects(document, threadCount_);
 
-        // 1. Find the root object (Catalog)
-        PDFObjectPtr rootObj = nullptr;
-        if (document.rootObjectNumber > 0) {
-            auto it = document.objects.find(document.rootObjectNumber);
-            if (it != document.objects.end()) rootObj = it->second;
-        }
-        if (!rootObj) {
-            std::cout << "[ERROR] Could not find root (Catalog) object." << std::endl;
+        // --- Page tree and content stream extraction ---
+        if (!document.getCatalog()) {
+            PS_LOG_ERROR(Parser, "Could not find root (Catalog) object");
             return document;
         }
-        std::cout << "[PAGE] Found Catalog object (" << document.rootObjectNumber << ")" << std::endl;
+        PS_LOG_INFO(Page, "Found Catalog object (" << document.rootObjectNumber << ")");
 
-        // 2. Find the Pages tree
-        PDFObjectPtr pagesObj = nullptr;
-        if (rootObj->isString()) {
-            std::cout << "[ERROR] Root object is a string, not a dictionary." << std::endl;
+        // The page report below only feeds the log
+        if (!PS_LOG_ENABLED(Page, Info)) {
             return document;
         }
-        if (rootObj->isDictionary()) {
-            auto dict = rootObj->asDictionary();
-            auto it = dict.find("Pages");
-            if (it != dict.end()) {
-                pagesObj = resolve(it->second);
-            }
-        }
-        if (!pagesObj) {
-            std::cout << "[ERROR] Could not find Pages tree from Catalog." << std::endl;
-            return document;
-        }
-        std::cout << "[PAGE] Found Pages tree object." << std::endl;
-
-        // 3. Traverse the page tree to find all page objects
-        std::vector<PDFObjectPtr> pageObjects;
-        std::function<void(PDFObjectPtr)> traversePages;
-        traversePages = [&](PDFObjectPtr node) {
-            if (!node) {
-                std::cout << "[PAGE] Node is null" << std::endl;
-                return;
-            }
-            std::cout << "[PAGE] Traversing node of type: " << static_cast<int>(node->getType()) << std::endl;
-            if (node->isDictionary()) {
-                auto dict = node->asDictionary();
-                std::cout << "[PAGE] Dictionary has " << dict.size() << " keys: ";
-                for (const auto& pair : dict) {
-                    std::cout << pair.first << " ";
-                }
-                std::cout << std::endl;
-                auto typeIt = dict.find("Type");
-                if (typeIt != dict.end()) {
-                    PDFObjectPtr typeObj = resolve(typeIt->second);
-                    if (typeObj && typeObj->isName()) {
-                        std::string typeName = typeObj->asName().value;
-                        std::cout << "[PAGE] Node type: " << typeName << std::endl;
-                        if (typeName == "Page") {
-                            // This is a page
-                            pageObjects.push_back(node);
-                            std::cout << "[PAGE] Found page object" << std::endl;
-                            return;
-                        } else if (typeName == "Pages") {
-                            // If it's a Pages node, traverse Kids
-                            auto kidsIt = dict.find("Kids");
-                            if (kidsIt != dict.end()) {
-                                PDFObjectPtr kidsObj = resolve(kidsIt->second);
-                                if (kidsObj && kidsObj->isArray()) {
-                                    PDFArray kids = kidsObj->asArray();
-                                    std::cout << "[PAGE] Pages node has " << kids.size() << " kids" << std::endl;
-                                    for (size_t i = 0; i < kids.size(); ++i) {
-                                        std::cout << "[PAGE] Traversing kid " << i << std::endl;
-                                        traversePages(resolve(kids[i]));
-                                    }
-                                } else {
-                                    std::cout << "[PAGE] Kids is not an array" << std::endl;
-                                }
-                            } else {
-                                std::cout << "[PAGE] Pages node has no Kids" << std::endl;
-                            }
-                        }
-                    } else {
-                        std::cout << "[PAGE] Type is not a name" << std::endl;
-                    }
-                } else {
-                    std::cout << "[PAGE] Node has no Type" << std::endl;
-                }
-            } else {
-                std::cout << "[PAGE] Node is not a dictionary" << std::endl;
-            }
-        };
-        traversePages(pagesObj);
-        std::cout << "[PAGE] Found " << pageObjects.size() << " page(s) in the document." << std::endl;
+        std::vector<PDFObjectPtr> pageObjects = document.getPages();
+        PS_LOG_INFO(Page, "Found " << pageObjects.size() << " page(s) in the document.");
 
-        // 4. Extract content streams for each page
+        // Report the content streams of each page
         for (size_t i = 0; i < pageObjects.size(); ++i) {
-            auto page = pageObjects[i];
-            if (!page || !page->isDictionary()) continue;
-            auto dict = page->asDictionary();
-            auto contentIt = dict.find("Contents");
-            if (contentIt == dict.end()) {
-                std::cout << "[PAGE] Page " << i << " has no Contents." << std::endl;
-                continue;
-            }
-            PDFObjectPtr contentsObj = resolve(contentIt->second);
+            PDFObjectPtr contentsObj = document.resolveKey(pageObjects[i], "Contents");
             if (!contentsObj) {
-                std::cout << "[PAGE] Page " << i << " Contents reference could not be resolved." << std::endl;
+                PS_LOG_INFO(Page, "Page " << i << " has no resolvable Contents.");
                 continue;
             }
             if (contentsObj->isStream()) {
-                auto stream = contentsObj->asStream();
-                std::cout << "[PAGE] Page " << i << " has a content stream of length " << stream.data.size() << "." << std::endl;
+                PS_LOG_INFO(Page, "Page " << i << " has a content stream of length "
+                            << contentsObj->getStream().data.size() << ".");
             } else if (contentsObj->isArray()) {
-                PDFArray arr = contentsObj->asArray();
-                std::cout << "[PAGE] Page " << i << " has an array of " << arr.size() << " content streams." << std::endl;
+                const PDFArray& arr = contentsObj->getArray();
+                PS_LOG_INFO(Page, "Page " << i << " has an array of " << arr.size() << " content streams.");
                 for (size_t j = 0; j < arr.size(); ++j) {
-                    PDFObjectPtr streamObj = resolve(arr[j]);
+                    PDFObjectPtr streamObj = document.resolve(arr[j]);
                     if (streamObj && streamObj->isStream()) {
-                        auto stream = streamObj->asStream();
-                        std::cout << "[PAGE]   Content stream " << j << " length: " << stream.data.size() << std::endl;
+                        PS_LOG_INFO(Page, "  Content stream " << j << " length: " << streamObj->getStream().data.size());
                     } else {
-                        std::cout << "[PAGE]   Content stream " << j << " is not a stream object." << std::endl;
+                        PS_LOG_INFO(Page, "  Content stream " << j << " is not a stream object.");
                     }
                 }
             } else {
-                std::cout << "[PAGE] Page " << i << " Contents is not a stream or array." << std::endl;
+                PS_LOG_INFO(Page, "Page " << i << " Contents is not a stream or array.");
             }
         }
 
@@ -870,140 +794,396 @@ PDFDocument PDFParser::parseFile(const std::string& filename) {
 }
 
 PDFObjectPtr PDFParser::parseObject(const std::string& input) {
-    std::istringstream stream(input);
-    return parseObjectFromStream(stream);
+    size_t pos = 0;
+    return parseValue(input, pos);
 }
 
-std::vector<std::string> PDFParser::parseContentStream(const std::string& streamData) {
+std::vector<std::string> PDFParser::parseContentStream(std::string_view streamData) {
     std::vector<std::string> tokens;
-    std::istringstream stream(streamData);
-    std::string token;
-    
-    while (stream >> token) {
-        // Skip comments
-        if (token[0] == '%') {
-            std::string line;
-            std::getline(stream, line);
-            continue;
-        }
-        
-        tokens.push_back(token);
+    PDFMemorySource source(streamData);
+    PDFContentTokenizer tokenizer(source);
+    std::string_view token;
+    while (tokenizer.next(token)) {
+        tokens.emplace_back(token);
     }
-    
     return tokens;
 }
 
-void PDFParser::skipWhitespace(std::ifstream& file) {
-    char c;
-    while (file.get(c)) {
-        if (!isWhitespace(c)) {
-            file.unget();
-            break;
+std::vector<PageTokens> PDFParser::tokenizePages(PDFDocument& document) const {
+    // Walk the page tree once up front; the threads only resolve and decode contents
+    std::vector<PDFObjectPtr> pages = document.getPages();
+    std::vector<PageTokens> results(pages.size());
+    runParallel(threadsFor(threadCount_, pages.size()), pages.size(), [&document, &pages, &results](size_t i) {
+        PageTokens& result = results[i];
+        result.pageIndex = i;
+        try {
+            PDFObjectPtr contents = document.resolveKey(pages[i], "Contents");
+            if (!contents) {
+                return;
+            }
+            if (contents->isArray()) {
+                for (const auto& stream : contents->getArray()) {
+                    appendTokens(document.resolve(stream), result.tokens);
+                }
+            } else {
+                appendTokens(contents, result.tokens);
+            }
+        } catch (const std::exception& e) {
+            result.succeeded = false;
+            result.error = e.what();
+        }
+    });
+    return results;
+}
+
+// --- PDFContentTokenizer ---
+
+PDFContentTokenizer::PDFContentTokenizer(PDFFilter& source, size_t chunkSize)
+    : source_(source), chunkSize_(std::max<size_t>(chunkSize, 1)) {}
+
+bool PDFContentTokenizer::fill() {
+    if (eof_) {
+        return false;
+    }
+    // Keep the unconsumed tail; the buffer only grows past one chunk for a token longer than that
+    buffer_.erase(0, pos_);
+    pos_ = 0;
+    size_t used = buffer_.size();
+    buffer_.resize(used + chunkSize_);
+    size_t n = source_.read(&buffer_[used], chunkSize_);
+    buffer_.resize(used + n);
+    eof_ = n == 0;
+    return n > 0;
+}
+
+bool PDFContentTokenizer::next(std::string_view& token) {
+    while (true) {
+        // Whitespace-separated tokens
+        while (true) {
+            pos_ = ByteScan::skipWhile(buffer_, pos_, WHITESPACE);
+            if (pos_ < buffer_.size()) break;
+            if (!fill()) return false;
+        }
+        size_t end = pos_;
+        while (true) {
+            end = ByteScan::skipUntil(buffer_, end, WHITESPACE);
+            if (end < buffer_.size() || eof_) break;
+            size_t offset = end - pos_;
+            fill();
+            end = pos_ + offset;
+        }
+
+        // Skip comments through the end of the line
+        if (buffer_[pos_] == '%') {
+            pos_ = end;
+            while (true) {
+                pos_ = ByteScan::skipUntil(buffer_, pos_, NEWLINE);
+                if (pos_ < buffer_.size() || !fill()) break;
+            }
+            continue;
         }
+
+        token = std::string_view(buffer_).substr(pos_, end - pos_);
+        pos_ = end;
+        return true;
     }
 }
 
-std::string PDFParser::readToken(std::ifstream& file) {
-    std::string token;
-    char c;
+namespace {
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+} // namespace
+
+PDFObjectPtr PDFParser::parseValue(std::string_view data, size_t& pos, int depth) {
+    skipWhitespace(data, pos);
+    if (pos >= data.size()) {
+        return makeObject();
+    }
     
-    skipWhitespace(file);
+    char c = data[pos];
+    switch (c) {
+        case '/':
+            return makeObject(parseName(data, pos));
+        case '(':
+            return makeObject(parseString(data, pos));
+        case '[':
+            return makeObject(parseArray(data, pos, depth));
+        case '<':
+            if (pos + 1 < data.size() && data[pos + 1] == '<') {
+                return makeObject(parseDictionary(data, pos, depth));
+            }
+            return makeObject(parseString(data, pos));
+        default:
+            break;
+    }
     
-    while (file.get(c)) {
-        if (isWhitespace(c) || isDelimiter(c)) {
-            if (!token.empty()) {
-                file.unget();
-                break;
+    if (isDigit(c) || c == '+' || c == '-' || c == '.') {
+        PDFObjectPtr number = parseNumber(data, pos);
+        
+        // "<int> <int> R" is an indirect reference; look ahead without consuming
+        if (number->isInteger() && number->asInteger() >= 0) {
+            size_t look = pos;
+            skipWhitespace(data, look);
+            // Generations go up to 65535, so more than 5 digits cannot start a reference
+            size_t genStart = look;
+            int generation = 0;
+            while (look < data.size() && isDigit(data[look]) && look - genStart < 6) {
+                generation = generation * 10 + (data[look] - '0');
+                ++look;
             }
-            if (isDelimiter(c)) {
-                token = c;
-                break;
+            if (look > genStart && generation <= 65535 && look < data.size() && isWhitespace(data[look])) {
+                skipWhitespace(data, look);
+                if (look < data.size() && data[look] == 'R' &&
+                    (look + 1 == data.size() || isWhitespace(data[look + 1]) || isDelimiter(data[look + 1]))) {
+                    pos = look + 1;
+                    return makeObject(PDFReference(number->asInteger(), generation));
+                }
             }
-        } else {
-            token += c;
         }
+        return number;
     }
     
-    return token;
+    std::string_view keyword = readKeyword(data, pos);
+    if (keyword.empty()) {
+        throw std::runtime_error(std::string("Unexpected '") + c + "' in PDF object");
+    }
+    if (keyword == "true") {
+        return makeObject(true);
+    }
+    if (keyword == "false") {
+        return makeObject(false);
+    }
+    // "null" and anything unrecognised
+    return makeObject();
 }
 
-bool PDFParser::isWhitespace(char c) const {
-    return std::isspace(static_cast<unsigned char>(c));
+PDFDictionary PDFParser::parseDictionary(std::string_view data, size_t& pos, int depth) {
+    skipWhitespace(data, pos);
+    if (data.substr(pos, 2) != "<<") {
+        throw std::runtime_error("Expected '<<' at start of dictionary");
+    }
+    if (depth >= MAX_NESTING_DEPTH) {
+        throw std::runtime_error("PDF objects nested too deeply");
+    }
+    pos += 2;
+    
+    PDFDictionary dict;
+    while (true) {
+        skipWhitespace(data, pos);
+        if (pos >= data.size()) {
+            throw std::runtime_error("Unterminated dictionary");
+        }
+        if (data[pos] == '>') {
+            if (pos + 1 >= data.size() || data[pos + 1] != '>') {
+                throw std::runtime_error("Expected '>>' at end of dictionary");
+            }
+            pos += 2;
+            break;
+        }
+        if (data[pos] != '/') {
+            throw std::runtime_error("Dictionary key is not a name");
+        }
+        PDFName key = parseName(data, pos);
+        dict[key.value] = parseValue(data, pos, depth + 1);
+    }
+    return dict;
 }
 
-bool PDFParser::isDelimiter(char c) const {
-    return c == '(' || c == ')' || c == '<' || c == '>' || 
-           c == '[' || c == ']' || c == '{' || c == '}' || 
-           c == '/' || c == '%';
+PDFArray PDFParser::parseArray(std::string_view data, size_t& pos, int depth) {
+    skipWhitespace(data, pos);
+    if (pos >= data.size() || data[pos] != '[') {
+        throw std::runtime_error("Expected '[' at start of array");
+    }
+    if (depth >= MAX_NESTING_DEPTH) {
+        throw std::runtime_error("PDF objects nested too deeply");
+    }
+    ++pos;
+    
+    PDFArray array;
+    while (true) {
+        skipWhitespace(data, pos);
+        if (pos >= data.size()) {
+            throw std::runtime_error("Unterminated array");
+        }
+        if (data[pos] == ']') {
+            ++pos;
+            break;
+        }
+        array.push_back(parseValue(data, pos, depth + 1));
+    }
+    return array;
 }
 
-// Helper method for parsing objects from streams
-PDFObjectPtr PDFParser::parseObjectFromStream(std::istream& stream) {
-    // This is a simplified implementation
-    // In a full implementation, we'd handle all PDF object types
-    
-    std::string token;
-    stream >> token;
+PDFString PDFParser::parseString(std::string_view data, size_t& pos) {
+    std::string value;
     
-    if (token.empty()) {
-        return std::make_shared<PDFObject>();
+    if (data[pos] == '<') {
+        // Hexadecimal string; whitespace is ignored and an odd final digit is padded with 0
+        ++pos;
+        int high = -1;
+        while (pos < data.size() && data[pos] != '>') {
+            int digit = hexValue(data[pos++]);
+            if (digit < 0) continue;
+            if (high < 0) {
+                high = digit;
+            } else {
+                value.push_back(static_cast<char>((high << 4) | digit));
+                high = -1;
+            }
+        }
+        if (pos >= data.size()) {
+            throw std::runtime_error("Unterminated hexadecimal string");
+        }
+        ++pos;
+        if (high >= 0) {
+            value.push_back(static_cast<char>(high << 4));
+        }
+        return PDFString(value, true);
     }
     
-    // Try to parse as number
-    try {
-        if (token.find('.') != std::string::npos) {
-            double value = std::stod(token);
-            return std::make_shared<PDFObject>(value);
-        } else {
-            int value = std::stoi(token);
-            return std::make_shared<PDFObject>(value);
+    // Literal string with balanced parentheses and backslash escapes
+    ++pos;
+    int depth = 1;
+    while (pos < data.size()) {
+        char c = data[pos++];
+        if (c == '(') {
+            ++depth;
+        } else if (c == ')') {
+            if (--depth == 0) {
+                return PDFString(value);
+            }
+        } else if (c == '\\' && pos < data.size()) {
+            char e = data[pos++];
+            switch (e) {
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case '\r':
+                    // Line continuation
+                    if (pos < data.size() && data[pos] == '\n') ++pos;
+                    continue;
+                case '\n':
+                    continue;
+                default:
+                    if (e >= '0' && e <= '7') {
+                        int code = e - '0';
+                        for (int i = 0; i < 2 && pos < data.size() && data[pos] >= '0' && data[pos] <= '7'; ++i) {
+                            code = code * 8 + (data[pos++] - '0');
+                        }
+                        c = static_cast<char>(code);
+                    } else {
+                        c = e;
+                    }
+                    break;
+            }
         }
-    } catch (...) {
-        // Not a number, continue to other types
+        value.push_back(c);
     }
-    
-    // Try to parse as boolean
-    if (token == "true") {
-        return std::make_shared<PDFObject>(true);
+    throw std::runtime_error("Unterminated literal string");
+}
+
+PDFName PDFParser::parseName(std::string_view data, size_t& pos) {
+    ++pos; // skip '/'
+    size_t end = ByteScan::skipUntil(data, pos, TOKEN_END);
+    std::string_view raw = data.substr(pos, end - pos);
+    if (raw.find('#') == std::string_view::npos) {
+        pos = end;
+        return PDFName(std::string(raw));
     }
-    if (token == "false") {
-        return std::make_shared<PDFObject>(false);
+    std::string value;
+    while (pos < end) {
+        char c = data[pos++];
+        if (c == '#' && pos + 1 < data.size()) {
+            int high = hexValue(data[pos]);
+            int low = hexValue(data[pos + 1]);
+            if (high >= 0 && low >= 0) {
+                c = static_cast<char>((high << 4) | low);
+                pos += 2;
+            }
+        }
+        value.push_back(c);
     }
-    
-    // Try to parse as null
-    if (token == "null") {
-        return std::make_shared<PDFObject>();
+    return PDFName(value);
+}
+
+PDFObjectPtr PDFParser::parseNumber(std::string_view data, size_t& pos) {
+    bool negative = false;
+    if (pos < data.size() && (data[pos] == '+' || data[pos] == '-')) {
+        negative = data[pos] == '-';
+        ++pos;
     }
     
-    // Try to parse as name
-    if (token[0] == '/') {
-        return std::make_shared<PDFObject>(PDFName(token.substr(1)));
+    long long integer = 0;
+    double real = 0.0;
+    bool isReal = false;
+    while (pos < data.size() && isDigit(data[pos])) {
+        real = real * 10.0 + (data[pos] - '0');
+        if (integer <= std::numeric_limits<int>::max()) {
+            integer = integer * 10 + (data[pos] - '0');
+        }
+        ++pos;
+    }
+    if (pos < data.size() && data[pos] == '.') {
+        isReal = true;
+        ++pos;
+        double scale = 0.1;
+        while (pos < data.size() && isDigit(data[pos])) {
+            real += (data[pos] - '0') * scale;
+            scale *= 0.1;
+            ++pos;
+        }
     }
     
-    // For now, treat as string
-    return std::make_shared<PDFObject>(PDFString(token));
-}
-
-// Utility: FlateDecode decompression
-std::string flate_decompress(const std::string& data) {
-    if (data.empty()) return "";
-    // Estimate output size (arbitrary, can be improved)
-    size_t out_size = data.size() * 4 + 1024;
-    std::string out(out_size, '\0');
-    z_stream zs{};
-    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
-    zs.avail_in = data.size();
-    zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
-    zs.avail_out = out_size;
-    if (inflateInit(&zs) != Z_OK) throw std::runtime_error("zlib inflateInit failed");
-    int ret = inflate(&zs, Z_FINISH);
-    if (ret != Z_STREAM_END && ret != Z_OK) {
-        inflateEnd(&zs);
-        throw std::runtime_error("zlib inflate failed");
-    }
-    out.resize(zs.total_out);
-    inflateEnd(&zs);
-    return out;
+    if (!isReal && integer <= std::numeric_limits<int>::max()) {
+        int value = static_cast<int>(integer);
+        return makeObject(negative ? -value : value);
+    }
+    return makeObject(negative ? -real : real);
+}
+
+std::string_view PDFParser::readKeyword(std::string_view data, size_t& pos) {
+    skipWhitespace(data, pos);
+    size_t start = pos;
+    pos = ByteScan::skipUntil(data, pos, TOKEN_END);
+    return data.substr(start, pos - start);
+}
+
+void PDFParser::skipWhitespace(std::string_view data, size_t& pos) {
+    while (true) {
+        pos = ByteScan::skipWhile(data, pos, WHITESPACE);
+        if (pos == data.size() || data[pos] != '%') {
+            break;
+        }
+        pos = ByteScan::skipUntil(data, pos, LINE_END);
+    }
+}
+
+bool PDFParser::isWhitespace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\0';
+}
+
+bool PDFParser::isDelimiter(char c) {
+    return c == '(' || c == ')' || c == '<' || c == '>' || 
+           c == '[' || c == ']' || c == '{' || c == '}' || 
+           c == '/' || c == '%';
+}
+
+// Helper method for parsing objects from streams
+PDFObjectPtr PDFParser::parseObjectFromStream(std::istream& stream) {
+    std::string input((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    return parseObject(input);
 }
 
 } // namespace PDF 
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include "pdf_prefetch.h"
+#include "pdf_file.h"
+#include "log.h"
+#include <algorithm>
+#include <unordered_set>
+#include <utility>
+
+namespace PDF {
+
+namespace {
+
+// Guards against cyclic page trees, as PDFDocument::getPage does
+constexpr int MAX_TREE_DEPTH = 64;
+
+const PDFDictionary* entriesOf(const PDFObjectPtr& object) {
+    if (!object) return nullptr;
+    if (object->isDictionary()) return &object->getDictionary();
+    if (object->isStream()) return &object->getStream().dict;
+    return nullptr;
+}
+
+bool isType(const PDFObjectPtr& node, const char* type) {
+    const PDFDictionary* entries = entriesOf(node);
+    if (!entries) return false;
+    auto it = entries->find("Type");
+    return it != entries->end() && it->second->isName() && it->second->asName().value == type;
+}
+
+// References held directly in an object (not following them); /Parent would climb back up the page tree
+void collectReferences(const PDFObjectPtr& object, std::vector<int>& numbers) {
+    if (!object) return;
+    if (object->isReference()) {
+        numbers.push_back(object->asReference().objectNumber);
+    } else if (object->isArray()) {
+        for (const PDFObjectPtr& element : object->getArray()) {
+            collectReferences(element, numbers);
+        }
+    } else if (const PDFDictionary* entries = entriesOf(object)) {
+        for (const auto& [key, value] : *entries) {
+            if (key != "Parent") {
+                collectReferences(value, numbers);
+            }
+        }
+    }
+}
+
+} // namespace
+
+PDFPrefetcher::PDFPrefetcher(PDFDocument& document, size_t ioThreads)
+    : document_(document), threads_(std::max<size_t>(ioThreads, 1)) {}
+
+void PDFPrefetcher::fetchObjects(const std::vector<int>& objectNumbers) {
+    const std::vector<XRefEntry>& xref = document_.xref;
+    std::vector<int> pending;
+    std::vector<std::pair<uint64_t, uint64_t>> ranges; // [start, end) of each object to read
+    for (int number : objectNumbers) {
+        if (number < 0 || static_cast<size_t>(number) >= xref.size() || xref[number].isLoaded() ||
+            xref[number].type == XRefEntry::Type::Free) {
+            continue;
+        }
+        pending.push_back(number);
+        if (!document_.extents) {
+            continue;
+        }
+        // A compressed object is read with its object stream, unless that is loaded already
+        const XRefEntry* entry = &xref[number];
+        if (entry->type == XRefEntry::Type::Compressed) {
+            const int stream = entry->streamNumber;
+            if (stream < 0 || static_cast<size_t>(stream) >= xref.size() || xref[stream].isLoaded()) {
+                continue;
+            }
+            entry = &xref[stream];
+        }
+        if (entry->type == XRefEntry::Type::InUse) {
+            const uint64_t length = document_.extents->lengthAt(entry->offset);
+            if (!document_.file->isFetched(entry->offset, length)) {
+                ranges.emplace_back(entry->offset, entry->offset + length);
+            }
+        }
+    }
+    if (pending.empty()) {
+        return;
+    }
+
+    if (!ranges.empty()) {
+        // Reading a gap of up to a block costs less than another request
+        std::sort(ranges.begin(), ranges.end());
+        const uint64_t gap = document_.file->getBlockSize();
+        std::vector<std::pair<uint64_t, uint64_t>> reads{ranges.front()};
+        for (const auto& range : ranges) {
+            if (range.first <= reads.back().second + gap) {
+                reads.back().second = std::max(reads.back().second, range.second);
+            } else {
+                reads.push_back(range);
+            }
+        }
+        const PDFFileData& file = *document_.file;
+        threads_.parallelFor(reads.size(), [&file, &reads](size_t i, size_t) {
+            file.fetch(static_cast<size_t>(reads[i].first), static_cast<size_t>(reads[i].second - reads[i].first));
+        });
+        ++rounds_;
+        reads_ += reads.size();
+        PS_LOG_DEBUG(Parser, "Prefetched " << pending.size() << " objects in " << reads.size() << " reads");
+    }
+
+    // Everything is local now, so parsing needs no further reads
+    for (int number : pending) {
+        document_.getObject(number);
+    }
+    objects_ += pending.size();
+}
+
+PDFObjectPtr PDFPrefetcher::fetchEntry(const PDFObjectPtr& dictionary, const char* key) {
+    const PDFDictionary* entries = entriesOf(dictionary);
+    auto it = entries ? entries->find(key) : PDFDictionary::const_iterator();
+    if (!entries || it == entries->end()) {
+        return nullptr;
+    }
+    if (it->second->isReference()) {
+        fetchObjects({it->second->asReference().objectNumber});
+    }
+    return document_.resolve(it->second);
+}
+
+PDFObjectPtr PDFPrefetcher::fetchPage(size_t index) {
+    fetchObjects({document_.rootObjectNumber});
+    std::vector<int> numbers;
+
+    // Descend as PDFDocument::getPage does, fetching all kids of a node in one round
+    std::vector<PDFObjectPtr> path;
+    PDFObjectPtr node = fetchEntry(document_.getCatalog(), "Pages");
+    PDFObjectPtr page;
+    for (int depth = 0; node && depth <= MAX_TREE_DEPTH; ++depth) {
+        if (isType(node, "Page")) {
+            page = index == 0 ? node : nullptr;
+            break;
+        }
+        path.push_back(node);
+        PDFObjectPtr kids = fetchEntry(node, "Kids");
+        if (!kids || !kids->isArray()) break;
+        numbers.clear();
+        collectReferences(kids, numbers);
+        fetchObjects(numbers);
+
+        PDFObjectPtr next;
+        for (const auto& kidRef : kids->getArray()) {
+            PDFObjectPtr kid = document_.resolve(kidRef);
+            if (std::find(path.begin(), path.end(), kid) != path.end()) {
+                continue; // One of its own ancestors
+            }
+            size_t count = 0;
+            if (isType(kid, "Page")) {
+                count = 1;
+            } else if (PDFObjectPtr kidCount = document_.resolveKey(kid, "Count");
+                       kidCount && kidCount->isInteger() && kidCount->asInteger() > 0) {
+                count = static_cast<size_t>(kidCount->asInteger());
+            }
+            if (index < count) {
+                next = kid;
+                break;
+            }
+            index -= count;
+        }
+        node = next;
+    }
+    if (!page) {
+        return nullptr;
+    }
+
+    // The page's contents and resources (inherited from the nearest ancestor if it has none)
+    std::vector<int> level;
+    const PDFDictionary& entries = *entriesOf(page);
+    auto contents = entries.find("Contents");
+    if (contents != entries.end()) {
+        collectReferences(contents->second, level);
+    }
+    // In a well-formed tree the ancestors on /Parent are the nodes just fetched
+    if (PDFObjectPtr resources = document_.findInheritedEntry(page, "Resources")) {
+        collectReferences(resources, level);
+    }
+
+    // Then what those refer to, a level per round
+    std::unordered_set<int> seen(level.begin(), level.end());
+    for (int depth = 0; !level.empty() && depth < MAX_DEPTH; ++depth) {
+        fetchObjects(level);
+        std::vector<int> next;
+        for (int number : level) {
+            numbers.clear();
+            collectReferences(document_.getObject(number), numbers);
+            for (int found : numbers) {
+                if (seen.insert(found).second) {
+                    next.push_back(found);
+                }
+            }
+        }
+        level = std::move(next);
+    }
+    return page;
+}
+
+std::future<PDFObjectPtr> PDFPrefetcher::prefetchPage(size_t index) {
+    return threads_.submit([this, index]() { return fetchPage(index); });
+}
+
+void PDFPrefetcher::fetchPageTree() {
+    fetchObjects({document_.rootObjectNumber});
+    std::vector<int> numbers;
+    std::vector<PDFObjectPtr> level;
+    if (PDFObjectPtr root = fetchEntry(document_.getCatalog(), "Pages")) {
+        level.push_back(root);
+    }
+    std::unordered_set<const PDFObject*> visited;
+    for (int depth = 0; !level.empty() && depth <= MAX_TREE_DEPTH; ++depth) {
+        // Kids arrays kept in objects of their own first, then the kids of the whole level at once
+        numbers.clear();
+        for (const PDFObjectPtr& node : level) {
+            const PDFDictionary* entries = entriesOf(node);
+            auto it = entries ? entries->find("Kids") : PDFDictionary::const_iterator();
+            if (entries && it != entries->end() && it->second->isReference()) {
+                numbers.push_back(it->second->asReference().objectNumber);
+            }
+        }
+        fetchObjects(numbers);
+        std::vector<PDFObjectPtr> kidArrays;
+        numbers.clear();
+        for (const PDFObjectPtr& node : level) {
+            PDFObjectPtr kids = document_.resolveKey(node, "Kids");
+            if (kids && kids->isArray()) {
+                collectReferences(kids, numbers);
+                kidArrays.push_back(kids);
+            }
+        }
+        fetchObjects(numbers);
+
+        std::vector<PDFObjectPtr> next;
+        for (const PDFObjectPtr& kids : kidArrays) {
+            for (const auto& kidRef : kids->getArray()) {
+                PDFObjectPtr kid = document_.resolve(kidRef);
+                if (kid && kid->isDictionary() && !isType(kid, "Page") && visited.insert(kid.get()).second) {
+                    next.push_back(kid);
+                }
+            }
+        }
+        level = std::move(next);
+    }
+}
+
+PDFPrefetcher::Stats PDFPrefetcher::getStats() const {
+    Stats stats;
+    stats.rounds = rounds_.load();
+    stats.reads = reads_.load();
+    stats.objects = objects_.load();
+    return stats;
+}
+
+} // namespace PDF
@@ -0,0 +1,358 @@
+#include "pdf_source.h"
+#include "log.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PDF_SOURCE_POSIX 1
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+namespace PDF {
+
+namespace {
+
+constexpr const char* HTTP_SCHEME = "http://";
+
+#if PDF_SOURCE_POSIX
+
+// A stalled server fails the read instead of hanging the page
+constexpr int SOCKET_TIMEOUT_SECONDS = 30;
+
+#ifdef MSG_NOSIGNAL
+constexpr int SEND_FLAGS = MSG_NOSIGNAL; // A server that hung up must not kill the process
+#else
+constexpr int SEND_FLAGS = 0;
+#endif
+
+bool sendAll(int fd, const std::string& data) {
+    for (size_t sent = 0; sent < data.size();) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, SEND_FLAGS);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+ssize_t receive(int fd, char* buffer, size_t size) {
+    ssize_t n;
+    do {
+        n = ::recv(fd, buffer, size, 0);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+bool parseUnsigned(std::string_view text, uint64_t& value) {
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return !text.empty() && result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) text.remove_suffix(1);
+    return text;
+}
+
+#endif // PDF_SOURCE_POSIX
+
+} // namespace
+
+// --- PDFByteSource ---
+
+bool PDFByteSource::isURL(const std::string& location) {
+    return location.find("://") != std::string::npos;
+}
+
+std::shared_ptr<PDFByteSource> PDFByteSource::open(const std::string& location) {
+    if (isURL(location)) {
+        return std::make_shared<HTTPRangeSource>(location);
+    }
+    return std::make_shared<PReadSource>(location);
+}
+
+// --- PReadSource ---
+
+#if PDF_SOURCE_POSIX
+
+PReadSource::PReadSource(const std::string& filename) : filename_(filename) {
+    fd_ = ::open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd_ < 0 || fstat(fd_, &st) != 0) {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+        throw std::runtime_error("Cannot open PDF file: " + filename);
+    }
+    size_ = static_cast<uint64_t>(st.st_size);
+}
+
+PReadSource::~PReadSource() {
+    ::close(fd_);
+}
+
+void PReadSource::read(uint64_t offset, size_t count, char* buffer) {
+    while (count > 0) {
+        ssize_t n = ::pread(fd_, buffer, count, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw std::runtime_error("Cannot read " + std::to_string(count) + " bytes at offset " +
+                                     std::to_string(offset) + " of " + filename_);
+        }
+        buffer += n;
+        offset += static_cast<uint64_t>(n);
+        count -= static_cast<size_t>(n);
+    }
+}
+
+#else
+
+PReadSource::PReadSource(const std::string& filename) : filename_(filename), stream_(filename, std::ios::binary) {
+    if (!stream_.is_open()) {
+        throw std::runtime_error("Cannot open PDF file: " + filename);
+    }
+    stream_.seekg(0, std::ios::end);
+    size_ = static_cast<uint64_t>(stream_.tellg());
+}
+
+PReadSource::~PReadSource() = default;
+
+void PReadSource::read(uint64_t offset, size_t count, char* buffer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stream_.clear();
+    stream_.seekg(static_cast<std::streamoff>(offset));
+    stream_.read(buffer, static_cast<std::streamsize>(count));
+    if (static_cast<size_t>(stream_.gcount()) != count) {
+        throw std::runtime_error("Cannot read " + std::to_string(count) + " bytes at offset " +
+                                 std::to_string(offset) + " of " + filename_);
+    }
+}
+
+#endif // PDF_SOURCE_POSIX
+
+// --- HTTPRangeSource ---
+
+struct HTTPRangeSource::Response {
+    int status = 0;
+    uint64_t total = 0;  // From Content-Range
+    size_t length = 0;   // Body bytes received
+};
+
+#if PDF_SOURCE_POSIX
+
+HTTPRangeSource::HTTPRangeSource(const std::string& url) : url_(url) {
+    if (url.compare(0, std::strlen(HTTP_SCHEME), HTTP_SCHEME) != 0) {
+        throw std::runtime_error("Unsupported URL (only http:// is supported): " + url);
+    }
+    std::string rest = url.substr(std::strlen(HTTP_SCHEME));
+    size_t slash = rest.find('/');
+    std::string authority = rest.substr(0, slash);
+    path_ = slash == std::string::npos ? "/" : rest.substr(slash);
+    size_t colon = authority.rfind(':');
+    host_ = authority.substr(0, colon);
+    port_ = colon == std::string::npos ? "80" : authority.substr(colon + 1);
+    if (host_.empty() || port_.empty()) {
+        throw std::runtime_error("Invalid URL: " + url);
+    }
+
+    // The size comes from the Content-Range of a one-byte request
+    char first;
+    Response response = request(0, 0, &first, 1);
+    size_ = response.total;
+    PS_LOG_DEBUG(Parser, "Opened " << url << ": " << size_ << " bytes");
+}
+
+HTTPRangeSource::~HTTPRangeSource() {
+    for (int fd : idle_) {
+        ::close(fd);
+    }
+}
+
+uint64_t HTTPRangeSource::getRequestCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return requests_;
+}
+
+int HTTPRangeSource::connect() {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    int error = ::getaddrinfo(host_.c_str(), port_.c_str(), &hints, &addresses);
+    if (error != 0) {
+        throw std::runtime_error("Cannot resolve " + host_ + ": " + gai_strerror(error));
+    }
+    int fd = -1;
+    for (addrinfo* address = addresses; address && fd < 0; address = address->ai_next) {
+        fd = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (::connect(fd, address->ai_addr, address->ai_addrlen) != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    ::freeaddrinfo(addresses);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot connect to " + host_ + ":" + port_);
+    }
+    timeval timeout{SOCKET_TIMEOUT_SECONDS, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+HTTPRangeSource::Response HTTPRangeSource::request(uint64_t first, uint64_t last, char* buffer, size_t capacity) {
+    const std::string message = "GET " + path_ + " HTTP/1.1\r\nHost: " + host_ + "\r\nRange: bytes=" +
+                                std::to_string(first) + "-" + std::to_string(last) + "\r\n\r\n";
+    // A kept-alive connection may have been closed by the server meanwhile; retry those once on a new one
+    for (int attempt = 0;; ++attempt) {
+        int fd = -1;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++requests_;
+            if (attempt == 0 && !idle_.empty()) {
+                fd = idle_.back();
+                idle_.pop_back();
+            }
+        }
+        const bool reused = fd >= 0;
+        if (!reused) {
+            fd = connect();
+        }
+
+        std::string head;
+        char chunk[4096];
+        size_t headerEnd = std::string::npos;
+        bool sent = sendAll(fd, message);
+        while (sent && headerEnd == std::string::npos) {
+            ssize_t n = receive(fd, chunk, sizeof(chunk));
+            if (n <= 0) {
+                break;
+            }
+            head.append(chunk, static_cast<size_t>(n));
+            headerEnd = head.find("\r\n\r\n");
+        }
+        if (headerEnd == std::string::npos) {
+            ::close(fd);
+            if (reused && head.empty()) {
+                continue;
+            }
+            throw std::runtime_error("No response from " + url_);
+        }
+
+        // Status line and the headers that matter here
+        Response response;
+        uint64_t contentLength = 0;
+        bool hasLength = false, keepAlive = head.compare(0, 8, "HTTP/1.1") == 0;
+        std::string_view headers(head.data(), headerEnd);
+        size_t space = headers.find(' ');
+        if (space != std::string_view::npos) {
+            uint64_t status = 0;
+            parseUnsigned(headers.substr(space + 1, 3), status);
+            response.status = static_cast<int>(status);
+        }
+        for (size_t lineStart = headers.find("\r\n"); lineStart != std::string_view::npos;) {
+            lineStart += 2;
+            size_t lineEnd = std::min(headers.find("\r\n", lineStart), headers.size());
+            std::string_view line = headers.substr(lineStart, lineEnd - lineStart);
+            size_t colon = line.find(':');
+            if (colon != std::string_view::npos) {
+                std::string name = lowercase(std::string(line.substr(0, colon)));
+                std::string_view value = trim(line.substr(colon + 1));
+                if (name == "content-length") {
+                    hasLength = parseUnsigned(value, contentLength);
+                } else if (name == "content-range") {
+                    size_t total = value.rfind('/');
+                    if (total != std::string_view::npos) {
+                        parseUnsigned(value.substr(total + 1), response.total);
+                    }
+                } else if (name == "connection") {
+                    keepAlive = lowercase(std::string(value)) != "close";
+                }
+            }
+            lineStart = lineEnd < headers.size() ? lineEnd : std::string_view::npos;
+        }
+        if (response.status != 206 || !hasLength || contentLength != last - first + 1 || contentLength > capacity) {
+            ::close(fd);
+            throw std::runtime_error(url_ + ": expected " + std::to_string(last - first + 1) +
+                                     " bytes of partial content, got status " + std::to_string(response.status));
+        }
+
+        // Body: whatever followed the headers, then the rest from the socket
+        size_t received = std::min<size_t>(head.size() - headerEnd - 4, contentLength);
+        std::memcpy(buffer, head.data() + headerEnd + 4, received);
+        while (received < contentLength) {
+            ssize_t n = receive(fd, buffer + received, contentLength - received);
+            if (n <= 0) {
+                ::close(fd);
+                throw std::runtime_error(url_ + ": connection closed inside a response");
+            }
+            received += static_cast<size_t>(n);
+        }
+        response.length = received;
+
+        if (keepAlive) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            idle_.push_back(fd);
+        } else {
+            ::close(fd);
+        }
+        return response;
+    }
+}
+
+void HTTPRangeSource::read(uint64_t offset, size_t count, char* buffer) {
+    if (count == 0) {
+        return;
+    }
+    request(offset, offset + count - 1, buffer, count);
+}
+
+#else
+
+HTTPRangeSource::HTTPRangeSource(const std::string& url) : url_(url) {
+    throw std::runtime_error("HTTP sources need a POSIX system");
+}
+
+HTTPRangeSource::~HTTPRangeSource() = default;
+
+uint64_t HTTPRangeSource::getRequestCount() const {
+    return 0;
+}
+
+int HTTPRangeSource::connect() {
+    return -1;
+}
+
+HTTPRangeSource::Response HTTPRangeSource::request(uint64_t, uint64_t, char*, size_t) {
+    return Response();
+}
+
+void HTTPRangeSource::read(uint64_t, size_t, char*) {}
+
+#endif // PDF_SOURCE_POSIX
+
+} // namespace PDF
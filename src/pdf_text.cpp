@@ -0,0 +1,477 @@
+#include "pdf_text.h"
+#include "byte_scan.h"
+#include <algorithm>
+#include <cmath>
+
+namespace PDF {
+
+namespace {
+
+// The lexer's byte classes, as in the PDF parser
+constexpr ByteScan::ByteSet WHITESPACE(std::string_view(" \t\n\r\f\0", 6));
+constexpr ByteScan::ByteSet TOKEN_END(std::string_view(" \t\n\r\f\0()<>[]{}/%", 16));
+constexpr ByteScan::ByteSet NEWLINE(std::string_view("\r\n", 2));
+constexpr ByteScan::ByteSet STRING_SPECIAL(std::string_view("()\\", 3));
+
+int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool parseNumber(std::string_view token, double& value) {
+    size_t pos = 0;
+    bool negative = false;
+    if (pos < token.size() && (token[pos] == '+' || token[pos] == '-')) {
+        negative = token[pos] == '-';
+        ++pos;
+    }
+    double result = 0.0;
+    bool digits = false;
+    while (pos < token.size() && token[pos] >= '0' && token[pos] <= '9') {
+        result = result * 10.0 + (token[pos++] - '0');
+        digits = true;
+    }
+    if (pos < token.size() && token[pos] == '.') {
+        ++pos;
+        double scale = 0.1;
+        while (pos < token.size() && token[pos] >= '0' && token[pos] <= '9') {
+            result += (token[pos++] - '0') * scale;
+            scale *= 0.1;
+            digits = true;
+        }
+    }
+    value = negative ? -result : result;
+    return digits && pos == token.size();
+}
+
+} // namespace
+
+PDFTextExtractor::PDFTextExtractor(size_t chunkSize) : chunkSize_(std::max<size_t>(chunkSize, 1)) {}
+
+void PDFTextExtractor::reset() {
+    // Members are cleared rather than replaced so their buffers are kept
+    state_.ctm = Matrix();
+    state_.font.clear();
+    state_.fontSize = 0.0;
+    state_.leading = 0.0;
+    depth_ = 0;
+    textMatrix_ = Matrix();
+    lineMatrix_ = Matrix();
+    operands_.clear();
+    inImage_ = false;
+}
+
+size_t PDFTextExtractor::extract(PDFFilter& source, const TextRunHandler& onRun) {
+    source_ = &source;
+    buffer_.clear();
+    data_ = buffer_;
+    pos_ = 0;
+    eof_ = false;
+    size_t runs = run(onRun);
+    source_ = nullptr;
+    return runs;
+}
+
+size_t PDFTextExtractor::extract(std::string_view content, const TextRunHandler& onRun) {
+    data_ = content;
+    pos_ = 0;
+    eof_ = true;
+    return run(onRun);
+}
+
+bool PDFTextExtractor::fill() {
+    if (eof_) {
+        return false;
+    }
+    // Keep the pending operands along with the token being read
+    size_t keep = pos_;
+    if (!operands_.empty()) {
+        keep = std::min(keep, operands_.front().offset);
+    }
+    buffer_.erase(0, keep);
+    pos_ -= keep;
+    for (Token& operand : operands_) {
+        operand.offset -= keep;
+    }
+    size_t used = buffer_.size();
+    buffer_.resize(used + chunkSize_);
+    size_t n = source_->read(&buffer_[used], chunkSize_);
+    buffer_.resize(used + n);
+    data_ = buffer_;
+    eof_ = n == 0;
+    return true;
+}
+
+size_t PDFTextExtractor::run(const TextRunHandler& onRun) {
+    runs_ = 0;
+    operands_.clear();
+    Token token;
+    while (true) {
+        const bool image = inImage_;
+        Scan result = image ? skipInlineImage() : scan(token);
+        if (result == Scan::NeedMore) {
+            fill();
+            continue;
+        }
+        if (result == Scan::End) {
+            break;
+        }
+        if (image) {
+            continue;
+        }
+        if (token.kind == Kind::Operator) {
+            execute(data_.substr(token.offset, token.length), onRun);
+            operands_.clear();
+        } else {
+            operands_.push_back(token);
+        }
+    }
+    operands_.clear();
+    return runs_;
+}
+
+PDFTextExtractor::Scan PDFTextExtractor::scan(Token& token) {
+    // A token that reaches the end of the data is incomplete unless the stream has ended;
+    // pos_ stays at its start, and scanning restarts there once more data is in
+    const size_t size = data_.size();
+    while (true) {
+        pos_ = ByteScan::skipWhile(data_, pos_, WHITESPACE);
+        if (pos_ >= size) {
+            return eof_ ? Scan::End : Scan::NeedMore;
+        }
+        if (data_[pos_] != '%') {
+            break;
+        }
+        size_t end = ByteScan::skipUntil(data_, pos_, NEWLINE);
+        if (end >= size && !eof_) {
+            return Scan::NeedMore;
+        }
+        pos_ = end;
+    }
+
+    const char c = data_[pos_];
+    token.number = 0.0;
+    switch (c) {
+    case '(': {
+        int depth = 1;
+        size_t i = pos_ + 1;
+        while (depth > 0) {
+            i = ByteScan::skipUntil(data_, i, STRING_SPECIAL);
+            if (i >= size || (data_[i] == '\\' && i + 1 >= size)) {
+                if (!eof_) return Scan::NeedMore;
+                i = size;
+                break; // Unterminated: the string runs to the end of the content
+            }
+            if (data_[i] == '\\') {
+                i += 2;
+            } else {
+                depth += data_[i] == '(' ? 1 : -1;
+                ++i;
+            }
+        }
+        token.kind = Kind::String;
+        token.offset = pos_ + 1;
+        token.length = (depth > 0 ? i : i - 1) - token.offset;
+        pos_ = i;
+        return Scan::Token;
+    }
+    case '<': {
+        if (pos_ + 1 >= size && !eof_) return Scan::NeedMore;
+        if (pos_ + 1 < size && data_[pos_ + 1] == '<') {
+            token.kind = Kind::Other;
+            token.offset = pos_;
+            token.length = 2;
+            pos_ += 2;
+            return Scan::Token;
+        }
+        size_t end = data_.find('>', pos_ + 1);
+        if (end == std::string_view::npos) {
+            if (!eof_) return Scan::NeedMore;
+            end = size;
+        }
+        token.kind = Kind::HexString;
+        token.offset = pos_ + 1;
+        token.length = end - token.offset;
+        pos_ = std::min(end + 1, size);
+        return Scan::Token;
+    }
+    case '>':
+        if (pos_ + 1 >= size && !eof_) return Scan::NeedMore;
+        token.kind = Kind::Other;
+        token.offset = pos_;
+        token.length = pos_ + 1 < size && data_[pos_ + 1] == '>' ? 2 : 1;
+        pos_ += token.length;
+        return Scan::Token;
+    case '[':
+    case ']':
+        token.kind = c == '[' ? Kind::ArrayBegin : Kind::ArrayEnd;
+        token.offset = pos_++;
+        token.length = 1;
+        return Scan::Token;
+    case '{':
+    case '}':
+    case ')':
+        token.kind = Kind::Other;
+        token.offset = pos_++;
+        token.length = 1;
+        return Scan::Token;
+    default:
+        break;
+    }
+
+    // Names, numbers and operators run up to the next delimiter
+    const size_t start = c == '/' ? pos_ + 1 : pos_;
+    size_t end = ByteScan::skipUntil(data_, start, TOKEN_END);
+    if (end >= size && !eof_) {
+        return Scan::NeedMore;
+    }
+    token.offset = start;
+    token.length = end - start;
+    std::string_view text = data_.substr(start, end - start);
+    if (c == '/') {
+        token.kind = Kind::Name;
+    } else if ((c >= '0' && c <= '9') || c == '+' || c == '-' || c == '.') {
+        token.kind = parseNumber(text, token.number) ? Kind::Number : Kind::Other;
+    } else {
+        token.kind = Kind::Operator;
+    }
+    pos_ = end;
+    return Scan::Token;
+}
+
+PDFTextExtractor::Scan PDFTextExtractor::skipInlineImage() {
+    // The image data ends at whitespace, "EI" and a delimiter (or the end of the content)
+    const size_t size = data_.size();
+    for (size_t at = ByteScan::find(data_, "EI", pos_); at != std::string_view::npos;
+         at = ByteScan::find(data_, "EI", at + 1)) {
+        if (at + 2 >= size && !eof_) {
+            break;
+        }
+        if (at > pos_ && WHITESPACE.contains(data_[at - 1]) && (at + 2 >= size || TOKEN_END.contains(data_[at + 2]))) {
+            pos_ = at + 2;
+            inImage_ = false;
+            return Scan::Token;
+        }
+    }
+    if (eof_) {
+        pos_ = size;
+        inImage_ = false;
+        return Scan::End;
+    }
+    // Discard what was searched, keeping enough to match a marker split across chunks
+    pos_ = std::max(pos_, size > 3 ? size - 3 : 0);
+    return Scan::NeedMore;
+}
+
+double PDFTextExtractor::number(size_t fromEnd) const {
+    const Token& operand = operands_[operands_.size() - fromEnd];
+    return operand.kind == Kind::Number ? operand.number : 0.0;
+}
+
+void PDFTextExtractor::nextLine(double tx, double ty) {
+    lineMatrix_.e += tx * lineMatrix_.a + ty * lineMatrix_.c;
+    lineMatrix_.f += tx * lineMatrix_.b + ty * lineMatrix_.d;
+    textMatrix_ = lineMatrix_;
+}
+
+void PDFTextExtractor::execute(std::string_view op, const TextRunHandler& onRun) {
+    const size_t count = operands_.size();
+    if (op.size() == 1) {
+        switch (op[0]) {
+        case 'q':
+            if (depth_ == stack_.size()) {
+                stack_.push_back(state_);
+            } else {
+                stack_[depth_] = state_;
+            }
+            ++depth_;
+            break;
+        case 'Q':
+            if (depth_ > 0) {
+                state_ = stack_[--depth_];
+            }
+            break;
+        case '\'':
+        case '"':
+            nextLine(0.0, -state_.leading);
+            show(onRun);
+            break;
+        default:
+            break;
+        }
+        return;
+    }
+    if (op.size() != 2) {
+        return;
+    }
+    switch (op[0]) {
+    case 'B':
+        if (op[1] == 'T') {
+            textMatrix_ = Matrix();
+            lineMatrix_ = Matrix();
+        }
+        break;
+    case 'I':
+        if (op[1] == 'D') {
+            inImage_ = true;
+        }
+        break;
+    case 'c':
+        if (op[1] == 'm' && count >= 6) {
+            const Matrix m{number(6), number(5), number(4), number(3), number(2), number(1)};
+            const Matrix& n = state_.ctm;
+            state_.ctm = Matrix{m.a * n.a + m.b * n.c,       m.a * n.b + m.b * n.d,
+                                m.c * n.a + m.d * n.c,       m.c * n.b + m.d * n.d,
+                                m.e * n.a + m.f * n.c + n.e, m.e * n.b + m.f * n.d + n.f};
+        }
+        break;
+    case 'T':
+        switch (op[1]) {
+        case 'f':
+            if (count >= 2 && operands_[count - 2].kind == Kind::Name) {
+                const Token& name = operands_[count - 2];
+                state_.font.assign(data_.data() + name.offset, name.length);
+                state_.fontSize = number(1);
+            }
+            break;
+        case 'L':
+            if (count >= 1) {
+                state_.leading = number(1);
+            }
+            break;
+        case 'D':
+            if (count >= 2) {
+                state_.leading = -number(1);
+                nextLine(number(2), number(1));
+            }
+            break;
+        case 'd':
+            if (count >= 2) {
+                nextLine(number(2), number(1));
+            }
+            break;
+        case 'm':
+            if (count >= 6) {
+                lineMatrix_ = Matrix{number(6), number(5), number(4), number(3), number(2), number(1)};
+                textMatrix_ = lineMatrix_;
+            }
+            break;
+        case '*':
+            nextLine(0.0, -state_.leading);
+            break;
+        case 'j':
+        case 'J':
+            show(onRun);
+            break;
+        default:
+            break;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void PDFTextExtractor::appendString(const Token& token) {
+    std::string_view raw = data_.substr(token.offset, token.length);
+    if (token.kind == Kind::HexString) {
+        int high = -1;
+        for (char c : raw) {
+            int digit = hexDigit(c);
+            if (digit < 0) continue;
+            if (high < 0) {
+                high = digit;
+            } else {
+                text_.push_back(static_cast<char>(high << 4 | digit));
+                high = -1;
+            }
+        }
+        if (high >= 0) {
+            text_.push_back(static_cast<char>(high << 4)); // An odd final digit is followed by 0
+        }
+        return;
+    }
+    for (size_t i = 0; i < raw.size(); ++i) {
+        char c = raw[i];
+        if (c == '\r') {
+            // An unescaped end of line of any kind reads as \n
+            if (i + 1 < raw.size() && raw[i + 1] == '\n') ++i;
+            text_.push_back('\n');
+            continue;
+        }
+        if (c != '\\' || i + 1 >= raw.size()) {
+            text_.push_back(c);
+            continue;
+        }
+        c = raw[++i];
+        switch (c) {
+        case 'n': text_.push_back('\n'); break;
+        case 'r': text_.push_back('\r'); break;
+        case 't': text_.push_back('\t'); break;
+        case 'b': text_.push_back('\b'); break;
+        case 'f': text_.push_back('\f'); break;
+        case '\r':
+            if (i + 1 < raw.size() && raw[i + 1] == '\n') ++i;
+            break; // Line continuation
+        case '\n':
+            break;
+        default:
+            if (c >= '0' && c <= '7') {
+                int value = c - '0';
+                for (int digits = 1; digits < 3 && i + 1 < raw.size() && raw[i + 1] >= '0' && raw[i + 1] <= '7'; ++digits) {
+                    value = value * 8 + (raw[++i] - '0');
+                }
+                text_.push_back(static_cast<char>(value));
+            } else {
+                text_.push_back(c); // \( \) \\ and unknown escapes stand for the character
+            }
+            break;
+        }
+    }
+}
+
+void PDFTextExtractor::show(const TextRunHandler& onRun) {
+    text_.clear();
+    const size_t count = operands_.size();
+    if (count == 0) {
+        return;
+    }
+    const Token& last = operands_[count - 1];
+    if (last.kind == Kind::String || last.kind == Kind::HexString) {
+        // Tj, ' and " show their last operand
+        appendString(last);
+    } else if (last.kind == Kind::ArrayEnd) {
+        // TJ: the strings of the array, with wide gaps read as word breaks
+        size_t begin = count - 1;
+        while (begin > 0 && operands_[begin - 1].kind != Kind::ArrayBegin) --begin;
+        for (size_t i = begin; i + 1 < count; ++i) {
+            const Token& element = operands_[i];
+            if (element.kind == Kind::String || element.kind == Kind::HexString) {
+                appendString(element);
+            } else if (element.kind == Kind::Number && element.number <= -WORD_GAP && !text_.empty() &&
+                       text_.back() != ' ') {
+                text_.push_back(' ');
+            }
+        }
+    }
+    if (text_.empty()) {
+        return;
+    }
+
+    // Text space to user space: the text matrix, then the CTM
+    const Matrix& t = textMatrix_;
+    const Matrix& m = state_.ctm;
+    TextRun run;
+    run.text = text_;
+    run.font = state_.font;
+    run.fontSize = state_.fontSize;
+    run.x = t.e * m.a + t.f * m.c + m.e;
+    run.y = t.e * m.b + t.f * m.d + m.f;
+    run.size = state_.fontSize * std::hypot(t.c * m.a + t.d * m.c, t.c * m.b + t.d * m.d);
+    ++runs_;
+    onRun(run);
+}
+
+} // namespace PDF
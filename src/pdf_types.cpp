@@ -1,10 +1,20 @@
 #include "pdf_types.h"
+#include "pdf_object_stream.h"
+#include "log.h"
 #include <stdexcept>
 #include <sstream>
 #include <iomanip>
+#include <thread>
+#include <unordered_set>
 
 namespace PDF {
 
+PDFBytes::PDFBytes(std::string bytes) {
+    auto owned = std::make_shared<const std::string>(std::move(bytes));
+    view_ = *owned;
+    owner_ = std::move(owned);
+}
+
 bool PDFObject::asBoolean() const {
     if (type_ != ObjectType::BOOLEAN) {
         throw std::runtime_error("Object is not a boolean");
@@ -68,6 +78,27 @@ PDFReference PDFObject::asReference() const {
     return std::get<PDFReference>(value_);
 }
 
+const PDFArray& PDFObject::getArray() const {
+    if (type_ != ObjectType::ARRAY) {
+        throw std::runtime_error("Object is not an array");
+    }
+    return std::get<PDFArray>(value_);
+}
+
+const PDFDictionary& PDFObject::getDictionary() const {
+    if (type_ != ObjectType::DICTIONARY) {
+        throw std::runtime_error("Object is not a dictionary");
+    }
+    return std::get<PDFDictionary>(value_);
+}
+
+const PDFStream& PDFObject::getStream() const {
+    if (type_ != ObjectType::STREAM) {
+        throw std::runtime_error("Object is not a stream");
+    }
+    return std::get<PDFStream>(value_);
+}
+
 bool PDFObject::hasKey(const std::string& key) const {
     if (type_ != ObjectType::DICTIONARY) {
         return false;
@@ -176,7 +207,7 @@ std::string PDFObject::toString() const {
             for (const auto& pair : stream.dict) {
                 oss << " /" << pair.first << " " << pair.second->toString();
             }
-            oss << " >>\nstream\n" << stream.data << "\nendstream";
+            oss << " >>\nstream\n" << stream.data.view() << "\nendstream";
             return oss.str();
         }
         case ObjectType::REFERENCE: {
@@ -190,4 +221,231 @@ std::string PDFObject::toString() const {
     }
 }
 
-} // namespace PDF 
\ No newline at end of file
+XRefEntry& XRefEntry::operator=(const XRefEntry& other) {
+    type = other.type;
+    generation = other.generation;
+    index = other.index;
+    offset = other.offset;
+    streamNumber = other.streamNumber;
+    object = other.object;
+    state_.store(other.isLoaded() ? READY : EMPTY, std::memory_order_relaxed);
+    return *this;
+}
+
+XRefEntry XRefEntry::inUse(uint64_t offset, uint16_t generation) {
+    XRefEntry entry;
+    entry.type = Type::InUse;
+    entry.offset = offset;
+    entry.generation = generation;
+    return entry;
+}
+
+XRefEntry XRefEntry::compressed(int streamNumber, uint32_t index) {
+    XRefEntry entry;
+    entry.type = Type::Compressed;
+    entry.streamNumber = streamNumber;
+    entry.index = index;
+    return entry;
+}
+
+PDFObjectPtr XRefEntry::publish(PDFObjectPtr parsed) {
+    uint8_t expected = EMPTY;
+    if (state_.compare_exchange_strong(expected, WRITING, std::memory_order_acquire)) {
+        object = std::move(parsed);
+        state_.store(READY, std::memory_order_release);
+        return object;
+    }
+    // Another thread parsed it too and is storing its copy; that one is kept
+    while (state_.load(std::memory_order_acquire) != READY) {
+        std::this_thread::yield();
+    }
+    return object;
+}
+
+PDFObjectPtr PDFDocument::getObject(int objectNumber) {
+    if (objectNumber < 0 || static_cast<size_t>(objectNumber) >= xref.size()) {
+        return nullptr;
+    }
+    XRefEntry& entry = xref[objectNumber];
+    if (entry.isLoaded()) {
+        return entry.object;
+    }
+    
+    PDFObjectPtr obj;
+    switch (entry.type) {
+        case XRefEntry::Type::Free:
+            return nullptr;
+        case XRefEntry::Type::InUse:
+            if (!objectLoader) {
+                return nullptr;
+            }
+            obj = objectLoader(entry.offset, objectNumber, entry.generation);
+            break;
+        case XRefEntry::Type::Compressed: {
+            // Object streams themselves are never compressed, which also rules out cycles
+            const int streamNumber = entry.streamNumber;
+            if (!objectStreams || streamNumber < 0 || static_cast<size_t>(streamNumber) >= xref.size() ||
+                xref[streamNumber].type != XRefEntry::Type::InUse) {
+                return nullptr;
+            }
+            std::shared_ptr<const ObjectStream> stream = objectStreams->get(streamNumber, [&] {
+                PDFObjectPtr streamObj = getObject(streamNumber);
+                try {
+                    if (streamObj && streamObj->isStream()) {
+                        return ObjectStream::decode(streamObj->getStream());
+                    }
+                    PS_LOG_DEBUG(Parser, "Object " << streamNumber << " is not an object stream");
+                } catch (const std::exception& e) {
+                    PS_LOG_DEBUG(Parser, "Object stream " << streamNumber << " unusable: " << e.what());
+                }
+                // Cache the failure as an empty stream so it is not decoded again
+                return std::make_shared<const ObjectStream>();
+            });
+            Memory::ArenaScope scope(arena.get());
+            obj = stream->parseObject(stream->find(objectNumber, entry.index));
+            break;
+        }
+    }
+    return entry.publish(std::move(obj));
+}
+
+size_t PDFDocument::getObjectCount() const {
+    size_t count = 0;
+    for (const XRefEntry& entry : xref) {
+        count += entry.type != XRefEntry::Type::Free;
+    }
+    return count;
+}
+
+size_t PDFDocument::getLoadedObjectCount() const {
+    size_t count = 0;
+    for (const XRefEntry& entry : xref) {
+        count += entry.isLoaded();
+    }
+    return count;
+}
+
+PDFObjectPtr PDFDocument::resolve(const PDFObjectPtr& obj) {
+    if (!obj) return nullptr;
+    if (obj->isReference()) {
+        return getObject(obj->asReference().objectNumber);
+    }
+    return obj;
+}
+
+PDFObjectPtr PDFDocument::resolveKey(const PDFObjectPtr& dict, const std::string& key) {
+    if (!dict) return nullptr;
+    const PDFDictionary* entries = nullptr;
+    if (dict->isDictionary()) {
+        entries = &dict->getDictionary();
+    } else if (dict->isStream()) {
+        entries = &dict->getStream().dict;
+    } else {
+        return nullptr;
+    }
+    auto it = entries->find(key);
+    if (it == entries->end()) return nullptr;
+    return resolve(it->second);
+}
+
+PDFObjectPtr PDFDocument::getCatalog() {
+    if (rootObjectNumber <= 0) return nullptr;
+    return getObject(rootObjectNumber);
+}
+
+namespace {
+
+bool isNodeOfType(PDFDocument& document, const PDFObjectPtr& node, const std::string& type) {
+    PDFObjectPtr typeObj = document.resolveKey(node, "Type");
+    return typeObj && typeObj->isName() && typeObj->asName().value == type;
+}
+
+size_t nodePageCount(PDFDocument& document, const PDFObjectPtr& node) {
+    if (isNodeOfType(document, node, "Page")) return 1;
+    PDFObjectPtr count = document.resolveKey(node, "Count");
+    if (count && count->isInteger() && count->asInteger() > 0) {
+        return static_cast<size_t>(count->asInteger());
+    }
+    return 0;
+}
+
+// Each node is visited once, so a tree that refers back to itself cannot fan out
+void collectPages(PDFDocument& document, const PDFObjectPtr& node, std::vector<PDFObjectPtr>& pages,
+                  std::unordered_set<const PDFObject*>& visited, size_t limit, int depth) {
+    if (!node || !node->isDictionary() || depth > 64 || pages.size() >= limit ||
+        !visited.insert(node.get()).second) {
+        return;
+    }
+    if (isNodeOfType(document, node, "Page")) {
+        pages.push_back(node);
+        return;
+    }
+    PDFObjectPtr kids = document.resolveKey(node, "Kids");
+    if (!kids || !kids->isArray()) return;
+    for (const auto& kid : kids->getArray()) {
+        collectPages(document, document.resolve(kid), pages, visited, limit, depth + 1);
+    }
+}
+
+} // namespace
+
+size_t PDFDocument::getPageCount() {
+    PDFObjectPtr pages = resolveKey(getCatalog(), "Pages");
+    if (!pages) return 0;
+    size_t count = nodePageCount(*this, pages);
+    // Without a usable /Count the tree itself is the only answer
+    return count > 0 ? count : getPages().size();
+}
+
+PDFObjectPtr PDFDocument::getPage(size_t index) {
+    PDFObjectPtr node = resolveKey(getCatalog(), "Pages");
+    std::unordered_set<const PDFObject*> visited;
+    for (int depth = 0; node && depth <= 64 && visited.insert(node.get()).second; ++depth) {
+        if (isNodeOfType(*this, node, "Page")) {
+            return index == 0 ? node : nullptr;
+        }
+        PDFObjectPtr kids = resolveKey(node, "Kids");
+        if (!kids || !kids->isArray()) return nullptr;
+        
+        PDFObjectPtr next = nullptr;
+        for (const auto& kidRef : kids->getArray()) {
+            PDFObjectPtr kid = resolve(kidRef);
+            // A kid that is one of its own ancestors holds no pages of its own, as in getPages
+            if (!kid || !kid->isDictionary() || visited.count(kid.get())) continue;
+            size_t count = nodePageCount(*this, kid);
+            if (index < count) {
+                next = kid;
+                break;
+            }
+            index -= count;
+        }
+        node = next;
+    }
+    return nullptr;
+}
+
+std::vector<PDFObjectPtr> PDFDocument::getPages() {
+    std::vector<PDFObjectPtr> pages;
+    PDFObjectPtr root = resolveKey(getCatalog(), "Pages");
+    // The root's /Count bounds the list, so it agrees with getPageCount
+    size_t count = root ? nodePageCount(*this, root) : 0;
+    std::unordered_set<const PDFObject*> visited;
+    collectPages(*this, root, pages, visited, count > 0 ? count : SIZE_MAX, 0);
+    return pages;
+}
+
+PDFObjectPtr PDFDocument::findInheritedEntry(const PDFObjectPtr& page, const std::string& key) {
+    PDFObjectPtr node = page;
+    std::unordered_set<const PDFObject*> visited;
+    for (int depth = 0; node && node->isDictionary() && depth <= 64 && visited.insert(node.get()).second; ++depth) {
+        const PDFDictionary& entries = node->getDictionary();
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            return it->second;
+        }
+        node = resolveKey(node, "Parent");
+    }
+    return nullptr;
+}
+
+} // namespace PDF 
@@ -0,0 +1,279 @@
+#include "profiler.h"
+#include "ps_names.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace Profiling {
+
+namespace detail {
+std::atomic<bool> enabled{false};
+}
+
+namespace {
+
+constexpr size_t KIND_COUNT = 3;
+
+uint64_t now() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+}
+
+// Written only by the owning thread; atomic so report() can read it meanwhile
+struct Counter {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> self{0};
+    uint32_t active = 0; // Open scopes for this counter (owner only)
+};
+
+struct Frame {
+    Counter* counter;
+    uint64_t children; // Time spent in scopes nested directly inside
+    uint64_t start;
+};
+
+struct Totals {
+    uint64_t calls = 0;
+    uint64_t total = 0;
+    uint64_t self = 0;
+};
+
+using TotalsMap = std::map<std::pair<Kind, uint32_t>, Totals>;
+
+class ThreadProfile;
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<ThreadProfile*> threads;
+    TotalsMap retired;     // Collected from threads that have exited
+    uint64_t onTime = 0;   // Collection time before onSince
+    uint64_t onSince = 0;  // When collection was last turned on, 0 while off
+};
+
+// Never destroyed, so threads that exit during static destruction can still retire
+Registry& registry() {
+    static Registry* instance = new Registry;
+    return *instance;
+}
+
+/**
+ * One thread's counters, indexed by kind and id. The owner grows a table
+ * only under mutex_, which report() also holds, and deque growth leaves
+ * existing counters in place.
+ */
+class ThreadProfile {
+public:
+    ThreadProfile() {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        registry().threads.push_back(this);
+    }
+
+    ~ThreadProfile() {
+        Registry& shared = registry();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        collect(shared.retired);
+        shared.threads.erase(std::find(shared.threads.begin(), shared.threads.end(), this));
+    }
+
+    Counter& counter(Kind kind, uint32_t id) {
+        std::deque<Counter>& table = tables_[static_cast<size_t>(kind)];
+        if (id >= table.size()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            while (table.size() <= id) {
+                table.emplace_back();
+            }
+        }
+        return table[id];
+    }
+
+    void collect(TotalsMap& into) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t kind = 0; kind < KIND_COUNT; ++kind) {
+            for (size_t id = 0; id < tables_[kind].size(); ++id) {
+                const Counter& counter = tables_[kind][id];
+                uint64_t calls = counter.calls.load(std::memory_order_relaxed);
+                if (calls == 0) {
+                    continue;
+                }
+                Totals& totals = into[{static_cast<Kind>(kind), static_cast<uint32_t>(id)}];
+                totals.calls += calls;
+                totals.total += counter.total.load(std::memory_order_relaxed);
+                totals.self += counter.self.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& table : tables_) {
+            for (Counter& counter : table) {
+                counter.calls.store(0, std::memory_order_relaxed);
+                counter.total.store(0, std::memory_order_relaxed);
+                counter.self.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::vector<Frame> frames; // Open scopes, innermost last (owner only)
+
+private:
+    std::mutex mutex_;
+    std::deque<Counter> tables_[KIND_COUNT];
+};
+
+ThreadProfile& local() {
+    thread_local ThreadProfile profile;
+    return profile;
+}
+
+const char* phaseName(uint32_t phase) {
+    switch (static_cast<Phase>(phase)) {
+        case Phase::XRef: return "xref";
+        case Phase::Object: return "object";
+        case Phase::Decompress: return "decompress";
+        case Phase::Page: return "page";
+    }
+    return "?";
+}
+
+void writeString(std::ostream& out, const std::string& text) {
+    static const char HEX[] = "0123456789abcdef";
+    out << '"';
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (c < 0x20) {
+            out << "\\u00" << HEX[c >> 4] << HEX[c & 15];
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+void writeEntries(std::ostream& out, const char* key, const std::vector<Entry>& entries) {
+    out << "  \"" << key << "\": [";
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const Entry& entry = entries[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": ";
+        writeString(out, entry.name);
+        out << ", \"calls\": " << entry.calls << ", \"total_ns\": " << entry.totalNanoseconds
+            << ", \"self_ns\": " << entry.selfNanoseconds << '}';
+    }
+    out << (entries.empty() ? "]" : "\n  ]");
+}
+
+} // namespace
+
+void setEnabled(bool enabled) {
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    if (enabled && !shared.onSince) {
+        shared.onSince = now();
+    } else if (!enabled && shared.onSince) {
+        shared.onTime += now() - shared.onSince;
+        shared.onSince = 0;
+    }
+    detail::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void reset() {
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    shared.retired.clear();
+    for (ThreadProfile* profile : shared.threads) {
+        profile->clear();
+    }
+    shared.onTime = 0;
+    if (shared.onSince) {
+        shared.onSince = now();
+    }
+}
+
+void Scope::enter(Kind kind, uint32_t id) {
+    ThreadProfile& profile = local();
+    Counter& counter = profile.counter(kind, id);
+    ++counter.active;
+    active_ = true;
+    // Read the clock last so the bookkeeping above is not charged to the call
+    profile.frames.push_back(Frame{&counter, 0, now()});
+}
+
+void Scope::leave() {
+    const uint64_t end = now();
+    active_ = false;
+    ThreadProfile& profile = local();
+    Frame frame = profile.frames.back();
+    profile.frames.pop_back();
+
+    const uint64_t elapsed = end - frame.start;
+    Counter& counter = *frame.counter;
+    counter.calls.fetch_add(1, std::memory_order_relaxed);
+    counter.self.fetch_add(elapsed > frame.children ? elapsed - frame.children : 0, std::memory_order_relaxed);
+    // A recursive call's time is already part of its outermost call
+    if (--counter.active == 0) {
+        counter.total.fetch_add(elapsed, std::memory_order_relaxed);
+    }
+    if (!profile.frames.empty()) {
+        profile.frames.back().children += elapsed;
+    }
+}
+
+Report report() {
+    Report result;
+    TotalsMap totals;
+    {
+        Registry& shared = registry();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        totals = shared.retired;
+        for (ThreadProfile* profile : shared.threads) {
+            profile->collect(totals);
+        }
+        result.elapsedNanoseconds = shared.onTime + (shared.onSince ? now() - shared.onSince : 0);
+    }
+
+    for (const auto& [key, value] : totals) {
+        Entry entry;
+        entry.name = key.first == Kind::Phase ? phaseName(key.second)
+                                              : PostScript::NameTable::global().name(key.second);
+        entry.calls = value.calls;
+        entry.totalNanoseconds = value.total;
+        entry.selfNanoseconds = value.self;
+        switch (key.first) {
+            case Kind::Operator:
+                result.operators.push_back(std::move(entry));
+                break;
+            case Kind::Procedure:
+                result.procedures.push_back(std::move(entry));
+                break;
+            case Kind::Phase:
+                result.phases.push_back(std::move(entry));
+                break;
+        }
+    }
+
+    auto bySelfTime = [](const Entry& a, const Entry& b) {
+        return a.selfNanoseconds != b.selfNanoseconds ? a.selfNanoseconds > b.selfNanoseconds : a.name < b.name;
+    };
+    std::sort(result.operators.begin(), result.operators.end(), bySelfTime);
+    std::sort(result.procedures.begin(), result.procedures.end(), bySelfTime);
+    std::sort(result.phases.begin(), result.phases.end(), bySelfTime);
+    return result;
+}
+
+void Report::writeJSON(std::ostream& out) const {
+    out << "{\n  \"elapsed_ns\": " << elapsedNanoseconds << ",\n";
+    writeEntries(out, "operators", operators);
+    out << ",\n";
+    writeEntries(out, "procedures", procedures);
+    out << ",\n";
+    writeEntries(out, "phases", phases);
+    out << "\n}\n";
+}
+
+} // namespace Profiling
@@ -0,0 +1,310 @@
+#include "ps_batch.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PS_BATCH_SOCKETS 1
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace PostScript {
+
+namespace {
+
+constexpr size_t PAYLOAD_CHUNK = 64 * 1024;
+
+// Next request, skipping empty lines; false at the end of the input
+bool readJob(std::istream& in, BatchJob& job) {
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+        job.path.clear();
+        job.program.clear();
+        if (line.compare(0, 5, "exec ") != 0) {
+            job.path = line;
+            return true;
+        }
+        size_t length = 0;
+        const char* end = line.data() + line.size();
+        auto parsed = std::from_chars(line.data() + 5, end, length);
+        if (parsed.ec != std::errc() || parsed.ptr != end) {
+            // Where the payload ends is unknown, so nothing after this line can be framed
+            in.setstate(std::ios::failbit);
+            throw std::runtime_error("Malformed request: " + line);
+        }
+        // Grow with what actually arrives rather than trusting the length up front
+        while (job.program.size() < length) {
+            size_t used = job.program.size();
+            size_t chunk = std::min(PAYLOAD_CHUNK, length - used);
+            job.program.resize(used + chunk);
+            in.read(&job.program[used], static_cast<std::streamsize>(chunk));
+            if (static_cast<size_t>(in.gcount()) != chunk) {
+                throw std::runtime_error("Input ended inside an exec payload");
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+void writeResult(std::ostream& out, const BatchResult& result) {
+    out << "job " << result.id << (result.succeeded ? " ok " : " error ") << result.output.size();
+    if (!result.succeeded) {
+        std::string message = result.error;
+        std::replace(message.begin(), message.end(), '\n', ' ');
+        out << ' ' << message;
+    }
+    out << '\n' << result.output;
+    out.flush();
+}
+
+#if PS_BATCH_SOCKETS
+
+// Buffered stream over a connected socket, closed on destruction
+class SocketBuffer : public std::streambuf {
+public:
+    explicit SocketBuffer(int fd) : fd_(fd) {
+        setg(input_, input_, input_);
+        setp(output_, output_ + sizeof(output_));
+    }
+    ~SocketBuffer() override {
+        sync();
+        ::close(fd_);
+    }
+
+protected:
+    int underflow() override {
+        ssize_t got;
+        do {
+            got = ::recv(fd_, input_, sizeof(input_), 0);
+        } while (got < 0 && errno == EINTR);
+        if (got <= 0) {
+            return traits_type::eof();
+        }
+        setg(input_, input_, input_ + got);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    int overflow(int c) override {
+        if (sync() != 0) {
+            return traits_type::eof();
+        }
+        if (c != traits_type::eof()) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override {
+#ifdef MSG_NOSIGNAL
+        const int flags = MSG_NOSIGNAL; // A client that hung up must not kill the server
+#else
+        const int flags = 0;
+#endif
+        for (char* next = pbase(); next < pptr();) {
+            ssize_t sent = ::send(fd_, next, static_cast<size_t>(pptr() - next), flags);
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent <= 0) {
+                return -1;
+            }
+            next += sent;
+        }
+        setp(output_, output_ + sizeof(output_));
+        return 0;
+    }
+
+private:
+    int fd_;
+    char input_[PAYLOAD_CHUNK];
+    char output_[PAYLOAD_CHUNK];
+};
+
+#endif // PS_BATCH_SOCKETS
+
+} // namespace
+
+InterpreterPool::InterpreterPool(size_t size, const std::string& prolog) {
+    if (size == 0) {
+        size = Threading::ThreadPool::hardwareThreads();
+    }
+    for (size_t i = 0; i < size; ++i) {
+        auto worker = std::make_unique<Worker>();
+        worker->interpreter.setOutput(worker->output);
+        if (!prolog.empty()) {
+            try {
+                worker->interpreter.execute(prolog);
+            } catch (const std::exception& e) {
+                throw std::runtime_error(std::string("Prolog failed: ") + e.what());
+            }
+        }
+        worker->operands = worker->interpreter.getStack();
+        idle_.push_back(worker.get());
+        workers_.push_back(std::move(worker));
+    }
+}
+
+BatchResult InterpreterPool::run(const BatchJob& job) {
+    Worker* worker = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        available_.wait(lock, [this]() { return !idle_.empty(); });
+        worker = idle_.back();
+        idle_.pop_back();
+    }
+
+    BatchResult result;
+    result.id = job.id;
+    worker->output.str("");
+    worker->output.clear();
+    PSSave save = worker->interpreter.save();
+    try {
+        if (!job.path.empty()) {
+            worker->interpreter.executeFile(job.path);
+        } else {
+            worker->interpreter.execute(job.program);
+        }
+    } catch (const std::exception& e) {
+        result.succeeded = false;
+        result.error = e.what();
+    }
+    result.output = worker->output.str();
+    // The operand stack is not part of a save, so it is put back separately
+    worker->interpreter.getStack() = worker->operands;
+    worker->interpreter.restore(save);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle_.push_back(worker);
+    }
+    available_.notify_one();
+    return result;
+}
+
+BatchServer::BatchServer(InterpreterPool& interpreters)
+    : interpreters_(interpreters), threads_(interpreters.size()) {}
+
+uint64_t BatchServer::serve(std::istream& in, std::ostream& out) {
+    // Enough queued work to keep every interpreter busy while earlier responses are written
+    const size_t maxPending = 2 * interpreters_.size();
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::future<BatchResult>> pending;
+    bool finished = false;
+
+    // Responses go out in request order, each as soon as it is ready
+    std::thread writer([&]() {
+        while (true) {
+            std::future<BatchResult> next;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return !pending.empty() || finished; });
+                if (pending.empty()) {
+                    return;
+                }
+                next = std::move(pending.front());
+                pending.pop_front();
+            }
+            changed.notify_all();
+            writeResult(out, next.get());
+        }
+    });
+
+    uint64_t count = 0;
+    while (true) {
+        std::future<BatchResult> result;
+        BatchJob job;
+        try {
+            if (!readJob(in, job)) {
+                break;
+            }
+            job.id = ++count;
+            result = threads_.submit([this, job = std::move(job)]() { return interpreters_.run(job); });
+        } catch (const std::exception& e) {
+            // A bad request still gets a response, so later ids stay in step
+            std::promise<BatchResult> failed;
+            BatchResult response;
+            response.id = ++count;
+            response.succeeded = false;
+            response.error = e.what();
+            failed.set_value(std::move(response));
+            result = failed.get_future();
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() { return pending.size() < maxPending; });
+            pending.push_back(std::move(result));
+        }
+        changed.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+    }
+    changed.notify_all();
+    writer.join();
+    return count;
+}
+
+void BatchServer::listen(const std::string& path) {
+#if PS_BATCH_SOCKETS
+    sockaddr_un address{};
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Invalid socket path: " + path);
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        throw std::runtime_error(std::string("Cannot create socket: ") + std::strerror(errno));
+    }
+    ::unlink(path.c_str());
+    if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 ||
+        ::listen(listener, SOMAXCONN) < 0) {
+        int error = errno;
+        ::close(listener);
+        throw std::runtime_error("Cannot listen on " + path + ": " + std::strerror(error));
+    }
+
+    while (true) {
+        int connection = ::accept(listener, nullptr, nullptr);
+        if (connection < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            int error = errno;
+            ::close(listener);
+            throw std::runtime_error(std::string("Cannot accept connections: ") + std::strerror(error));
+        }
+        // Connections share the interpreters; each keeps its own job numbering
+        std::thread([this, connection]() {
+            auto buffer = std::make_unique<SocketBuffer>(connection);
+            std::istream in(buffer.get());
+            std::ostream out(buffer.get());
+            serve(in, out);
+        }).detach();
+    }
+#else
+    (void)path;
+    throw std::runtime_error("Socket mode needs a POSIX system");
+#endif
+}
+
+} // namespace PostScript
@@ -0,0 +1,261 @@
+#include "ps_display_list.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace PostScript {
+
+namespace {
+
+// Stream layout: magic, version, then records until End. Each record is a
+// tag byte and its payload; integers are little-endian, reals IEEE 754
+// doubles stored as little-endian 64-bit integers.
+constexpr char MAGIC[4] = {'P', 'S', 'D', 'L'};
+constexpr uint32_t VERSION = 1;
+
+enum class Tag : uint8_t {
+    End,
+    Matrix,    // 6 reals: the CTM of the following commands
+    Color,     // 3 reals
+    LineWidth, // 1 real
+    Path,      // u32 verb count, verbs (one byte each), then 2 reals per point
+    Fill,      // Paint with the current state and path
+    EOFill,
+    Stroke,
+    ShowPage
+};
+
+// Bounds verb counts read from untrusted data before anything is allocated
+constexpr uint32_t MAX_VERBS = 1u << 24;
+
+class Writer {
+public:
+    explicit Writer(std::ostream& out) : out_(out) {}
+
+    void tag(Tag value) { byte(static_cast<uint8_t>(value)); }
+    void byte(uint8_t value) { out_.put(static_cast<char>(value)); }
+
+    void u32(uint32_t value) {
+        char bytes[4];
+        for (int i = 0; i < 4; ++i) {
+            bytes[i] = static_cast<char>(value >> (8 * i));
+        }
+        out_.write(bytes, sizeof(bytes));
+    }
+
+    void real(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        char bytes[8];
+        for (int i = 0; i < 8; ++i) {
+            bytes[i] = static_cast<char>(bits >> (8 * i));
+        }
+        out_.write(bytes, sizeof(bytes));
+    }
+
+private:
+    std::ostream& out_;
+};
+
+class Reader {
+public:
+    explicit Reader(std::istream& in) : in_(in) {}
+
+    void bytes(char* data, size_t count) {
+        if (!in_.read(data, static_cast<std::streamsize>(count))) {
+            throw std::runtime_error("Display list: unexpected end of data");
+        }
+    }
+
+    uint8_t byte() {
+        char value;
+        bytes(&value, 1);
+        return static_cast<uint8_t>(value);
+    }
+
+    uint32_t u32() {
+        unsigned char data[4];
+        bytes(reinterpret_cast<char*>(data), sizeof(data));
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            value |= static_cast<uint32_t>(data[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    double real() {
+        unsigned char data[8];
+        bytes(reinterpret_cast<char*>(data), sizeof(data));
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; ++i) {
+            bits |= static_cast<uint64_t>(data[i]) << (8 * i);
+        }
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+private:
+    std::istream& in_;
+};
+
+Tag paintTag(PaintCommand::Operation operation) {
+    switch (operation) {
+        case PaintCommand::Operation::Fill:
+            return Tag::Fill;
+        case PaintCommand::Operation::EOFill:
+            return Tag::EOFill;
+        case PaintCommand::Operation::Stroke:
+            break;
+    }
+    return Tag::Stroke;
+}
+
+} // namespace
+
+void DisplayList::write(std::ostream& out) const {
+    Writer writer(out);
+    out.write(MAGIC, sizeof(MAGIC));
+    writer.u32(VERSION);
+
+    const PaintCommand* previous = nullptr;
+    bool lineWidthWritten = false;  // Fills leave the line width out
+    double lineWidth = 0;
+    size_t page = 0;
+    for (size_t i = 0; i <= commands_.size(); ++i) {
+        for (; page < pageEnds_.size() && pageEnds_[page] == i; ++page) {
+            writer.tag(Tag::ShowPage);
+        }
+        if (i == commands_.size()) {
+            break;
+        }
+
+        const PaintCommand& command = commands_[i];
+        if (!previous || command.ctm != previous->ctm) {
+            writer.tag(Tag::Matrix);
+            for (double value : command.ctm) {
+                writer.real(value);
+            }
+        }
+        if (!previous || command.r != previous->r || command.g != previous->g || command.b != previous->b) {
+            writer.tag(Tag::Color);
+            writer.real(command.r);
+            writer.real(command.g);
+            writer.real(command.b);
+        }
+        if (command.operation == PaintCommand::Operation::Stroke &&
+            (!lineWidthWritten || command.lineWidth != lineWidth)) {
+            writer.tag(Tag::LineWidth);
+            writer.real(command.lineWidth);
+            lineWidthWritten = true;
+            lineWidth = command.lineWidth;
+        }
+        // Copies of one path share their verb array
+        if (!previous || command.path.verbs() != previous->path.verbs()) {
+            writer.tag(Tag::Path);
+            writer.u32(static_cast<uint32_t>(command.path.size()));
+            for (size_t v = 0; v < command.path.size(); ++v) {
+                writer.byte(static_cast<uint8_t>(command.path.verbs()[v]));
+            }
+            for (size_t p = 0; p < command.path.pointCount(); ++p) {
+                writer.real(command.path.points()[p].x);
+                writer.real(command.path.points()[p].y);
+            }
+        }
+        writer.tag(paintTag(command.operation));
+        previous = &command;
+    }
+    writer.tag(Tag::End);
+    if (!out) {
+        throw std::runtime_error("Display list: write failed");
+    }
+}
+
+DisplayList DisplayList::read(std::istream& in) {
+    Reader reader(in);
+    char magic[sizeof(MAGIC)];
+    reader.bytes(magic, sizeof(magic));
+    if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Display list: bad signature");
+    }
+    uint32_t version = reader.u32();
+    if (version != VERSION) {
+        throw std::runtime_error("Display list: unsupported version " + std::to_string(version));
+    }
+
+    DisplayList list;
+    // The state a paint record uses, as in a fresh GraphicsState
+    PaintCommand state = PaintCommand::fromState(PaintCommand::Operation::Fill, GraphicsState());
+    while (true) {
+        Tag tag = static_cast<Tag>(reader.byte());
+        switch (tag) {
+            case Tag::End:
+                return list;
+            case Tag::Matrix:
+                for (double& value : state.ctm) {
+                    value = reader.real();
+                }
+                break;
+            case Tag::Color:
+                state.r = reader.real();
+                state.g = reader.real();
+                state.b = reader.real();
+                break;
+            case Tag::LineWidth:
+                state.lineWidth = reader.real();
+                break;
+            case Tag::Path: {
+                uint32_t count = reader.u32();
+                if (count > MAX_VERBS) {
+                    throw std::runtime_error("Display list: path too long");
+                }
+                std::vector<PSPath::Verb> verbs(count);
+                for (PSPath::Verb& verb : verbs) {
+                    uint8_t value = reader.byte();
+                    if (value > static_cast<uint8_t>(PSPath::Verb::ClosePath)) {
+                        throw std::runtime_error("Display list: bad path verb");
+                    }
+                    verb = static_cast<PSPath::Verb>(value);
+                }
+                PSPath path;
+                Point points[3];
+                for (PSPath::Verb verb : verbs) {
+                    for (size_t p = 0; p < PSPath::pointsPerVerb(verb); ++p) {
+                        points[p].x = reader.real();
+                        points[p].y = reader.real();
+                    }
+                    switch (verb) {
+                        case PSPath::Verb::MoveTo:
+                            path.moveTo(points[0]);
+                            break;
+                        case PSPath::Verb::LineTo:
+                            path.lineTo(points[0]);
+                            break;
+                        case PSPath::Verb::CurveTo:
+                            path.curveTo(points[0], points[1], points[2]);
+                            break;
+                        case PSPath::Verb::ClosePath:
+                            path.closePath();
+                            break;
+                    }
+                }
+                state.path = std::move(path);
+                break;
+            }
+            case Tag::Fill:
+            case Tag::EOFill:
+            case Tag::Stroke:
+                state.operation = tag == Tag::Fill     ? PaintCommand::Operation::Fill
+                                  : tag == Tag::EOFill ? PaintCommand::Operation::EOFill
+                                                       : PaintCommand::Operation::Stroke;
+                list.add(state);
+                break;
+            case Tag::ShowPage:
+                list.showpage();
+                break;
+            default:
+                throw std::runtime_error("Display list: bad record tag");
+        }
+    }
+}
+
+} // namespace PostScript
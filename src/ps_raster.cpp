@@ -0,0 +1,912 @@
+#include "ps_raster.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace PostScript {
+
+namespace {
+
+// --- Span kernels ---
+//
+// resolveSpan turns a row of accumulated signed areas into coverage with a
+// running sum, zeroing the cells as it goes; compositeSpan blends a colour
+// into RGBA8 pixels by coverage. Vector versions are chosen at compile time
+// (AVX2 needs -mavx2 or -march=native; SSE2 is the x86-64 baseline).
+
+inline float ruleCoverage(float winding, FillRule rule) {
+    if (rule == FillRule::NonZero) {
+        return std::min(std::fabs(winding), 1.0f);
+    }
+    // Distance to the nearest even winding number: 0..1 inside, 1..2 folds back
+    return std::fabs(winding - 2.0f * std::nearbyint(winding * 0.5f));
+}
+
+inline uint8_t div255(unsigned value) {
+    value += 128;
+    return static_cast<uint8_t>((value + (value >> 8)) >> 8);
+}
+
+void resolveSpanScalar(float* cells, float* coverage, int count, float& sum, FillRule rule) {
+    for (int i = 0; i < count; ++i) {
+        sum += cells[i];
+        cells[i] = 0.0f;
+        coverage[i] = ruleCoverage(sum, rule);
+    }
+}
+
+void compositeSpanScalar(uint8_t* pixels, const float* coverage, int count, const uint8_t color[4]) {
+    const float scale = static_cast<float>(color[3]);
+    for (int i = 0; i < count; ++i) {
+        unsigned alpha = static_cast<unsigned>(coverage[i] * scale + 0.5f);
+        if (alpha == 0) {
+            continue;
+        }
+        uint8_t* pixel = pixels + 4 * i;
+        if (alpha == 255) {
+            pixel[0] = color[0];
+            pixel[1] = color[1];
+            pixel[2] = color[2];
+            pixel[3] = 255;
+            continue;
+        }
+        for (int channel = 0; channel < 3; ++channel) {
+            pixel[channel] = div255(pixel[channel] * (255 - alpha) + color[channel] * alpha);
+        }
+        pixel[3] = div255(pixel[3] * (255 - alpha) + 255 * alpha);
+    }
+}
+
+#if defined(__SSE2__)
+
+inline __m128i div255(__m128i value) {
+    value = _mm_add_epi16(value, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(value, _mm_srli_epi16(value, 8)), 8);
+}
+
+void resolveSpan(float* cells, float* coverage, int count, FillRule rule) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 carry = zero;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // In-register prefix sum of four cells, plus the sum so far
+        __m128 x = _mm_loadu_ps(cells + i);
+        x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 4)));
+        x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 8)));
+        x = _mm_add_ps(x, carry);
+        carry = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 3, 3));
+        _mm_storeu_ps(cells + i, zero);
+        __m128 cover;
+        if (rule == FillRule::NonZero) {
+            cover = _mm_min_ps(_mm_and_ps(x, signMask), one);
+        } else {
+            __m128 nearestEven = _mm_mul_ps(two, _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, half))));
+            cover = _mm_and_ps(_mm_sub_ps(x, nearestEven), signMask);
+        }
+        _mm_storeu_ps(coverage + i, cover);
+    }
+    float sum = _mm_cvtss_f32(carry);
+    resolveSpanScalar(cells + i, coverage + i, count - i, sum, rule);
+}
+
+void compositeSpan(uint8_t* pixels, const float* coverage, int count, const uint8_t color[4]) {
+    const __m128 scale = _mm_set1_ps(static_cast<float>(color[3]));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(255);
+    const __m128i source = _mm_setr_epi16(color[0], color[1], color[2], 255, color[0], color[1], color[2], 255);
+    const __m128i solid = _mm_set1_epi32(static_cast<int>(
+        color[0] | (color[1] << 8) | (color[2] << 16) | (0xffu << 24)));
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256 scale8 = _mm256_set1_ps(static_cast<float>(color[3]));
+    const __m256i zero8 = _mm256_setzero_si256();
+    const __m256i full8 = _mm256_set1_epi16(255);
+    const __m256i source8 = _mm256_broadcastsi128_si256(source);
+    const __m256i solid8 = _mm256_broadcastsi128_si256(solid);
+    for (; i + 8 <= count; i += 8) {
+        __m256i alpha32 = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(coverage + i), scale8));
+        int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha32, zero8));
+        if (mask == -1) {
+            continue;
+        }
+        uint8_t* pixel = pixels + 4 * i;
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha32, _mm256_set1_epi32(255))) == -1) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixel), solid8);
+            continue;
+        }
+        // Per 128-bit lane: pixels 0,1 | 4,5 in the low half, 2,3 | 6,7 in the high
+        __m256i alpha16 = _mm256_packs_epi32(alpha32, alpha32);
+        alpha16 = _mm256_unpacklo_epi16(alpha16, alpha16);
+        __m256i alphaLow = _mm256_unpacklo_epi32(alpha16, alpha16);
+        __m256i alphaHigh = _mm256_unpackhi_epi32(alpha16, alpha16);
+        __m256i dst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixel));
+        __m256i low = _mm256_unpacklo_epi8(dst, zero8);
+        __m256i high = _mm256_unpackhi_epi8(dst, zero8);
+        low = _mm256_add_epi16(_mm256_mullo_epi16(low, _mm256_sub_epi16(full8, alphaLow)),
+                               _mm256_mullo_epi16(source8, alphaLow));
+        high = _mm256_add_epi16(_mm256_mullo_epi16(high, _mm256_sub_epi16(full8, alphaHigh)),
+                                _mm256_mullo_epi16(source8, alphaHigh));
+        low = _mm256_add_epi16(low, _mm256_set1_epi16(128));
+        low = _mm256_srli_epi16(_mm256_add_epi16(low, _mm256_srli_epi16(low, 8)), 8);
+        high = _mm256_add_epi16(high, _mm256_set1_epi16(128));
+        high = _mm256_srli_epi16(_mm256_add_epi16(high, _mm256_srli_epi16(high, 8)), 8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixel), _mm256_packus_epi16(low, high));
+    }
+#endif
+    for (; i + 4 <= count; i += 4) {
+        __m128i alpha32 = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(coverage + i), scale));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha32, zero)) == 0xffff) {
+            continue;
+        }
+        uint8_t* pixel = pixels + 4 * i;
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha32, _mm_set1_epi32(255))) == 0xffff) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pixel), solid);
+            continue;
+        }
+        // Each pixel's alpha repeated over its four channels, two pixels per register
+        __m128i alpha16 = _mm_packs_epi32(alpha32, alpha32);
+        alpha16 = _mm_unpacklo_epi16(alpha16, alpha16);
+        __m128i alphaLow = _mm_unpacklo_epi32(alpha16, alpha16);
+        __m128i alphaHigh = _mm_unpackhi_epi32(alpha16, alpha16);
+        __m128i dst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixel));
+        __m128i low = _mm_unpacklo_epi8(dst, zero);
+        __m128i high = _mm_unpackhi_epi8(dst, zero);
+        low = div255(_mm_add_epi16(_mm_mullo_epi16(low, _mm_sub_epi16(full, alphaLow)),
+                                   _mm_mullo_epi16(source, alphaLow)));
+        high = div255(_mm_add_epi16(_mm_mullo_epi16(high, _mm_sub_epi16(full, alphaHigh)),
+                                    _mm_mullo_epi16(source, alphaHigh)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixel), _mm_packus_epi16(low, high));
+    }
+    compositeSpanScalar(pixels + 4 * i, coverage + i, count - i, color);
+}
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+
+void resolveSpan(float* cells, float* coverage, int count, FillRule rule) {
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    float32x4_t carry = zero;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t x = vld1q_f32(cells + i);
+        x = vaddq_f32(x, vextq_f32(zero, x, 3));
+        x = vaddq_f32(x, vextq_f32(zero, x, 2));
+        x = vaddq_f32(x, carry);
+        carry = vdupq_laneq_f32(x, 3);
+        vst1q_f32(cells + i, zero);
+        float32x4_t cover;
+        if (rule == FillRule::NonZero) {
+            cover = vminq_f32(vabsq_f32(x), one);
+        } else {
+            float32x4_t nearestEven = vmulq_n_f32(vrndnq_f32(vmulq_n_f32(x, 0.5f)), 2.0f);
+            cover = vabsq_f32(vsubq_f32(x, nearestEven));
+        }
+        vst1q_f32(coverage + i, cover);
+    }
+    float sum = vgetq_lane_f32(carry, 0);
+    resolveSpanScalar(cells + i, coverage + i, count - i, sum, rule);
+}
+
+inline uint8x8_t blend(uint8x8_t dst, uint8x8_t source, uint8x8_t alpha, uint8x8_t inverse) {
+    uint16x8_t sum = vmlal_u8(vmull_u8(dst, inverse), source, alpha);
+    return vrshrn_n_u16(vrsraq_n_u16(sum, sum, 8), 8);
+}
+
+void compositeSpan(uint8_t* pixels, const float* coverage, int count, const uint8_t color[4]) {
+    const float scale = static_cast<float>(color[3]);
+    const uint8x8_t red = vdup_n_u8(color[0]);
+    const uint8x8_t green = vdup_n_u8(color[1]);
+    const uint8x8_t blue = vdup_n_u8(color[2]);
+    const uint8x8_t opaque = vdup_n_u8(255);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint32x4_t a0 = vcvtnq_u32_f32(vmulq_n_f32(vld1q_f32(coverage + i), scale));
+        uint32x4_t a1 = vcvtnq_u32_f32(vmulq_n_f32(vld1q_f32(coverage + i + 4), scale));
+        uint8x8_t alpha = vmovn_u16(vcombine_u16(vmovn_u32(a0), vmovn_u32(a1)));
+        if (vmaxv_u8(alpha) == 0) {
+            continue;
+        }
+        uint8_t* pixel = pixels + 4 * i;
+        uint8x8x4_t dst = vld4_u8(pixel);
+        uint8x8_t inverse = vsub_u8(opaque, alpha);
+        dst.val[0] = blend(dst.val[0], red, alpha, inverse);
+        dst.val[1] = blend(dst.val[1], green, alpha, inverse);
+        dst.val[2] = blend(dst.val[2], blue, alpha, inverse);
+        dst.val[3] = blend(dst.val[3], opaque, alpha, inverse);
+        vst4_u8(pixel, dst);
+    }
+    compositeSpanScalar(pixels + 4 * i, coverage + i, count - i, color);
+}
+
+#else
+
+void resolveSpan(float* cells, float* coverage, int count, FillRule rule) {
+    float sum = 0.0f;
+    resolveSpanScalar(cells, coverage, count, sum, rule);
+}
+
+void compositeSpan(uint8_t* pixels, const float* coverage, int count, const uint8_t color[4]) {
+    compositeSpanScalar(pixels, coverage, count, color);
+}
+
+#endif
+
+uint8_t toByte(double component) {
+    return static_cast<uint8_t>(std::lround(std::clamp(component, 0.0, 1.0) * 255.0));
+}
+
+} // namespace
+
+// --- Matrix ---
+
+Matrix Matrix::then(const Matrix& next) const {
+    Matrix m;
+    m.a = a * next.a + b * next.c;
+    m.b = a * next.b + b * next.d;
+    m.c = c * next.a + d * next.c;
+    m.d = c * next.b + d * next.d;
+    m.e = e * next.a + f * next.c + next.e;
+    m.f = e * next.b + f * next.d + next.f;
+    return m;
+}
+
+// --- Framebuffer ---
+
+Framebuffer::Framebuffer(int width, int height)
+    : width_(width), height_(height), pixels_(static_cast<size_t>(width) * height * 4) {}
+
+void Framebuffer::clear(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    for (size_t i = 0; i < pixels_.size(); i += 4) {
+        pixels_[i] = r;
+        pixels_[i + 1] = g;
+        pixels_[i + 2] = b;
+        pixels_[i + 3] = a;
+    }
+}
+
+void Framebuffer::writePAM(std::ostream& out) const {
+    out << "P7\nWIDTH " << width_ << "\nHEIGHT " << height_
+        << "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+    out.write(reinterpret_cast<const char*>(pixels_.data()), static_cast<std::streamsize>(pixels_.size()));
+}
+
+void Framebuffer::writePPM(std::ostream& out) const {
+    out << "P6\n" << width_ << ' ' << height_ << "\n255\n";
+    std::vector<char> rgb(static_cast<size_t>(width_) * 3);
+    for (int y = 0; y < height_; ++y) {
+        const uint8_t* pixel = row(y);
+        for (int x = 0; x < width_; ++x) {
+            rgb[3 * x] = static_cast<char>(pixel[4 * x]);
+            rgb[3 * x + 1] = static_cast<char>(pixel[4 * x + 1]);
+            rgb[3 * x + 2] = static_cast<char>(pixel[4 * x + 2]);
+        }
+        out.write(rgb.data(), static_cast<std::streamsize>(rgb.size()));
+    }
+}
+
+// --- Rasterizer ---
+
+void Rasterizer::reset(int width, int height) {
+    clearTouched();
+    width_ = width;
+    height_ = height;
+    stride_ = static_cast<size_t>(width) + 2;
+    const size_t cells = stride_ * static_cast<size_t>(height);
+    if (cells_.size() < cells) {
+        cells_.assign(cells, 0.0f);
+    }
+    if (coverage_.size() < stride_) {
+        coverage_.assign(stride_, 0.0f);
+    }
+    minX_ = width_;
+    maxX_ = -1;
+    minY_ = height_;
+    maxY_ = -1;
+}
+
+void Rasterizer::clearTouched() {
+    // Edges added but never filled; everything else is already zero
+    for (int y = minY_; y <= maxY_ && maxX_ >= minX_; ++y) {
+        std::fill_n(cells_.begin() + y * stride_ + minX_, maxX_ - minX_ + 1, 0.0f);
+    }
+}
+
+void Rasterizer::addLine(const Point& p0, const Point& p1) {
+    if (!std::isfinite(p0.x) || !std::isfinite(p0.y) || !std::isfinite(p1.x) || !std::isfinite(p1.y)) {
+        return;
+    }
+    // Far-off vertices are pulled in (consistently, so contours stay closed)
+    // to keep the clipping arithmetic finite
+    constexpr double LIMIT = 1e150;
+    double x0 = std::clamp(p0.x, -LIMIT, LIMIT), y0 = std::clamp(p0.y, -LIMIT, LIMIT);
+    double x1 = std::clamp(p1.x, -LIMIT, LIMIT), y1 = std::clamp(p1.y, -LIMIT, LIMIT);
+
+    // Rows above and below the area receive nothing, so those parts are cut off
+    const double bottom = height_;
+    if ((y0 <= 0 && y1 <= 0) || (y0 >= bottom && y1 >= bottom)) {
+        return;
+    }
+    if (y0 < 0 || y1 < 0 || y0 > bottom || y1 > bottom) {
+        const double dx = x1 - x0, dy = y1 - y0;
+        const double ta = -y0 / dy, tb = (bottom - y0) / dy;
+        const double tStart = std::clamp(std::min(ta, tb), 0.0, 1.0);
+        const double tEnd = std::clamp(std::max(ta, tb), 0.0, 1.0);
+        const double xStart = x0 + dx * tStart, yStart = std::clamp(y0 + dy * tStart, 0.0, bottom);
+        const double xEnd = x0 + dx * tEnd, yEnd = std::clamp(y0 + dy * tEnd, 0.0, bottom);
+        x0 = xStart;
+        y0 = yStart;
+        x1 = xEnd;
+        y1 = yEnd;
+    }
+    addClippedLine(x0, y0, x1, y1);
+}
+
+void Rasterizer::addClippedLine(double x0, double y0, double x1, double y1) {
+    // Parts outside the target are flattened onto its left or right border:
+    // on the left they still cover every pixel to their right, and on the
+    // right they end the spans that reach the border
+    const double right = width_;
+    if ((x0 >= 0 && x0 <= right && x1 >= 0 && x1 <= right) || (x0 <= 0 && x1 <= 0) ||
+        (x0 >= right && x1 >= right)) {
+        accumulate(std::clamp(x0, 0.0, right), y0, std::clamp(x1, 0.0, right), y1);
+        return;
+    }
+
+    // Split where the edge crosses the left and right borders
+    double splits[4] = {0.0, 0.0, 0.0, 0.0};
+    int count = 1;
+    for (double border : {0.0, right}) {
+        double t = (border - x0) / (x1 - x0);
+        if (t > 0.0 && t < 1.0) {
+            splits[count++] = t;
+        }
+    }
+    if (count == 3 && splits[1] > splits[2]) {
+        std::swap(splits[1], splits[2]);
+    }
+    splits[count++] = 1.0;
+    for (int i = 0; i + 1 < count; ++i) {
+        double ta = splits[i], tb = splits[i + 1];
+        double xa = x0 + (x1 - x0) * ta, ya = y0 + (y1 - y0) * ta;
+        double xb = x0 + (x1 - x0) * tb, yb = y0 + (y1 - y0) * tb;
+        double middle = 0.5 * (xa + xb);
+        if (middle <= 0) {
+            xa = xb = 0;
+        } else if (middle >= right) {
+            xa = xb = right;
+        }
+        accumulate(std::clamp(xa, 0.0, right), ya, std::clamp(xb, 0.0, right), yb);
+    }
+}
+
+void Rasterizer::accumulate(double x0, double y0, double x1, double y1) {
+    if (y0 == y1) {
+        return;
+    }
+    float direction = 1.0f;
+    if (y0 > y1) {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+        direction = -1.0f;
+    }
+    if (y1 <= 0 || y0 >= height_) {
+        return;
+    }
+    const double dxdy = (x1 - x0) / (y1 - y0);
+    double x = x0;
+    if (y0 < 0) {
+        x = std::clamp(x - y0 * dxdy, 0.0, static_cast<double>(width_));
+        y0 = 0;
+    }
+    const int yStart = static_cast<int>(y0);
+    const int yEnd = std::min(height_, static_cast<int>(std::ceil(y1)));
+    minY_ = std::min(minY_, yStart);
+    maxY_ = std::max(maxY_, yEnd - 1);
+
+    for (int y = yStart; y < yEnd; ++y) {
+        float* row = cells_.data() + y * stride_;
+        const double dy = std::min(y + 1.0, y1) - std::max(static_cast<double>(y), y0);
+        const double xNext = std::clamp(x + dxdy * dy, 0.0, static_cast<double>(width_));
+        const double d = dy * direction;
+        const double left = std::min(x, xNext), rightX = std::max(x, xNext);
+        const double leftFloor = std::floor(left);
+        const int leftCell = static_cast<int>(leftFloor);
+        const int rightCell = static_cast<int>(std::ceil(rightX));
+        if (rightCell <= leftCell + 1) {
+            // Within one pixel column: split the area by the edge's mean x
+            const double fraction = 0.5 * (x + xNext) - leftFloor;
+            row[leftCell] += static_cast<float>(d - d * fraction);
+            row[leftCell + 1] += static_cast<float>(d * fraction);
+            minX_ = std::min(minX_, leftCell);
+            maxX_ = std::max(maxX_, leftCell + 1);
+        } else {
+            // Across several columns: a ramp from the first to the last
+            const double inverse = 1.0 / (rightX - left);
+            const double leftFraction = left - leftFloor;
+            const double first = 0.5 * inverse * (1.0 - leftFraction) * (1.0 - leftFraction);
+            const double rightFraction = rightX - rightCell + 1;
+            const double last = 0.5 * inverse * rightFraction * rightFraction;
+            row[leftCell] += static_cast<float>(d * first);
+            if (rightCell == leftCell + 2) {
+                row[leftCell + 1] += static_cast<float>(d * (1.0 - first - last));
+            } else {
+                const double second = inverse * (1.5 - leftFraction);
+                row[leftCell + 1] += static_cast<float>(d * (second - first));
+                const float step = static_cast<float>(d * inverse);
+                for (int cell = leftCell + 2; cell < rightCell - 1; ++cell) {
+                    row[cell] += step;
+                }
+                const double beforeLast = second + (rightCell - leftCell - 3) * inverse;
+                row[rightCell - 1] += static_cast<float>(d * (1.0 - beforeLast - last));
+            }
+            row[rightCell] += static_cast<float>(d * last);
+            minX_ = std::min(minX_, leftCell);
+            maxX_ = std::max(maxX_, rightCell);
+        }
+        x = xNext;
+    }
+}
+
+void Rasterizer::fill(Framebuffer& target, FillRule rule, const uint8_t color[4], int originX, int originY) {
+    if (maxY_ >= minY_ && maxX_ >= minX_) {
+        // Past the last touched cell every running sum is back to zero
+        const int end = std::min(maxX_ + 1, width_);
+        const int count = end - minX_;
+        for (int y = minY_; y <= maxY_; ++y) {
+            float* row = cells_.data() + y * stride_;
+            if (count > 0) {
+                resolveSpan(row + minX_, coverage_.data(), count, rule);
+                compositeSpan(target.row(originY + y) + 4 * (originX + minX_), coverage_.data(), count, color);
+            }
+            std::fill(row + std::max(end, minX_), row + maxX_ + 1, 0.0f);
+        }
+    }
+    minX_ = width_;
+    maxX_ = -1;
+    minY_ = height_;
+    maxY_ = -1;
+}
+
+// --- RasterDevice ---
+
+struct PreparedPaint {
+    struct Edge {
+        Point from, to;
+    };
+    // A closed run of edges; one wholly outside a tile cannot change its winding numbers
+    struct Contour {
+        size_t first, count;
+        double minX, minY, maxX, maxY;
+    };
+    std::vector<Edge> edges;  // Device pixels
+    std::vector<Contour> contours;
+    FillRule rule = FillRule::NonZero;
+    uint8_t color[4] = {0, 0, 0, 255};
+    int minX = 0, minY = 0;   // Pixel bounds on the page; empty when maxX < minX
+    int maxX = -1, maxY = -1;
+};
+
+namespace {
+
+constexpr double FLATNESS = 0.2;    // Maximum curve deviation in device pixels
+constexpr double MITER_LIMIT = 10.0;
+
+/**
+ * Turns paint commands into device-space edges. Holds only scratch
+ * buffers, so each rendering thread keeps one and reuses it.
+ */
+class OutlineBuilder {
+public:
+    void build(const PaintCommand& command, const Matrix& toDevice, int width, int height, PreparedPaint& out);
+
+private:
+    struct Subpath {
+        size_t first;  // Index into points_
+        size_t count;
+        bool closed;
+    };
+
+    // Flatten into polylines (kept in user space) within FLATNESS device pixels
+    void flatten(const PSPath& path, const Matrix& toDevice);
+    void strokePolyline(Point* points, size_t count, bool closed, double halfWidth, const Matrix& toDevice,
+                        PreparedPaint& out);
+    static void addPolygon(const Matrix& toDevice, std::initializer_list<Point> points, PreparedPaint& out);
+    static void endContour(PreparedPaint& out, size_t first);
+
+    std::vector<Point> points_;
+    std::vector<Subpath> subpaths_;
+};
+
+void OutlineBuilder::build(const PaintCommand& command, const Matrix& toDevice, int width, int height,
+                           PreparedPaint& out) {
+    out.edges.clear();
+    out.contours.clear();
+    out.minX = out.minY = 0;
+    out.maxX = out.maxY = -1;
+    out.color[0] = toByte(command.r);
+    out.color[1] = toByte(command.g);
+    out.color[2] = toByte(command.b);
+    out.color[3] = 255;
+    if (command.path.empty()) {
+        return;
+    }
+
+    flatten(command.path, toDevice);
+    if (command.operation == PaintCommand::Operation::Stroke) {
+        double halfWidth = 0.5 * command.lineWidth;
+        if (halfWidth <= 0) {
+            // Width 0 asks for the thinnest visible line: one device pixel
+            double scale = std::sqrt(std::fabs(toDevice.determinant()));
+            if (scale == 0) {
+                return;
+            }
+            halfWidth = 0.5 / scale;
+        }
+        for (const Subpath& subpath : subpaths_) {
+            strokePolyline(points_.data() + subpath.first, subpath.count, subpath.closed, halfWidth, toDevice, out);
+        }
+        out.rule = FillRule::NonZero;
+    } else {
+        for (const Subpath& subpath : subpaths_) {
+            // Every subpath is implicitly closed for filling
+            const Point* points = points_.data() + subpath.first;
+            const size_t first = out.edges.size();
+            Point previous = toDevice.apply(points[subpath.count - 1]);
+            for (size_t i = 0; i < subpath.count; ++i) {
+                Point next = toDevice.apply(points[i]);
+                out.edges.push_back(PreparedPaint::Edge{previous, next});
+                previous = next;
+            }
+            endContour(out, first);
+        }
+        out.rule = command.operation == PaintCommand::Operation::EOFill ? FillRule::EvenOdd : FillRule::NonZero;
+    }
+
+    if (out.contours.empty()) {
+        return;
+    }
+    double minX = out.contours[0].minX, maxX = out.contours[0].maxX;
+    double minY = out.contours[0].minY, maxY = out.contours[0].maxY;
+    for (const PreparedPaint::Contour& contour : out.contours) {
+        minX = std::min(minX, contour.minX);
+        maxX = std::max(maxX, contour.maxX);
+        minY = std::min(minY, contour.minY);
+        maxY = std::max(maxY, contour.maxY);
+    }
+    if (!(maxX > 0 && maxY > 0 && minX < width && minY < height)) {
+        return; // Entirely off the page (or not finite)
+    }
+    out.minX = static_cast<int>(std::floor(std::max(minX, 0.0)));
+    out.minY = static_cast<int>(std::floor(std::max(minY, 0.0)));
+    out.maxX = static_cast<int>(std::ceil(std::min(maxX, static_cast<double>(width)))) - 1;
+    out.maxY = static_cast<int>(std::ceil(std::min(maxY, static_cast<double>(height)))) - 1;
+}
+
+void OutlineBuilder::flatten(const PSPath& path, const Matrix& toDevice) {
+    points_.clear();
+    subpaths_.clear();
+    Point current, start;
+    bool open = false;
+
+    auto beginSubpath = [&](const Point& point) {
+        subpaths_.push_back(Subpath{points_.size(), 1, false});
+        points_.push_back(point);
+        start = point;
+        open = true;
+    };
+    auto addPoint = [&](const Point& point) {
+        if (!open) {
+            beginSubpath(current);
+        }
+        points_.push_back(point);
+        ++subpaths_.back().count;
+    };
+
+    for (PSPath::Segment segment : path) {
+        const Point* p = segment.points;
+        switch (segment.verb) {
+            case PSPath::Verb::MoveTo:
+                beginSubpath(p[0]);
+                current = p[0];
+                break;
+            case PSPath::Verb::LineTo:
+                addPoint(p[0]);
+                current = p[0];
+                break;
+            case PSPath::Verb::CurveTo: {
+                // Wang's bound: enough pieces that each deviates at most FLATNESS pixels
+                Point d0 = toDevice.apply(current), d1 = toDevice.apply(p[0]);
+                Point d2 = toDevice.apply(p[1]), d3 = toDevice.apply(p[2]);
+                double dd = std::max(std::hypot(d0.x - 2 * d1.x + d2.x, d0.y - 2 * d1.y + d2.y),
+                                     std::hypot(d1.x - 2 * d2.x + d3.x, d1.y - 2 * d2.y + d3.y));
+                int pieces = std::clamp(static_cast<int>(std::ceil(std::sqrt(0.75 * dd / FLATNESS))), 1, 1024);
+                const Point p0 = current;
+                for (int i = 1; i <= pieces; ++i) {
+                    double t = static_cast<double>(i) / pieces, u = 1.0 - t;
+                    double w0 = u * u * u, w1 = 3 * u * u * t, w2 = 3 * u * t * t, w3 = t * t * t;
+                    addPoint(Point(w0 * p0.x + w1 * p[0].x + w2 * p[1].x + w3 * p[2].x,
+                                   w0 * p0.y + w1 * p[0].y + w2 * p[1].y + w3 * p[2].y));
+                }
+                current = p[2];
+                break;
+            }
+            case PSPath::Verb::ClosePath:
+                if (open) {
+                    subpaths_.back().closed = true;
+                    open = false;
+                }
+                current = start;
+                break;
+        }
+    }
+}
+
+void OutlineBuilder::strokePolyline(Point* points, size_t count, bool closed, double halfWidth,
+                                    const Matrix& toDevice, PreparedPaint& out) {
+    // Repeated points have no direction; drop them
+    size_t n = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (n == 0 || points[i].x != points[n - 1].x || points[i].y != points[n - 1].y) {
+            points[n++] = points[i];
+        }
+    }
+    if (closed && n > 1 && points[0].x == points[n - 1].x && points[0].y == points[n - 1].y) {
+        --n;
+    }
+    if (n < 2) {
+        return;
+    }
+
+    // The stroke is built in user space, so a non-uniform CTM shapes the pen too
+    auto direction = [&](size_t i) {
+        const Point& from = points[i];
+        const Point& to = points[(i + 1) % n];
+        double length = std::hypot(to.x - from.x, to.y - from.y);
+        return Point((to.x - from.x) / length, (to.y - from.y) / length);
+    };
+    auto normal = [&](const Point& u) { return Point(-u.y * halfWidth, u.x * halfWidth); };
+
+    const size_t segments = closed ? n : n - 1;
+    for (size_t i = 0; i < segments; ++i) {
+        const Point& from = points[i];
+        const Point& to = points[(i + 1) % n];
+        Point offset = normal(direction(i));
+        addPolygon(toDevice, {Point(from.x + offset.x, from.y + offset.y), Point(to.x + offset.x, to.y + offset.y),
+                              Point(to.x - offset.x, to.y - offset.y), Point(from.x - offset.x, from.y - offset.y)},
+                   out);
+    }
+
+    // Miter joins, falling back to bevels past the miter limit
+    const size_t firstJoin = closed ? 0 : 1;
+    const size_t lastJoin = closed ? n : n - 1;
+    for (size_t j = firstJoin; j < lastJoin; ++j) {
+        const Point& vertex = points[j];
+        Point before = direction((j + n - 1) % n);
+        Point after = direction(j);
+        double cross = before.x * after.y - before.y * after.x;
+        double dot = before.x * after.x + before.y * after.y;
+        if (std::fabs(cross) < 1e-12) {
+            continue;
+        }
+        // The outer side of a left turn is on the right
+        double side = cross > 0 ? -1.0 : 1.0;
+        Point n1 = normal(before), n2 = normal(after);
+        Point outer1(vertex.x + side * n1.x, vertex.y + side * n1.y);
+        Point outer2(vertex.x + side * n2.x, vertex.y + side * n2.y);
+        if (1.0 + dot > 0 && 1.0 / std::sqrt(0.5 * (1.0 + dot)) <= MITER_LIMIT) {
+            double reach = side / (1.0 + dot);
+            Point tip(vertex.x + reach * (n1.x + n2.x), vertex.y + reach * (n1.y + n2.y));
+            addPolygon(toDevice, {vertex, outer1, tip, outer2}, out);
+        } else {
+            addPolygon(toDevice, {vertex, outer1, outer2}, out);
+        }
+    }
+}
+
+void OutlineBuilder::addPolygon(const Matrix& toDevice, std::initializer_list<Point> points, PreparedPaint& out) {
+    Point device[4];
+    size_t count = 0;
+    for (const Point& point : points) {
+        device[count++] = toDevice.apply(point);
+    }
+    // One orientation for every stroke polygon, so overlaps add up under
+    // the nonzero rule instead of cancelling
+    double area = 0;
+    for (size_t i = 0, j = count - 1; i < count; j = i++) {
+        area += (device[j].x - device[i].x) * (device[j].y + device[i].y);
+    }
+    const size_t first = out.edges.size();
+    for (size_t i = 0; i < count; ++i) {
+        const Point& from = device[i];
+        const Point& to = device[(i + 1) % count];
+        out.edges.push_back(area >= 0 ? PreparedPaint::Edge{from, to} : PreparedPaint::Edge{to, from});
+    }
+    endContour(out, first);
+}
+
+void OutlineBuilder::endContour(PreparedPaint& out, size_t first) {
+    if (first == out.edges.size()) {
+        return;
+    }
+    PreparedPaint::Contour contour{first, out.edges.size() - first, out.edges[first].from.x, out.edges[first].from.y,
+                                   out.edges[first].from.x, out.edges[first].from.y};
+    for (size_t i = first; i < out.edges.size(); ++i) {
+        const Point& point = out.edges[i].to;  // Edges are chained, so the ends visit every vertex
+        contour.minX = std::min(contour.minX, point.x);
+        contour.maxX = std::max(contour.maxX, point.x);
+        contour.minY = std::min(contour.minY, point.y);
+        contour.maxY = std::max(contour.maxY, point.y);
+    }
+    out.contours.push_back(contour);
+}
+
+} // namespace
+
+RasterDevice::RasterDevice(double widthPoints, double heightPoints, double resolution) {
+    const double scale = resolution / 72.0;
+    const int width = std::max(1, static_cast<int>(std::ceil(widthPoints * scale)));
+    const int height = std::max(1, static_cast<int>(std::ceil(heightPoints * scale)));
+    // PostScript's y axis points up, the framebuffer's down
+    defaultMatrix_ = Matrix{scale, 0, 0, -scale, 0, static_cast<double>(height)};
+    page_ = Framebuffer(width, height);
+    page_.clear(255, 255, 255);
+}
+
+RasterDevice::~RasterDevice() = default;
+
+void RasterDevice::setThreadCount(size_t count) {
+    if (count != threadCount_) {
+        threadCount_ = count;
+        pool_.reset();
+    }
+}
+
+size_t RasterDevice::participants() const {
+    return threadCount_ > 0 ? threadCount_ : Threading::ThreadPool::hardwareThreads();
+}
+
+Matrix RasterDevice::deviceMatrix(const std::array<double, 6>& ctm) const {
+    return Matrix{ctm[0], ctm[1], ctm[2], ctm[3], ctm[4], ctm[5]}.then(defaultMatrix_);
+}
+
+void RasterDevice::paint(PaintCommand command) {
+    if (!command.path.empty()) {
+        displayList_.add(std::move(command));
+    }
+}
+
+void RasterDevice::replay(const DisplayList& list) {
+    size_t next = 0;
+    for (size_t end : list.pageEnds()) {
+        for (; next < end; ++next) {
+            paint(list[next]);
+        }
+        showpage();
+    }
+    for (; next < list.size(); ++next) {
+        paint(list[next]);
+    }
+}
+
+void RasterDevice::fill(const GraphicsState& gs, FillRule rule) {
+    paint(PaintCommand::fromState(
+        rule == FillRule::EvenOdd ? PaintCommand::Operation::EOFill : PaintCommand::Operation::Fill, gs));
+}
+
+void RasterDevice::stroke(const GraphicsState& gs) {
+    paint(PaintCommand::fromState(PaintCommand::Operation::Stroke, gs));
+}
+
+void RasterDevice::render() {
+    if (displayList_.empty()) {
+        return;
+    }
+    const size_t threads = participants();
+    if (threads > 1 && !pool_) {
+        // The rendering thread takes part, so it needs one worker fewer
+        pool_ = std::make_unique<Threading::ThreadPool>(threads - 1);
+    }
+    if (rasterizers_.size() < threads) {
+        rasterizers_.resize(threads);
+    }
+    auto forEach = [this](size_t count, const std::function<void(size_t, size_t)>& fn) {
+        if (pool_) {
+            pool_->parallelFor(count, fn);
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                fn(i, 0);
+            }
+        }
+    };
+
+    // Resolve every command to device-space edges
+    const size_t commandCount = displayList_.size();
+    if (prepared_.size() < commandCount) {
+        prepared_.resize(commandCount);
+    }
+    forEach(commandCount, [this](size_t index, size_t) {
+        thread_local OutlineBuilder builder;
+        const PaintCommand& command = displayList_[index];
+        builder.build(command, deviceMatrix(command.ctm), page_.width(), page_.height(), prepared_[index]);
+    });
+
+    // Bin commands into every tile their bounds touch, keeping painting order
+    const int tilesX = (page_.width() + TILE_SIZE - 1) / TILE_SIZE;
+    const int tilesY = (page_.height() + TILE_SIZE - 1) / TILE_SIZE;
+    bins_.resize(static_cast<size_t>(tilesX) * tilesY);
+    for (auto& bin : bins_) {
+        bin.clear();
+    }
+    for (size_t index = 0; index < commandCount; ++index) {
+        const PreparedPaint& paint = prepared_[index];
+        if (paint.maxX < paint.minX || paint.maxY < paint.minY) {
+            continue;
+        }
+        for (int ty = paint.minY / TILE_SIZE; ty <= paint.maxY / TILE_SIZE; ++ty) {
+            for (int tx = paint.minX / TILE_SIZE; tx <= paint.maxX / TILE_SIZE; ++tx) {
+                bins_[static_cast<size_t>(ty) * tilesX + tx].push_back(static_cast<uint32_t>(index));
+            }
+        }
+    }
+
+    // Tiles cover disjoint pixels, so they can be painted concurrently
+    forEach(bins_.size(), [this, tilesX](size_t tile, size_t slot) {
+        const std::vector<uint32_t>& bin = bins_[tile];
+        if (bin.empty()) {
+            return;
+        }
+        const int originX = static_cast<int>(tile % tilesX) * TILE_SIZE;
+        const int originY = static_cast<int>(tile / tilesX) * TILE_SIZE;
+        const int width = std::min(TILE_SIZE, page_.width() - originX);
+        const int height = std::min(TILE_SIZE, page_.height() - originY);
+        Rasterizer& rasterizer = rasterizers_[slot];
+        rasterizer.reset(width, height);
+        for (uint32_t index : bin) {
+            const PreparedPaint& paint = prepared_[index];
+            for (const PreparedPaint::Contour& contour : paint.contours) {
+                if (contour.maxX <= originX || contour.minX >= originX + width || contour.maxY <= originY ||
+                    contour.minY >= originY + height) {
+                    continue;
+                }
+                for (size_t i = contour.first; i < contour.first + contour.count; ++i) {
+                    const PreparedPaint::Edge& edge = paint.edges[i];
+                    rasterizer.addLine(Point(edge.from.x - originX, edge.from.y - originY),
+                                       Point(edge.to.x - originX, edge.to.y - originY));
+                }
+            }
+            rasterizer.fill(page_, paint.rule, paint.color, originX, originY);
+        }
+    });
+
+    displayList_.clear();
+}
+
+const Framebuffer& RasterDevice::page() {
+    render();
+    return page_;
+}
+
+void RasterDevice::showpage() {
+    render();
+    ++pageCount_;
+    if (pageHandler_) {
+        pageHandler_(page_, pageCount_);
+    }
+    page_.clear(255, 255, 255);
+}
+
+} // namespace PostScript
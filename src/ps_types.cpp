@@ -1,97 +1,186 @@
 #include "ps_types.h"
+#include <algorithm>
 #include <stdexcept>
 #include <sstream>
 
 namespace PostScript {
 
-int PSObject::asInteger() const {
-    if (type_ != ObjectType::INTEGER) {
-        throw std::runtime_error("Object is not an integer");
+namespace {
+
+thread_local PSSaveLog* activeLog = nullptr;
+std::atomic<uint64_t> nextSaveSerial{1};
+
+} // namespace
+
+uint64_t detail::activeSaveSerial() {
+    return activeLog ? activeLog->serial() : 0;
+}
+
+PSObject::PSObject(std::string value) : type_(ObjectType::STRING) {
+    payload_ = StringPayload::create(std::move(value));
+}
+
+PSObject::PSObject(PSArray array) : type_(ObjectType::ARRAY) {
+    payload_ = ArrayPayload::create(std::move(array));
+}
+
+PSObject::PSObject(PSDictionary dict) : type_(ObjectType::DICTIONARY) {
+    payload_ = DictionaryPayload::create(std::move(dict));
+}
+
+PSObject::PSObject(PSProcedure proc) : type_(ObjectType::PROCEDURE) {
+    payload_ = ProcedurePayload::create(std::move(proc));
+}
+
+std::atomic<uint32_t>& PSObject::refs() const {
+    // refs is the first member of every payload type
+    return static_cast<StringPayload*>(payload_)->refs;
+}
+
+void PSObject::destroy() {
+    switch (type_) {
+        case ObjectType::STRING:
+            StringPayload::destroy(static_cast<StringPayload*>(payload_));
+            break;
+        case ObjectType::ARRAY:
+            ArrayPayload::destroy(static_cast<ArrayPayload*>(payload_));
+            break;
+        case ObjectType::DICTIONARY:
+            DictionaryPayload::destroy(static_cast<DictionaryPayload*>(payload_));
+            break;
+        case ObjectType::PROCEDURE:
+            ProcedurePayload::destroy(static_cast<ProcedurePayload*>(payload_));
+            break;
+        default:
+            break;
     }
-    return std::get<int>(value_);
 }
 
-double PSObject::asReal() const {
-    if (type_ != ObjectType::REAL) {
-        throw std::runtime_error("Object is not a real number");
+void PSObject::setReadOnly() {
+    if (isComposite()) {
+        static_cast<ArrayPayload*>(payload_)->readOnly = true;
     }
-    return std::get<double>(value_);
 }
 
-std::string PSObject::asString() const {
-    if (type_ != ObjectType::STRING) {
-        throw std::runtime_error("Object is not a string");
+bool PSObject::isReadOnly() const {
+    return isComposite() && static_cast<ArrayPayload*>(payload_)->readOnly;
+}
+
+void PSObject::beforeChange() {
+    // readOnly, like refs, is at the same place in every payload type
+    if (static_cast<ArrayPayload*>(payload_)->readOnly) {
+        throw std::runtime_error(type_ == ObjectType::ARRAY ? "Array is read-only" : "Dictionary is read-only");
+    }
+    PSSaveLog* log = activeLog;
+    if (!log) {
+        return;
     }
-    return std::get<std::string>(value_);
+    uint64_t& saved = static_cast<ArrayPayload*>(payload_)->saved;
+    uint64_t serial = log->serial();
+    if (serial != 0 && saved != serial) {
+        log->record(*this);
+        saved = serial;
+    }
+}
+
+void PSObject::typeError(const char* expected) const {
+    throw std::runtime_error(std::string("Object is not ") + expected);
+}
+
+PSArray& PSObject::arrayValue() const {
+    return static_cast<ArrayPayload*>(payload_)->value;
+}
+
+PSDictionary& PSObject::dictionaryValue() const {
+    return static_cast<DictionaryPayload*>(payload_)->value;
 }
 
-bool PSObject::asBoolean() const {
-    if (type_ != ObjectType::BOOLEAN) {
-        throw std::runtime_error("Object is not a boolean");
+const std::string& PSObject::asString() const {
+    if (type_ != ObjectType::STRING) {
+        typeError("a string");
     }
-    return std::get<bool>(value_);
+    return stringValue();
 }
 
-PSArray PSObject::asArray() const {
+const PSArray& PSObject::asArray() const {
     if (type_ != ObjectType::ARRAY) {
-        throw std::runtime_error("Object is not an array");
+        typeError("an array");
     }
-    return std::get<PSArray>(value_);
+    return arrayValue();
 }
 
-PSDictionary PSObject::asDictionary() const {
+const PSDictionary& PSObject::asDictionary() const {
     if (type_ != ObjectType::DICTIONARY) {
-        throw std::runtime_error("Object is not a dictionary");
+        typeError("a dictionary");
     }
-    return std::get<PSDictionary>(value_);
+    return dictionaryValue();
 }
 
-PSProcedure PSObject::asProcedure() const {
+const PSProcedure& PSObject::asProcedure() const {
     if (type_ != ObjectType::PROCEDURE) {
-        throw std::runtime_error("Object is not a procedure");
+        typeError("a procedure");
+    }
+    return static_cast<ProcedurePayload*>(payload_)->value;
+}
+
+PSObject PSObject::duplicate() const {
+    switch (type_) {
+        case ObjectType::STRING:
+            return PSObject(stringValue());
+        case ObjectType::ARRAY:
+            return PSObject(arrayValue());
+        case ObjectType::DICTIONARY:
+            return PSObject(dictionaryValue());
+        case ObjectType::PROCEDURE:
+            return PSObject(asProcedure());
+        default:
+            return *this;
     }
-    return std::get<PSProcedure>(value_);
 }
 
 std::string PSObject::toString() const {
     switch (type_) {
         case ObjectType::INTEGER:
-            return std::to_string(std::get<int>(value_));
+            return std::to_string(integer_);
         case ObjectType::REAL: {
             std::ostringstream oss;
-            oss << std::get<double>(value_);
+            oss << real_;
             return oss.str();
         }
         case ObjectType::STRING:
-            return std::get<std::string>(value_);
+            return stringValue();
+        case ObjectType::NAME:
+            return "/" + NameTable::global().name(name_);
+        case ObjectType::OPERATOR:
+            return "--" + NameTable::global().name(aux_) + "--";
         case ObjectType::BOOLEAN:
-            return std::get<bool>(value_) ? "true" : "false";
+            return boolean_ ? "true" : "false";
         case ObjectType::ARRAY: {
-            const auto& array = std::get<PSArray>(value_);
+            const auto& array = arrayValue();
             std::ostringstream oss;
             oss << "[";
             for (size_t i = 0; i < array.size(); ++i) {
                 if (i > 0) oss << " ";
-                oss << array[i]->toString();
+                oss << array[i].toString();
             }
             oss << "]";
             return oss.str();
         }
         case ObjectType::DICTIONARY: {
-            const auto& dict = std::get<PSDictionary>(value_);
+            const auto& dict = dictionaryValue();
             std::ostringstream oss;
             oss << "<<";
             bool first = true;
             for (const auto& pair : dict) {
                 if (!first) oss << " ";
-                oss << "/" << pair.first << " " << pair.second->toString();
+                oss << "/" << NameTable::global().name(pair.first) << " " << pair.second.toString();
                 first = false;
             }
             oss << ">>";
             return oss.str();
         }
         case ObjectType::PROCEDURE: {
-            const auto& proc = std::get<PSProcedure>(value_);
+            const auto& proc = asProcedure().tokens;
             std::ostringstream oss;
             oss << "{";
             for (size_t i = 0; i < proc.size(); ++i) {
@@ -103,38 +192,42 @@ std::string PSObject::toString() const {
         }
         case ObjectType::NULL_OBJECT:
             return "null";
+        case ObjectType::SAVE:
+            return "-save-";
         default:
             return "unknown";
     }
 }
 
 // Array operations
-void PSObject::arrayAppend(const PSObjectPtr& obj) {
+void PSObject::arrayAppend(const PSObject& obj) {
     if (type_ != ObjectType::ARRAY) {
         throw std::runtime_error("Object is not an array");
     }
-    std::get<PSArray>(value_).push_back(obj);
+    beforeChange();
+    arrayValue().push_back(obj);
 }
 
-PSObjectPtr PSObject::arrayGet(size_t index) const {
+PSObject PSObject::arrayGet(size_t index) const {
     if (type_ != ObjectType::ARRAY) {
         throw std::runtime_error("Object is not an array");
     }
-    const auto& array = std::get<PSArray>(value_);
+    const auto& array = arrayValue();
     if (index >= array.size()) {
         throw std::runtime_error("Array index out of bounds");
     }
     return array[index];
 }
 
-void PSObject::arraySet(size_t index, const PSObjectPtr& obj) {
+void PSObject::arraySet(size_t index, const PSObject& obj) {
     if (type_ != ObjectType::ARRAY) {
         throw std::runtime_error("Object is not an array");
     }
-    auto& array = std::get<PSArray>(value_);
+    auto& array = arrayValue();
     if (index >= array.size()) {
         throw std::runtime_error("Array index out of bounds");
     }
+    beforeChange();
     array[index] = obj;
 }
 
@@ -142,51 +235,61 @@ size_t PSObject::arrayLength() const {
     if (type_ != ObjectType::ARRAY) {
         throw std::runtime_error("Object is not an array");
     }
-    return std::get<PSArray>(value_).size();
+    return arrayValue().size();
 }
 
 // Dictionary operations
-void PSObject::dictPut(const std::string& key, const PSObjectPtr& value) {
+bool PSObject::dictPut(NameId key, const PSObject& value) {
     if (type_ != ObjectType::DICTIONARY) {
         throw std::runtime_error("Object is not a dictionary");
     }
-    std::get<PSDictionary>(value_)[key] = value;
+    beforeChange();
+    return dictionaryValue().insert_or_assign(key, value).second;
 }
 
-PSObjectPtr PSObject::dictGet(const std::string& key) const {
+PSObject PSObject::dictGet(NameId key) const {
     if (type_ != ObjectType::DICTIONARY) {
         throw std::runtime_error("Object is not a dictionary");
     }
-    const auto& dict = std::get<PSDictionary>(value_);
+    const auto& dict = dictionaryValue();
     auto it = dict.find(key);
     if (it == dict.end()) {
-        throw std::runtime_error("Dictionary key not found: " + key);
+        throw std::runtime_error("Dictionary key not found: " + NameTable::global().name(key));
     }
     return it->second;
 }
 
-bool PSObject::dictHas(const std::string& key) const {
+bool PSObject::dictHas(NameId key) const {
     if (type_ != ObjectType::DICTIONARY) {
         return false;
     }
-    const auto& dict = std::get<PSDictionary>(value_);
+    const auto& dict = dictionaryValue();
     return dict.find(key) != dict.end();
 }
 
-void PSObject::dictRemove(const std::string& key) {
+const PSObject* PSObject::dictFind(NameId key) const {
+    if (type_ != ObjectType::DICTIONARY) {
+        return nullptr;
+    }
+    const auto& dict = dictionaryValue();
+    auto it = dict.find(key);
+    return it == dict.end() ? nullptr : &it->second;
+}
+
+void PSObject::dictRemove(NameId key) {
     if (type_ != ObjectType::DICTIONARY) {
         throw std::runtime_error("Object is not a dictionary");
     }
-    auto& dict = std::get<PSDictionary>(value_);
-    dict.erase(key);
+    beforeChange();
+    dictionaryValue().erase(key);
 }
 
-std::vector<std::string> PSObject::dictKeys() const {
+std::vector<NameId> PSObject::dictKeys() const {
     if (type_ != ObjectType::DICTIONARY) {
         throw std::runtime_error("Object is not a dictionary");
     }
-    const auto& dict = std::get<PSDictionary>(value_);
-    std::vector<std::string> keys;
+    const auto& dict = dictionaryValue();
+    std::vector<NameId> keys;
     keys.reserve(dict.size());
     for (const auto& pair : dict) {
         keys.push_back(pair.first);
@@ -194,4 +297,87 @@ std::vector<std::string> PSObject::dictKeys() const {
     return keys;
 }
 
+// A name that was never interned cannot be a key, so lookups only use find
+PSObject PSObject::dictGet(const std::string& key) const {
+    NameId id = NameTable::global().find(key);
+    if (id == NO_NAME) {
+        if (type_ != ObjectType::DICTIONARY) {
+            throw std::runtime_error("Object is not a dictionary");
+        }
+        throw std::runtime_error("Dictionary key not found: " + key);
+    }
+    return dictGet(id);
+}
+
+bool PSObject::dictHas(const std::string& key) const {
+    NameId id = NameTable::global().find(key);
+    return id != NO_NAME && dictHas(id);
+}
+
+const PSObject* PSObject::dictFind(const std::string& key) const {
+    NameId id = NameTable::global().find(key);
+    return id == NO_NAME ? nullptr : dictFind(id);
+}
+
+uint64_t PSSaveLog::push() {
+    uint64_t serial = nextSaveSerial.fetch_add(1, std::memory_order_relaxed);
+    levels_.push_back(Level{serial, entries_.size()});
+    return serial;
+}
+
+void PSSaveLog::rollBack(uint64_t serial) {
+    auto level = std::find_if(levels_.begin(), levels_.end(),
+                              [serial](const Level& open) { return open.serial == serial; });
+    if (level == levels_.end()) {
+        throw std::runtime_error("Save level is not active");
+    }
+    size_t first = level->firstEntry;
+    levels_.erase(level, levels_.end());
+    // Newest first, so an object recorded at several levels gets its oldest contents back
+    while (entries_.size() > first) {
+        Entry& entry = entries_.back();
+        if (entry.object.type_ == ObjectType::ARRAY) {
+            entry.object.arrayValue() = std::move(std::get<PSArray>(entry.contents));
+        } else {
+            entry.object.dictionaryValue() = std::move(std::get<PSDictionary>(entry.contents));
+        }
+        entries_.pop_back();
+    }
+}
+
+void PSSaveLog::clear() {
+    levels_.clear();
+    entries_.clear();
+}
+
+bool PSSaveLog::isOpen(uint64_t serial) const {
+    return std::any_of(levels_.begin(), levels_.end(), [serial](const Level& open) { return open.serial == serial; });
+}
+
+void PSSaveLog::record(const PSObject& object) {
+    // Copied to the heap, so rolling back does not tie the object to any save level's arena
+    if (object.type_ == ObjectType::ARRAY) {
+        const PSArray& array = object.arrayValue();
+        entries_.push_back(Entry{object, std::variant<PSArray, PSDictionary>(
+            std::in_place_type<PSArray>, array.begin(), array.end(), Memory::ArenaAllocator<PSObject>(nullptr))});
+    } else {
+        const PSDictionary& dict = object.dictionaryValue();
+        entries_.push_back(Entry{object, std::variant<PSArray, PSDictionary>(
+            std::in_place_type<PSDictionary>, dict.begin(), dict.end(), dict.bucket_count(), dict.hash_function(),
+            dict.key_eq(), Memory::ArenaAllocator<PSDictionary::value_type>(nullptr))});
+    }
+}
+
+PSSaveLog* PSSaveLog::active() {
+    return activeLog;
+}
+
+PSSaveLog::Scope::Scope(PSSaveLog& log) : previous_(activeLog) {
+    activeLog = &log;
+}
+
+PSSaveLog::Scope::~Scope() {
+    activeLog = previous_;
+}
+
 } // namespace PostScript 
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+namespace Threading {
+
+ThreadPool::ThreadPool(size_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = hardwareThreads();
+    }
+    workers_.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    available_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+namespace {
+
+// Shared by the participants of one parallelFor; outlives the call if a
+// worker only gets to its task after all the items are done
+struct ParallelForState {
+    struct Block {
+        std::mutex mutex;
+        size_t next = 0; // Owner takes from here
+        size_t end = 0;  // Thieves take from here
+    };
+
+    ParallelForState(size_t count, size_t participants)
+        : blocks(new Block[participants]), blockCount(participants), remaining(count) {
+        for (size_t p = 0; p < participants; ++p) {
+            blocks[p].next = count * p / participants;
+            blocks[p].end = count * (p + 1) / participants;
+        }
+    }
+
+    bool take(size_t slot, size_t& index) {
+        Block& own = blocks[slot];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.next == own.end) {
+            return false;
+        }
+        index = own.next++;
+        return true;
+    }
+
+    bool steal(size_t slot) {
+        for (size_t k = 1; k < blockCount; ++k) {
+            Block& victim = blocks[(slot + k) % blockCount];
+            size_t first, last;
+            {
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (victim.next == victim.end) {
+                    continue;
+                }
+                last = victim.end;
+                first = victim.next + (victim.end - victim.next) / 2;
+                victim.end = first;
+            }
+            Block& own = blocks[slot];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            own.next = first;
+            own.end = last;
+            return true;
+        }
+        return false;
+    }
+
+    void run(size_t slot) {
+        size_t index;
+        while (true) {
+            if (!take(slot, index)) {
+                if (!steal(slot)) {
+                    return;
+                }
+                continue;
+            }
+            if (!failed.load(std::memory_order_relaxed)) {
+                try {
+                    (*fn)(index, slot);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(doneMutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                    failed.store(true, std::memory_order_relaxed);
+                }
+            }
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(doneMutex);
+                done.notify_all();
+            }
+        }
+    }
+
+    std::unique_ptr<Block[]> blocks;
+    size_t blockCount;
+    const std::function<void(size_t, size_t)>* fn = nullptr; // Valid while items remain
+    std::atomic<size_t> remaining;
+    std::atomic<bool> failed{false}; // Skip the rest once an item has thrown
+    std::mutex doneMutex;
+    std::condition_variable done;
+    std::exception_ptr error;
+};
+
+} // namespace
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t index, size_t slot)>& fn) {
+    const size_t participants = std::min(count, workers_.size() + 1);
+    if (participants <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            fn(i, 0);
+        }
+        return;
+    }
+
+    auto state = std::make_shared<ParallelForState>(count, participants);
+    state->fn = &fn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t slot = 1; slot < participants; ++slot) {
+            tasks_.emplace([state, slot]() { state->run(slot); });
+        }
+    }
+    available_.notify_all();
+
+    state->run(0);
+    std::unique_lock<std::mutex> lock(state->doneMutex);
+    state->done.wait(lock, [&state]() { return state->remaining.load(std::memory_order_acquire) == 0; });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+size_t ThreadPool::hardwareThreads() {
+    unsigned count = std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            available_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                return; // stopping and drained
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+        task();
+    }
+}
+
+} // namespace Threading